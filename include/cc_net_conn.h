@@ -22,6 +22,7 @@
 
 #include "cc_pollthr_mgr.h"
 #include "cc_of_lib.h"
+#include "cc_of_msg.h"
 #include <netinet/in.h>
 
 #define MAXBUF 4096 
@@ -29,6 +30,13 @@
 /* For most of the systems(32/64 bit) have this as 
  * hard limit for max files open. 
  */
+/* dummy fds of a controller's UDP channels, one per peer, follow the
+ * real ones: MAX_OPEN_FILES up to MAX_OPEN_FILES + CC_OFRW_UDP_PEERS_MAX.
+ * Freed ones are handed out again.
+ */
+#define CC_OFRW_UDP_PEERS_MAX 65536
+/* slots of the rw socket table, see cc_ofrw_tbl_t */
+#define CC_OFRW_TBL_SLOTS (MAX_OPEN_FILES + CC_OFRW_UDP_PEERS_MAX)
 
 typedef uint32_t ipaddr_v4_t;
 typedef ipaddr_v4_t ipaddr_v4v6_t;
@@ -63,6 +71,63 @@ typedef struct cc_ofchannel_info_ {
     cc_ofstats_t          stats;    
 } cc_ofchannel_info_t;
 
+/* reconnect of a switch channel that went down: waiting for its poll
+ * thread timer, or connecting again. Kept in ofreconn_htbl by channel
+ * key until the channel is up or deleted.
+ */
+typedef struct cc_ofchann_reconn_ {
+    cc_ofdev_key_t       dev_key;
+    L4_type_e            layer4_proto;
+    cc_of_conn_state_e   state;  /* CC_OF_CONN_BACKOFF or _CONNECTING */
+    uint32_t             count_retries;
+    uint32_t             gen;    /* of the timer armed for it */
+} cc_ofchann_reconn_t;
+
+/* poll thread timer of a reconnect; owned by the timer wheel, stale if
+ * the reconnect is no longer in ofreconn_htbl with the same gen
+ */
+typedef struct cc_ofchann_reconn_timer_ {
+    adpoll_timer_t       timer;
+    cc_ofchannel_key_t   chann_key;
+    uint32_t             gen;
+} cc_ofchann_reconn_timer_t;
+
+/* send route of a channel: where cc_of_send_pkt hands its messages */
+typedef struct cc_ofchann_route_ {
+    cc_ofchannel_key_t   key;
+    gboolean             in_use;
+    int                  rw_sockfd;
+    uint32_t             fd_gen;      /* of rw_sockfd, for its messages */
+    adpoll_thread_mgr_t  *thr_mgr_p;  /* NULL until the first send */
+} cc_ofchann_route_t;
+
+/* open addressed route array of a shard, replaced as a whole on grow */
+typedef struct cc_ofchann_routes_ {
+    uint32_t             size;   /* power of 2 */
+    cc_ofchann_route_t   *route;
+} cc_ofchann_routes_t;
+
+/* read-mostly copy of ofchannel_htbl for the send path, sharded by
+ * dp_id. Readers take no lock: they retry if seq was odd (a writer
+ * was in the shard) or moved while they looked. Writers are serialized
+ * by the shard lock. Route arrays replaced on grow are kept on retired
+ * until the table is freed, as a reader may still be walking one.
+ */
+#define CC_OFCHANN_SHARDS          16
+#define CC_OFCHANN_SHARD_INIT_SIZE 64
+
+typedef struct cc_ofchann_shard_ {
+    gint                 seq;
+    GMutex               lock;
+    cc_ofchann_routes_t  *routes;
+    uint32_t             count;
+    GList                *retired;
+} __attribute__ ((aligned(ADPOLL_CACHELINE))) cc_ofchann_shard_t;
+
+typedef struct cc_ofchann_rtbl_ {
+    cc_ofchann_shard_t   shard[CC_OFCHANN_SHARDS];
+} cc_ofchann_rtbl_t;
+
 /* node in ofdev_htbl */
 typedef struct cc_ofdev_info_ {
     cc_ofver_e     of_max_ver;  /* cc_ofver_e */
@@ -70,11 +135,18 @@ typedef struct cc_ofdev_info_ {
     GList          *ofrw_socket_list; //list of rw sockets
 
     cc_of_recv_pkt recv_func; /* cc_of_recv_pkt function ptr */
+    cc_of_recv_pkt_batch recv_batch_func; /* optional, used over recv_func */
     cc_of_accept_channel accept_chann_func; /* cc_of_accept_channel func ptr */
     cc_of_delete_channel del_chann_func;/* cc_of_delete_channel function ptr */
+    cc_of_channel_up chann_up_func; /* switch, optional */
+    cc_of_channel_ready chann_ready_func; /* controller, optional */
 
     int            main_sockfd_tcp;
     int            main_sockfd_udp;
+    /* TCP listeners are on the rw poll threads, not oflisten_pollthr_p;
+     * they are closed with ofrw_socket_list
+     */
+    gboolean       tcp_listen_rw;
 } cc_ofdev_info_t;
 
 typedef enum cc_ofrw_state_ {
@@ -86,7 +158,7 @@ typedef struct cc_ofrw_key_ {
     int       rw_sockfd;    
 } cc_ofrw_key_t;
 
-/* node in ofrw_htbl */
+/* node in ofrw_tbl */
 typedef struct cc_ofrw_info_ {
     cc_ofrw_state_e      state;
     /* needed for easier lookup of device given the rwsocket */
@@ -94,8 +166,121 @@ typedef struct cc_ofrw_info_ {
     L4_type_e            layer4_proto;
     struct sockaddr_in   client_addr; /* needed for UDP connections */
     adpoll_thread_mgr_t  *thr_mgr_p;
+    /* controller UDP channel: the UDP socket its datagrams came in on
+     * and that its messages are sent on. -1 for other sockets.
+     */
+    int                  parent_sockfd;
 } cc_ofrw_info_t;
 
+struct cc_ofrw_ctx_;
+
+/* slot of the rw socket table, one cache line each */
+typedef struct cc_ofrw_slot_ {
+    cc_ofrw_info_t       info;
+    /* receive context of the socket on its poll thread, once it has
+     * one - see cc_ofrw_ctx_update
+     */
+    struct cc_ofrw_ctx_  *ctx;
+    gboolean             in_use;
+    /* g_atomic_int, never 0: bumped when the fd is added or deleted */
+    gint                 gen;
+    /* g_atomic_int: bumped on every change to what ctx caches - the
+     * rw entry, its channel or its device
+     */
+    gint                 ctx_gen;
+    uint32_t             pos;   /* index of the fd in cc_ofrw_tbl_t fds */
+} __attribute__ ((aligned(ADPOLL_CACHELINE))) cc_ofrw_slot_t;
+
+/* rw socket table: socket fds are small and dense, so the slots are
+ * indexed by fd directly. The slots for every fd, dummy UDP ones
+ * included, are mapped once as anonymous memory that is only backed
+ * once touched, and never move: poll threads read a slot's gen without
+ * ofrw_htbl_lock. fds lists the slots in use for walks. Lookups hand
+ * out pointers into it that are only valid while ofrw_htbl_lock is
+ * held.
+ */
+typedef struct cc_ofrw_tbl_ {
+    cc_ofrw_slot_t       *slots;
+    uint32_t             size;   /* number of slots */
+    uint32_t             count;  /* slots in use */
+    int                  *fds;   /* fds of the slots in use */
+    uint32_t             fds_size;
+    /* UDP peer (cc_ofrw_peer_key) -> dummy fd, for the controller to
+     * demultiplex datagrams on its one UDP socket
+     */
+    GHashTable           *peer_htbl;
+    /* dummy fds: never handed out yet from dummy_next, freed ones on
+     * dummy_free (int)
+     */
+    int                  dummy_next;
+    GArray               *dummy_free;
+} cc_ofrw_tbl_t;
+
+/* request of cc_of_send_request waiting for its reply. It goes to the
+ * poll thread with its send message (req), and is put in the xid table
+ * of the socket's receive context when the message is sent.
+ */
+typedef struct cc_of_xid_req_ {
+    uint32_t             xid;
+    uint64_t             dp_id;
+    uint8_t              aux_id;
+    uint32_t             timeout_ms;  /* 0 - no timeout */
+    cc_of_reply          reply_func;
+    /* instead of reply_func: parts are copied to mp_data, their
+     * lengths to mp_lens, until the last one
+     */
+    cc_of_multipart_reply mp_func;
+    GByteArray           *mp_data;
+    GArray               *mp_lens;    /* size_t */
+    void                 *reply_ctx;
+    adpoll_timer_t       timer;
+    struct cc_ofrw_ctx_  *rw_ctx;     /* xid table it is in, or NULL */
+} cc_of_xid_req_t;
+
+/* receive context of a rw socket, kept in its poll thread fd entry
+ * (adpoll_fd_info_t user_ctx). Only the poll thread touches it, so the
+ * receive path reads it without the htbl locks; it is filled again from
+ * the htbls whenever the ctx_gen of the socket's slot has moved.
+ */
+typedef struct cc_ofrw_ctx_ {
+    gboolean             cached;  /* filled at least once */
+    gint                 gen;     /* slot ctx_gen when it was filled */
+    gboolean             found;   /* socket has channel, rw and dev entries */
+    cc_ofchannel_key_t   chann_key;
+    cc_ofrw_state_e      state;
+    cc_of_recv_pkt       recv_func;
+    cc_of_recv_pkt_batch recv_batch_func;
+    cc_of_accept_channel accept_chann_func;
+    cc_of_channel_up     chann_up_func;
+    cc_of_channel_ready  chann_ready_func;
+    cc_of_msg_rx_t       *rx;     /* TCP only - OF message reassembly */
+    int                  sockfd;
+    adpoll_thread_mgr_t  *thr_mgr_p;
+    /* TCP hello exchange: nothing is delivered before it is done */
+    uint32_t             of_bitmap;     /* versions of the device */
+    gboolean             hello_done;
+    gboolean             setup_failed;  /* hello or features exchange */
+    gboolean             close_pending; /* once the send queue is out */
+    /* controller: FEATURES_REQUEST sent for the real dp_id/aux_id,
+     * nothing is delivered before its reply
+     */
+    gboolean             features_pending;
+    /* negotiated, read by cc_of_get_conn_version */
+    volatile gint        of_version;
+    /* TCP echo keepalive, see cc_of_set_echo */
+    gboolean             echo_started;
+    adpoll_timer_t       echo_timer;
+    uint32_t             echo_xid;      /* of the last echo request sent */
+    gint64               echo_sent_at;  /* 0 if it was answered */
+    uint32_t             echo_missed;   /* replies missed in a row */
+    /* read by cc_of_get_conn_rtt through the rw socket table */
+    volatile gint        rtt_us;
+    volatile gint        srtt_us;
+    volatile gint        min_rtt_us;
+    /* xid -> cc_of_xid_req_t, created with the first request */
+    GHashTable           *xid_htbl;
+} cc_ofrw_ctx_t;
+
 typedef struct net_svcs_ {
     int (*open_clientfd)(cc_ofdev_key_t key, cc_ofchannel_key_t ofchann_key);
     int (*open_serverfd)(cc_ofdev_key_t key);
@@ -31,6 +31,19 @@
 
 #define MAX_PER_THREAD_PIPES          0 /* no additional pipes */
 
+/* default coalescing of queued messages per POLLOUT on a socket */
+#define CC_OF_SEND_MAX_IOV           64
+#define CC_OF_SEND_MAX_BYTES         (256 * 1024)
+#define CC_OF_SEND_IOV_LIMIT         1024 /* UIO_MAXIOV */
+
+/* default backoff of switch channel reconnects */
+#define CC_OF_RECONN_BASE_MS         100
+#define CC_OF_RECONN_MAX_MS          (30 * 1000)
+
+/* default echo keepalive of TCP channels */
+#define CC_OF_ECHO_INTERVAL_MS       (5 * 1000)
+#define CC_OF_ECHO_MAX_MISSED        3
+
 typedef struct cc_of_global_ {
     /* layer4 device type could be switch or controller */
     of_dev_type_e     ofdev_type;
@@ -42,9 +55,13 @@ typedef struct cc_of_global_ {
     /* node:  cc_ofchannel_info_t */
     GHashTable       *ofchannel_htbl;
     GMutex	         ofchannel_htbl_lock;
+    /* rw_sockfd -> cc_ofchannel_key_t, under ofchannel_htbl_lock */
+    GHashTable       *ofchann_fd_htbl;
+    /* channel send routes, lock-free readers; follows ofchannel_htbl */
+    cc_ofchann_rtbl_t ofchann_rtbl;
 
-    /*node: cc_ofrw_info_t */
-    GHashTable       *ofrw_htbl;
+    /*node: cc_ofrw_info_t, indexed by rw sockfd */
+    cc_ofrw_tbl_t    ofrw_tbl;
     GMutex           ofrw_htbl_lock;
     
     net_svcs_t       NET_SVCS[MAX_L4_TYPE];
@@ -54,6 +71,42 @@ typedef struct cc_of_global_ {
     GList            *ofrw_pollthr_list; /* adpoll_thread_mgr elems */
     GMutex           ofrw_pollthr_list_lock;
 
+    /* event backend for new poll threads, epoll by default */
+    adpoll_backend_e ofpoll_backend;
+    /* event backend for rw poll threads - can also be io_uring */
+    adpoll_backend_e ofrw_backend;
+
+    /* max messages and bytes written per POLLOUT; 0 is the default */
+    uint32_t         ofsend_max_iov;
+    uint32_t         ofsend_max_bytes;
+
+    /* UDP sockets opened by a controller device, one per rw poll thread;
+     * 0 opens none
+     */
+    uint32_t         ofudp_num_sockets;
+
+    /* TCP listeners opened by a controller device. More than 1 are
+     * served by the rw poll threads, else by oflisten_pollthr_p
+     */
+    uint32_t         oftcp_num_listeners;
+
+    /* SWITCH: backoff of channel reconnects, base 0 turns them off */
+    uint32_t         ofreconn_base_ms;
+    uint32_t         ofreconn_max_ms;
+    uint32_t         ofreconn_max_retries; /* 0: forever */
+    /* cc_ofchannel_key_t -> cc_ofchann_reconn_t of the channels being
+     * reconnected, under ofchannel_htbl_lock
+     */
+    GHashTable       *ofreconn_htbl;
+
+    /* echo requests answered on the poll threads, and echoes sent
+     * every ofecho_interval_ms (0: none) to measure RTT. A channel
+     * missing ofecho_max_missed (0: no limit) replies in a row is down.
+     */
+    gboolean         ofecho_offload;
+    uint32_t         ofecho_interval_ms;
+    uint32_t         ofecho_max_missed;
+
     /* debugs and log file */
     FILE             *oflog_fd;
     char             *oflog_file;
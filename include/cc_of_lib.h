@@ -20,9 +20,6 @@
 #ifndef CC_OF_LIB_H
 #define CC_OF_LIB_H
 
-#define SEND_MSG_BUF_SIZE 1024
-char SEND_MSG_BUF[SEND_MSG_BUF_SIZE];
-
 //CC_OF_LIB error codes
 typedef int cc_of_ret;
 #define CC_OF_OK        0
@@ -36,6 +33,7 @@ typedef int cc_of_ret;
 #define CC_OF_ECHANN   -8  /* unable to establish socket */
 #define CC_OF_EEXIST   -9  /* already exists */
 #define CC_OF_EMISC    -10 /* misc error */
+#define CC_OF_ETIMEOUT -11 /* timed out */
 
 
 static const char * cc_of_errtable[] = {
@@ -50,6 +48,7 @@ static const char * cc_of_errtable[] = {
     "unable to establish sockets",
     "already exists",
     "misc error",
+    "timed out",
 };
 
 inline const char *cc_of_strerror(int errnum);
@@ -77,6 +76,22 @@ typedef enum of_dev_type_ {
     MAX_OF_DEV_TYPE
 } of_dev_type_e;
 
+/* how the rw poll threads wait for and do socket I/O */
+typedef enum cc_of_pollmode_ {
+    CC_OF_POLLMODE_EPOLL = 0, /* default */
+    CC_OF_POLLMODE_POLL,
+    CC_OF_POLLMODE_IOURING,   /* falls back to epoll if not supported */
+    MAX_POLLMODE_TYPE
+} cc_of_pollmode_e;
+
+/* state of a channel, see cc_of_get_conn_state */
+typedef enum cc_of_conn_state_ {
+    CC_OF_CONN_UP = 0,
+    CC_OF_CONN_CONNECTING,  /* switch: connect in progress */
+    CC_OF_CONN_BACKOFF,     /* switch: waiting to reconnect */
+    MAX_CONN_STATE
+} cc_of_conn_state_e;
+
 #define CC_OF_ERRTABLE_SIZE (sizeof(cc_of_errtable) / sizeof(cc_of_errtable[0]))
 
 
@@ -92,12 +107,56 @@ typedef enum of_dev_type_ {
  *
  * Notes:
  * 01. This will be a callback. 
+ * 02. On TCP channels it is called once per complete OF message, header
+ *     included; partial and back to back messages are handled by the
+ *     library. of_msg is only valid during the call.
  *
  */
 typedef int (*cc_of_recv_pkt)(uint64_t dp_id, uint8_t aux_id,
-                              void *of_msg, 
+                              void *of_msg,
                               size_t of_msg_len);
 
+/* one received OF message handed to cc_of_recv_pkt_batch */
+typedef struct cc_of_recv_msg_ {
+    uint64_t dp_id;
+    uint8_t  aux_id;
+    void     *of_msg;
+    size_t   of_msg_len;
+} cc_of_recv_msg_t;
+
+/* max number of messages in one cc_of_recv_pkt_batch call */
+#define CC_OF_RECV_BATCH_MAX 64
+
+/* max number of UDP sockets of a device, see cc_of_set_udp_sockets */
+#define CC_OF_UDP_MAX_SOCKETS 16
+
+/* max number of TCP listeners of a device, see cc_of_set_tcp_listeners */
+#define CC_OF_TCP_MAX_LISTENERS 16
+
+/**
+ * cc_of_recv_pkt_batch
+ *
+ * Description:
+ * This callback function is called by the library with the OF messages
+ * received in one read from a channel socket.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. This will be a callback. It is optional and is registered with
+ *     cc_of_dev_register_recv_batch(); when registered it is called
+ *     instead of cc_of_recv_pkt.
+ * 02. msgs holds num_msgs (1..CC_OF_RECV_BATCH_MAX) messages in the order
+ *     they were received. A read with more messages than that results in
+ *     more than one call.
+ * 03. The msgs array and the of_msg buffers are only valid during the
+ *     call.
+ *
+ */
+typedef int (*cc_of_recv_pkt_batch)(cc_of_recv_msg_t *msgs,
+                                    uint32_t num_msgs);
+
 
 /**
  * cc_of_accept_channel
@@ -115,6 +174,10 @@ typedef int (*cc_of_recv_pkt)(uint64_t dp_id, uint8_t aux_id,
  * Notes:
  * 01. This will be a callback. 
  *
+ * 02. For a TCP channel it is called once the library's OF hello
+ *     exchange with the switch agreed on a version; a switch with no
+ *     version in common is closed without the controller being told.
+ *
  */
 typedef int (*cc_of_accept_channel)(uint64_t dummy_dpid,
                                     uint8_t dummy_auxid,
@@ -135,11 +198,138 @@ typedef int (*cc_of_accept_channel)(uint64_t dummy_dpid,
  *
  * Notes:
  * 01. This will be a callback. 
+ * 02. On a controller it is how the application learns that a switch
+ *     closed its TCP channel or that the channel failed; the library
+ *     has closed the socket by then.
  *
  */
 typedef int (*cc_of_delete_channel)(uint64_t dpid,
                                     uint8_t auxid);
 
+
+/**
+ * cc_of_channel_up
+ *
+ * Description:
+ * This callback function is called by the library on the switch
+ * when the connection of a channel created with cc_of_create_channel()
+ * to the controller is established.
+ *
+ * No-op for controller
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. This will be a callback. It is optional and is registered with
+ *     cc_of_dev_register_chann_up().
+ * 02. If the connection cannot be established the channel is deleted
+ *     and cc_of_delete_channel is called instead.
+ * 03. The library sends and answers the OF hello itself; the channel
+ *     is up once the hello exchange agreed on a version. See
+ *     cc_of_get_conn_version().
+ *
+ */
+typedef int (*cc_of_channel_up)(uint64_t dp_id,
+                                uint8_t aux_id);
+
+/**
+ * cc_of_channel_ready
+ *
+ * Description:
+ * This callback function is called by the library on the controller
+ * when a new TCP channel is known by its real dp_id/aux_id: the
+ * library sent the switch an OFPT_FEATURES_REQUEST after the hello
+ * exchange and moved the channel to the ids of the FEATURES_REPLY.
+ *
+ * No-op for switch
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. This will be a callback. It is optional and is registered with
+ *     cc_of_dev_register_chann_ready(). When it is registered it is
+ *     called instead of cc_of_accept_channel, and
+ *     cc_of_set_real_dpid_auxid() is not needed.
+ * 02. The FEATURES_REPLY itself is delivered to cc_of_recv_pkt right
+ *     after; nothing else is delivered on the channel before it.
+ * 03. A channel whose reply is bad, or whose ids are in use by
+ *     another channel, is closed without the controller being told.
+ *
+ */
+typedef int (*cc_of_channel_ready)(uint64_t dp_id,
+                                   uint8_t aux_id,
+                                   uint32_t client_ip,
+                                   uint16_t client_port);
+
+/**
+ * cc_of_reply
+ *
+ * Description:
+ * This callback function is called by the library with the reply to a
+ * request sent with cc_of_send_request(), on the polling thread of the
+ * channel. The reply is the OF message from the peer with the xid of
+ * the request - a barrier reply, a multipart reply, an error, ... - and
+ * is not given to cc_of_recv_pkt.
+ *
+ * Returns:
+ * None
+ *
+ * Notes:
+ * 01. This will be a callback. of_msg is only valid during the call.
+ * 02. status is CC_OF_OK with a reply. Without one (of_msg NULL) it is
+ *     CC_OF_ETIMEOUT if none came within the timeout of the request,
+ *     CC_OF_ECHANN if the channel went down first and CC_OF_EEXIST if
+ *     a request with the same xid was still waiting on the channel.
+ * 03. A multipart reply calls it once per part; the request is done
+ *     with the part that does not have the REPLY_MORE flag.
+ *
+ */
+typedef void (*cc_of_reply)(uint64_t dp_id,
+                            uint8_t aux_id,
+                            uint32_t xid,
+                            void *of_msg,
+                            size_t of_msg_len,
+                            cc_of_ret status,
+                            void *reply_ctx);
+
+/* one message of a reply gathered by the library, see
+ * cc_of_multipart_reply
+ */
+typedef struct cc_of_msg_part_ {
+    void   *of_msg;
+    size_t of_msg_len;
+} cc_of_msg_part_t;
+
+/**
+ * cc_of_multipart_reply
+ *
+ * Description:
+ * This callback function is called by the library once with all the
+ * parts of the reply to a request sent with
+ * cc_of_send_multipart_request(), on the polling thread of the channel,
+ * when the part without the REPLY_MORE flag arrives.
+ *
+ * Returns:
+ * None
+ *
+ * Notes:
+ * 01. This will be a callback. parts[] holds num_parts OF messages in
+ *     the order they were received and is only valid during the call.
+ * 02. status is as for cc_of_reply. The parts received before a
+ *     timeout or the loss of the channel are still passed.
+ * 03. The last part can be an error, which also ends the reply.
+ *
+ */
+typedef void (*cc_of_multipart_reply)(uint64_t dp_id,
+                                      uint8_t aux_id,
+                                      uint32_t xid,
+                                      cc_of_msg_part_t *parts,
+                                      uint32_t num_parts,
+                                      cc_of_ret status,
+                                      void *reply_ctx);
+
 /**
  * cc_of_lib_init
  *
@@ -162,6 +352,28 @@ typedef int (*cc_of_delete_channel)(uint64_t dpid,
 cc_of_ret 
 cc_of_lib_init(of_dev_type_e dev_type);
 
+/**
+ * cc_of_lib_init_pollmode
+ *
+ * Description:
+ * Same as cc_of_lib_init, with the poll mode of the read-write
+ * poll threads.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. CC_OF_POLLMODE_IOURING batches the socket reads and writes of
+ *     the TCP channels through io_uring. If the kernel does not support
+ *     it the library uses CC_OF_POLLMODE_EPOLL.
+ *
+ * 02. The listen poll thread always uses epoll, or poll() with
+ *     CC_OF_POLLMODE_POLL.
+ */
+cc_of_ret
+cc_of_lib_init_pollmode(of_dev_type_e dev_type,
+                        cc_of_pollmode_e pollmode);
+
 cc_of_ret
 cc_of_lib_free(void);
 
@@ -175,6 +387,70 @@ cc_of_dev_register(uint32_t controller_ip,
                    cc_of_delete_channel del_func);
 /* possible additional fields for TLS certificate */
 
+/**
+ * cc_of_dev_register_recv_batch
+ *
+ * Description:
+ * This function registers a batched receive callback for a device
+ * already registered with cc_of_dev_register().
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. Once registered, received messages of the device are delivered
+ *     through recv_batch_func instead of the cc_of_recv_pkt callback.
+ *     Passing NULL goes back to cc_of_recv_pkt.
+ *
+ */
+cc_of_ret
+cc_of_dev_register_recv_batch(uint32_t controller_ip,
+                              uint32_t switch_ip,
+                              uint16_t controller_L4_port,
+                              cc_of_recv_pkt_batch recv_batch_func);
+
+/**
+ * cc_of_dev_register_chann_up
+ *
+ * Description:
+ * This function registers the channel up callback for a switch device
+ * already registered with cc_of_dev_register().
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. Passing NULL clears it.
+ *
+ */
+cc_of_ret
+cc_of_dev_register_chann_up(uint32_t controller_ip,
+                            uint32_t switch_ip,
+                            uint16_t controller_L4_port,
+                            cc_of_channel_up chann_up_func);
+
+/**
+ * cc_of_dev_register_chann_ready
+ *
+ * Description:
+ * This function registers the channel ready callback for a controller
+ * device already registered with cc_of_dev_register(). With it the
+ * library finds the dp_id/aux_id of each new TCP channel itself.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. Passing NULL clears it. It applies to the channels whose hello
+ *     exchange completes afterwards.
+ *
+ */
+cc_of_ret
+cc_of_dev_register_chann_ready(uint32_t controller_ip,
+                               uint32_t switch_ip,
+                               uint16_t controller_L4_port,
+                               cc_of_channel_ready chann_ready_func);
+
 cc_of_ret
 cc_of_dev_free(uint32_t controller_ip,
                uint32_t switch_ip,
@@ -196,6 +472,14 @@ cc_of_dev_free_lockfree(uint32_t controller_ip,
  * Returns:
  * Status
  *
+ * Notes:
+ * 01. TCP channels are connected asynchronously: the call returns once
+ *     the connect is started. cc_of_channel_up is called when the
+ *     channel is connected, or cc_of_delete_channel if it could not be
+ *     and reconnect attempts ran out (see cc_of_set_reconnect).
+ * 02. Messages sent before the channel is up are sent once it is.
+ * 03. A channel the controller closes is reconnected the same way.
+ *
  */
 cc_of_ret
 cc_of_create_channel(uint32_t controller_ip,
@@ -230,6 +514,11 @@ cc_of_destroy_channel(uint64_t dp_id,
  *
  * Returns:
  * Status
+ *
+ * Notes:
+ * 01. of_msg is copied once into a library buffer and can be reused
+ *     as soon as the call returns. Use cc_of_send_buf_alloc() and
+ *     cc_of_send_pkt_buf() to avoid the copy.
  */
 cc_of_ret
 cc_of_send_pkt(uint64_t dp_id, 
@@ -238,6 +527,149 @@ cc_of_send_pkt(uint64_t dp_id,
                size_t msg_len);
 
 
+/**
+ * cc_of_send_buf_alloc
+ * 
+ * Description:
+ * This function returns a library owned buffer of at least msg_len
+ * bytes from the send buffer pool. The OF message is built directly
+ * in this buffer and handed over with cc_of_send_pkt_buf().
+ *
+ * Returns:
+ * Pointer to the buffer, NULL if out of memory
+ *
+ * Notes:
+ * 01. Thread safe. There is no limit on msg_len.
+ */
+void *
+cc_of_send_buf_alloc(size_t msg_len);
+
+
+/**
+ * cc_of_send_buf_free
+ * 
+ * Description:
+ * This function returns a buffer from cc_of_send_buf_alloc() that
+ * was not handed over with cc_of_send_pkt_buf() to the pool.
+ */
+void
+cc_of_send_buf_free(void *buf);
+
+
+/**
+ * cc_of_send_pkt_buf
+ * 
+ * Description:
+ * This function sends the first msg_len bytes of buf, a buffer from
+ * cc_of_send_buf_alloc(), to the switch without copying it.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. On CC_OF_OK the buffer belongs to the library and must not be
+ *     touched again; it is freed once it has been sent.
+ * 02. On error the buffer still belongs to the caller, who can send it
+ *     again or release it with cc_of_send_buf_free().
+ */
+cc_of_ret
+cc_of_send_pkt_buf(uint64_t dp_id, 
+                   uint8_t aux_id, 
+                   void *buf, 
+                   size_t msg_len);
+
+
+/* one message of cc_of_send_pkt_batch() */
+typedef struct cc_of_send_entry_ {
+    uint64_t  dp_id;
+    uint8_t   aux_id;
+    void      *buf;     /* from cc_of_send_buf_alloc() */
+    size_t    msg_len;
+    cc_of_ret status;   /* filled in by cc_of_send_pkt_batch() */
+} cc_of_send_entry_t;
+
+/**
+ * cc_of_send_pkt_batch
+ * 
+ * Description:
+ * This function sends num_entries OF messages, possibly to many
+ * switches, in one call. The channel table is looked up once for the
+ * whole batch and the messages of each polling thread are handed over
+ * together with a single wakeup.
+ *
+ * Returns:
+ * CC_OF_OK if every entry was sent, else the status of the first
+ * entry that failed. The status of each entry is set in entries[].
+ *
+ * Notes:
+ * 01. Each buf is passed as in cc_of_send_pkt_buf(): buffers of entries
+ *     with status CC_OF_OK belong to the library, the others still
+ *     belong to the caller.
+ * 02. Messages for the same channel are sent in array order.
+ */
+cc_of_ret
+cc_of_send_pkt_batch(cc_of_send_entry_t *entries, 
+                     uint32_t num_entries);
+
+
+/**
+ * cc_of_send_request
+ * 
+ * Description:
+ * This function sends an OF request like cc_of_send_pkt() and has the
+ * reply with its xid passed to reply_func instead of cc_of_recv_pkt.
+ * The request waits for its reply in a table of its channel that only
+ * the channel's polling thread uses, and expires on a timer of that
+ * thread after timeout_ms.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. On CC_OF_OK reply_func is called exactly once, or once per part
+ *     of a multipart reply; on error it is not called.
+ * 02. TCP channels only, CC_OF_EINVAL on others.
+ * 03. The xid is taken from the header of of_msg. It must not be 0 and
+ *     should not be reused while the request is waiting.
+ */
+cc_of_ret
+cc_of_send_request(uint64_t dp_id, 
+                   uint8_t aux_id, 
+                   void *of_msg, 
+                   size_t msg_len,
+                   uint32_t timeout_ms,
+                   cc_of_reply reply_func,
+                   void *reply_ctx);
+
+
+/**
+ * cc_of_send_multipart_request
+ * 
+ * Description:
+ * This function sends an OF multipart request (a stats request in 1.0)
+ * like cc_of_send_request(), but the polling thread gathers the parts
+ * of the reply and hands them to reply_func in one call once the last
+ * one has arrived, instead of waking the application for each part.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. As for cc_of_send_request(); the timeout starts again with each
+ *     part.
+ * 02. Each part is copied as it arrives, so the whole reply is held in
+ *     memory until reply_func returns.
+ */
+cc_of_ret
+cc_of_send_multipart_request(uint64_t dp_id, 
+                             uint8_t aux_id, 
+                             void *of_msg, 
+                             size_t msg_len,
+                             uint32_t timeout_ms,
+                             cc_of_multipart_reply reply_func,
+                             void *reply_ctx);
+
+
 /**
  * cc_of_get_real_dpid_auxid
  * 
@@ -247,6 +679,7 @@ cc_of_send_pkt(uint64_t dp_id,
  * determines the dp_id/aux_id from the OFP_FEATURES_REQ packet 
  * and notifies the id's to oflib library. Until then oflib 
  * will be using a dummy dp_id/aux_id for the of_channel.
+ * Not needed if cc_of_dev_register_chann_ready() is used.
  *
  * No-op for switch
  *
@@ -277,6 +710,193 @@ cc_of_get_conn_stats(uint64_t dp_id,
                      uint32_t *tx_pkt,
                      uint32_t *tx_drops);
 
+/**
+ * cc_of_get_conn_state
+ *
+ * Description:
+ * This function returns the state of a channel and, on the switch, the
+ * number of reconnection attempts made for it.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. While a switch channel is reconnecting, count_retries is the
+ *     attempt in progress or waited for. Once it is up again it is the
+ *     number of attempts that took.
+ *
+ * 02. CC_OF_EINVAL if the channel does not exist.
+ */
+cc_of_ret
+cc_of_get_conn_state(uint64_t dp_id,
+                     uint8_t aux_id,
+                     cc_of_conn_state_e *state,
+                     uint32_t *count_retries);
+
+/**
+ * cc_of_get_conn_rtt
+ *
+ * Description:
+ * This function returns the round trip time of a TCP channel measured
+ * with the library's echo requests (see cc_of_set_echo): the last one,
+ * a smoothed average (7/8 old, 1/8 new) and the minimum, in usecs.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. CC_OF_EINVAL if the channel does not exist, CC_OF_EAGAIN if no
+ *     echo reply has been received on it yet.
+ */
+cc_of_ret
+cc_of_get_conn_rtt(uint64_t dp_id,
+                   uint8_t aux_id,
+                   uint32_t *rtt_us,
+                   uint32_t *srtt_us,
+                   uint32_t *min_rtt_us);
+
+/**
+ * cc_of_get_conn_version
+ *
+ * Description:
+ * This function returns the OpenFlow version (wire value, e.g. 0x04
+ * for 1.3) negotiated on a TCP channel by the library's hello exchange.
+ * The library offers the versions up to the max_ofver the device was
+ * registered with, using the hello version bitmap of OF 1.3.1.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. CC_OF_EINVAL if the channel does not exist, CC_OF_EAGAIN if the
+ *     hello exchange has not completed.
+ */
+cc_of_ret
+cc_of_get_conn_version(uint64_t dp_id,
+                       uint8_t aux_id,
+                       uint8_t *of_version);
+
+/**
+ * cc_of_set_send_coalescing
+ *
+ * Description:
+ * Sets how many queued messages, and how many bytes, are written to a
+ * TCP channel with one writev when the socket becomes writable.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. max_iov is 1 to 1024; 1 sends one message per syscall.
+ *
+ * 02. Defaults are 64 messages and 256KB.
+ */
+cc_of_ret
+cc_of_set_send_coalescing(uint32_t max_iov,
+                          uint32_t max_bytes);
+
+/**
+ * cc_of_set_udp_sockets
+ *
+ * Description:
+ * Sets how many UDP sockets a CONTROLLER device registered after this
+ * call listens on. With more than one, the sockets share the port with
+ * SO_REUSEPORT and each is owned by a different rw poll thread; the
+ * kernel spreads the switches across them by their address.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. num_sockets is 0 to CC_OF_UDP_MAX_SOCKETS. 0, the default,
+ *     opens no UDP socket.
+ *
+ * 02. Call after cc_of_lib_init.
+ */
+cc_of_ret
+cc_of_set_udp_sockets(uint32_t num_sockets);
+
+/**
+ * cc_of_set_tcp_listeners
+ *
+ * Description:
+ * Sets how many TCP listen sockets a CONTROLLER device registered after
+ * this call opens. With more than one, the listeners share the port with
+ * SO_REUSEPORT and each is served by a different rw poll thread instead
+ * of the one listen thread. A connection is accepted by the thread whose
+ * listener the kernel picked and stays on that thread, so a burst of
+ * switches reconnecting is accepted in parallel.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. num_listeners is 0 to CC_OF_TCP_MAX_LISTENERS. 0, the default,
+ *     and 1 open one listener on the listen thread.
+ *
+ * 02. Call after cc_of_lib_init.
+ */
+cc_of_ret
+cc_of_set_tcp_listeners(uint32_t num_listeners);
+
+/**
+ * cc_of_set_reconnect
+ *
+ * Description:
+ * Sets how a SWITCH reconnects a TCP channel that is lost or could not
+ * be connected. Attempt n is made after a delay of base_ms * 2^(n-1),
+ * capped at max_ms, less a random part of up to half so switches
+ * that lost the controller together do not all come back at once.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. base_ms 0 turns reconnecting off: the channel is deleted and
+ *     cc_of_delete_channel is called. Defaults are 100ms and 30s.
+ *
+ * 02. max_retries 0, the default, retries forever. Otherwise the
+ *     channel is deleted after that many failed attempts.
+ *
+ * 03. Call after cc_of_lib_init.
+ */
+cc_of_ret
+cc_of_set_reconnect(uint32_t base_ms,
+                    uint32_t max_ms,
+                    uint32_t max_retries);
+
+/**
+ * cc_of_set_echo
+ *
+ * Description:
+ * Sets the OpenFlow echo keepalive of TCP channels. With offload, echo
+ * requests are answered by the library on its polling threads instead
+ * of going to cc_of_recv_pkt, and the library sends an echo request on
+ * each channel every interval_ms and measures the round trip time.
+ *
+ * Returns:
+ * Status
+ *
+ * Notes:
+ * 01. Offload is on by default with an interval of 5s. interval_ms 0
+ *     answers echo requests but sends none.
+ *
+ * 02. A channel that misses max_missed echo replies in a row is closed
+ *     and cc_of_delete_channel is called; a switch reconnects it (see
+ *     cc_of_set_reconnect). max_missed 0 never closes it. Default 3.
+ *
+ * 03. Echo replies to requests the application sent itself still go to
+ *     cc_of_recv_pkt.
+ *
+ * 04. Call after cc_of_lib_init. Channels already up keep their echo
+ *     interval until their next echo, and stop sending them then if
+ *     offload is off or interval_ms is 0.
+ */
+cc_of_ret
+cc_of_set_echo(gboolean offload,
+               uint32_t interval_ms,
+               uint32_t max_missed);
+
 /**
  * cc_of_debug_toggle
  *
@@ -0,0 +1,149 @@
+/*
+*****************************************************
+**      CodeChix ONF Driver (LibCCOF)
+**      codechix.org - May the code be with you...
+**              Sept. 15, 2013
+*****************************************************
+**
+** License:        Apache 2.0 (ONF requirement)
+** Version:        0.0
+** LibraryName:    LibCCOF
+** GLIB License:   GNU LGPL
+** Description:    OpenFlow message framing for LibCCOF
+** Assumptions:    N/A
+** Testing:        N/A
+** Authors:        Deepa Karnad Dhurka
+**
+*****************************************************
+*/
+
+#ifndef CC_OF_MSG_H
+#define CC_OF_MSG_H
+
+#include <glib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "cc_of_lib.h"
+
+/* common header of every OpenFlow message - all versions */
+typedef struct ofp_header_ {
+    uint8_t  version;
+    uint8_t  type;
+    uint16_t length;   /* network byte order, includes the header */
+    uint32_t xid;      /* network byte order */
+} __attribute__ ((packed)) ofp_header_t;
+
+#define OFP_HEADER_LEN      sizeof(ofp_header_t)
+#define OFP_MAX_MSG_LEN     0xffff
+
+/* message types that are the same in all versions */
+#define OFPT_HELLO          0
+#define OFPT_ERROR          1
+#define OFPT_ECHO_REQUEST   2
+#define OFPT_ECHO_REPLY     3
+#define OFPT_FEATURES_REQUEST 5
+#define OFPT_FEATURES_REPLY   6
+#define OFPT_PACKET_IN        10
+#define OFPT_FLOW_REMOVED     11
+#define OFPT_PORT_STATUS      12
+
+/* reply to a multipart request - a stats reply in 1.0 */
+#define OFPT10_STATS_REPLY    17
+#define OFPT13_MULTIPART_REPLY 19
+#define OFP_MULTIPART_FLAGS_OFF 10  /* uint16 flags after the header */
+#define OFPMPF_REPLY_MORE     1     /* more parts follow */
+
+/* wire versions of cc_ofver_e */
+#define OFP_VERSION_1_0     0x01
+#define OFP_VERSION_1_3     0x04
+
+/* hello element carrying the versions a device supports, OF 1.3.1 */
+#define OFPHET_VERSIONBITMAP 1
+
+/* error sent when no version is common to both ends */
+#define OFPET_HELLO_FAILED   0
+#define OFPHFC_INCOMPATIBLE  0
+
+/* largest hello built by cc_of_msg_hello_build */
+#define CC_OF_MSG_HELLO_MAX_LEN (OFP_HEADER_LEN + 8)
+
+/* fixed part of a FEATURES_REPLY, 1.0 and 1.3 */
+#define OFP_SWITCH_FEATURES_LEN 32
+#define OFP_SWITCH_FEATURES_AUX_OFF 21   /* auxiliary_id, 1.3 */
+
+/* initial size of a receive buffer; grows up to hold one message */
+#define CC_OF_MSG_RX_BUF_SIZE 16384
+
+/* Per-connection receive buffer for a byte stream.
+ * Data is read straight into the free space at buf + off + len; complete
+ * messages are handed out in place and a partial one is moved to the
+ * front when the space for the next read is asked for. Messages handed
+ * out by a commit therefore stay valid until the next cc_of_msg_rx_space.
+ */
+typedef struct cc_of_msg_rx_ {
+    char     *buf;
+    uint32_t size;
+    uint32_t off;      /* start of the data not yet handed out */
+    uint32_t len;      /* bytes at buf + off not yet handed out */
+    uint64_t rx_msgs;  /* complete messages handed out */
+    uint64_t rx_errs;  /* bad headers, buffer dropped */
+} cc_of_msg_rx_t;
+
+/* called once per complete message; msg stays valid until the next
+ * cc_of_msg_rx_space() on the buffer
+ */
+typedef void (*cc_of_msg_func)(char *msg, size_t msg_len, void *user_data);
+
+cc_of_msg_rx_t *cc_of_msg_rx_new(void);
+
+void cc_of_msg_rx_free(cc_of_msg_rx_t *rx);
+
+/* returns where the next read should go and its max size in *space;
+ * moves a partial message to the front, so it invalidates the messages
+ * handed out by the previous commit
+ */
+char *cc_of_msg_rx_space(cc_of_msg_rx_t *rx, size_t *space);
+
+/* account for data_len bytes read into the space and call func for each
+ * message completed by them (func NULL drops them).
+ * return value: number of messages, CC_OF_EINVAL if a header had a bad
+ *               length - the buffered data is then dropped.
+ */
+int cc_of_msg_rx_commit(cc_of_msg_rx_t *rx, size_t data_len,
+                        cc_of_msg_func func, void *user_data);
+
+/* bitmap of the wire versions supported up to max_ofver, bit n set
+ * for version n
+ */
+uint32_t cc_of_msg_version_bitmap(cc_ofver_e max_ofver);
+
+/* build the hello for the versions of bitmap at buf, which has room
+ * for CC_OF_MSG_HELLO_MAX_LEN bytes.
+ * return value: length of the hello
+ */
+size_t cc_of_msg_hello_build(char *buf, uint32_t bitmap, uint32_t xid);
+
+/* version both ends use after the peer's hello msg, given the versions
+ * of bitmap on this end. The version bitmap of the peer is used if it
+ * sent one, else the lower of the two hello versions.
+ * return value: the version, CC_OF_EINVAL if none is common
+ */
+int cc_of_msg_hello_negotiate(const char *msg, size_t msg_len,
+                              uint32_t bitmap);
+
+/* datapath_id and auxiliary_id of a FEATURES_REPLY; aux_id is 0 before
+ * 1.3, which has no auxiliary connections.
+ * return value: CC_OF_OK, CC_OF_EINVAL if msg is too short
+ */
+int cc_of_msg_features_parse(const char *msg, size_t msg_len,
+                             uint64_t *dp_id, uint8_t *aux_id);
+
+/* TRUE for messages a peer sends on its own and never as a reply to a
+ * request: hello, echo request and the asynchronous messages
+ */
+gboolean cc_of_msg_unsolicited(const char *msg);
+
+/* TRUE for a part of a multipart reply that has more parts after it */
+gboolean cc_of_msg_reply_more(const char *msg, size_t msg_len);
+
+#endif
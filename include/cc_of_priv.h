@@ -36,6 +36,7 @@
 #include "cc_tcp_conn.h"
 #include "cc_udp_conn.h"
 #include "cc_of_util.h"
+#include "cc_of_msg.h"
 
 
 #endif
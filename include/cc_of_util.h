@@ -30,7 +30,7 @@
 
 /* HTBL utilities */
 
-#define MAX_OFRW_HTBL_SIZE 10007
+#define CC_OFRW_TBL_INIT_SIZE 1024 /* rw sockets in use, grows as needed */
 #define MAX_OFCHANN_HTBL_SIZE 10007
 #define MAX_OFDEV_HTBL_SIZE 101
 
@@ -50,8 +50,6 @@ guint cc_ofdev_hash_func(gconstpointer key);
 
 guint cc_ofchann_hash_func(gconstpointer key);
 
-guint cc_ofrw_hash_func(gconstpointer key);
-
 void cc_of_destroy_generic(gpointer data);
 
 void cc_ofdev_htbl_destroy_val(gpointer data);
@@ -62,8 +60,88 @@ gboolean cc_ofdev_htbl_equal_func(gconstpointer a,
 gboolean cc_ofchannel_htbl_equal_func(gconstpointer a, 
                                       gconstpointer b);
 
-gboolean cc_ofrw_htbl_equal_func(gconstpointer a, 
-                                 gconstpointer b);
+/* rw socket table, indexed by fd; caller holds ofrw_htbl_lock */
+cc_of_ret
+cc_ofrw_tbl_init(cc_ofrw_tbl_t *tbl);
+
+void
+cc_ofrw_tbl_free(cc_ofrw_tbl_t *tbl);
+
+/* NULL if sockfd is not in the table */
+cc_ofrw_info_t *
+cc_ofrw_lookup(int sockfd);
+
+/* generation of the fd's slot; changes when the fd is deleted or
+ * reused, so a saved value detects that the socket was replaced.
+ * Needs no lock.
+ */
+uint32_t
+cc_ofrw_get_gen(int sockfd);
+
+/* ctx_gen of the fd's slot, see cc_ofrw_ctx_update. Needs no lock. */
+gint
+cc_ofrw_get_ctx_gen(int sockfd);
+
+/* the cached receive context of the fd is out of date; called with
+ * the lock of the htbl that changed held. Needs no other lock.
+ */
+void
+cc_ofrw_ctx_invalidate(int sockfd);
+
+/* ... of every socket of the device; caller holds ofrw_htbl_lock */
+void
+cc_ofrw_ctx_invalidate_dev(cc_ofdev_key_t *dev_key);
+
+/* dummy fd for a new UDP peer of a controller, -1 if all
+ * CC_OFRW_UDP_PEERS_MAX are in use. It goes back with the DEL of its
+ * slot.
+ */
+int
+cc_ofrw_dummy_fd_alloc(void);
+
+/* UDP socket of a peer address, -1 if none */
+int
+cc_ofrw_lookup_peer(struct sockaddr_in *peer_addr);
+
+/* walk the sockets in the table: start with *sockfd = -1 */
+gboolean
+cc_ofrw_iter_next(int *sockfd, cc_ofrw_info_t **info);
+
+/* ADD/UPD copy rw_info into the fd's slot, DEL clears it */
+cc_of_ret
+cc_ofrw_tbl_update(htbl_update_ops_e htbl_op,
+                   cc_ofrw_key_t *rw_key,
+                   cc_ofrw_info_t *rw_info,
+                   gboolean *new_entry);
+
+/* channel send route table; writers also hold ofchannel_htbl_lock */
+void
+cc_ofchann_rtbl_init(cc_ofchann_rtbl_t *rtbl);
+
+void
+cc_ofchann_rtbl_free(cc_ofchann_rtbl_t *rtbl);
+
+void
+cc_ofchann_route_add(cc_ofchannel_key_t *key, int rw_sockfd);
+
+void
+cc_ofchann_route_del(cc_ofchannel_key_t *key);
+
+/* record the socket the channel is sent on, its cc_ofrw_get_gen and
+ * its poll thread
+ */
+void
+cc_ofchann_route_set_thr(cc_ofchannel_key_t *key, int rw_sockfd,
+                         uint32_t fd_gen, adpoll_thread_mgr_t *tmgr);
+
+/* lock-free unless writers keep the shard busy. CC_OF_EAGAIN if the
+ * channel has no poll thread recorded yet, CC_OF_EHTBL if it is not
+ * in the table
+ */
+cc_of_ret
+cc_ofchann_route_lookup(uint64_t dp_id, uint8_t aux_id,
+                        int *rw_sockfd, uint32_t *fd_gen,
+                        adpoll_thread_mgr_t **tmgr);
 
 cc_of_ret
 update_global_htbl(htbl_type_e htbl_type,
@@ -117,6 +195,13 @@ add_upd_ofchann_rwsocket(cc_ofchannel_key_t key,
 cc_of_ret
 del_ofchann_rwsocket(int rwsock);
 
+/* move the channel of rw_sockfd to new_key; CC_OF_EEXIST if that is
+ * the channel of another socket
+ */
+// caller will acquire ofchannel lock
+cc_of_ret
+cc_ofchann_rekey(int rw_sockfd, cc_ofchannel_key_t *new_key);
+
 cc_of_ret
 find_ofchann_key_rwsocket(int sockfd, 
                           cc_ofchannel_key_t **fd_chann_key);
@@ -127,6 +212,50 @@ add_ofdev_rwsocket(cc_ofdev_key_t key, int rwsock);
 cc_of_ret
 del_ofdev_rwsocket(cc_ofdev_key_t key, int rwsock);
 
+/* cached receive context of a rw socket */
+cc_ofrw_ctx_t *
+cc_ofrw_ctx_new(L4_type_e layer4_proto);
+
+void
+cc_ofrw_ctx_free(cc_ofrw_ctx_t *ctx);
+
+// callee will acquire the three htbl locks, only if ctx is out of date
+void
+cc_ofrw_ctx_update(int sockfd, cc_ofrw_ctx_t *ctx);
+
+/* receive context of the socket, NULL until its poll thread has one */
+// caller will acquire ofrw lock
+cc_ofrw_ctx_t *
+cc_ofrw_lookup_ctx(int sockfd);
+
+/* requests of cc_of_send_request, see cc_of_xid_req_t */
+cc_of_xid_req_t *
+cc_of_xid_req_new(uint64_t dp_id, uint8_t aux_id, uint32_t xid,
+                  uint32_t timeout_ms, cc_of_reply reply_func,
+                  cc_of_multipart_reply mp_func, void *reply_ctx);
+
+/* free a request that was never sent, without calling it back */
+void
+cc_of_xid_req_free(cc_of_xid_req_t *req);
+
+/* req_free of the send message: the request is failed with
+ * CC_OF_ECHANN if its message is dropped before it is sent
+ */
+void
+cc_of_xid_req_drop(gpointer req);
+
+/* on the poll thread of ctx, when the request's message is sent */
+void
+cc_ofrw_xid_req_add(cc_ofrw_ctx_t *ctx, cc_of_xid_req_t *req);
+
+/* on the poll thread of ctx: request waiting for msg as its reply */
+cc_of_xid_req_t *
+cc_ofrw_xid_lookup(cc_ofrw_ctx_t *ctx, char *msg);
+
+/* pass the reply msg to req; done with it unless more parts follow */
+void
+cc_ofrw_xid_reply(cc_of_xid_req_t *req, char *msg, size_t msg_len);
+
 cc_of_ret
 atomic_add_upd_htbls_with_rwsocket(int sockfd, struct sockaddr_in *client_addr, 
                                    adpoll_thread_mgr_t  *thr_mgr,
@@ -151,6 +280,11 @@ cc_get_count_rw_pollthr(void);
 cc_of_ret
 cc_find_or_create_rw_pollthr(adpoll_thread_mgr_t **tmgr);
 
+/* a poll thread that is not on excl_list */
+cc_of_ret
+cc_find_or_create_rw_pollthr_excl(GList *excl_list,
+                                  adpoll_thread_mgr_t **tmgr);
+
 
 cc_of_ret
 cc_del_sockfd_rw_pollthr(adpoll_thread_mgr_t *tmgr, 
@@ -163,4 +297,41 @@ cc_add_sockfd_rw_pollthr(adpoll_thr_msg_t *msg,
                          L4_type_e layer4_proto,
                          cc_ofchannel_key_t ofchann_key);
 
+/* same, on the given poll thread */
+cc_of_ret
+cc_add_sockfd_rw_pollthr_tmgr(adpoll_thread_mgr_t *tmgr,
+                              adpoll_thr_msg_t *msg,
+                              cc_ofdev_key_t key,
+                              L4_type_e layer4_proto,
+                              cc_ofchannel_key_t ofchann_key);
+
+/* arm timer on the poll thread of the channel's socket; cancel with
+ * adp_thr_mgr_timer_cancel
+ */
+// caller will acquire ofchannel and ofrw locks
+cc_of_ret
+cc_ofchann_timer_arm(cc_ofchannel_key_t chann_key, adpoll_timer_t *timer,
+                     uint32_t delay_ms);
+
+/* switch channel reconnect - see cc_of_set_reconnect */
+
+/* backoff of retry count_retries, from 1, in ms */
+uint32_t
+cc_ofchann_reconnect_delay(uint32_t count_retries);
+
+// caller will acquire three htbl locks; call on a rw poll thread
+gboolean
+cc_ofchann_reconnect(char *tname, cc_ofchannel_key_t chann_key,
+                     cc_ofdev_key_t dev_key, L4_type_e layer4_proto,
+                     uint32_t count_retries);
+
+// caller will acquire ofchannel lock
+gboolean
+cc_ofchann_reconnect_clear(cc_ofchannel_key_t chann_key,
+                           uint32_t *count_retries);
+
+// caller will acquire ofchannel lock
+void
+cc_ofchann_reconnect_dev_clear(cc_ofdev_key_t dev_key);
+
 #endif //CC_OF_UTIL_H
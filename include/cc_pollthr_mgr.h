@@ -27,6 +27,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/poll.h>
+#include <sys/uio.h>
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
@@ -68,14 +69,36 @@ typedef enum adpoll_fd_action_ {
     DELETE_FD
 } adpoll_fd_action_e;
 
+/* event backend used by a poll thread to wait on its fds */
+typedef enum adpoll_backend_ {
+    ADPOLL_EPOLL = 0, /* default */
+    ADPOLL_POLL,
+    ADPOLL_IOURING,   /* also does the socket I/O of io_offload fds */
+    MAX_ADPOLL_BACKEND
+} adpoll_backend_e;
+
+typedef struct adpoll_send_ring_ adpoll_send_ring_t;
+
+/* what a poll thread dropped unsent, the fd being gone or replaced;
+ * g_atomic_int, read by app threads
+ */
+typedef struct adpoll_tx_drops_ {
+    gint          msgs;   /* send messages, whole or their tail */
+    gint          bytes;  /* of those and of what the backend buffered */
+} adpoll_tx_drops_t;
+
 /* Global data for async dynamic poll-thread manager */
 typedef struct adpoll_thread_mgr {
     char          tname[MAX_NAME_LEN];
-    uint16_t      num_sockets;
+    gint          num_sockets;    /* g_atomic_int: poll and app threads */
+    adpoll_tx_drops_t *tx_drops;
     uint16_t      num_pipes;
     uint32_t      max_sockets;
     uint32_t      max_pipes;
+    adpoll_backend_e backend;
     int           *pipes_arr;
+    adpoll_send_ring_t *send_ring;
+    struct adpoll_timer_wheel_ *timer_wheel;
     GThread       *thread_p;
     GMutex        *add_del_pipe_cv_mutex;
     GCond         *add_del_pipe_cv_cond;
@@ -88,6 +111,8 @@ typedef struct adpoll_pollthr_data_ {
     char tname[MAX_NAME_LEN];
     int max_pollfds;
     int primary_pipe_rd_fd;
+    adpoll_backend_e backend;
+    adpoll_send_ring_t *send_ring;
     adpoll_thread_mgr_t *mgr;
 } adpoll_pollthr_data_t;
 
@@ -97,11 +122,29 @@ typedef struct adpoll_send_msg_htbl_key_ {
     uint8_t           aux_id; 
 } adpoll_send_msg_htbl_key_t;
 
+/* queued on the fd's send_q until all of data is sent. The pollout
+ * callback sends from data + data_off and advances data_off by the
+ * bytes written; setting it to data_size drops the message.
+ * Allocated with adp_thr_mgr_msg_alloc(); the poll thread frees it.
+ */
 typedef struct adpoll_send_msg_htbl_info_ {
 //    struct pollfd     *pollfd_entry_p; /*poll struct of the rx fd */
     uint              data_size;
+    uint              data_off;
+    uint              buf_size;  /* room in data[] */
+    int               pool_idx;  /* size class, -1 if not pooled */
     uint64_t          dp_id;
     uint8_t           aux_id;
+    /* cc_ofrw_get_gen of the fd when the message was addressed to it.
+     * The poll thread drops the message if the fd was closed and
+     * reused since; 0 - not checked
+     */
+    uint32_t          fd_gen;
+    /* taken by the fd's pollout callback when it sends the message;
+     * req_free is called on it if the message is freed with it
+     */
+    gpointer          req;
+    GDestroyNotify    req_free;
     char              data[];
 } adpoll_send_msg_htbl_info_t;
 
@@ -120,6 +163,8 @@ typedef struct adpoll_thr_msg_ {
     short              poll_events; /* poll flags */
     fd_process_func    pollin_func;
     fd_process_func    pollout_func;
+    gboolean           io_offload;  /* recv/send may be done by backend */
+    gboolean           connect_pending; /* socket connect in progress */
 } adpoll_thr_msg_t;
 
 
@@ -130,39 +175,180 @@ typedef struct adpoll_fd_info_ {
     fd_process_func    pollin_func;
     fd_process_func    pollout_func;
     struct pollfd      *pollfd_entry_p; /*poll syscall uses this info*/
+    struct pollfd      pollfd_entry; /* used by backends without an array */
+    int                backend_idx;  /* slot in the backend's fd array */
+    gboolean           deleted;      /* freed after the current dispatch */
+    gboolean           io_offload;   /* backend does recv/send */
+    /* polled for POLLOUT until the connect completes; pollout_func is
+     * then called once without a message
+     */
+    gboolean           connect_pending;
+    void               *backend_priv;
+    GQueue             *send_q;      /* adpoll_send_msg_htbl_info_t FIFO */
+    uint64_t           tx_syscalls;  /* pollout callback calls */
+    uint64_t           tx_msgs;      /* messages completed by them */
+    gpointer           user_ctx;     /* owned by the fd's callbacks */
+    GDestroyNotify     user_ctx_free; /* called when the entry is freed */
 } adpoll_fd_info_t;
 
-typedef struct adpoll_send_msg_hdr_ {
-    uint               msg_size;
-    int                fd;
-    uint64_t           dp_id;
-    uint8_t            aux_id;
-} adpoll_send_msg_hdr_t;
-
+/* written to the data pipe - the message itself is passed by pointer
+ * and owned by the poll thread once the write succeeds. The record is
+ * far below PIPE_BUF so writes from several threads do not interleave.
+ */
 typedef struct adpoll_send_msg_ {
-    adpoll_send_msg_hdr_t hdr;
-    char                  data[];
+    int                         fd;
+    adpoll_send_msg_htbl_info_t *msg_p;
 } adpoll_send_msg_t;
 
-
-
-typedef struct pollthr_private_ {
+/* slots in the send ring of a poll thread - power of 2 */
+#define ADPOLL_SEND_RING_SIZE 1024
+
+#define ADPOLL_CACHELINE 64
+
+typedef struct adpoll_send_ring_slot_ {
+    gint               seq;
+    adpoll_send_msg_t  msg;
+} adpoll_send_ring_slot_t;
+
+/* Bounded lock-free MPSC ring of send messages for a poll thread.
+ * Application threads claim a slot by advancing tail; the poll thread
+ * is the only consumer and owns head. doorbell_fd is an eventfd that is
+ * written only when the consumer has caught up with the message just
+ * published, i.e. the ring went from empty to non-empty.
+ * When the ring is full messages go through the data pipe instead;
+ * overflow counts those not yet taken off the pipe and keeps later
+ * messages on the pipe so they are not reordered.
+ */
+struct adpoll_send_ring_ {
+    gint               tail __attribute__ ((aligned(ADPOLL_CACHELINE)));
+    gint               overflow;
+    gint               head __attribute__ ((aligned(ADPOLL_CACHELINE)));
+    int                doorbell_fd;
+    guint              mask;
+    adpoll_send_ring_slot_t *slots;
+};
+
+typedef struct adpoll_timer_ adpoll_timer_t;
+typedef struct adpoll_timer_wheel_ adpoll_timer_wheel_t;
+
+/* called on the poll thread when timer expires, without the wheel
+ * lock; the timer is no longer armed and may be armed again or freed
+ */
+typedef void (*adpoll_timer_func)(char *tname, adpoll_timer_t *timer);
+
+/* timer of a poll thread - see adp_thr_mgr_timer_arm */
+struct adpoll_timer_ {
+    adpoll_timer_t     *next;
+    adpoll_timer_t     **pprev;     /* NULL when not armed */
+    uint64_t           expiry;      /* in ticks */
+    uint32_t           level;       /* of the wheel it is linked in */
+    adpoll_timer_wheel_t *wheel;    /* last armed on */
+    adpoll_timer_func  func;
+    GDestroyNotify     free_func;   /* timers still armed at thread exit */
+    gpointer           data;
+};
+
+/* ms per tick, and levels of the timer wheel with 2^LEVEL_BITS slots
+ * each: level n slots are 2^(n*LEVEL_BITS) ticks apart, so 4 levels
+ * of 256 reach 2^32 ticks (over a year) out
+ */
+#define ADPOLL_TIMER_TICK_MS     10
+#define ADPOLL_TIMER_LEVEL_BITS  8
+#define ADPOLL_TIMER_LEVEL_SLOTS (1 << ADPOLL_TIMER_LEVEL_BITS)
+#define ADPOLL_TIMER_LEVEL_MASK  (ADPOLL_TIMER_LEVEL_SLOTS - 1)
+#define ADPOLL_TIMER_LEVELS      4
+
+/* Hierarchical timer wheel of a poll thread manager. A timer is linked
+ * into the level its expiry falls in and the slot of its expiry there,
+ * so arming and cancelling are O(1). When level 0 wraps, the next slot
+ * of level 1 is cascaded down into level 0, and so on up. next_tick is
+ * a lower bound on the tick at which any slot expires or cascades: the
+ * poll thread sleeps until then and skips the ticks before it.
+ * Any thread may arm and cancel timers under lock; the poll thread
+ * runs them. Arming one ahead of next_tick wakes the poll thread
+ * through wake_fd.
+ */
+struct adpoll_timer_wheel_ {
+    GMutex             lock;
+    adpoll_timer_t     *slot[ADPOLL_TIMER_LEVELS][ADPOLL_TIMER_LEVEL_SLOTS];
+    uint32_t           level_timers[ADPOLL_TIMER_LEVELS];
+    uint32_t           num_timers;  /* armed, including those being run */
+    uint64_t           tick;        /* next tick to run */
+    uint64_t           next_tick;
+    int                wake_fd;
+    gboolean           stopped;     /* poll thread exited */
+};
+
+typedef struct pollthr_private_ pollthr_private_t;
+
+/* Event backend of a poll thread - see cc_poll_backend.c and
+ * cc_epoll_backend.c. All calls are made on the poll thread.
+ * wait() fills ready_arr with the entries that have revents set.
+ */
+typedef struct adpoll_backend_ops_ {
+    const char *name;
+    int  (*init)(pollthr_private_t *thr_pvt_p);
+    void (*cleanup)(pollthr_private_t *thr_pvt_p);
+    int  (*add_fd)(pollthr_private_t *thr_pvt_p,
+                   adpoll_fd_info_t *fd_entry_p,
+                   short poll_events);
+    int  (*del_fd)(pollthr_private_t *thr_pvt_p,
+                   adpoll_fd_info_t *fd_entry_p);
+    /* push fd_entry_p->pollfd_entry_p->events to the backend */
+    int  (*mod_fd)(pollthr_private_t *thr_pvt_p,
+                   adpoll_fd_info_t *fd_entry_p);
+    int  (*wait)(pollthr_private_t *thr_pvt_p, int timeout);
+    /* optional - only for fds added with io_offload */
+    ssize_t (*recv)(pollthr_private_t *thr_pvt_p,
+                    adpoll_fd_info_t *fd_entry_p,
+                    void *buf, size_t len);
+    ssize_t (*send)(pollthr_private_t *thr_pvt_p,
+                    adpoll_fd_info_t *fd_entry_p,
+                    const void *buf, size_t len);
+} adpoll_backend_ops_t;
+
+extern adpoll_backend_ops_t adpoll_poll_fns;
+extern adpoll_backend_ops_t adpoll_epoll_fns;
+extern adpoll_backend_ops_t adpoll_iouring_fns;
+
+gboolean adpoll_iouring_supported(void);
+
+struct pollthr_private_ {
     int           num_pollfds;
-    struct pollfd *pollfd_arr;
-    GList         *fd_list;
-    GHashTable    *send_msg_htbl;
-    GMutex	  send_msg_htbl_lock;
+    int           max_pollfds;
+    int           pri_pipe_rd_fd;
+    int           data_pipe_rd_fd;
+    adpoll_send_ring_t *send_ring;
+    adpoll_fd_info_t *doorbell_entry; /* not in fd_htbl */
+    GHashTable    *fd_htbl;  /* fd -> adpoll_fd_info_t */
+    GList         *fd_free_list; /* entries deleted during dispatch */
+    adpoll_fd_info_t **ready_arr;
+    int           num_ready;
+    adpoll_backend_ops_t *backend;
+    void          *backend_data;
+    adpoll_timer_wheel_t *timer_wheel; /* of its thread manager */
     GMutex        *add_del_pipe_cv_mutex;
     GCond         *add_del_pipe_cv_cond;
     GMutex        *adp_thr_init_cv_mutex;
     GCond         *adp_thr_init_cv_cond;
-} pollthr_private_t;
+    adpoll_tx_drops_t *tx_drops; /* of its thread manager */
+};
+
+/* count data dropped unsent; on the poll thread, backends included */
+void pollthr_tx_drop(pollthr_private_t *thr_pvt_p, uint32_t msgs,
+                     uint32_t bytes);
 
 adpoll_thread_mgr_t *
 adp_thr_mgr_new(char *tname,
                 uint32_t max_sockets,
                 uint32_t max_pipes);
 
+adpoll_thread_mgr_t *
+adp_thr_mgr_new_backend(char *tname,
+                        uint32_t max_sockets,
+                        uint32_t max_pipes,
+                        adpoll_backend_e backend);
+
 int adp_thr_mgr_add_del_fd(adpoll_thread_mgr_t *this,
                             adpoll_thr_msg_t    *msg);
 
@@ -183,6 +369,63 @@ int adp_thr_mgr_get_data_pipe_rd(adpoll_thread_mgr_t *this);
 
 uint32_t adp_thr_mgr_get_num_avail_sockfd(adpoll_thread_mgr_t *this);
 
+/* send messages dropped unsent and, if bytes is not NULL, the bytes
+ * - see adpoll_tx_drops_t
+ */
+uint32_t adp_thr_mgr_get_tx_drops(adpoll_thread_mgr_t *this,
+                                  uint32_t *bytes);
+
 void adp_thr_mgr_free(adpoll_thread_mgr_t *this);
 
+/* recv/send on a socket from its poll thread callbacks; goes through
+ * the backend when it does the I/O for the fd, else the plain syscall
+ */
+ssize_t adp_thr_mgr_recv(int fd, void *buf, size_t len, int flags);
+
+ssize_t adp_thr_mgr_send(int fd, const void *buf, size_t len, int flags);
+
+/* pooled send message buffers; thread safe */
+adpoll_send_msg_htbl_info_t *adp_thr_mgr_msg_alloc(uint buf_size);
+
+void adp_thr_mgr_msg_free(adpoll_send_msg_htbl_info_t *msg_p);
+
+/* hand msg_p to the poll thread to be sent on fd. On success the
+ * message belongs to the poll thread, on failure it stays with the caller.
+ * Goes through the send ring, the data pipe only if the ring is full.
+ */
+int adp_thr_mgr_send_msg(adpoll_thread_mgr_t *this, int fd,
+                         adpoll_send_msg_htbl_info_t *msg_p);
+
+/* same for several messages with at most one wakeup of the thread;
+ * returns how many were handed over, in order
+ */
+int adp_thr_mgr_send_msg_batch(adpoll_thread_mgr_t *this,
+                               adpoll_send_msg_t *msg_arr, int num_msgs);
+
+ssize_t adp_thr_mgr_sendv(int fd, const struct iovec *iov, int iovcnt,
+                          int flags);
+
+void adp_thr_mgr_timer_init(adpoll_timer_t *timer, adpoll_timer_func func,
+                            GDestroyNotify free_func, gpointer data);
+
+/* arm timer to expire on this poll thread in delay_ms; an armed timer
+ * is moved. Thread safe, but arming and cancelling one timer must not
+ * race each other. return value: 0, or -1 if the poll thread exited or
+ * the timer is armed on another one
+ */
+int adp_thr_mgr_timer_arm(adpoll_thread_mgr_t *this, adpoll_timer_t *timer,
+                          uint32_t delay_ms);
+
+/* same on the calling poll thread, from its callbacks. return value:
+ * 0, or -1 if not called on a poll thread or the timer is armed
+ */
+int adp_thr_mgr_timer_add(adpoll_timer_t *timer, uint32_t delay_ms);
+
+/* return value: TRUE if the timer was armed; it will not run. FALSE if
+ * it was not, or its callback has been or is being called
+ */
+gboolean adp_thr_mgr_timer_cancel(adpoll_timer_t *timer);
+
+gboolean adp_thr_mgr_timer_pending(adpoll_timer_t *timer);
+
 #endif
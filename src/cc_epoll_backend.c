@@ -0,0 +1,178 @@
+/*
+*****************************************************
+**      CodeChix ONF Driver (LibCCOF)
+**      codechix.org - May the code be with you...
+**              Sept. 15, 2013
+*****************************************************
+**
+** License:        Apache 2.0 (ONF requirement)
+** Version:        0.0
+** LibraryName:    LibCCOF
+** GLIB License:   GNU LGPL
+** Description:    epoll event backend for the poll thread
+** Assumptions:    Linux
+** Testing:        N/A
+** Authors:        Deepa Karnad Dhurka
+**
+*****************************************************
+*/
+
+#include <sys/epoll.h>
+#include "cc_pollthr_mgr.h"
+#include "cc_log.h"
+
+/* max events returned by one epoll_wait */
+#define EPOLL_MAX_EVENTS 256
+
+typedef struct epoll_backend_data_ {
+    int                epfd;
+    int                max_events;
+    struct epoll_event *event_arr;
+} epoll_backend_data_t;
+
+/* POLLIN/POLLOUT/POLLERR/POLLHUP have the same values as their
+ * EPOLL counterparts on Linux, so the masks are used as is
+ */
+static int
+epoll_backend_ctl(epoll_backend_data_t *edata, int op,
+                  adpoll_fd_info_t *fd_entry_p)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (uint32_t)(unsigned short)fd_entry_p->pollfd_entry.events;
+    ev.data.ptr = fd_entry_p;
+
+    return epoll_ctl(edata->epfd, op, fd_entry_p->fd, &ev);
+}
+
+static int
+epoll_backend_init(pollthr_private_t *thr_pvt_p)
+{
+    epoll_backend_data_t *edata;
+
+    edata = (epoll_backend_data_t *)malloc(sizeof(epoll_backend_data_t));
+    if (edata == NULL) {
+        return -1;
+    }
+
+    edata->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (edata->epfd == -1) {
+        CC_LOG_ERROR("%s(%d): epoll_create1 failed %s",
+                     __FUNCTION__, __LINE__, g_strerror(errno));
+        free(edata);
+        return -1;
+    }
+
+    edata->max_events = MIN(thr_pvt_p->max_pollfds, EPOLL_MAX_EVENTS);
+    edata->event_arr = (struct epoll_event *)
+        malloc(sizeof(struct epoll_event) * edata->max_events);
+    if (edata->event_arr == NULL) {
+        close(edata->epfd);
+        free(edata);
+        return -1;
+    }
+    thr_pvt_p->backend_data = edata;
+    return 0;
+}
+
+static void
+epoll_backend_cleanup(pollthr_private_t *thr_pvt_p)
+{
+    epoll_backend_data_t *edata = thr_pvt_p->backend_data;
+
+    close(edata->epfd);
+    free(edata->event_arr);
+    free(edata);
+    thr_pvt_p->backend_data = NULL;
+}
+
+static int
+epoll_backend_add_fd(pollthr_private_t *thr_pvt_p,
+                     adpoll_fd_info_t *fd_entry_p,
+                     short poll_events)
+{
+    epoll_backend_data_t *edata = thr_pvt_p->backend_data;
+
+    fd_entry_p->pollfd_entry.fd = fd_entry_p->fd;
+    fd_entry_p->pollfd_entry.events = poll_events;
+    fd_entry_p->pollfd_entry.revents = 0;
+    fd_entry_p->pollfd_entry_p = &fd_entry_p->pollfd_entry;
+    fd_entry_p->backend_idx = -1;
+
+    if (epoll_backend_ctl(edata, EPOLL_CTL_ADD, fd_entry_p) == -1) {
+        CC_LOG_ERROR("%s(%d): EPOLL_CTL_ADD failed for fd %d: %s",
+                     __FUNCTION__, __LINE__, fd_entry_p->fd,
+                     g_strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int
+epoll_backend_del_fd(pollthr_private_t *thr_pvt_p,
+                     adpoll_fd_info_t *fd_entry_p)
+{
+    epoll_backend_data_t *edata = thr_pvt_p->backend_data;
+
+    /* a closed fd has already dropped out of the epoll set */
+    if ((epoll_ctl(edata->epfd, EPOLL_CTL_DEL, fd_entry_p->fd, NULL) == -1) &&
+        (errno != EBADF) && (errno != ENOENT)) {
+        CC_LOG_ERROR("%s(%d): EPOLL_CTL_DEL failed for fd %d: %s",
+                     __FUNCTION__, __LINE__, fd_entry_p->fd,
+                     g_strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int
+epoll_backend_mod_fd(pollthr_private_t *thr_pvt_p,
+                     adpoll_fd_info_t *fd_entry_p)
+{
+    epoll_backend_data_t *edata = thr_pvt_p->backend_data;
+
+    if (epoll_backend_ctl(edata, EPOLL_CTL_MOD, fd_entry_p) == -1) {
+        CC_LOG_ERROR("%s(%d): EPOLL_CTL_MOD failed for fd %d: %s",
+                     __FUNCTION__, __LINE__, fd_entry_p->fd,
+                     g_strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int
+epoll_backend_wait(pollthr_private_t *thr_pvt_p, int timeout)
+{
+    epoll_backend_data_t *edata = thr_pvt_p->backend_data;
+    adpoll_fd_info_t *fd_entry_p;
+    int rv, i;
+
+    thr_pvt_p->num_ready = 0;
+
+    rv = epoll_wait(edata->epfd, edata->event_arr, edata->max_events,
+                    timeout);
+    if (rv <= 0) {
+        return rv;
+    }
+
+    for (i = 0; i < rv; i++) {
+        fd_entry_p = (adpoll_fd_info_t *)edata->event_arr[i].data.ptr;
+        fd_entry_p->pollfd_entry.revents =
+            (short)edata->event_arr[i].events;
+        thr_pvt_p->ready_arr[thr_pvt_p->num_ready++] = fd_entry_p;
+    }
+    return thr_pvt_p->num_ready;
+}
+
+adpoll_backend_ops_t adpoll_epoll_fns = {
+    "epoll",
+    epoll_backend_init,
+    epoll_backend_cleanup,
+    epoll_backend_add_fd,
+    epoll_backend_del_fd,
+    epoll_backend_mod_fd,
+    epoll_backend_wait,
+    NULL,
+    NULL,
+};
@@ -0,0 +1,878 @@
+/*
+*****************************************************
+**      CodeChix ONF Driver (LibCCOF)
+**      codechix.org - May the code be with you...
+**              Sept. 15, 2013
+*****************************************************
+**
+** License:        Apache 2.0 (ONF requirement)
+** Version:        0.0
+** LibraryName:    LibCCOF
+** GLIB License:   GNU LGPL
+** Description:    io_uring event and I/O backend for the rw poll threads
+** Assumptions:    Linux 5.6 or later, checked by adpoll_iouring_supported
+** Testing:        N/A
+** Authors:        Deepa Karnad Dhurka
+**
+*****************************************************
+*/
+
+/*
+ * Fds added with io_offload have a RECV kept outstanding on them
+ * instead of a poll. When it completes the fd is reported POLLIN and
+ * the pollin callback gets the received bytes through
+ * adp_thr_mgr_recv() without another syscall. Sends are copied to a
+ * per-fd buffer and go out as one SEND at a time per fd, so stream
+ * order is kept and messages queued behind a SEND are coalesced. The
+ * buffer is bounded: past IOURING_TX_PEND_MAX a send takes what fits
+ * or fails with EAGAIN, and POLLOUT is not reported until the SEND in
+ * flight completes. A failed SEND fails every later send with its errno.
+ * An fd deleted while a SEND is in flight keeps a dup of the socket
+ * until the buffer is out, the caller closing the fd right after.
+ * Other fds (pipes, listen and udp sockets) use a one-shot POLL_ADD
+ * that is re-armed after the dispatch.
+ *
+ * All SQEs queued during a loop iteration are submitted, and the
+ * completions reaped, by the single io_uring_enter() in wait().
+ */
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "cc_pollthr_mgr.h"
+#include "cc_log.h"
+
+#define IOURING_RX_BUF_SIZE   16384
+#define IOURING_MAX_ENTRIES   4096
+#define IOURING_TX_PEND_MAX   (256 * 1024)  /* bytes queued behind a SEND */
+
+typedef enum iouring_op_type_ {
+    IOURING_OP_POLL,
+    IOURING_OP_RECV,
+    IOURING_OP_SEND,
+    IOURING_OP_TIMEOUT
+} iouring_op_type_e;
+
+typedef struct iouring_fd_ iouring_fd_t;
+
+/* user_data of every SQE we care about; 0 is used for cancels */
+typedef struct iouring_op_ {
+    iouring_op_type_e type;
+    gboolean          inflight;
+    iouring_fd_t      *ifd;
+} iouring_op_t;
+
+struct iouring_fd_ {
+    adpoll_fd_info_t  *fd_entry_p; /* NULL once the fd is deleted */
+    int               fd;
+    GList             *link;       /* in ifd_list */
+    gboolean          on_pending;
+    uint32_t          ready_round;
+    iouring_op_t      rd_op;       /* POLL_ADD, or RECV if offloaded */
+    iouring_op_t      send_op;
+    /* rx - filled by RECV, drained by iouring_backend_recv */
+    char              *rx_buf;
+    ssize_t           rx_len;
+    ssize_t           rx_off;
+    int               rx_err;
+    gboolean          rx_eof;
+    /* tx - tx_inflight is owned by the kernel while send_op is inflight */
+    GByteArray        *tx_inflight;
+    size_t            tx_off;
+    GByteArray        *tx_pend;
+    int               tx_err;      /* of a failed SEND, then sticky */
+    gboolean          tx_linger;   /* deleted, fd is our dup of it */
+};
+
+typedef struct iouring_backend_data_ {
+    int                  ring_fd;
+    unsigned             sq_entries;
+    unsigned             *sq_head;
+    unsigned             *sq_tail;
+    unsigned             *sq_mask;
+    unsigned             *sq_array;
+    struct io_uring_sqe  *sqes;
+    unsigned             sq_local_tail;
+    unsigned             to_submit;
+    unsigned             *cq_head;
+    unsigned             *cq_tail;
+    unsigned             *cq_mask;
+    struct io_uring_cqe  *cqes;
+    void                 *sq_ring_p;
+    size_t               sq_ring_sz;
+    void                 *cq_ring_p;
+    size_t               cq_ring_sz;
+    size_t               sqes_sz;
+    /* two so that an earlier deadline can be armed while the removed
+     * timeout is still completing
+     */
+    iouring_op_t         timeout_op[2];
+    struct __kernel_timespec timeout_ts[2];
+    int                  timeout_cur;
+    gint64               timeout_deadline; /* of timeout_cur, monotonic us */
+    int                  num_inflight;
+    uint32_t             round;
+    GList                *ifd_list;     /* every iouring_fd_t */
+    GList                *pending_list; /* re-arm or report at next wait */
+} iouring_backend_data_t;
+
+
+static int
+iouring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int
+iouring_enter(int ring_fd, unsigned to_submit, unsigned min_complete,
+              unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                        min_complete, flags, NULL, 0);
+}
+
+/* Function: adpoll_iouring_supported
+ * Check that the kernel has io_uring and the opcodes used here
+ */
+gboolean
+adpoll_iouring_supported(void)
+{
+    struct io_uring_params params;
+    struct io_uring_probe *probe;
+    size_t probe_sz;
+    int ring_fd, i;
+    gboolean supported = TRUE;
+    static const int ops[] = { IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE,
+                               IORING_OP_ASYNC_CANCEL, IORING_OP_TIMEOUT,
+                               IORING_OP_TIMEOUT_REMOVE,
+                               IORING_OP_RECV, IORING_OP_SEND };
+
+    memset(&params, 0, sizeof(params));
+    ring_fd = iouring_setup(4, &params);
+    if (ring_fd < 0) {
+        return FALSE;
+    }
+
+    probe_sz = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+    probe = (struct io_uring_probe *)calloc(1, probe_sz);
+    if ((probe == NULL) ||
+        (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE,
+                 probe, 256) < 0)) {
+        supported = FALSE;
+    } else {
+        for (i = 0; i < (int)(sizeof(ops) / sizeof(ops[0])); i++) {
+            if ((ops[i] > probe->last_op) ||
+                !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+                supported = FALSE;
+                break;
+            }
+        }
+    }
+    free(probe);
+    close(ring_fd);
+    return supported;
+}
+
+/* push the queued SQEs to the kernel, optionally waiting for CQEs */
+static int
+iouring_submit(iouring_backend_data_t *ring, unsigned min_complete)
+{
+    int rv;
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    if ((ring->to_submit == 0) && (min_complete == 0)) {
+        return 0;
+    }
+    rv = iouring_enter(ring->ring_fd, ring->to_submit, min_complete,
+                       min_complete ? IORING_ENTER_GETEVENTS : 0);
+    if (rv < 0) {
+        return rv;
+    }
+    ring->to_submit -= MIN((unsigned)rv, ring->to_submit);
+    return rv;
+}
+
+static struct io_uring_sqe *
+iouring_get_sqe(iouring_backend_data_t *ring)
+{
+    struct io_uring_sqe *sqe;
+    unsigned head;
+
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        /* SQ full - hand what is queued to the kernel first */
+        if (iouring_submit(ring, 0) < 0) {
+            return NULL;
+        }
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (ring->sq_local_tail - head >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+    sqe = &ring->sqes[ring->sq_local_tail & *ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_local_tail++;
+    ring->to_submit++;
+    return sqe;
+}
+
+static int
+iouring_queue_op(iouring_backend_data_t *ring, iouring_op_t *op,
+                 int opcode, int fd, void *addr, unsigned len)
+{
+    struct io_uring_sqe *sqe;
+
+    sqe = iouring_get_sqe(ring);
+    if (sqe == NULL) {
+        CC_LOG_ERROR("%s(%d): no SQE for opcode %d on fd %d",
+                     __FUNCTION__, __LINE__, opcode, fd);
+        return -1;
+    }
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->user_data = (uint64_t)(uintptr_t)op;
+    if (op) {
+        op->inflight = TRUE;
+        ring->num_inflight++;
+    }
+    return 0;
+}
+
+/* cancel an inflight op; the cancel's own completion is ignored */
+static void
+iouring_cancel_op(iouring_backend_data_t *ring, iouring_op_t *op)
+{
+    int opcode = IORING_OP_ASYNC_CANCEL;
+
+    if (op->type == IOURING_OP_POLL) {
+        opcode = IORING_OP_POLL_REMOVE;
+    } else if (op->type == IOURING_OP_TIMEOUT) {
+        opcode = IORING_OP_TIMEOUT_REMOVE;
+    }
+    iouring_queue_op(ring, NULL, opcode, -1, op, 0);
+}
+
+/* make sure the wait returns by timeout ms. A timeout already armed
+ * for a later deadline is removed and the earlier one armed in the
+ * other slot; one armed earlier is kept, the loop just wakes early.
+ */
+static void
+iouring_arm_timeout(iouring_backend_data_t *ring, int timeout)
+{
+    iouring_op_t *cur = &ring->timeout_op[ring->timeout_cur];
+    gint64 deadline = g_get_monotonic_time() + (gint64)timeout * 1000;
+    int next;
+
+    if (cur->inflight) {
+        if (deadline >= ring->timeout_deadline) {
+            return;
+        }
+        next = !ring->timeout_cur;
+        if (ring->timeout_op[next].inflight) {
+            /* the last remove has not completed yet */
+            return;
+        }
+        iouring_cancel_op(ring, cur);
+        ring->timeout_cur = next;
+    }
+
+    ring->timeout_ts[ring->timeout_cur].tv_sec = timeout / 1000;
+    ring->timeout_ts[ring->timeout_cur].tv_nsec =
+        (timeout % 1000) * 1000000LL;
+    if (iouring_queue_op(ring, &ring->timeout_op[ring->timeout_cur],
+                         IORING_OP_TIMEOUT, -1,
+                         &ring->timeout_ts[ring->timeout_cur], 1) == 0) {
+        ring->timeout_deadline = deadline;
+    }
+}
+
+static int
+iouring_arm_rd(iouring_backend_data_t *ring, iouring_fd_t *ifd)
+{
+    struct io_uring_sqe *sqe;
+
+    if (ifd->rd_op.inflight) {
+        return 0;
+    }
+    if (ifd->rd_op.type == IOURING_OP_RECV) {
+        return iouring_queue_op(ring, &ifd->rd_op, IORING_OP_RECV, ifd->fd,
+                                ifd->rx_buf, IOURING_RX_BUF_SIZE);
+    }
+    if (iouring_queue_op(ring, &ifd->rd_op, IORING_OP_POLL_ADD, ifd->fd,
+                         NULL, 0) < 0) {
+        return -1;
+    }
+    sqe = &ring->sqes[(ring->sq_local_tail - 1) & *ring->sq_mask];
+    sqe->poll32_events =
+        (uint32_t)(unsigned short)ifd->fd_entry_p->pollfd_entry.events;
+    return 0;
+}
+
+static void
+iouring_send_next(iouring_backend_data_t *ring, iouring_fd_t *ifd)
+{
+    GByteArray *swap;
+
+    if (ifd->send_op.inflight) {
+        return;
+    }
+    if (ifd->tx_off >= ifd->tx_inflight->len) {
+        g_byte_array_set_size(ifd->tx_inflight, 0);
+        ifd->tx_off = 0;
+        swap = ifd->tx_inflight;
+        ifd->tx_inflight = ifd->tx_pend;
+        ifd->tx_pend = swap;
+    }
+    if (ifd->tx_inflight->len == 0) {
+        return;
+    }
+    if (iouring_queue_op(ring, &ifd->send_op, IORING_OP_SEND, ifd->fd,
+                         ifd->tx_inflight->data + ifd->tx_off,
+                         ifd->tx_inflight->len - ifd->tx_off) == 0) {
+        ring->sqes[(ring->sq_local_tail - 1) & *ring->sq_mask].msg_flags =
+            MSG_NOSIGNAL;
+    }
+}
+
+static void
+iouring_set_pending(iouring_backend_data_t *ring, iouring_fd_t *ifd)
+{
+    if (!ifd->on_pending) {
+        ifd->on_pending = TRUE;
+        ring->pending_list = g_list_prepend(ring->pending_list, ifd);
+    }
+}
+
+static void
+iouring_mark_ready(pollthr_private_t *thr_pvt_p, iouring_fd_t *ifd,
+                   short revents)
+{
+    iouring_backend_data_t *ring = thr_pvt_p->backend_data;
+    adpoll_fd_info_t *fd_entry_p = ifd->fd_entry_p;
+
+    if (ifd->ready_round != ring->round) {
+        ifd->ready_round = ring->round;
+        fd_entry_p->pollfd_entry.revents = 0;
+        thr_pvt_p->ready_arr[thr_pvt_p->num_ready++] = fd_entry_p;
+    }
+    fd_entry_p->pollfd_entry.revents |= revents;
+    /* re-arm, or report again, after this dispatch */
+    iouring_set_pending(ring, ifd);
+}
+
+/* drop, and count, what is left to send */
+static void
+iouring_tx_drop(pollthr_private_t *thr_pvt_p, iouring_fd_t *ifd)
+{
+    uint32_t bytes;
+
+    bytes = ifd->tx_inflight->len - (guint)ifd->tx_off + ifd->tx_pend->len;
+    if (bytes) {
+        CC_LOG_DEBUG("%s(%d): fd %d - dropping %u bytes unsent",
+                     __FUNCTION__, __LINE__, ifd->fd, bytes);
+        pollthr_tx_drop(thr_pvt_p, 0, bytes);
+    }
+    ifd->tx_off = ifd->tx_inflight->len;
+    g_byte_array_set_size(ifd->tx_pend, 0);
+}
+
+static void
+iouring_ifd_free(pollthr_private_t *thr_pvt_p, iouring_fd_t *ifd)
+{
+    iouring_backend_data_t *ring = thr_pvt_p->backend_data;
+
+    iouring_tx_drop(thr_pvt_p, ifd);
+    if (ifd->tx_linger) {
+        close(ifd->fd);
+    }
+    ring->ifd_list = g_list_delete_link(ring->ifd_list, ifd->link);
+    g_byte_array_free(ifd->tx_inflight, TRUE);
+    g_byte_array_free(ifd->tx_pend, TRUE);
+    free(ifd->rx_buf);
+    free(ifd);
+}
+
+static void
+iouring_process_cqe(pollthr_private_t *thr_pvt_p, struct io_uring_cqe *cqe)
+{
+    iouring_backend_data_t *ring = thr_pvt_p->backend_data;
+    iouring_op_t *op = (iouring_op_t *)(uintptr_t)cqe->user_data;
+    iouring_fd_t *ifd;
+
+    if (op == NULL) {
+        return;
+    }
+    op->inflight = FALSE;
+    ring->num_inflight--;
+
+    if (op->type == IOURING_OP_TIMEOUT) {
+        return;
+    }
+    ifd = op->ifd;
+
+    switch (op->type) {
+      case IOURING_OP_POLL:
+        if (ifd->fd_entry_p == NULL) {
+            break;
+        }
+        if (cqe->res == -ECANCELED) {
+            /* removed to change the events */
+            iouring_set_pending(ring, ifd);
+        } else if (cqe->res < 0) {
+            iouring_mark_ready(thr_pvt_p, ifd, POLLERR);
+        } else {
+            iouring_mark_ready(thr_pvt_p, ifd, (short)cqe->res);
+        }
+        break;
+      case IOURING_OP_RECV:
+        if (ifd->fd_entry_p == NULL) {
+            break;
+        }
+        if (cqe->res > 0) {
+            ifd->rx_len = cqe->res;
+            ifd->rx_off = 0;
+            iouring_mark_ready(thr_pvt_p, ifd, POLLIN);
+        } else if (cqe->res == 0) {
+            ifd->rx_eof = TRUE;
+            iouring_mark_ready(thr_pvt_p, ifd, POLLIN | POLLHUP);
+        } else if ((cqe->res == -EAGAIN) || (cqe->res == -EINTR) ||
+                   (cqe->res == -ECANCELED)) {
+            iouring_set_pending(ring, ifd);
+        } else {
+            ifd->rx_err = -cqe->res;
+            iouring_mark_ready(thr_pvt_p, ifd, POLLIN | POLLERR);
+        }
+        break;
+      case IOURING_OP_SEND:
+        if (cqe->res >= 0) {
+            ifd->tx_off += cqe->res;
+        } else if ((cqe->res != -EAGAIN) && (cqe->res != -EINTR)) {
+            /* the next send returns the error to the caller */
+            CC_LOG_DEBUG("%s(%d): send failed on fd %d: %s",
+                         __FUNCTION__, __LINE__, ifd->fd,
+                         g_strerror(-cqe->res));
+            ifd->tx_err = -cqe->res;
+            iouring_tx_drop(thr_pvt_p, ifd);
+        }
+        if (ifd->fd_entry_p != NULL) {
+            iouring_send_next(ring, ifd);
+            /* room again, or an error to report */
+            if (ifd->fd_entry_p->pollfd_entry.events & POLLOUT) {
+                iouring_set_pending(ring, ifd);
+            }
+        } else if (ifd->tx_linger && !ifd->tx_err) {
+            /* the rest of what was buffered before the delete */
+            iouring_send_next(ring, ifd);
+        }
+        break;
+      default:
+        break;
+    }
+
+    if ((ifd->fd_entry_p == NULL) &&
+        !ifd->rd_op.inflight && !ifd->send_op.inflight) {
+        iouring_ifd_free(thr_pvt_p, ifd);
+    }
+}
+
+static int
+iouring_reap(pollthr_private_t *thr_pvt_p)
+{
+    iouring_backend_data_t *ring = thr_pvt_p->backend_data;
+    unsigned head, tail;
+    int count = 0;
+
+    head = *ring->cq_head;
+    tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        iouring_process_cqe(thr_pvt_p, &ring->cqes[head & *ring->cq_mask]);
+        head++;
+        count++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+static void
+iouring_unmap(iouring_backend_data_t *ring)
+{
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_sz);
+    }
+    if (ring->cq_ring_p && (ring->cq_ring_p != ring->sq_ring_p)) {
+        munmap(ring->cq_ring_p, ring->cq_ring_sz);
+    }
+    if (ring->sq_ring_p) {
+        munmap(ring->sq_ring_p, ring->sq_ring_sz);
+    }
+}
+
+static int
+iouring_backend_init(pollthr_private_t *thr_pvt_p)
+{
+    iouring_backend_data_t *ring;
+    struct io_uring_params params;
+    unsigned entries = 8, i;
+
+    ring = (iouring_backend_data_t *)calloc(1, sizeof(iouring_backend_data_t));
+    if (ring == NULL) {
+        return -1;
+    }
+
+    /* one read op, one send and one cancel per fd */
+    while ((entries < (unsigned)thr_pvt_p->max_pollfds * 2 + 8) &&
+           (entries < IOURING_MAX_ENTRIES)) {
+        entries <<= 1;
+    }
+
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = iouring_setup(entries, &params);
+    if (ring->ring_fd < 0) {
+        CC_LOG_ERROR("%s(%d): io_uring_setup failed %s",
+                     __FUNCTION__, __LINE__, g_strerror(errno));
+        free(ring);
+        return -1;
+    }
+
+    ring->sq_ring_sz = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_sz = params.cq_off.cqes +
+        params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_ring_sz = ring->cq_ring_sz = MAX(ring->sq_ring_sz,
+                                                  ring->cq_ring_sz);
+    }
+    ring->sq_ring_p = mmap(NULL, ring->sq_ring_sz, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+                           IORING_OFF_SQ_RING);
+    if (ring->sq_ring_p == MAP_FAILED) {
+        ring->sq_ring_p = NULL;
+        goto fail;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring_p = ring->sq_ring_p;
+    } else {
+        ring->cq_ring_p = mmap(NULL, ring->cq_ring_sz, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+                               IORING_OFF_CQ_RING);
+        if (ring->cq_ring_p == MAP_FAILED) {
+            ring->cq_ring_p = NULL;
+            goto fail;
+        }
+    }
+    ring->sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        goto fail;
+    }
+
+    ring->sq_entries = params.sq_entries;
+    ring->sq_head = (unsigned *)((char *)ring->sq_ring_p + params.sq_off.head);
+    ring->sq_tail = (unsigned *)((char *)ring->sq_ring_p + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)((char *)ring->sq_ring_p +
+                                 params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)((char *)ring->sq_ring_p +
+                                  params.sq_off.array);
+    ring->cq_head = (unsigned *)((char *)ring->cq_ring_p + params.cq_off.head);
+    ring->cq_tail = (unsigned *)((char *)ring->cq_ring_p + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)((char *)ring->cq_ring_p +
+                                 params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring_p +
+                                         params.cq_off.cqes);
+
+    /* SQ slots are always used in ring order */
+    for (i = 0; i < ring->sq_entries; i++) {
+        ring->sq_array[i] = i;
+    }
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->timeout_op[0].type = ring->timeout_op[1].type = IOURING_OP_TIMEOUT;
+
+    thr_pvt_p->backend_data = ring;
+    return 0;
+
+fail:
+    CC_LOG_ERROR("%s(%d): io_uring mmap failed %s",
+                 __FUNCTION__, __LINE__, g_strerror(errno));
+    iouring_unmap(ring);
+    close(ring->ring_fd);
+    free(ring);
+    return -1;
+}
+
+static void
+iouring_backend_cleanup(pollthr_private_t *thr_pvt_p)
+{
+    iouring_backend_data_t *ring = thr_pvt_p->backend_data;
+    iouring_fd_t *ifd;
+    GList *elem;
+    int tries = 0, i;
+
+    /* the kernel must be done with our buffers before they are freed */
+    for (i = 0; i < 2; i++) {
+        if (ring->timeout_op[i].inflight) {
+            iouring_cancel_op(ring, &ring->timeout_op[i]);
+        }
+    }
+    for (elem = ring->ifd_list; elem != NULL; elem = elem->next) {
+        ifd = (iouring_fd_t *)elem->data;
+        ifd->fd_entry_p = NULL;
+        if (ifd->rd_op.inflight) {
+            iouring_cancel_op(ring, &ifd->rd_op);
+        }
+        /* a peer that does not read would hold up the exit */
+        if (ifd->send_op.inflight) {
+            iouring_cancel_op(ring, &ifd->send_op);
+        }
+    }
+    while ((ring->num_inflight > 0) && (tries++ < 100)) {
+        if ((iouring_submit(ring, 1) < 0) && (errno != EINTR)) {
+            break;
+        }
+        iouring_reap(thr_pvt_p);
+    }
+
+    while (ring->ifd_list) {
+        iouring_ifd_free(thr_pvt_p, (iouring_fd_t *)ring->ifd_list->data);
+    }
+    g_list_free(ring->pending_list);
+    iouring_unmap(ring);
+    close(ring->ring_fd);
+    free(ring);
+    thr_pvt_p->backend_data = NULL;
+}
+
+static int
+iouring_backend_add_fd(pollthr_private_t *thr_pvt_p,
+                       adpoll_fd_info_t *fd_entry_p,
+                       short poll_events)
+{
+    iouring_backend_data_t *ring = thr_pvt_p->backend_data;
+    iouring_fd_t *ifd;
+
+    ifd = (iouring_fd_t *)calloc(1, sizeof(iouring_fd_t));
+    if (ifd == NULL) {
+        return -1;
+    }
+    ifd->fd = fd_entry_p->fd;
+    ifd->fd_entry_p = fd_entry_p;
+    ifd->rd_op.ifd = ifd;
+    ifd->rd_op.type = IOURING_OP_POLL;
+    ifd->send_op.ifd = ifd;
+    ifd->send_op.type = IOURING_OP_SEND;
+    ifd->tx_inflight = g_byte_array_new();
+    ifd->tx_pend = g_byte_array_new();
+
+    if (fd_entry_p->io_offload) {
+        ifd->rd_op.type = IOURING_OP_RECV;
+        ifd->rx_buf = (char *)malloc(IOURING_RX_BUF_SIZE);
+        if (ifd->rx_buf == NULL) {
+            g_byte_array_free(ifd->tx_inflight, TRUE);
+            g_byte_array_free(ifd->tx_pend, TRUE);
+            free(ifd);
+            return -1;
+        }
+    }
+
+    fd_entry_p->pollfd_entry.fd = fd_entry_p->fd;
+    fd_entry_p->pollfd_entry.events = poll_events;
+    fd_entry_p->pollfd_entry.revents = 0;
+    fd_entry_p->pollfd_entry_p = &fd_entry_p->pollfd_entry;
+    fd_entry_p->backend_idx = -1;
+    fd_entry_p->backend_priv = ifd;
+
+    ring->ifd_list = g_list_prepend(ring->ifd_list, ifd);
+    ifd->link = ring->ifd_list;
+
+    /* armed by the next wait */
+    iouring_set_pending(ring, ifd);
+    return 0;
+}
+
+static int
+iouring_backend_del_fd(pollthr_private_t *thr_pvt_p,
+                       adpoll_fd_info_t *fd_entry_p)
+{
+    iouring_backend_data_t *ring = thr_pvt_p->backend_data;
+    iouring_fd_t *ifd = fd_entry_p->backend_priv;
+    int linger_fd;
+
+    if (ifd == NULL) {
+        return -1;
+    }
+    fd_entry_p->backend_priv = NULL;
+    ifd->fd_entry_p = NULL;
+
+    if (ifd->on_pending) {
+        ring->pending_list = g_list_remove(ring->pending_list, ifd);
+        ifd->on_pending = FALSE;
+    }
+    if (ifd->rd_op.inflight) {
+        iouring_cancel_op(ring, &ifd->rd_op);
+    }
+    /* buffered sends go out now, the caller closes the fd after this */
+    iouring_send_next(ring, ifd);
+    if (ifd->tx_pend->len && !ifd->tx_err) {
+        /* they follow the SEND in flight, on a socket of our own */
+        linger_fd = dup(ifd->fd);
+        if (linger_fd < 0) {
+            CC_LOG_DEBUG("%s(%d): fd %d dup failed: %s", __FUNCTION__,
+                         __LINE__, ifd->fd, g_strerror(errno));
+            pollthr_tx_drop(thr_pvt_p, 0, ifd->tx_pend->len);
+            g_byte_array_set_size(ifd->tx_pend, 0);
+        } else {
+            ifd->fd = linger_fd;
+            ifd->tx_linger = TRUE;
+        }
+    }
+    iouring_submit(ring, 0);
+
+    if (!ifd->rd_op.inflight && !ifd->send_op.inflight) {
+        iouring_ifd_free(thr_pvt_p, ifd);
+    }
+    return 0;
+}
+
+static int
+iouring_backend_mod_fd(pollthr_private_t *thr_pvt_p,
+                       adpoll_fd_info_t *fd_entry_p)
+{
+    iouring_backend_data_t *ring = thr_pvt_p->backend_data;
+    iouring_fd_t *ifd = fd_entry_p->backend_priv;
+
+    if (ifd == NULL) {
+        return -1;
+    }
+    if (fd_entry_p->io_offload) {
+        /* POLLOUT is reported without polling, SENDs are queued */
+        if (fd_entry_p->pollfd_entry.events & POLLOUT) {
+            iouring_set_pending(ring, ifd);
+        }
+        return 0;
+    }
+    if (ifd->rd_op.inflight) {
+        /* re-armed with the new events when the remove completes */
+        iouring_cancel_op(ring, &ifd->rd_op);
+    }
+    return 0;
+}
+
+static int
+iouring_backend_wait(pollthr_private_t *thr_pvt_p, int timeout)
+{
+    iouring_backend_data_t *ring = thr_pvt_p->backend_data;
+    adpoll_fd_info_t *fd_entry_p;
+    iouring_fd_t *ifd;
+    GList *pending, *elem;
+    gboolean wait;
+    int rv;
+
+    thr_pvt_p->num_ready = 0;
+    ring->round++;
+
+    pending = ring->pending_list;
+    ring->pending_list = NULL;
+    for (elem = pending; elem != NULL; elem = elem->next) {
+        ifd = (iouring_fd_t *)elem->data;
+        ifd->on_pending = FALSE;
+        fd_entry_p = ifd->fd_entry_p;
+
+        if (!fd_entry_p->io_offload) {
+            iouring_arm_rd(ring, ifd);
+            continue;
+        }
+        if ((ifd->rx_off < ifd->rx_len) || ifd->rx_eof || ifd->rx_err) {
+            /* not all of the last RECV was consumed */
+            iouring_mark_ready(thr_pvt_p, ifd, POLLIN);
+        } else {
+            iouring_arm_rd(ring, ifd);
+        }
+        /* when full, reported again once the SEND in flight completes */
+        if ((fd_entry_p->pollfd_entry.events & POLLOUT) &&
+            ((ifd->tx_pend->len < IOURING_TX_PEND_MAX) || ifd->tx_err)) {
+            iouring_mark_ready(thr_pvt_p, ifd, POLLOUT);
+        }
+    }
+    g_list_free(pending);
+
+    /* a zero timeout only polls, like poll() with 0 */
+    wait = (thr_pvt_p->num_ready == 0) && (timeout != 0);
+    if (wait && (timeout > 0)) {
+        iouring_arm_timeout(ring, timeout);
+    }
+
+    /* one syscall submits everything queued and waits for completions */
+    rv = iouring_submit(ring, wait ? 1 : 0);
+    if ((rv < 0) && (thr_pvt_p->num_ready == 0)) {
+        return -1;
+    }
+
+    iouring_reap(thr_pvt_p);
+    return thr_pvt_p->num_ready;
+}
+
+static ssize_t
+iouring_backend_recv(pollthr_private_t *thr_pvt_p UNUSED,
+                     adpoll_fd_info_t *fd_entry_p,
+                     void *buf, size_t len)
+{
+    iouring_fd_t *ifd = fd_entry_p->backend_priv;
+    size_t n;
+
+    if (ifd->rx_off < ifd->rx_len) {
+        n = MIN(len, (size_t)(ifd->rx_len - ifd->rx_off));
+        memcpy(buf, ifd->rx_buf + ifd->rx_off, n);
+        ifd->rx_off += n;
+        if (ifd->rx_off == ifd->rx_len) {
+            ifd->rx_off = ifd->rx_len = 0;
+        }
+        return n;
+    }
+    if (ifd->rx_err) {
+        errno = ifd->rx_err;
+        ifd->rx_err = 0;
+        return -1;
+    }
+    if (ifd->rx_eof) {
+        return 0;
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+static ssize_t
+iouring_backend_send(pollthr_private_t *thr_pvt_p,
+                     adpoll_fd_info_t *fd_entry_p,
+                     const void *buf, size_t len)
+{
+    iouring_fd_t *ifd = fd_entry_p->backend_priv;
+
+    if (ifd->tx_err) {
+        errno = ifd->tx_err;
+        return -1;
+    }
+    if (ifd->tx_pend->len >= IOURING_TX_PEND_MAX) {
+        errno = EAGAIN;
+        return -1;
+    }
+    len = MIN(len, IOURING_TX_PEND_MAX - ifd->tx_pend->len);
+    g_byte_array_append(ifd->tx_pend, (const guint8 *)buf, len);
+    iouring_send_next(thr_pvt_p->backend_data, ifd);
+    return len;
+}
+
+adpoll_backend_ops_t adpoll_iouring_fns = {
+    "io_uring",
+    iouring_backend_init,
+    iouring_backend_cleanup,
+    iouring_backend_add_fd,
+    iouring_backend_del_fd,
+    iouring_backend_mod_fd,
+    iouring_backend_wait,
+    iouring_backend_recv,
+    iouring_backend_send,
+};
@@ -45,6 +45,14 @@ inline const char *cc_of_strerror(int errnum)
 
 cc_of_ret
 cc_of_lib_init(of_dev_type_e dev_type)
+{
+    return cc_of_lib_init_pollmode(dev_type, CC_OF_POLLMODE_EPOLL);
+}
+
+
+cc_of_ret
+cc_of_lib_init_pollmode(of_dev_type_e dev_type,
+                        cc_of_pollmode_e pollmode)
 {
     cc_of_ret status = CC_OF_OK;
     CC_LOG_INFO("%s(%d): %s", __FUNCTION__, __LINE__,
@@ -58,6 +66,38 @@ cc_of_lib_init(of_dev_type_e dev_type)
     cc_of_global.oflog_file = malloc(sizeof(char) *
                                      LOG_FILE_NAME_SIZE);
     g_mutex_init(&cc_of_global.oflog_lock);
+
+    switch (pollmode) {
+      case CC_OF_POLLMODE_POLL:
+        cc_of_global.ofpoll_backend = ADPOLL_POLL;
+        cc_of_global.ofrw_backend = ADPOLL_POLL;
+        break;
+      case CC_OF_POLLMODE_IOURING:
+        cc_of_global.ofpoll_backend = ADPOLL_EPOLL;
+        if (adpoll_iouring_supported()) {
+            cc_of_global.ofrw_backend = ADPOLL_IOURING;
+        } else {
+            CC_LOG_INFO("%s(%d): io_uring not supported by the kernel,"
+                        " using epoll", __FUNCTION__, __LINE__);
+            cc_of_global.ofrw_backend = ADPOLL_EPOLL;
+        }
+        break;
+      case CC_OF_POLLMODE_EPOLL:
+      default:
+        cc_of_global.ofpoll_backend = ADPOLL_EPOLL;
+        cc_of_global.ofrw_backend = ADPOLL_EPOLL;
+        break;
+    }
+    cc_of_global.ofsend_max_iov = CC_OF_SEND_MAX_IOV;
+    cc_of_global.ofsend_max_bytes = CC_OF_SEND_MAX_BYTES;
+    cc_of_global.ofudp_num_sockets = 0;
+    cc_of_global.oftcp_num_listeners = 0;
+    cc_of_global.ofreconn_base_ms = CC_OF_RECONN_BASE_MS;
+    cc_of_global.ofreconn_max_ms = CC_OF_RECONN_MAX_MS;
+    cc_of_global.ofreconn_max_retries = 0;
+    cc_of_global.ofecho_offload = TRUE;
+    cc_of_global.ofecho_interval_ms = CC_OF_ECHO_INTERVAL_MS;
+    cc_of_global.ofecho_max_missed = CC_OF_ECHO_MAX_MISSED;
     
     cc_of_global.ofdev_type = dev_type;
     cc_of_global.ofdev_htbl = g_hash_table_new_full(cc_ofdev_hash_func,
@@ -83,14 +123,30 @@ cc_of_lib_init(of_dev_type_e dev_type)
 	    CC_LOG_FATAL("%s(%d): %s", __FUNCTION__, __LINE__,
                      cc_of_strerror(status));
     }
+    cc_of_global.ofchann_fd_htbl = g_hash_table_new_full(g_direct_hash,
+                                                         g_direct_equal,
+                                                         NULL,
+                                                         cc_of_destroy_generic);
+    if (cc_of_global.ofchann_fd_htbl == NULL) {
+	    status = CC_OF_EHTBL;
+	    cc_of_lib_free();
+	    CC_LOG_FATAL("%s(%d): %s", __FUNCTION__, __LINE__,
+                     cc_of_strerror(status));
+    }
+    cc_of_global.ofreconn_htbl = g_hash_table_new_full(cc_ofchann_hash_func,
+                                                       cc_ofchannel_htbl_equal_func,
+                                                       cc_of_destroy_generic,
+                                                       cc_of_destroy_generic);
+    if (cc_of_global.ofreconn_htbl == NULL) {
+	    status = CC_OF_EHTBL;
+	    cc_of_lib_free();
+	    CC_LOG_FATAL("%s(%d): %s", __FUNCTION__, __LINE__,
+                     cc_of_strerror(status));
+    }
     g_mutex_init(&cc_of_global.ofchannel_htbl_lock);
+    cc_ofchann_rtbl_init(&cc_of_global.ofchann_rtbl);
 
-    cc_of_global.ofrw_htbl = g_hash_table_new_full(cc_ofrw_hash_func,
-                                                   cc_ofrw_htbl_equal_func,
-                                                   cc_of_destroy_generic,
-                                                   cc_of_destroy_generic);
-
-    if (cc_of_global.ofrw_htbl == NULL) {
+    if (cc_ofrw_tbl_init(&cc_of_global.ofrw_tbl) < 0) {
 	    status = CC_OF_EHTBL;
 	    cc_of_lib_free();
 	    CC_LOG_FATAL("%s(%d): %s", __FUNCTION__, __LINE__,
@@ -163,7 +219,14 @@ cc_of_lib_free()
     g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
 
     g_hash_table_destroy(cc_of_global.ofchannel_htbl);
-    g_hash_table_destroy(cc_of_global.ofrw_htbl);
+    g_hash_table_destroy(cc_of_global.ofchann_fd_htbl);
+    /* reconnect timers still armed find it gone */
+    if (cc_of_global.ofreconn_htbl) {
+        g_hash_table_destroy(cc_of_global.ofreconn_htbl);
+        cc_of_global.ofreconn_htbl = NULL;
+    }
+    cc_ofchann_rtbl_free(&cc_of_global.ofchann_rtbl);
+    cc_ofrw_tbl_free(&cc_of_global.ofrw_tbl);
         
     g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);    
     g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
@@ -288,6 +351,7 @@ cc_of_dev_register(uint32_t controller_ipaddr,
     if (cc_of_global.ofdev_type == CONTROLLER) {
 
         // Create a TCP sockfd for tcp connections
+        dev_info->tcp_listen_rw = (cc_of_global.oftcp_num_listeners > 1);
         dev_info->main_sockfd_tcp =
             cc_of_global.NET_SVCS[TCP].open_serverfd(*key);
         if (dev_info->main_sockfd_tcp < 0) {
@@ -301,23 +365,23 @@ cc_of_dev_register(uint32_t controller_ipaddr,
         CC_LOG_DEBUG("%s(%d): %s", __FUNCTION__, __LINE__,
                  "Created TCP listenfd");
 
-        // Create a udp sockfd for udp connections
-#if 0
-        dev_info->main_sockfd_udp =
-            cc_of_global.NET_SVCS[UDP].open_serverfd(*key);
-        if (dev_info->main_sockfd_udp < 0) {
-	        status = CC_OF_EMISC;
-	        CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__,
-                         cc_of_strerror(status));
-            g_free(key);
-            g_free(dev_info);
-	        return status;
+        // Create the udp sockfds for udp connections, if asked for
+        dev_info->main_sockfd_udp = -1;
+        if (cc_of_global.ofudp_num_sockets > 0) {
+            dev_info->main_sockfd_udp =
+                cc_of_global.NET_SVCS[UDP].open_serverfd(*key);
+            if (dev_info->main_sockfd_udp < 0) {
+                status = CC_OF_EMISC;
+                CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__,
+                             cc_of_strerror(status));
+                g_free(key);
+                g_free(dev_info);
+                return status;
+            }
+
+            CC_LOG_DEBUG("%s(%d): Created %u UDP serverfds", __FUNCTION__,
+                         __LINE__, cc_of_global.ofudp_num_sockets);
         }
-
-        CC_LOG_DEBUG("%s(%d): %s", __FUNCTION__, __LINE__,
-                 "Created UDP serverfd");
- #endif
-
     }
 
     CC_LOG_INFO("%s(%d):CC_OF_DEV initilaized successfully"
@@ -329,6 +393,113 @@ cc_of_dev_register(uint32_t controller_ipaddr,
 }
 
 
+cc_of_ret
+cc_of_dev_register_recv_batch(uint32_t controller_ip_addr,
+                              uint32_t switch_ip_addr,
+                              uint16_t controller_L4_port,
+                              cc_of_recv_pkt_batch recv_batch_func)
+{
+    cc_ofdev_key_t dkey;
+    cc_ofdev_info_t *dev_info;
+
+    memset(&dkey, 0, sizeof(dkey));
+    dkey.controller_ip_addr = controller_ip_addr;
+    dkey.switch_ip_addr = switch_ip_addr;
+    dkey.controller_L4_port = controller_L4_port;
+
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    dev_info = g_hash_table_lookup(cc_of_global.ofdev_htbl, &dkey);
+    if (dev_info == NULL) {
+        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+        CC_LOG_ERROR("%s(%d): device controller_ip-0x%x switch_ip-0x%x "
+                     "port-%hu is not registered", __FUNCTION__, __LINE__,
+                     controller_ip_addr, switch_ip_addr, controller_L4_port);
+        return CC_OF_EINVAL;
+    }
+    /* the poll threads pick it up through their cached rw contexts */
+    dev_info->recv_batch_func = recv_batch_func;
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    cc_ofrw_ctx_invalidate_dev(&dkey);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+
+    CC_LOG_INFO("%s(%d): batched receive callback %s", __FUNCTION__,
+                __LINE__, recv_batch_func ? "registered" : "cleared");
+    return CC_OF_OK;
+}
+
+
+cc_of_ret
+cc_of_dev_register_chann_up(uint32_t controller_ip_addr,
+                            uint32_t switch_ip_addr,
+                            uint16_t controller_L4_port,
+                            cc_of_channel_up chann_up_func)
+{
+    cc_ofdev_key_t dkey;
+    cc_ofdev_info_t *dev_info;
+
+    memset(&dkey, 0, sizeof(dkey));
+    dkey.controller_ip_addr = controller_ip_addr;
+    dkey.switch_ip_addr = switch_ip_addr;
+    dkey.controller_L4_port = controller_L4_port;
+
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    dev_info = g_hash_table_lookup(cc_of_global.ofdev_htbl, &dkey);
+    if (dev_info == NULL) {
+        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+        CC_LOG_ERROR("%s(%d): device controller_ip-0x%x switch_ip-0x%x "
+                     "port-%hu is not registered", __FUNCTION__, __LINE__,
+                     controller_ip_addr, switch_ip_addr, controller_L4_port);
+        return CC_OF_EINVAL;
+    }
+    dev_info->chann_up_func = chann_up_func;
+    /* the poll threads pick it up through their cached rw contexts */
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    cc_ofrw_ctx_invalidate_dev(&dkey);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+
+    CC_LOG_INFO("%s(%d): channel up callback %s", __FUNCTION__,
+                __LINE__, chann_up_func ? "registered" : "cleared");
+    return CC_OF_OK;
+}
+
+cc_of_ret
+cc_of_dev_register_chann_ready(uint32_t controller_ip_addr,
+                               uint32_t switch_ip_addr,
+                               uint16_t controller_L4_port,
+                               cc_of_channel_ready chann_ready_func)
+{
+    cc_ofdev_key_t dkey;
+    cc_ofdev_info_t *dev_info;
+
+    memset(&dkey, 0, sizeof(dkey));
+    dkey.controller_ip_addr = controller_ip_addr;
+    dkey.switch_ip_addr = switch_ip_addr;
+    dkey.controller_L4_port = controller_L4_port;
+
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    dev_info = g_hash_table_lookup(cc_of_global.ofdev_htbl, &dkey);
+    if (dev_info == NULL) {
+        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+        CC_LOG_ERROR("%s(%d): device controller_ip-0x%x switch_ip-0x%x "
+                     "port-%hu is not registered", __FUNCTION__, __LINE__,
+                     controller_ip_addr, switch_ip_addr, controller_L4_port);
+        return CC_OF_EINVAL;
+    }
+    dev_info->chann_ready_func = chann_ready_func;
+    /* poll threads pick it up with the next channel */
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    cc_ofrw_ctx_invalidate_dev(&dkey);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+
+    CC_LOG_INFO("%s(%d): channel ready callback %s", __FUNCTION__,
+                __LINE__, chann_ready_func ? "registered" : "cleared");
+    return CC_OF_OK;
+}
+
+
 cc_of_ret
 cc_of_dev_free(uint32_t controller_ip_addr,
                uint32_t switch_ip_addr,
@@ -363,6 +534,8 @@ cc_of_dev_free(uint32_t controller_ip_addr,
  
     g_assert(g_hash_table_size(cc_of_global.ofdev_htbl) == 1);
 
+    cc_ofchann_reconnect_dev_clear(*dkey);
+
     g_assert(g_hash_table_contains(cc_of_global.ofdev_htbl,
                                    dkey) == TRUE);
 
@@ -409,28 +582,25 @@ cc_of_dev_free(uint32_t controller_ip_addr,
     while (elem != NULL) {
         cc_ofrw_key_t rwkey;
         cc_ofrw_info_t *rwinfo;
-        gpointer rwht_key = NULL, rwht_info = NULL;
 
         rwkey.rw_sockfd = *((int *)(elem->data));
         CC_LOG_DEBUG("rw sockfd found: %d", rwkey.rw_sockfd);
 
         print_ofrw_htbl();
 
-        if (g_hash_table_lookup_extended(cc_of_global.ofrw_htbl, &rwkey,
-                                         &rwht_key, &rwht_info) == FALSE) {
+        rwinfo = cc_ofrw_lookup(rwkey.rw_sockfd);
+        if (rwinfo == NULL) {
             CC_LOG_ERROR("%s(%d): ofrw lookup failed", __FUNCTION__,
                          __LINE__);
         } else {
-            CC_LOG_DEBUG("%s(%d): found %d in ofrw htbl", __FUNCTION__,
+            CC_LOG_DEBUG("%s(%d): found %d in ofrw tbl", __FUNCTION__,
                          __LINE__, rwkey.rw_sockfd);
         }
-        
-        rwinfo = (cc_ofrw_info_t *)rwht_info;
 
 
         
         if (rwinfo == NULL) {
-            CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_htbl"
+            CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_tbl"
                          "for sockfd-%d", __FUNCTION__, __LINE__, rwkey.rw_sockfd);
             continue;
         } else {
@@ -462,19 +632,25 @@ cc_of_dev_free(uint32_t controller_ip_addr,
     }
 
     // close main tcp listenfd and remove it from oflisten_pollthr.
-    thr_msg.fd = ht_dinfo->main_sockfd_tcp;
-    thr_msg.fd_type = SOCKET;
-    thr_msg.fd_action = DELETE_FD;
-
-    status = adp_thr_mgr_add_del_fd(cc_of_global.oflisten_pollthr_p, &thr_msg);
-    if (status != -1 ) {
-        CC_LOG_ERROR("%s(%d):Error deleting tcp_listenfd from oflisten_pollthr_p: %s",
-                     __FUNCTION__, __LINE__, cc_of_strerror(errno));
-    }
-    status = close(ht_dinfo->main_sockfd_tcp);
-    if (status < 0) {
-        CC_LOG_ERROR("%s(%d):Error closing tcp_listenfd: %s",
-                     __FUNCTION__, __LINE__, strerror(errno));
+    // listeners on the rw poll threads were closed by the walk above.
+    // a switch has no listenfd
+    if ((cc_of_global.ofdev_type == CONTROLLER) &&
+        !ht_dinfo->tcp_listen_rw) {
+        thr_msg.fd = ht_dinfo->main_sockfd_tcp;
+        thr_msg.fd_type = SOCKET;
+        thr_msg.fd_action = DELETE_FD;
+
+        status = adp_thr_mgr_add_del_fd(cc_of_global.oflisten_pollthr_p,
+                                        &thr_msg);
+        if (status != -1 ) {
+            CC_LOG_ERROR("%s(%d):Error deleting tcp_listenfd from oflisten_pollthr_p: %s",
+                         __FUNCTION__, __LINE__, cc_of_strerror(errno));
+        }
+        status = close(ht_dinfo->main_sockfd_tcp);
+        if (status < 0) {
+            CC_LOG_ERROR("%s(%d):Error closing tcp_listenfd: %s",
+                         __FUNCTION__, __LINE__, strerror(errno));
+        }
     }
 
     // delete dev from devhtbl
@@ -555,6 +731,8 @@ cc_of_dev_free_lockfree(uint32_t controller_ip_addr,
     g_assert(g_hash_table_contains(cc_of_global.ofdev_htbl,
                                    dkey) == TRUE);
 
+    cc_ofchann_reconnect_dev_clear(*dkey);
+
     CC_LOG_DEBUG("%s(%d): looking up "
                  "controller_ip-0x%x, switch_ip-0x%x,"
                  "controller_l4_port-%d",__FUNCTION__, __LINE__,
@@ -598,28 +776,25 @@ cc_of_dev_free_lockfree(uint32_t controller_ip_addr,
     while (elem != NULL) {
         cc_ofrw_key_t rwkey;
         cc_ofrw_info_t *rwinfo;
-        gpointer rwht_key = NULL, rwht_info = NULL;
 
         rwkey.rw_sockfd = *((int *)(elem->data));
         CC_LOG_DEBUG("rw sockfd found: %d", rwkey.rw_sockfd);
 
         print_ofrw_htbl();
 
-        if (g_hash_table_lookup_extended(cc_of_global.ofrw_htbl, &rwkey,
-                                         &rwht_key, &rwht_info) == FALSE) {
+        rwinfo = cc_ofrw_lookup(rwkey.rw_sockfd);
+        if (rwinfo == NULL) {
             CC_LOG_ERROR("%s(%d): ofrw lookup failed", __FUNCTION__,
                          __LINE__);
         } else {
-            CC_LOG_DEBUG("%s(%d): found %d in ofrw htbl", __FUNCTION__,
+            CC_LOG_DEBUG("%s(%d): found %d in ofrw tbl", __FUNCTION__,
                          __LINE__, rwkey.rw_sockfd);
         }
-        
-        rwinfo = (cc_ofrw_info_t *)rwht_info;
 
 
         
         if (rwinfo == NULL) {
-            CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_htbl"
+            CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_tbl"
                          "for sockfd-%d", __FUNCTION__, __LINE__, rwkey.rw_sockfd);
             continue;
         } else {
@@ -651,19 +826,25 @@ cc_of_dev_free_lockfree(uint32_t controller_ip_addr,
     }
 
     // close main tcp listenfd and remove it from oflisten_pollthr.
-    thr_msg.fd = ht_dinfo->main_sockfd_tcp;
-    thr_msg.fd_type = SOCKET;
-    thr_msg.fd_action = DELETE_FD;
-
-    status = adp_thr_mgr_add_del_fd(cc_of_global.oflisten_pollthr_p, &thr_msg);
-    if (status != -1 ) {
-        CC_LOG_ERROR("%s(%d):Error deleting tcp_listenfd from oflisten_pollthr_p: %s",
-                     __FUNCTION__, __LINE__, cc_of_strerror(errno));
-    }
-    status = close(ht_dinfo->main_sockfd_tcp);
-    if (status < 0) {
-        CC_LOG_ERROR("%s(%d):Error closing tcp_listenfd: %s",
-                     __FUNCTION__, __LINE__, strerror(errno));
+    // listeners on the rw poll threads were closed by the walk above.
+    // a switch has no listenfd
+    if ((cc_of_global.ofdev_type == CONTROLLER) &&
+        !ht_dinfo->tcp_listen_rw) {
+        thr_msg.fd = ht_dinfo->main_sockfd_tcp;
+        thr_msg.fd_type = SOCKET;
+        thr_msg.fd_action = DELETE_FD;
+
+        status = adp_thr_mgr_add_del_fd(cc_of_global.oflisten_pollthr_p,
+                                        &thr_msg);
+        if (status != -1 ) {
+            CC_LOG_ERROR("%s(%d):Error deleting tcp_listenfd from oflisten_pollthr_p: %s",
+                         __FUNCTION__, __LINE__, cc_of_strerror(errno));
+        }
+        status = close(ht_dinfo->main_sockfd_tcp);
+        if (status < 0) {
+            CC_LOG_ERROR("%s(%d):Error closing tcp_listenfd: %s",
+                         __FUNCTION__, __LINE__, strerror(errno));
+        }
     }
 
     CC_LOG_INFO("%s(%d):, Devfree success for device"
@@ -728,10 +909,9 @@ cc_of_destroy_channel(uint64_t dp_id, uint8_t aux_id)
     cc_of_ret status = CC_OF_OK;
     cc_ofchannel_key_t ofchann_key;
     cc_ofchannel_info_t *ofchann_info;
-    cc_ofrw_key_t rwkey;
     cc_ofrw_info_t *rwinfo = NULL;
     gpointer chht_key = NULL, chht_info = NULL;
-    gpointer rwht_key = NULL, rwht_info = NULL;
+    gboolean reconn;
 
     CC_LOG_INFO("%s(%d): %s", __FUNCTION__, __LINE__,
                "Started destroying ofchannel for dp_id:%lu,"
@@ -743,31 +923,39 @@ cc_of_destroy_channel(uint64_t dp_id, uint8_t aux_id)
     g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
     g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
     
+    /* stops a reconnect of the channel */
+    reconn = cc_ofchann_reconnect_clear(ofchann_key, NULL);
+
     if (g_hash_table_lookup_extended(cc_of_global.ofchannel_htbl, 
                                      &ofchann_key, &chht_key,
                                      &chht_info) == FALSE) {
+        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+        if (reconn) {
+            /* waiting to reconnect - there is no socket */
+            CC_LOG_INFO("%s(%d):, Stopped reconnecting ofchannel dp_id-%lu,"
+                        "aux_id-%u", __FUNCTION__, __LINE__, dp_id, aux_id);
+            return CC_OF_OK;
+        }
         CC_LOG_ERROR("%s(%d):, could not find ofchann_info in ofchannel_htbl"
                      "for key dp_id-%lu, aux_id-%u",__FUNCTION__, __LINE__, 
                      dp_id, aux_id);
-        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
         return CC_OF_EINVAL;
     }
     
     ofchann_info = (cc_ofchannel_info_t *)chht_info;
         
-    rwkey.rw_sockfd = ofchann_info->rw_sockfd;
     g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
-    if (g_hash_table_lookup_extended(cc_of_global.ofrw_htbl, &rwkey,
-                                     &rwht_key, &rwht_info) == FALSE) {
-        CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_htbl"
-                     "for sockfd-%d", __FUNCTION__, __LINE__, rwkey.rw_sockfd);
+    rwinfo = cc_ofrw_lookup(ofchann_info->rw_sockfd);
+    if (rwinfo == NULL) {
+        CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_tbl"
+                     "for sockfd-%d", __FUNCTION__, __LINE__,
+                     ofchann_info->rw_sockfd);
         g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
         g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
         g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
         return CC_OF_EINVAL;
     }
-    rwinfo = (cc_ofrw_info_t *)rwht_info;
 
     status = cc_of_global.NET_SVCS[rwinfo->layer4_proto].close_conn(ofchann_info->rw_sockfd);
     if (status < 0) {
@@ -789,27 +977,52 @@ cc_of_destroy_channel(uint64_t dp_id, uint8_t aux_id)
 }
 
 
-cc_of_ret
-cc_of_send_pkt(uint64_t dp_id, uint8_t aux_id, void *of_msg, 
-               size_t msg_len)
+/* send message header of a buffer from cc_of_send_buf_alloc() */
+#define SEND_BUF_TO_MSG(buf)                                            \
+    ((adpoll_send_msg_htbl_info_t *)((char *)(buf) -                    \
+        G_STRUCT_OFFSET(adpoll_send_msg_htbl_info_t, data)))
+
+void *
+cc_of_send_buf_alloc(size_t msg_len)
+{
+    adpoll_send_msg_htbl_info_t *msg_p;
+
+    if (msg_len > G_MAXUINT) {
+        return NULL;
+    }
+    msg_p = adp_thr_mgr_msg_alloc((uint)msg_len);
+    if (msg_p == NULL) {
+        CC_LOG_ERROR("%s(%d): could not allocate %zu byte send buffer",
+                     __FUNCTION__, __LINE__, msg_len);
+        return NULL;
+    }
+    return msg_p->data;
+}
+
+void
+cc_of_send_buf_free(void *buf)
+{
+    if (buf) {
+        adp_thr_mgr_msg_free(SEND_BUF_TO_MSG(buf));
+    }
+}
+
+/* rw socket, its generation and its poll thread for a channel
+ * MUST be called with ofchannel_htbl_lock and ofrw_htbl_lock held
+ */
+static cc_of_ret
+cc_of_find_send_channel(uint64_t dp_id, uint8_t aux_id,
+                        int *rwsock, uint32_t *fd_gen,
+                        adpoll_thread_mgr_t **tmgr)
 {
     cc_ofchannel_info_t *chann_info;
-    adpoll_thread_mgr_t *tmgr = NULL;
-    int send_rwsock;    
-    adpoll_send_msg_t  *msg_p;
-    msg_p = (adpoll_send_msg_t *)SEND_MSG_BUF;
     cc_ofchannel_key_t chann_id;
+    cc_ofrw_info_t *rwinfo;
     gpointer chht_key = NULL, chht_info = NULL;
 
     chann_id.dp_id = dp_id;
     chann_id.aux_id = aux_id;
 
-    if (of_msg == NULL) {
-        CC_LOG_ERROR("%s(%d): message is invalid",
-                     __FUNCTION__, __LINE__);
-        return CC_OF_EINVAL;
-    }
-    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
     if (g_hash_table_lookup_extended(cc_of_global.ofchannel_htbl,
                                      (gconstpointer)&chann_id,
                                      &chht_key, &chht_info) == FALSE) {
@@ -824,32 +1037,326 @@ cc_of_send_pkt(uint64_t dp_id, uint8_t aux_id, void *of_msg,
             CC_LOG_ERROR("%s(%d): channel %d/%d not found", __FUNCTION__,
                          __LINE__, (int)chann_id.dp_id,
                          (int)chann_id.aux_id);
-            g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
             return CC_OF_EINVAL;
         }
     }
     chann_info = (cc_ofchannel_info_t *)chht_info;
-    send_rwsock = chann_info->rw_sockfd;
+    *rwsock = chann_info->rw_sockfd;
 
-    find_thrmgr_rwsocket(send_rwsock, &tmgr);
+    /* a controller's UDP channel has a dummy socket, its messages go
+     * out on the UDP socket it came in on
+     */
+    rwinfo = cc_ofrw_lookup(*rwsock);
+    if ((rwinfo != NULL) && (rwinfo->parent_sockfd >= 0)) {
+        *rwsock = rwinfo->parent_sockfd;
+    }
 
-    if (tmgr == NULL) {
+    *tmgr = NULL;
+    find_thrmgr_rwsocket_lockfree(*rwsock, tmgr);
+    if (*tmgr == NULL) {
         CC_LOG_ERROR("%s(%d): socket %d is invalid",
-                     __FUNCTION__, __LINE__, send_rwsock);
-        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+                     __FUNCTION__, __LINE__, *rwsock);
+        return CC_OF_EINVAL;
+    }
+    *fd_gen = cc_ofrw_get_gen(*rwsock);
+    /* later sends to the channel find it without the locks */
+    cc_ofchann_route_set_thr(&chann_id, *rwsock, *fd_gen, *tmgr);
+    return CC_OF_OK;
+}
+
+/* rw socket and its poll thread for a channel, normally from the
+ * lock-free channel route table. Only the first send to a channel
+ * goes to the htbls under their locks.
+ * fd_gen, recorded with the route, goes with the message, so the
+ * poll thread drops it if the socket was closed and its fd reused
+ * after the route was.
+ */
+static cc_of_ret
+cc_of_lookup_send_channel(uint64_t dp_id, uint8_t aux_id,
+                          int *rwsock, uint32_t *fd_gen,
+                          adpoll_thread_mgr_t **tmgr)
+{
+    cc_of_ret status;
+
+    status = cc_ofchann_route_lookup(dp_id, aux_id, rwsock, fd_gen, tmgr);
+    if (status == CC_OF_EHTBL) {
+        /* same aux_id fallback as cc_of_find_send_channel */
+        status = cc_ofchann_route_lookup(dp_id, (uint8_t)dp_id,
+                                         rwsock, fd_gen, tmgr);
+    }
+    if (status == CC_OF_OK) {
+        return status;
+    }
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    status = cc_of_find_send_channel(dp_id, aux_id, rwsock, fd_gen, tmgr);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    return status;
+}
+
+cc_of_ret
+cc_of_send_pkt_buf(uint64_t dp_id, uint8_t aux_id, void *buf,
+                   size_t msg_len)
+{
+    adpoll_thread_mgr_t *tmgr = NULL;
+    int send_rwsock;    
+    uint32_t fd_gen;
+    adpoll_send_msg_htbl_info_t *msg_p;
+    cc_of_ret status;
+
+    if (buf == NULL) {
+        CC_LOG_ERROR("%s(%d): message is invalid",
+                     __FUNCTION__, __LINE__);
+        return CC_OF_EINVAL;
+    }
+    msg_p = SEND_BUF_TO_MSG(buf);
+    if (msg_len > msg_p->buf_size) {
+        CC_LOG_ERROR("%s(%d): message length %zu exceeds buffer size %u",
+                     __FUNCTION__, __LINE__, msg_len, msg_p->buf_size);
         return CC_OF_EINVAL;
     }
+
+    status = cc_of_lookup_send_channel(dp_id, aux_id, &send_rwsock,
+                                       &fd_gen, &tmgr);
+    if (status != CC_OF_OK) {
+        return status;
+    }
     
-    msg_p->hdr.msg_size = msg_len + sizeof(adpoll_send_msg_hdr_t);
-    msg_p->hdr.fd = send_rwsock;
-    g_memmove(msg_p->data, of_msg, msg_len);
+    msg_p->data_size = msg_len;
+    msg_p->dp_id = dp_id;
+    msg_p->aux_id = aux_id;
+    msg_p->fd_gen = fd_gen;
+
+    /* ownership of msg_p moves to the poll thread */
+    if (adp_thr_mgr_send_msg(tmgr, send_rwsock, msg_p) < 0) {
+        return CC_OF_ESYS;
+    }
+    return CC_OF_OK;
+}
+
+/* messages of a batch that go to the same poll thread */
+typedef struct cc_of_send_group_ {
+    adpoll_thread_mgr_t *tmgr;
+    GArray              *msg_arr;   /* adpoll_send_msg_t */
+    GArray              *entry_arr; /* index into the batch */
+} cc_of_send_group_t;
+
+cc_of_ret
+cc_of_send_pkt_batch(cc_of_send_entry_t *entries, uint32_t num_entries)
+{
+    cc_of_send_entry_t *entry;
+    cc_of_send_group_t *group;
+    adpoll_send_msg_htbl_info_t *msg_p;
+    adpoll_send_msg_t send_msg;
+    adpoll_thread_mgr_t *tmgr = NULL;
+    GHashTable *group_htbl;
+    GHashTableIter group_iter;
+    gpointer gkey = NULL, ginfo = NULL;
+    cc_of_ret status = CC_OF_OK;
+    uint32_t i, fd_gen;
+    int num_sent, j;
+
+    if ((entries == NULL) || (num_entries == 0)) {
+        return CC_OF_EINVAL;
+    }
+    group_htbl = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    /* one pass to find every channel */
+    for (i = 0; i < num_entries; i++) {
+        entry = &entries[i];
+        if (entry->buf == NULL) {
+            entry->status = CC_OF_EINVAL;
+            continue;
+        }
+        msg_p = SEND_BUF_TO_MSG(entry->buf);
+        if (entry->msg_len > msg_p->buf_size) {
+            entry->status = CC_OF_EINVAL;
+            continue;
+        }
+        entry->status = cc_of_lookup_send_channel(entry->dp_id,
+                                                  entry->aux_id,
+                                                  &send_msg.fd, &fd_gen,
+                                                  &tmgr);
+        if (entry->status != CC_OF_OK) {
+            continue;
+        }
+        msg_p->data_size = entry->msg_len;
+        msg_p->dp_id = entry->dp_id;
+        msg_p->aux_id = entry->aux_id;
+        msg_p->fd_gen = fd_gen;
+        send_msg.msg_p = msg_p;
+
+        group = g_hash_table_lookup(group_htbl, tmgr);
+        if (group == NULL) {
+            group = (cc_of_send_group_t *)malloc(sizeof(cc_of_send_group_t));
+            group->tmgr = tmgr;
+            group->msg_arr = g_array_new(FALSE, FALSE,
+                                         sizeof(adpoll_send_msg_t));
+            group->entry_arr = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+            g_hash_table_insert(group_htbl, tmgr, group);
+        }
+        g_array_append_val(group->msg_arr, send_msg);
+        g_array_append_val(group->entry_arr, i);
+    }
 
-    write(adp_thr_mgr_get_data_pipe_wr(tmgr),
-          msg_p, msg_p->hdr.msg_size);
-    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock); 
+    /* one hand-off and at most one wakeup per poll thread */
+    g_hash_table_iter_init(&group_iter, group_htbl);
+    while (g_hash_table_iter_next(&group_iter, &gkey, &ginfo)) {
+        group = (cc_of_send_group_t *)ginfo;
+        num_sent = adp_thr_mgr_send_msg_batch(
+            group->tmgr, (adpoll_send_msg_t *)group->msg_arr->data,
+            group->msg_arr->len);
+        for (j = num_sent; j < (int)group->msg_arr->len; j++) {
+            entries[g_array_index(group->entry_arr, uint32_t, j)].status =
+                CC_OF_ESYS;
+        }
+        g_array_free(group->msg_arr, TRUE);
+        g_array_free(group->entry_arr, TRUE);
+        free(group);
+    }
+    g_hash_table_destroy(group_htbl);
+
+    for (i = 0; i < num_entries; i++) {
+        if (entries[i].status != CC_OF_OK) {
+            CC_LOG_ERROR("%s(%d): entry %u to %lu/%u failed: %s",
+                         __FUNCTION__, __LINE__, i, entries[i].dp_id,
+                         entries[i].aux_id,
+                         cc_of_strerror(entries[i].status));
+            if (status == CC_OF_OK) {
+                status = entries[i].status;
+            }
+        }
+    }
+    return status;
+}
+
+cc_of_ret
+cc_of_send_pkt(uint64_t dp_id, uint8_t aux_id, void *of_msg, 
+               size_t msg_len)
+{
+    void *buf;
+    cc_of_ret status;
+
+    if (of_msg == NULL) {
+        CC_LOG_ERROR("%s(%d): message is invalid",
+                     __FUNCTION__, __LINE__);
+        return CC_OF_EINVAL;
+    }
+    buf = cc_of_send_buf_alloc(msg_len);
+    if (buf == NULL) {
+        return CC_OF_ENOMEM;
+    }
+    g_memmove(buf, of_msg, msg_len);
+
+    status = cc_of_send_pkt_buf(dp_id, aux_id, buf, msg_len);
+    if (status != CC_OF_OK) {
+        cc_of_send_buf_free(buf);
+    }
+    return status;
+}
+
+/* request with one of reply_func or mp_func to be called back */
+static cc_of_ret
+cc_of_send_xid_req(uint64_t dp_id, uint8_t aux_id, void *of_msg,
+                   size_t msg_len, uint32_t timeout_ms,
+                   cc_of_reply reply_func, cc_of_multipart_reply mp_func,
+                   void *reply_ctx)
+{
+    adpoll_thread_mgr_t *tmgr = NULL;
+    adpoll_send_msg_htbl_info_t *msg_p;
+    cc_ofrw_info_t *rw_info = NULL;
+    L4_type_e layer4_proto = MAX_L4_TYPE;
+    cc_of_xid_req_t *req;
+    int send_rwsock;
+    uint32_t xid, fd_gen;
+    void *buf;
+    cc_of_ret status;
+
+    if ((of_msg == NULL) || (msg_len < OFP_HEADER_LEN) ||
+        ((reply_func == NULL) && (mp_func == NULL))) {
+        CC_LOG_ERROR("%s(%d): request is invalid",
+                     __FUNCTION__, __LINE__);
+        return CC_OF_EINVAL;
+    }
+    xid = ntohl(((ofp_header_t *)of_msg)->xid);
+    if (xid == 0) {
+        CC_LOG_ERROR("%s(%d): request to %lu/%u has no xid",
+                     __FUNCTION__, __LINE__, dp_id, aux_id);
+        return CC_OF_EINVAL;
+    }
+
+    status = cc_of_lookup_send_channel(dp_id, aux_id, &send_rwsock,
+                                       &fd_gen, &tmgr);
+    if (status != CC_OF_OK) {
+        return status;
+    }
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    rw_info = cc_ofrw_lookup(send_rwsock);
+    if (rw_info != NULL) {
+        layer4_proto = rw_info->layer4_proto;
+    }
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    if (layer4_proto != TCP) {
+        CC_LOG_ERROR("%s(%d): requests are only tracked on TCP channels",
+                     __FUNCTION__, __LINE__);
+        return CC_OF_EINVAL;
+    }
+
+    req = cc_of_xid_req_new(dp_id, aux_id, xid, timeout_ms, reply_func,
+                            mp_func, reply_ctx);
+    buf = cc_of_send_buf_alloc(msg_len);
+    if ((req == NULL) || (buf == NULL)) {
+        cc_of_xid_req_free(req);
+        cc_of_send_buf_free(buf);
+        return CC_OF_ENOMEM;
+    }
+    g_memmove(buf, of_msg, msg_len);
+    msg_p = SEND_BUF_TO_MSG(buf);
+    msg_p->data_size = msg_len;
+    msg_p->dp_id = dp_id;
+    msg_p->aux_id = aux_id;
+    msg_p->fd_gen = fd_gen;
+    msg_p->req = req;
+    msg_p->req_free = cc_of_xid_req_drop;
+
+    /* ownership of msg_p and req moves to the poll thread */
+    if (adp_thr_mgr_send_msg(tmgr, send_rwsock, msg_p) < 0) {
+        /* not failed through reply_func - the caller gets the error */
+        msg_p->req = NULL;
+        cc_of_xid_req_free(req);
+        cc_of_send_buf_free(buf);
+        return CC_OF_ESYS;
+    }
     return CC_OF_OK;
 }
 
+cc_of_ret
+cc_of_send_request(uint64_t dp_id, uint8_t aux_id, void *of_msg,
+                   size_t msg_len, uint32_t timeout_ms,
+                   cc_of_reply reply_func, void *reply_ctx)
+{
+    if (reply_func == NULL) {
+        return CC_OF_EINVAL;
+    }
+    return cc_of_send_xid_req(dp_id, aux_id, of_msg, msg_len, timeout_ms,
+                              reply_func, NULL, reply_ctx);
+}
+
+cc_of_ret
+cc_of_send_multipart_request(uint64_t dp_id, uint8_t aux_id, void *of_msg,
+                             size_t msg_len, uint32_t timeout_ms,
+                             cc_of_multipart_reply reply_func,
+                             void *reply_ctx)
+{
+    if (reply_func == NULL) {
+        return CC_OF_EINVAL;
+    }
+    return cc_of_send_xid_req(dp_id, aux_id, of_msg, msg_len, timeout_ms,
+                              NULL, reply_func, reply_ctx);
+}
+
 
 cc_of_ret
 cc_of_set_real_dpid_auxid(uint64_t dummy_dpid, uint8_t dummy_auxid,
@@ -857,13 +1364,9 @@ cc_of_set_real_dpid_auxid(uint64_t dummy_dpid, uint8_t dummy_auxid,
 {
     cc_of_ret status = CC_OF_OK;
     cc_ofchannel_info_t *ofchann_info_old = NULL;
-    cc_ofchannel_info_t ofchann_info_new;
     cc_ofchannel_key_t ofchann_key_old, ofchann_key_new;
-    gboolean new_entry;
     gpointer chht_key = NULL, chht_info = NULL;
 
-    ofchann_key_new.dp_id = dp_id;
-    ofchann_key_new.aux_id = aux_id;
     ofchann_key_old.dp_id = dummy_dpid;
     ofchann_key_old.aux_id = dummy_auxid;
 
@@ -893,17 +1396,264 @@ cc_of_set_real_dpid_auxid(uint64_t dummy_dpid, uint8_t dummy_auxid,
                 __FUNCTION__, __LINE__, ofchann_info_old);
 
 
-    memcpy(&ofchann_info_new, ofchann_info_old, sizeof(cc_ofchannel_info_t));
-    status = del_ofchann_rwsocket((int)dummy_dpid);
-	print_ofchann_htbl();
-    update_global_htbl_lockfree(OFCHANN, ADD, (gpointer)&ofchann_key_new, 
-                       &ofchann_info_new, &new_entry); 
+    ofchann_key_new.dp_id = dp_id;
+    ofchann_key_new.aux_id = aux_id;
+    status = cc_ofchann_rekey(ofchann_info_old->rw_sockfd, &ofchann_key_new);
     print_ofchann_htbl();
 	g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
     return status;
 }
 
 
+cc_of_ret
+cc_of_get_conn_stats(uint64_t dp_id, uint8_t aux_id,
+                     uint32_t *rx_pkt, uint32_t *tx_pkt, uint32_t *tx_drops)
+{
+    cc_ofchannel_key_t ofchann_key;
+    cc_ofchannel_info_t *ofchann_info;
+
+    ofchann_key.dp_id = dp_id;
+    ofchann_key.aux_id = aux_id;
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    ofchann_info = g_hash_table_lookup(cc_of_global.ofchannel_htbl,
+                                       &ofchann_key);
+    if (ofchann_info == NULL) {
+        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+        return CC_OF_EINVAL;
+    }
+    if (rx_pkt) {
+        *rx_pkt = ofchann_info->stats.rx_pkt;
+    }
+    if (tx_pkt) {
+        *tx_pkt = ofchann_info->stats.tx_pkt;
+    }
+    if (tx_drops) {
+        *tx_drops = ofchann_info->stats.tx_drops;
+    }
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    return CC_OF_OK;
+}
+
+cc_of_ret
+cc_of_get_conn_state(uint64_t dp_id, uint8_t aux_id,
+                     cc_of_conn_state_e *state, uint32_t *count_retries)
+{
+    cc_of_ret status = CC_OF_OK;
+    cc_ofchannel_key_t ofchann_key;
+    cc_ofchannel_info_t *ofchann_info;
+    cc_ofchann_reconn_t *reconn;
+    cc_ofrw_info_t *rwinfo;
+    cc_of_conn_state_e chann_state = CC_OF_CONN_UP;
+    uint32_t chann_retries = 0;
+
+    ofchann_key.dp_id = dp_id;
+    ofchann_key.aux_id = aux_id;
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+
+    ofchann_info = g_hash_table_lookup(cc_of_global.ofchannel_htbl,
+                                       &ofchann_key);
+    reconn = NULL;
+    if (cc_of_global.ofreconn_htbl) {
+        reconn = g_hash_table_lookup(cc_of_global.ofreconn_htbl,
+                                     &ofchann_key);
+    }
+
+    if (reconn != NULL) {
+        chann_state = reconn->state;
+        chann_retries = reconn->count_retries;
+    } else if (ofchann_info != NULL) {
+        chann_retries = ofchann_info->count_retries;
+        rwinfo = cc_ofrw_lookup(ofchann_info->rw_sockfd);
+        /* a switch socket is up once its connect completed */
+        if ((cc_of_global.ofdev_type == SWITCH) && (rwinfo != NULL) &&
+            (rwinfo->layer4_proto == TCP) &&
+            (rwinfo->state != CC_OF_RW_UP)) {
+            chann_state = CC_OF_CONN_CONNECTING;
+        }
+    } else {
+        status = CC_OF_EINVAL;
+    }
+
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+
+    if (status == CC_OF_OK) {
+        if (state) {
+            *state = chann_state;
+        }
+        if (count_retries) {
+            *count_retries = chann_retries;
+        }
+    }
+    return status;
+}
+
+cc_of_ret
+cc_of_get_conn_rtt(uint64_t dp_id, uint8_t aux_id, uint32_t *rtt_us,
+                   uint32_t *srtt_us, uint32_t *min_rtt_us)
+{
+    cc_of_ret status = CC_OF_OK;
+    cc_ofchannel_key_t ofchann_key;
+    cc_ofchannel_info_t *ofchann_info;
+    cc_ofrw_ctx_t *ctx = NULL;
+    gint rtt = 0, srtt = 0, min_rtt = 0;
+
+    ofchann_key.dp_id = dp_id;
+    ofchann_key.aux_id = aux_id;
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+
+    ofchann_info = g_hash_table_lookup(cc_of_global.ofchannel_htbl,
+                                       &ofchann_key);
+    if (ofchann_info == NULL) {
+        status = CC_OF_EINVAL;
+    } else {
+        /* the poll thread updates the estimates without the locks; the
+         * context is freed only after its fd left the table
+         */
+        ctx = cc_ofrw_lookup_ctx(ofchann_info->rw_sockfd);
+        if (ctx != NULL) {
+            rtt = g_atomic_int_get(&ctx->rtt_us);
+            srtt = g_atomic_int_get(&ctx->srtt_us);
+            min_rtt = g_atomic_int_get(&ctx->min_rtt_us);
+        }
+        if (srtt == 0) {
+            status = CC_OF_EAGAIN;
+        }
+    }
+
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+
+    if (status == CC_OF_OK) {
+        if (rtt_us) {
+            *rtt_us = (uint32_t)rtt;
+        }
+        if (srtt_us) {
+            *srtt_us = (uint32_t)srtt;
+        }
+        if (min_rtt_us) {
+            *min_rtt_us = (uint32_t)min_rtt;
+        }
+    }
+    return status;
+}
+
+cc_of_ret
+cc_of_get_conn_version(uint64_t dp_id, uint8_t aux_id, uint8_t *of_version)
+{
+    cc_of_ret status = CC_OF_OK;
+    cc_ofchannel_key_t ofchann_key;
+    cc_ofchannel_info_t *ofchann_info;
+    cc_ofrw_ctx_t *ctx = NULL;
+    gint version = 0;
+
+    ofchann_key.dp_id = dp_id;
+    ofchann_key.aux_id = aux_id;
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+
+    ofchann_info = g_hash_table_lookup(cc_of_global.ofchannel_htbl,
+                                       &ofchann_key);
+    if (ofchann_info == NULL) {
+        status = CC_OF_EINVAL;
+    } else {
+        ctx = cc_ofrw_lookup_ctx(ofchann_info->rw_sockfd);
+        if (ctx != NULL) {
+            version = g_atomic_int_get(&ctx->of_version);
+        }
+        if (version == 0) {
+            status = CC_OF_EAGAIN;
+        }
+    }
+
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+
+    if ((status == CC_OF_OK) && of_version) {
+        *of_version = (uint8_t)version;
+    }
+    return status;
+}
+
+
+cc_of_ret
+cc_of_set_send_coalescing(uint32_t max_iov,
+                          uint32_t max_bytes)
+{
+    if ((max_iov == 0) || (max_iov > CC_OF_SEND_IOV_LIMIT) ||
+        (max_bytes == 0)) {
+        CC_LOG_ERROR("%s(%d): invalid max_iov %u or max_bytes %u",
+                     __FUNCTION__, __LINE__, max_iov, max_bytes);
+        return CC_OF_EINVAL;
+    }
+    cc_of_global.ofsend_max_iov = max_iov;
+    cc_of_global.ofsend_max_bytes = max_bytes;
+    return CC_OF_OK;
+}
+
+cc_of_ret
+cc_of_set_udp_sockets(uint32_t num_sockets)
+{
+    if (num_sockets > CC_OF_UDP_MAX_SOCKETS) {
+        CC_LOG_ERROR("%s(%d): invalid num_sockets %u",
+                     __FUNCTION__, __LINE__, num_sockets);
+        return CC_OF_EINVAL;
+    }
+    cc_of_global.ofudp_num_sockets = num_sockets;
+    return CC_OF_OK;
+}
+
+cc_of_ret
+cc_of_set_tcp_listeners(uint32_t num_listeners)
+{
+    if (num_listeners > CC_OF_TCP_MAX_LISTENERS) {
+        CC_LOG_ERROR("%s(%d): invalid num_listeners %u",
+                     __FUNCTION__, __LINE__, num_listeners);
+        return CC_OF_EINVAL;
+    }
+    cc_of_global.oftcp_num_listeners = num_listeners;
+    return CC_OF_OK;
+}
+
+cc_of_ret
+cc_of_set_reconnect(uint32_t base_ms,
+                    uint32_t max_ms,
+                    uint32_t max_retries)
+{
+    if ((base_ms > 0) && (max_ms < base_ms)) {
+        CC_LOG_ERROR("%s(%d): invalid backoff base_ms %u max_ms %u",
+                     __FUNCTION__, __LINE__, base_ms, max_ms);
+        return CC_OF_EINVAL;
+    }
+    cc_of_global.ofreconn_base_ms = base_ms;
+    cc_of_global.ofreconn_max_ms = max_ms;
+    cc_of_global.ofreconn_max_retries = max_retries;
+    return CC_OF_OK;
+}
+
+cc_of_ret
+cc_of_set_echo(gboolean offload,
+               uint32_t interval_ms,
+               uint32_t max_missed)
+{
+    if (offload && (interval_ms > 0) &&
+        (interval_ms < ADPOLL_TIMER_TICK_MS)) {
+        CC_LOG_ERROR("%s(%d): echo interval %u ms is below the timer "
+                     "tick", __FUNCTION__, __LINE__, interval_ms);
+        return CC_OF_EINVAL;
+    }
+    cc_of_global.ofecho_offload = offload;
+    cc_of_global.ofecho_interval_ms = interval_ms;
+    cc_of_global.ofecho_max_missed = max_missed;
+    return CC_OF_OK;
+}
+
 void
 cc_of_debug_toggle(gboolean debug_on)
 {
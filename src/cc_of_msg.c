@@ -0,0 +1,279 @@
+/*
+*****************************************************
+**      CodeChix ONF Driver (LibCCOF)
+**      codechix.org - May the code be with you...
+**              Sept. 15, 2013
+*****************************************************
+**
+** License:        Apache 2.0 (ONF requirement)
+** Version:        0.0
+** LibraryName:    LibCCOF
+** GLIB License:   GNU LGPL
+** Description:    OpenFlow message framing for LibCCOF
+** Assumptions:    N/A
+** Testing:        N/A
+** Authors:        Deepa Karnad Dhurka
+**
+*****************************************************
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "cc_of_msg.h"
+#include "cc_log.h"
+
+cc_of_msg_rx_t *
+cc_of_msg_rx_new(void)
+{
+    cc_of_msg_rx_t *rx;
+
+    rx = (cc_of_msg_rx_t *)malloc(sizeof(cc_of_msg_rx_t));
+    if (rx == NULL) {
+        return NULL;
+    }
+    rx->buf = (char *)malloc(CC_OF_MSG_RX_BUF_SIZE);
+    if (rx->buf == NULL) {
+        free(rx);
+        return NULL;
+    }
+    rx->size = CC_OF_MSG_RX_BUF_SIZE;
+    rx->off = 0;
+    rx->len = 0;
+    rx->rx_msgs = 0;
+    rx->rx_errs = 0;
+    return rx;
+}
+
+void
+cc_of_msg_rx_free(cc_of_msg_rx_t *rx)
+{
+    if (rx) {
+        free(rx->buf);
+        free(rx);
+    }
+}
+
+/* length of the message at the front of buf, 0 if the header is
+ * incomplete
+ */
+static uint32_t
+cc_of_msg_rx_head_len(cc_of_msg_rx_t *rx)
+{
+    ofp_header_t *hdr;
+
+    if (rx->len < OFP_HEADER_LEN) {
+        return 0;
+    }
+    hdr = (ofp_header_t *)(rx->buf + rx->off);
+    return ntohs(hdr->length);
+}
+
+char *
+cc_of_msg_rx_space(cc_of_msg_rx_t *rx, size_t *space)
+{
+    uint32_t msg_len;
+    char *new_buf;
+
+    /* keep the partial message at the front */
+    if (rx->off) {
+        if (rx->len) {
+            memmove(rx->buf, rx->buf + rx->off, rx->len);
+        }
+        rx->off = 0;
+    }
+
+    /* a partial message longer than the buffer - make room for all of
+     * it; OF lengths are 16 bit so this is bounded
+     */
+    msg_len = cc_of_msg_rx_head_len(rx);
+    if (msg_len > rx->size) {
+        new_buf = (char *)realloc(rx->buf, msg_len);
+        if (new_buf) {
+            rx->buf = new_buf;
+            rx->size = msg_len;
+        }
+    }
+    *space = rx->size - rx->len;
+    return rx->buf + rx->len;
+}
+
+int
+cc_of_msg_rx_commit(cc_of_msg_rx_t *rx, size_t data_len,
+                    cc_of_msg_func func, void *user_data)
+{
+    uint32_t msg_len;
+    int num_msgs = 0;
+
+    g_assert(data_len <= (size_t)(rx->size - rx->off - rx->len));
+    rx->len += data_len;
+
+    /* hand out every complete message in place */
+    while (rx->len >= OFP_HEADER_LEN) {
+        msg_len = ntohs(((ofp_header_t *)(rx->buf + rx->off))->length);
+        if (msg_len < OFP_HEADER_LEN) {
+            CC_LOG_ERROR("%s(%d): bad OF message length %u - dropping "
+                         "%u buffered bytes", __FUNCTION__, __LINE__,
+                         msg_len, rx->len);
+            rx->off = 0;
+            rx->len = 0;
+            rx->rx_errs++;
+            return CC_OF_EINVAL;
+        }
+        if (rx->len < msg_len) {
+            break;
+        }
+        if (func) {
+            func(rx->buf + rx->off, msg_len, user_data);
+        }
+        rx->off += msg_len;
+        rx->len -= msg_len;
+        num_msgs++;
+    }
+    rx->rx_msgs += num_msgs;
+
+    /* nothing left over - the next read can start at the front */
+    if (rx->len == 0) {
+        rx->off = 0;
+    }
+    return num_msgs;
+}
+
+
+/* highest version set in bitmap, 0 if none */
+static uint8_t
+cc_of_msg_bitmap_max(uint32_t bitmap)
+{
+    uint8_t version = 0;
+
+    while (bitmap >>= 1) {
+        version++;
+    }
+    return version;
+}
+
+uint32_t
+cc_of_msg_version_bitmap(cc_ofver_e max_ofver)
+{
+    uint32_t bitmap = (1 << OFP_VERSION_1_0);
+
+    if (max_ofver >= CC_OFVER_1_3) {
+        /* 1.3.1 is a 1.3 on the wire */
+        bitmap |= (1 << OFP_VERSION_1_3);
+    }
+    return bitmap;
+}
+
+size_t
+cc_of_msg_hello_build(char *buf, uint32_t bitmap, uint32_t xid)
+{
+    ofp_header_t *hdr = (ofp_header_t *)buf;
+    uint16_t *elem;
+    uint32_t *elem_bitmap;
+    size_t msg_len = OFP_HEADER_LEN;
+
+    hdr->version = cc_of_msg_bitmap_max(bitmap);
+    hdr->type = OFPT_HELLO;
+    hdr->xid = htonl(xid);
+
+    /* versions before 1.3 have no hello elements */
+    if (hdr->version >= OFP_VERSION_1_3) {
+        elem = (uint16_t *)(buf + OFP_HEADER_LEN);
+        elem[0] = htons(OFPHET_VERSIONBITMAP);
+        elem[1] = htons(8);
+        elem_bitmap = (uint32_t *)(buf + OFP_HEADER_LEN + 4);
+        *elem_bitmap = htonl(bitmap);
+        msg_len += 8;
+    }
+    hdr->length = htons((uint16_t)msg_len);
+    return msg_len;
+}
+
+int
+cc_of_msg_hello_negotiate(const char *msg, size_t msg_len, uint32_t bitmap)
+{
+    const ofp_header_t *hdr = (const ofp_header_t *)msg;
+    uint32_t peer_bitmap = 0;
+    uint16_t elem_type, elem_len;
+    uint8_t version;
+    size_t off = OFP_HEADER_LEN;
+
+    /* elements are padded to 8 bytes; stop at one that does not fit */
+    while (off + 4 <= msg_len) {
+        elem_type = ntohs(*(const uint16_t *)(msg + off));
+        elem_len = ntohs(*(const uint16_t *)(msg + off + 2));
+        if ((elem_len < 4) || (off + elem_len > msg_len)) {
+            break;
+        }
+        if ((elem_type == OFPHET_VERSIONBITMAP) && (elem_len >= 8)) {
+            /* versions 32 and up are not ours */
+            peer_bitmap = ntohl(*(const uint32_t *)(msg + off + 4));
+            break;
+        }
+        off += (elem_len + 7) & ~7;
+    }
+
+    if (peer_bitmap) {
+        bitmap &= peer_bitmap;
+        if (bitmap == 0) {
+            return CC_OF_EINVAL;
+        }
+        return cc_of_msg_bitmap_max(bitmap);
+    }
+
+    version = MIN(hdr->version, cc_of_msg_bitmap_max(bitmap));
+    if ((bitmap & (1 << version)) == 0) {
+        return CC_OF_EINVAL;
+    }
+    return version;
+}
+
+int
+cc_of_msg_features_parse(const char *msg, size_t msg_len,
+                         uint64_t *dp_id, uint8_t *aux_id)
+{
+    const ofp_header_t *hdr = (const ofp_header_t *)msg;
+    uint32_t dp_id_hi, dp_id_lo;
+
+    if (msg_len < OFP_SWITCH_FEATURES_LEN) {
+        return CC_OF_EINVAL;
+    }
+    memcpy(&dp_id_hi, msg + OFP_HEADER_LEN, sizeof(uint32_t));
+    memcpy(&dp_id_lo, msg + OFP_HEADER_LEN + 4, sizeof(uint32_t));
+    *dp_id = ((uint64_t)ntohl(dp_id_hi) << 32) | ntohl(dp_id_lo);
+    *aux_id = (hdr->version >= OFP_VERSION_1_3) ?
+        (uint8_t)msg[OFP_SWITCH_FEATURES_AUX_OFF] : 0;
+    return CC_OF_OK;
+}
+
+gboolean
+cc_of_msg_unsolicited(const char *msg)
+{
+    switch (((const ofp_header_t *)msg)->type) {
+    case OFPT_HELLO:
+    case OFPT_ECHO_REQUEST:
+    case OFPT_PACKET_IN:
+    case OFPT_FLOW_REMOVED:
+    case OFPT_PORT_STATUS:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+gboolean
+cc_of_msg_reply_more(const char *msg, size_t msg_len)
+{
+    const ofp_header_t *hdr = (const ofp_header_t *)msg;
+    uint8_t type;
+    uint16_t flags;
+
+    type = (hdr->version >= OFP_VERSION_1_3) ?
+        OFPT13_MULTIPART_REPLY : OFPT10_STATS_REPLY;
+    if ((hdr->type != type) ||
+        (msg_len < OFP_MULTIPART_FLAGS_OFF + sizeof(uint16_t))) {
+        return FALSE;
+    }
+    memcpy(&flags, msg + OFP_MULTIPART_FLAGS_OFF, sizeof(uint16_t));
+    return ((ntohs(flags) & OFPMPF_REPLY_MORE) != 0);
+}
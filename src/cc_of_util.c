@@ -17,6 +17,8 @@
 *****************************************************
 */
 #include "cc_of_util.h"
+#include <sys/mman.h>
+#include <sched.h>
 /*-----------------------------------------------------------------------*/
 /* Utilities to manage the global hash tables                            */
 /*-----------------------------------------------------------------------*/
@@ -45,17 +47,6 @@ guint cc_ofchann_hash_func(gconstpointer key)
     return hash;
 }
 
-guint cc_ofrw_hash_func(gconstpointer key)
-{
-    cc_ofrw_key_t *ofrw_key;
-    guint hash = 0;
-
-    ofrw_key = (cc_ofrw_key_t *)key;
-    hash = ofrw_key->rw_sockfd;
-    hash = (hash * 2654435761) % MAX_OFRW_HTBL_SIZE;
-    return hash;
-}
-
 gboolean cc_ofdev_htbl_equal_func(gconstpointer a, gconstpointer b)
 {
     cc_ofdev_key_t *a_dev, *b_dev;
@@ -114,22 +105,603 @@ gboolean cc_ofchannel_htbl_equal_func(gconstpointer a, gconstpointer b)
 }
 
 
-gboolean cc_ofrw_htbl_equal_func(gconstpointer a, gconstpointer b)
+/* ofchann_fd_htbl maps rw_sockfd -> channel key so a socket's channel
+ * is found without walking ofchannel_htbl. It is kept in step with
+ * ofchannel_htbl by the htbl update functions below; callers hold
+ * ofchannel_htbl_lock. The channel send routes follow the same way.
+ */
+static void
+ofchann_fd_index_add(cc_ofchannel_key_t *key, cc_ofchannel_info_t *info)
 {
-    cc_ofrw_key_t *a_rw, *b_rw;
-    a_rw = (cc_ofrw_key_t *)a;
-    b_rw = (cc_ofrw_key_t *)b;
+    cc_ofchannel_key_t *fd_key;
+
+    fd_key = (cc_ofchannel_key_t *)g_malloc(sizeof(cc_ofchannel_key_t));
+    memcpy(fd_key, key, sizeof(cc_ofchannel_key_t));
+    g_hash_table_insert(cc_of_global.ofchann_fd_htbl,
+                        GINT_TO_POINTER(info->rw_sockfd), fd_key);
+    cc_ofchann_route_add(key, info->rw_sockfd);
+    cc_ofrw_ctx_invalidate(info->rw_sockfd);
+}
 
-    CC_LOG_DEBUG("%s: a rw_sockfd %d b is %d",
-                 __FUNCTION__,
-                 a_rw->rw_sockfd,
-                 b_rw->rw_sockfd);
-    
-    if (a_rw->rw_sockfd == b_rw->rw_sockfd) {
-	    return TRUE;
+static void
+ofchann_fd_index_del(cc_ofchannel_key_t *key)
+{
+    cc_ofchannel_info_t *info;
+    cc_ofchannel_key_t *fd_key;
+
+    cc_ofchann_route_del(key);
+    info = g_hash_table_lookup(cc_of_global.ofchannel_htbl, key);
+    if (info == NULL) {
+        return;
+    }
+    cc_ofrw_ctx_invalidate(info->rw_sockfd);
+    fd_key = g_hash_table_lookup(cc_of_global.ofchann_fd_htbl,
+                                 GINT_TO_POINTER(info->rw_sockfd));
+    if (fd_key && cc_ofchannel_htbl_equal_func(fd_key, key)) {
+        g_hash_table_remove(cc_of_global.ofchann_fd_htbl,
+                            GINT_TO_POINTER(info->rw_sockfd));
+    }
+}
+
+/*-----------------------------------------------------------------------*/
+/* channel send route table - sharded copy of ofchannel_htbl             */
+/*-----------------------------------------------------------------------*/
+#define CC_OFCHANN_GOLDEN 0x9E3779B97F4A7C15ULL
+/* lock-free reads of a shard a writer keeps busy before the lookup
+ * takes the shard lock
+ */
+#define CC_OFCHANN_ROUTE_TRIES 8
+
+/* all the channels of a switch land in one shard */
+static inline cc_ofchann_shard_t *
+ofchann_route_shard(uint64_t dp_id)
+{
+    return &cc_of_global.ofchann_rtbl.shard[
+        (guint)((dp_id * CC_OFCHANN_GOLDEN) >> 32) % CC_OFCHANN_SHARDS];
+}
+
+static inline uint32_t
+ofchann_route_hash(uint64_t dp_id, uint8_t aux_id)
+{
+    return (uint32_t)(((dp_id ^ ((uint64_t)aux_id << 56)) *
+                       CC_OFCHANN_GOLDEN) >> 40);
+}
+
+static cc_ofchann_routes_t *
+ofchann_routes_new(uint32_t size)
+{
+    cc_ofchann_routes_t *routes;
+
+    routes = g_malloc(sizeof(cc_ofchann_routes_t));
+    routes->size = size;
+    routes->route = g_malloc0(size * sizeof(cc_ofchann_route_t));
+    return routes;
+}
+
+static void
+ofchann_routes_free(gpointer data)
+{
+    cc_ofchann_routes_t *routes = (cc_ofchann_routes_t *)data;
+
+    g_free(routes->route);
+    g_free(routes);
+}
+
+/* slot of key, or of the empty slot ending its probe sequence */
+static uint32_t
+ofchann_route_slot(cc_ofchann_routes_t *routes, uint64_t dp_id,
+                   uint8_t aux_id)
+{
+    uint32_t mask = routes->size - 1;
+    uint32_t i = ofchann_route_hash(dp_id, aux_id) & mask;
+
+    while (routes->route[i].in_use &&
+           ((routes->route[i].key.dp_id != dp_id) ||
+            (routes->route[i].key.aux_id != aux_id))) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/* readers retry while the count is odd */
+static inline void
+ofchann_shard_write_begin(cc_ofchann_shard_t *shard)
+{
+    g_atomic_int_inc(&shard->seq);
+}
+
+static inline void
+ofchann_shard_write_end(cc_ofchann_shard_t *shard)
+{
+    g_atomic_int_inc(&shard->seq);
+}
+
+void
+cc_ofchann_rtbl_init(cc_ofchann_rtbl_t *rtbl)
+{
+    cc_ofchann_shard_t *shard;
+    int i;
+
+    for (i = 0; i < CC_OFCHANN_SHARDS; i++) {
+        shard = &rtbl->shard[i];
+        shard->seq = 0;
+        g_mutex_init(&shard->lock);
+        shard->routes = ofchann_routes_new(CC_OFCHANN_SHARD_INIT_SIZE);
+        shard->count = 0;
+        shard->retired = NULL;
+    }
+}
+
+void
+cc_ofchann_rtbl_free(cc_ofchann_rtbl_t *rtbl)
+{
+    cc_ofchann_shard_t *shard;
+    int i;
+
+    for (i = 0; i < CC_OFCHANN_SHARDS; i++) {
+        shard = &rtbl->shard[i];
+        if (shard->routes == NULL) {
+            continue;
+        }
+        ofchann_routes_free(shard->routes);
+        g_list_free_full(shard->retired, ofchann_routes_free);
+        shard->routes = NULL;
+        shard->retired = NULL;
+        shard->count = 0;
+        g_mutex_clear(&shard->lock);
+    }
+}
+
+void
+cc_ofchann_route_add(cc_ofchannel_key_t *key, int rw_sockfd)
+{
+    cc_ofchann_shard_t *shard = ofchann_route_shard(key->dp_id);
+    cc_ofchann_routes_t *routes, *new_routes;
+    cc_ofchann_route_t *route;
+    uint32_t i;
+
+    g_mutex_lock(&shard->lock);
+    routes = shard->routes;
+    route = &routes->route[ofchann_route_slot(routes, key->dp_id,
+                                              key->aux_id)];
+    if (!route->in_use && ((shard->count + 1) * 2 > routes->size)) {
+        /* keep the load under half; readers may still be in the old
+         * array, so it is retired rather than freed
+         */
+        new_routes = ofchann_routes_new(routes->size * 2);
+        for (i = 0; i < routes->size; i++) {
+            if (routes->route[i].in_use) {
+                new_routes->route[ofchann_route_slot(
+                    new_routes, routes->route[i].key.dp_id,
+                    routes->route[i].key.aux_id)] = routes->route[i];
+            }
+        }
+        ofchann_shard_write_begin(shard);
+        g_atomic_pointer_set(&shard->routes, new_routes);
+        ofchann_shard_write_end(shard);
+        shard->retired = g_list_prepend(shard->retired, routes);
+
+        routes = new_routes;
+        route = &routes->route[ofchann_route_slot(routes, key->dp_id,
+                                                  key->aux_id)];
+    }
+
+    ofchann_shard_write_begin(shard);
+    if (!route->in_use) {
+        route->key = *key;
+        route->in_use = TRUE;
+        shard->count++;
+    }
+    route->rw_sockfd = rw_sockfd;
+    route->fd_gen = 0;
+    route->thr_mgr_p = NULL;
+    ofchann_shard_write_end(shard);
+    g_mutex_unlock(&shard->lock);
+}
+
+void
+cc_ofchann_route_del(cc_ofchannel_key_t *key)
+{
+    cc_ofchann_shard_t *shard = ofchann_route_shard(key->dp_id);
+    cc_ofchann_routes_t *routes;
+    uint32_t mask, i, j, k;
+
+    g_mutex_lock(&shard->lock);
+    routes = shard->routes;
+    mask = routes->size - 1;
+    i = ofchann_route_slot(routes, key->dp_id, key->aux_id);
+    if (!routes->route[i].in_use) {
+        g_mutex_unlock(&shard->lock);
+        return;
+    }
+
+    ofchann_shard_write_begin(shard);
+    routes->route[i].in_use = FALSE;
+    /* shift back the routes that probed past the hole */
+    for (j = (i + 1) & mask; routes->route[j].in_use; j = (j + 1) & mask) {
+        k = ofchann_route_hash(routes->route[j].key.dp_id,
+                               routes->route[j].key.aux_id) & mask;
+        if (((j > i) && ((k <= i) || (k > j))) ||
+            ((j < i) && (k <= i) && (k > j))) {
+            routes->route[i] = routes->route[j];
+            routes->route[j].in_use = FALSE;
+            i = j;
+        }
+    }
+    shard->count--;
+    ofchann_shard_write_end(shard);
+    g_mutex_unlock(&shard->lock);
+}
+
+void
+cc_ofchann_route_set_thr(cc_ofchannel_key_t *key, int rw_sockfd,
+                         uint32_t fd_gen, adpoll_thread_mgr_t *tmgr)
+{
+    cc_ofchann_shard_t *shard = ofchann_route_shard(key->dp_id);
+    cc_ofchann_route_t *route;
+
+    g_mutex_lock(&shard->lock);
+    route = &shard->routes->route[ofchann_route_slot(shard->routes,
+                                                     key->dp_id,
+                                                     key->aux_id)];
+    if (route->in_use) {
+        ofchann_shard_write_begin(shard);
+        route->rw_sockfd = rw_sockfd;
+        route->fd_gen = fd_gen;
+        route->thr_mgr_p = tmgr;
+        ofchann_shard_write_end(shard);
+    }
+    g_mutex_unlock(&shard->lock);
+}
+
+/* probe for a route; bounded, as without the shard lock the slots may
+ * change under us
+ */
+static cc_of_ret
+ofchann_route_find(cc_ofchann_routes_t *routes,
+                   uint64_t dp_id, uint8_t aux_id,
+                   int *rw_sockfd, uint32_t *fd_gen,
+                   adpoll_thread_mgr_t **tmgr)
+{
+    cc_ofchann_route_t *route;
+    uint32_t mask, i, n;
+
+    mask = routes->size - 1;
+    i = ofchann_route_hash(dp_id, aux_id) & mask;
+    for (n = 0; n < routes->size; n++, i = (i + 1) & mask) {
+        route = &routes->route[i];
+        if (!route->in_use) {
+            break;
+        }
+        if ((route->key.dp_id == dp_id) &&
+            (route->key.aux_id == aux_id)) {
+            *rw_sockfd = route->rw_sockfd;
+            *fd_gen = route->fd_gen;
+            *tmgr = route->thr_mgr_p;
+            return ((*tmgr == NULL) ? CC_OF_EAGAIN : CC_OF_OK);
+        }
+    }
+    return CC_OF_EHTBL;
+}
+
+cc_of_ret
+cc_ofchann_route_lookup(uint64_t dp_id, uint8_t aux_id,
+                        int *rw_sockfd, uint32_t *fd_gen,
+                        adpoll_thread_mgr_t **tmgr)
+{
+    cc_ofchann_shard_t *shard = ofchann_route_shard(dp_id);
+    cc_of_ret status;
+    uint32_t tries;
+    gint seq;
+
+    for (tries = 0; tries < CC_OFCHANN_ROUTE_TRIES; tries++) {
+        seq = g_atomic_int_get(&shard->seq);
+        if (seq & 1) {
+            /* a writer is in the shard */
+            sched_yield();
+            continue;
+        }
+        status = ofchann_route_find(g_atomic_pointer_get(&shard->routes),
+                                    dp_id, aux_id, rw_sockfd, fd_gen, tmgr);
+        if (g_atomic_int_get(&shard->seq) == seq) {
+            return status;
+        }
+    }
+
+    /* writers kept the shard busy, wait for them */
+    g_mutex_lock(&shard->lock);
+    status = ofchann_route_find(shard->routes, dp_id, aux_id,
+                                rw_sockfd, fd_gen, tmgr);
+    g_mutex_unlock(&shard->lock);
+    return status;
+}
+
+/*-----------------------------------------------------------------------*/
+/* rw socket table - cc_ofrw_info_t slots indexed by socket fd           */
+/* caller holds ofrw_htbl_lock                                           */
+/*-----------------------------------------------------------------------*/
+/* a new generation for the slot; 0 is never one, see fd_gen of
+ * adpoll_send_msg_htbl_info_t
+ */
+static void
+cc_ofrw_slot_gen_bump(cc_ofrw_slot_t *slot)
+{
+    if (g_atomic_int_add(&slot->gen, 1) == -1) {
+        g_atomic_int_inc(&slot->gen);
+    }
+}
+
+/* addr and port as they are on the wire, no byte swapping */
+static inline gint64
+cc_ofrw_peer_key(struct sockaddr_in *addr)
+{
+    return ((gint64)addr->sin_addr.s_addr << 16) | addr->sin_port;
+}
+
+static gboolean
+cc_ofrw_has_peer(cc_ofrw_info_t *info)
+{
+    return ((info->layer4_proto == UDP) &&
+            (info->client_addr.sin_addr.s_addr || info->client_addr.sin_port));
+}
+
+static void
+cc_ofrw_peer_add(cc_ofrw_tbl_t *tbl, int sockfd, cc_ofrw_info_t *info)
+{
+    gint64 *key;
+
+    if (!cc_ofrw_has_peer(info)) {
+        return;
+    }
+    key = g_malloc(sizeof(gint64));
+    *key = cc_ofrw_peer_key(&info->client_addr);
+    g_hash_table_insert(tbl->peer_htbl, key, GINT_TO_POINTER(sockfd));
+}
+
+static void
+cc_ofrw_peer_del(cc_ofrw_tbl_t *tbl, int sockfd, cc_ofrw_info_t *info)
+{
+    gint64 key;
+
+    if (!cc_ofrw_has_peer(info)) {
+        return;
+    }
+    key = cc_ofrw_peer_key(&info->client_addr);
+    if (GPOINTER_TO_INT(g_hash_table_lookup(tbl->peer_htbl, &key)) ==
+        sockfd) {
+        g_hash_table_remove(tbl->peer_htbl, &key);
+    }
+}
+
+cc_of_ret
+cc_ofrw_tbl_init(cc_ofrw_tbl_t *tbl)
+{
+    tbl->slots = NULL;
+    tbl->size = 0;
+    tbl->count = 0;
+    tbl->fds_size = CC_OFRW_TBL_INIT_SIZE;
+    tbl->fds = g_malloc(tbl->fds_size * sizeof(int));
+    tbl->peer_htbl = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                                           cc_of_destroy_generic, NULL);
+    tbl->dummy_next = MAX_OPEN_FILES;
+    tbl->dummy_free = g_array_new(FALSE, FALSE, sizeof(int));
+
+    /* zero-filled and lazily backed: only touched slots cost memory */
+    tbl->slots = mmap(NULL, (size_t)CC_OFRW_TBL_SLOTS * sizeof(cc_ofrw_slot_t),
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (tbl->slots == MAP_FAILED) {
+        tbl->slots = NULL;
+        CC_LOG_ERROR("%s(%d): no memory for %u rw socket slots",
+                     __FUNCTION__, __LINE__, CC_OFRW_TBL_SLOTS);
+        return CC_OF_ENOMEM;
+    }
+    tbl->size = CC_OFRW_TBL_SLOTS;
+    return CC_OF_OK;
+}
+
+void
+cc_ofrw_tbl_free(cc_ofrw_tbl_t *tbl)
+{
+    if (tbl->slots) {
+        munmap(tbl->slots, (size_t)tbl->size * sizeof(cc_ofrw_slot_t));
+    }
+    g_free(tbl->fds);
+    if (tbl->peer_htbl) {
+        g_hash_table_destroy(tbl->peer_htbl);
+    }
+    if (tbl->dummy_free) {
+        g_array_free(tbl->dummy_free, TRUE);
+    }
+    tbl->peer_htbl = NULL;
+    tbl->dummy_free = NULL;
+    tbl->slots = NULL;
+    tbl->fds = NULL;
+    tbl->size = 0;
+    tbl->count = 0;
+    tbl->fds_size = 0;
+}
+
+cc_ofrw_info_t *
+cc_ofrw_lookup(int sockfd)
+{
+    cc_ofrw_tbl_t *tbl = &cc_of_global.ofrw_tbl;
+
+    if ((sockfd < 0) || ((uint32_t)sockfd >= tbl->size) ||
+        !tbl->slots[sockfd].in_use) {
+        return NULL;
+    }
+    return &tbl->slots[sockfd].info;
+}
+
+int
+cc_ofrw_dummy_fd_alloc(void)
+{
+    cc_ofrw_tbl_t *tbl = &cc_of_global.ofrw_tbl;
+    int sockfd;
+
+    if (tbl->dummy_free->len) {
+        sockfd = g_array_index(tbl->dummy_free, int,
+                               tbl->dummy_free->len - 1);
+        g_array_set_size(tbl->dummy_free, tbl->dummy_free->len - 1);
+        return sockfd;
+    }
+    if (tbl->dummy_next >= MAX_OPEN_FILES + CC_OFRW_UDP_PEERS_MAX) {
+        return -1;
+    }
+    return tbl->dummy_next++;
+}
+
+int
+cc_ofrw_lookup_peer(struct sockaddr_in *peer_addr)
+{
+    gint64 key = cc_ofrw_peer_key(peer_addr);
+    gpointer ht_key = NULL, ht_fd = NULL;
+
+    if (g_hash_table_lookup_extended(cc_of_global.ofrw_tbl.peer_htbl, &key,
+                                     &ht_key, &ht_fd) == FALSE) {
+        return -1;
+    }
+    return GPOINTER_TO_INT(ht_fd);
+}
+
+cc_ofrw_ctx_t *
+cc_ofrw_lookup_ctx(int sockfd)
+{
+    cc_ofrw_tbl_t *tbl = &cc_of_global.ofrw_tbl;
+
+    if ((sockfd < 0) || ((uint32_t)sockfd >= tbl->size) ||
+        !tbl->slots[sockfd].in_use) {
+        return NULL;
+    }
+    return tbl->slots[sockfd].ctx;
+}
+
+uint32_t
+cc_ofrw_get_gen(int sockfd)
+{
+    cc_ofrw_tbl_t *tbl = &cc_of_global.ofrw_tbl;
+
+    if ((sockfd < 0) || ((uint32_t)sockfd >= tbl->size)) {
+        return 0;
+    }
+    return (uint32_t)g_atomic_int_get(&tbl->slots[sockfd].gen);
+}
+
+gint
+cc_ofrw_get_ctx_gen(int sockfd)
+{
+    cc_ofrw_tbl_t *tbl = &cc_of_global.ofrw_tbl;
+
+    if ((sockfd < 0) || ((uint32_t)sockfd >= tbl->size)) {
+        return 0;
+    }
+    return g_atomic_int_get(&tbl->slots[sockfd].ctx_gen);
+}
+
+void
+cc_ofrw_ctx_invalidate(int sockfd)
+{
+    cc_ofrw_tbl_t *tbl = &cc_of_global.ofrw_tbl;
+
+    if ((sockfd < 0) || ((uint32_t)sockfd >= tbl->size)) {
+        return;
+    }
+    g_atomic_int_inc(&tbl->slots[sockfd].ctx_gen);
+}
+
+void
+cc_ofrw_ctx_invalidate_dev(cc_ofdev_key_t *dev_key)
+{
+    cc_ofrw_info_t *info;
+    int sockfd = -1;
+
+    while (cc_ofrw_iter_next(&sockfd, &info)) {
+        if (cc_ofdev_htbl_equal_func(&info->dev_key, dev_key)) {
+            cc_ofrw_ctx_invalidate(sockfd);
+        }
+    }
+}
+
+gboolean
+cc_ofrw_iter_next(int *sockfd, cc_ofrw_info_t **info)
+{
+    cc_ofrw_tbl_t *tbl = &cc_of_global.ofrw_tbl;
+    uint32_t pos = 0;
+
+    if (*sockfd >= 0) {
+        pos = tbl->slots[*sockfd].pos + 1;
+    }
+    if (pos >= tbl->count) {
+        return FALSE;
+    }
+    *sockfd = tbl->fds[pos];
+    *info = &tbl->slots[*sockfd].info;
+    return TRUE;
+}
+
+cc_of_ret
+cc_ofrw_tbl_update(htbl_update_ops_e htbl_op,
+                   cc_ofrw_key_t *rw_key,
+                   cc_ofrw_info_t *rw_info,
+                   gboolean *new_entry)
+{
+    cc_ofrw_tbl_t *tbl = &cc_of_global.ofrw_tbl;
+    cc_ofrw_slot_t *slot;
+    int sockfd = rw_key->rw_sockfd;
+
+    *new_entry = FALSE;
+    if (sockfd < 0) {
+        return CC_OF_EINVAL;
+    }
+
+    if (htbl_op == DEL) {
+        if (cc_ofrw_lookup(sockfd) == NULL) {
+            CC_LOG_DEBUG("%s(%d) DEL unsuccessful for rw sockfd %d",
+                         __FUNCTION__, __LINE__, sockfd);
+            return CC_OF_EHTBL;
+        }
+        slot = &tbl->slots[sockfd];
+        cc_ofrw_peer_del(tbl, sockfd, &slot->info);
+        memset(&slot->info, 0, sizeof(cc_ofrw_info_t));
+        slot->ctx = NULL;
+        slot->in_use = FALSE;
+        cc_ofrw_slot_gen_bump(slot);
+        /* move the last fd in use into the hole */
+        tbl->count--;
+        tbl->fds[slot->pos] = tbl->fds[tbl->count];
+        tbl->slots[tbl->fds[slot->pos]].pos = slot->pos;
+        if (sockfd >= MAX_OPEN_FILES) {
+            g_array_append_val(tbl->dummy_free, sockfd);
+        }
     } else {
-	    return FALSE;
+        if ((uint32_t)sockfd >= tbl->size) {
+            CC_LOG_ERROR("%s(%d): rw sockfd %d is beyond the %u slots",
+                         __FUNCTION__, __LINE__, sockfd, tbl->size);
+            return CC_OF_EINVAL;
+        }
+        slot = &tbl->slots[sockfd];
+        if (!slot->in_use) {
+            /* a new socket, possibly a reused fd */
+            if (tbl->count == tbl->fds_size) {
+                tbl->fds_size *= 2;
+                tbl->fds = g_realloc(tbl->fds, tbl->fds_size * sizeof(int));
+            }
+            slot->in_use = TRUE;
+            slot->ctx = NULL;
+            cc_ofrw_slot_gen_bump(slot);
+            slot->pos = tbl->count;
+            tbl->fds[tbl->count++] = sockfd;
+            *new_entry = TRUE;
+        } else {
+            cc_ofrw_peer_del(tbl, sockfd, &slot->info);
+        }
+        memcpy(&slot->info, rw_info, sizeof(cc_ofrw_info_t));
+        cc_ofrw_peer_add(tbl, sockfd, &slot->info);
     }
+
+    cc_ofrw_ctx_invalidate(sockfd);
+    return CC_OF_OK;
 }
 
 // TODO: UNUSED FUNCTION Remove before submission    
@@ -147,6 +719,14 @@ update_global_htbl(htbl_type_e htbl_type,
     *new_entry = FALSE;
     guint old_count;
 
+    if (htbl_type == OFRW) {
+        cc_of_ret rc;
+
+        g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+        rc = cc_ofrw_tbl_update(htbl_op, htbl_key, htbl_data, new_entry);
+        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+        return rc;
+    }
 
     switch(htbl_type) {
       case OFDEV:
@@ -163,26 +743,13 @@ update_global_htbl(htbl_type_e htbl_type,
             memcpy(info_data, htbl_data, sizeof(cc_ofdev_info_t));
         }
         break;
-      case OFRW:
-        cc_htbl = cc_of_global.ofrw_htbl;
-        cc_htbl_lock = &cc_of_global.ofrw_htbl_lock;
-        g_mutex_lock(cc_htbl_lock);
-        if ((htbl_op == ADD) &&
-            (g_hash_table_contains(cc_htbl, htbl_key))) {
-            htbl_op = UPD;
-            /* create a new key. the insert operation will free this */
-            key = malloc(sizeof(cc_ofrw_key_t));
-            memcpy(key, htbl_key, sizeof(cc_ofrw_key_t));
-            info_data = malloc(sizeof(cc_ofrw_info_t));
-            memcpy(info_data, htbl_data, sizeof(cc_ofrw_info_t));
-        }
-        break;
       case OFCHANN:
         cc_htbl = cc_of_global.ofchannel_htbl;
         cc_htbl_lock = &cc_of_global.ofchannel_htbl_lock;
         g_mutex_lock(cc_htbl_lock);
         if ((htbl_op == ADD) &&
             (g_hash_table_contains(cc_htbl, htbl_key))) {
+            htbl_op = UPD;
             /* create a new key. the insert operation will free this */
             key = malloc(sizeof(cc_ofchannel_key_t));
             memcpy(key, htbl_key, sizeof(cc_ofchannel_key_t));
@@ -195,6 +762,13 @@ update_global_htbl(htbl_type_e htbl_type,
                      __FUNCTION__, __LINE__, htbl_type);
     }
 
+    if ((htbl_type == OFDEV) && (htbl_op != ADD)) {
+        /* a new device has no sockets yet */
+        g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+        cc_ofrw_ctx_invalidate_dev((cc_ofdev_key_t *)htbl_key);
+        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    }
+
     if (htbl_op == ADD) {
 
         old_count = g_hash_table_size(cc_htbl);
@@ -208,22 +782,6 @@ update_global_htbl(htbl_type_e htbl_type,
                          ((cc_ofdev_key_t *)htbl_key)->controller_ip_addr,
                          ((cc_ofdev_key_t *)htbl_key)->switch_ip_addr,
                          ((cc_ofdev_key_t *)htbl_key)->controller_L4_port);
-        } else if (htbl_type == OFRW) {
-            CC_LOG_DEBUG("%s(%d) insert key has socket %d",
-                         __FUNCTION__, __LINE__,
-                         ((cc_ofrw_key_t *)htbl_key)->rw_sockfd);
-
-            CC_LOG_DEBUG("%s(%d) insert info has l4 proto %s",
-                         __FUNCTION__, __LINE__,
-                         (((cc_ofrw_info_t *)htbl_data)->layer4_proto == TCP)?
-                         "TCP":((((cc_ofrw_info_t *)htbl_data)->layer4_proto
-                                 == UDP)? "UDP":"INVALID"));
-
-            if (g_hash_table_contains(cc_htbl, htbl_key)) {
-                CC_LOG_DEBUG("(%s(%d): OFRW htbl already contains %d",
-                             __FUNCTION__, __LINE__,
-                             ((cc_ofrw_key_t *)htbl_key)->rw_sockfd);
-            }
         } else if (htbl_type == OFCHANN) {
             CC_LOG_DEBUG("%s(%d) ofchannel key dp/aux %lu/%hu",
                          __FUNCTION__, __LINE__,
@@ -233,48 +791,12 @@ update_global_htbl(htbl_type_e htbl_type,
 
 
         g_hash_table_insert(cc_htbl, htbl_key, htbl_data);
+        if (htbl_type == OFCHANN) {
+            ofchann_fd_index_add((cc_ofchannel_key_t *)htbl_key,
+                                 (cc_ofchannel_info_t *)htbl_data);
+        }
 
         if (htbl_type == OFDEV) {
-        } else if (htbl_type == OFRW) {
-            gpointer rwht_key = NULL, rwht_info = NULL;
-            if (g_hash_table_contains(cc_htbl, htbl_key)) {
-                CC_LOG_DEBUG("(%s(%d): OFRW htbl contains %d",
-                             __FUNCTION__, __LINE__,
-                             ((cc_ofrw_key_t *)htbl_key)->rw_sockfd);
-            }
-            CC_LOG_DEBUG("OFRW htbl size after insert of %d: %d",
-                         ((cc_ofrw_key_t *)htbl_key)->rw_sockfd,
-                         g_hash_table_size(cc_htbl));
-            print_ofrw_htbl();
-
-            if (g_hash_table_lookup_extended(cc_of_global.ofrw_htbl,
-                                             htbl_key,
-                                             &rwht_key, &rwht_info)
-                == FALSE) {
-                CC_LOG_DEBUG("extended lookup failed");
-            } else {
-                cc_ofrw_key_t *rw_key =  NULL;
-                cc_ofrw_info_t *rw_info = NULL;
-                rw_key = (cc_ofrw_key_t *)rwht_key;
-                rw_info = (cc_ofrw_info_t *)rwht_info;
-                CC_LOG_DEBUG("extended lookup passed");
-                CC_LOG_DEBUG("key: rw_sockfd: %d "
-                            "info: layer4_proto: %s "
-                            "info: poll thread name: %s"
-                            "info: devkey controller ip: 0x%x"
-                            "info: devkey switch ip: 0x%x"
-                            "info: devkey l4port: %d",
-                            rw_key->rw_sockfd,
-                            (rw_info->layer4_proto == TCP)? "TCP":"UDP",
-                            rw_info->thr_mgr_p->tname,
-                            rw_info->dev_key.controller_ip_addr,
-                            rw_info->dev_key.switch_ip_addr,
-                            rw_info->dev_key.controller_L4_port);
-                
-            }
-            CC_LOG_DEBUG("%s(%d) key has socket %d",
-                         __FUNCTION__, __LINE__,
-                         ((cc_ofrw_key_t *)htbl_key)->rw_sockfd);
         } else {
             print_ofchann_htbl();
         }
@@ -289,6 +811,9 @@ update_global_htbl(htbl_type_e htbl_type,
             CC_LOG_DEBUG("%s(%d) DEL operation found entry",
                          __FUNCTION__, __LINE__);
         }
+        if (htbl_type == OFCHANN) {
+            ofchann_fd_index_del((cc_ofchannel_key_t *)htbl_key);
+        }
         if (g_hash_table_remove(cc_htbl, htbl_key) == FALSE) {
             CC_LOG_DEBUG("%s(%d) DEL unsuccessful",
                          __FUNCTION__, __LINE__);
@@ -307,47 +832,19 @@ update_global_htbl(htbl_type_e htbl_type,
                          ((cc_ofdev_key_t *)key)->switch_ip_addr,
                          ((cc_ofdev_key_t *)key)->controller_L4_port);
         }
+        if (htbl_type == OFCHANN) {
+            /* the channel may have moved to another socket */
+            ofchann_fd_index_del((cc_ofchannel_key_t *)htbl_key);
+        }
         g_hash_table_insert(cc_htbl, key, info_data);
+        if (htbl_type == OFCHANN) {
+            ofchann_fd_index_add((cc_ofchannel_key_t *)htbl_key,
+                                 (cc_ofchannel_info_t *)info_data);
+        }
 
         if (htbl_type == OFDEV) {        
         } else if (htbl_type == OFCHANN) {
             print_ofchann_htbl();
-        } else if (htbl_type == OFRW) {
-            gpointer rwht_key = NULL, rwht_info = NULL;
-            if (g_hash_table_contains(cc_htbl, htbl_key)) {
-                CC_LOG_DEBUG("(%s(%d): OFRW htbl contains %d",
-                             __FUNCTION__, __LINE__,
-                             ((cc_ofrw_key_t *)htbl_key)->rw_sockfd);
-            }
-            CC_LOG_DEBUG("OFRW htbl size after insert of %d: %d",
-                         ((cc_ofrw_key_t *)htbl_key)->rw_sockfd,
-                         g_hash_table_size(cc_htbl));
-            
-            if (g_hash_table_lookup_extended(cc_of_global.ofrw_htbl,
-                                             htbl_key,
-                                             &rwht_key, &rwht_info)
-                == FALSE) {
-                CC_LOG_DEBUG("extended lookup failed");
-            } else {
-                cc_ofrw_key_t *rw_key =  NULL;
-                cc_ofrw_info_t *rw_info = NULL;
-                rw_key = (cc_ofrw_key_t *)rwht_key;
-                rw_info = (cc_ofrw_info_t *)rwht_info;
-                CC_LOG_DEBUG("extended lookup passed");
-                CC_LOG_DEBUG("key: rw_sockfd: %d "
-                            "info: layer4_proto: %s "
-                            "info: poll thread name: %s"
-                            "info: devkey controller ip: 0x%x"
-                            "info: devkey switch ip: 0x%x"
-                            "info: devkey l4port: %d",
-                            rw_key->rw_sockfd,
-                            (rw_info->layer4_proto == TCP)? "TCP":"UDP",
-                            rw_info->thr_mgr_p->tname,
-                            rw_info->dev_key.controller_ip_addr,
-                            rw_info->dev_key.switch_ip_addr,
-                            rw_info->dev_key.controller_L4_port);
-                
-            }
         }
         
         if (g_hash_table_size(cc_htbl) > old_count) {
@@ -355,7 +852,7 @@ update_global_htbl(htbl_type_e htbl_type,
         }
 
     }
-    
+
     g_mutex_unlock(cc_htbl_lock);
     return CC_OF_OK;
 }
@@ -374,6 +871,11 @@ update_global_htbl_lockfree(htbl_type_e htbl_type,
     *new_entry = FALSE;
     guint old_count;
 
+    /* the rw socket table is an array indexed by fd, not a GHashTable */
+    if (htbl_type == OFRW) {
+        return cc_ofrw_tbl_update(htbl_op, htbl_key, htbl_data, new_entry);
+    }
+
    switch(htbl_type) {
      case OFDEV:
         cc_htbl = cc_of_global.ofdev_htbl;
@@ -387,22 +889,11 @@ update_global_htbl_lockfree(htbl_type_e htbl_type,
             memcpy(info_data, htbl_data, sizeof(cc_ofdev_info_t));
         }
         break;
-      case OFRW:
-        cc_htbl = cc_of_global.ofrw_htbl;
-        if ((htbl_op == ADD) &&
-            (g_hash_table_contains(cc_htbl, htbl_key))) {
-            htbl_op = UPD;
-            /* create a new key. the insert operation will free ths */
-            key = malloc(sizeof(cc_ofrw_key_t));
-            memcpy(key, htbl_key, sizeof(cc_ofrw_key_t));
-            info_data = malloc(sizeof(cc_ofrw_info_t));
-            memcpy(info_data, htbl_data, sizeof(cc_ofrw_info_t));
-        }
-        break;
       case OFCHANN:
         cc_htbl = cc_of_global.ofchannel_htbl;
         if ((htbl_op == ADD) &&
             (g_hash_table_contains(cc_htbl, htbl_key))) {
+            htbl_op = UPD;
             /* create a new key. the insert operation will free this */
             key = malloc(sizeof(cc_ofchannel_key_t));
             memcpy(key, htbl_key, sizeof(cc_ofchannel_key_t));
@@ -415,6 +906,11 @@ update_global_htbl_lockfree(htbl_type_e htbl_type,
                      __FUNCTION__, __LINE__, htbl_type);
     }
 
+    if ((htbl_type == OFDEV) && (htbl_op != ADD)) {
+        /* a new device has no sockets yet */
+        cc_ofrw_ctx_invalidate_dev((cc_ofdev_key_t *)htbl_key);
+    }
+
     if (htbl_op == ADD) {
 
         old_count = g_hash_table_size(cc_htbl);
@@ -428,22 +924,6 @@ update_global_htbl_lockfree(htbl_type_e htbl_type,
                          ((cc_ofdev_key_t *)htbl_key)->controller_ip_addr,
                          ((cc_ofdev_key_t *)htbl_key)->switch_ip_addr,
                          ((cc_ofdev_key_t *)htbl_key)->controller_L4_port);
-        } else if (htbl_type == OFRW) {
-            CC_LOG_DEBUG("%s(%d) insert key has socket %d",
-                         __FUNCTION__, __LINE__,
-                         ((cc_ofrw_key_t *)htbl_key)->rw_sockfd);
-
-            CC_LOG_DEBUG("%s(%d) insert info has l4 proto %s",
-                         __FUNCTION__, __LINE__,
-                         (((cc_ofrw_info_t *)htbl_data)->layer4_proto == TCP)?
-                         "TCP":((((cc_ofrw_info_t *)htbl_data)->layer4_proto
-                                 == UDP)? "UDP":"INVALID"));
-
-            if (g_hash_table_contains(cc_htbl, htbl_key)) {
-                CC_LOG_DEBUG("(%s(%d): OFRW htbl already contains %d",
-                             __FUNCTION__, __LINE__,
-                             ((cc_ofrw_key_t *)htbl_key)->rw_sockfd);
-            }
         } else if (htbl_type == OFCHANN) {
             CC_LOG_DEBUG("%s(%d) ofchannel key dp/aux %lu/%hu",
                          __FUNCTION__, __LINE__,
@@ -453,47 +933,12 @@ update_global_htbl_lockfree(htbl_type_e htbl_type,
 
 
         g_hash_table_insert(cc_htbl, htbl_key, htbl_data);
+        if (htbl_type == OFCHANN) {
+            ofchann_fd_index_add((cc_ofchannel_key_t *)htbl_key,
+                                 (cc_ofchannel_info_t *)htbl_data);
+        }
 
         if (htbl_type == OFDEV) {
-        } else if (htbl_type == OFRW) {
-            gpointer rwht_key = NULL, rwht_info = NULL;
-            if (g_hash_table_contains(cc_htbl, htbl_key)) {
-                CC_LOG_DEBUG("(%s(%d): OFRW htbl contains %d",
-                             __FUNCTION__, __LINE__,
-                             ((cc_ofrw_key_t *)htbl_key)->rw_sockfd);
-            }
-            CC_LOG_DEBUG("OFRW htbl size after insert of %d: %d",
-                         ((cc_ofrw_key_t *)htbl_key)->rw_sockfd,
-                         g_hash_table_size(cc_htbl));
-
-            if (g_hash_table_lookup_extended(cc_of_global.ofrw_htbl,
-                                             htbl_key,
-                                             &rwht_key, &rwht_info)
-                == FALSE) {
-                CC_LOG_DEBUG("extended lookup failed");
-            } else {
-                cc_ofrw_key_t *rw_key =  NULL;
-                cc_ofrw_info_t *rw_info = NULL;
-                rw_key = (cc_ofrw_key_t *)rwht_key;
-                rw_info = (cc_ofrw_info_t *)rwht_info;
-                CC_LOG_DEBUG("extended lookup passed");
-                CC_LOG_DEBUG("key: rw_sockfd: %d "
-                            "info: layer4_proto: %s "
-                            "info: poll thread name: %s"
-                            "info: devkey controller ip: 0x%x"
-                            "info: devkey switch ip: 0x%x"
-                            "info: devkey l4port: %d",
-                            rw_key->rw_sockfd,
-                            (rw_info->layer4_proto == TCP)? "TCP":"UDP",
-                            rw_info->thr_mgr_p->tname,
-                            rw_info->dev_key.controller_ip_addr,
-                            rw_info->dev_key.switch_ip_addr,
-                            rw_info->dev_key.controller_L4_port);
-                
-            }
-            CC_LOG_DEBUG("%s(%d) key has socket %d",
-                         __FUNCTION__, __LINE__,
-                         ((cc_ofrw_key_t *)htbl_key)->rw_sockfd);
         }
         
         if (g_hash_table_size(cc_htbl) > old_count) {
@@ -506,6 +951,9 @@ update_global_htbl_lockfree(htbl_type_e htbl_type,
             CC_LOG_DEBUG("%s(%d) DEL operation found entry",
                          __FUNCTION__, __LINE__);
         }
+        if (htbl_type == OFCHANN) {
+            ofchann_fd_index_del((cc_ofchannel_key_t *)htbl_key);
+        }
         if (g_hash_table_remove(cc_htbl, htbl_key) == FALSE) {
             CC_LOG_DEBUG("%s(%d) DEL unsuccessful",
                          __FUNCTION__, __LINE__);
@@ -523,46 +971,18 @@ update_global_htbl_lockfree(htbl_type_e htbl_type,
                          ((cc_ofdev_key_t *)key)->switch_ip_addr,
                          ((cc_ofdev_key_t *)key)->controller_L4_port);
         }
+        if (htbl_type == OFCHANN) {
+            /* the channel may have moved to another socket */
+            ofchann_fd_index_del((cc_ofchannel_key_t *)htbl_key);
+        }
         g_hash_table_insert(cc_htbl, key, info_data);
+        if (htbl_type == OFCHANN) {
+            ofchann_fd_index_add((cc_ofchannel_key_t *)htbl_key,
+                                 (cc_ofchannel_info_t *)info_data);
+        }
 
         if (htbl_type == OFDEV) {        
         } else if (htbl_type == OFCHANN) {
-        } else if (htbl_type == OFRW) {
-            gpointer rwht_key = NULL, rwht_info = NULL;
-            if (g_hash_table_contains(cc_htbl, htbl_key)) {
-                CC_LOG_DEBUG("(%s(%d): OFRW htbl contains %d",
-                             __FUNCTION__, __LINE__,
-                             ((cc_ofrw_key_t *)htbl_key)->rw_sockfd);
-            }
-            CC_LOG_DEBUG("OFRW htbl size after insert of %d: %d",
-                         ((cc_ofrw_key_t *)htbl_key)->rw_sockfd,
-                         g_hash_table_size(cc_htbl));
-            
-            if (g_hash_table_lookup_extended(cc_of_global.ofrw_htbl,
-                                             htbl_key,
-                                             &rwht_key, &rwht_info)
-                == FALSE) {
-                CC_LOG_DEBUG("extended lookup failed");
-            } else {
-                cc_ofrw_key_t *rw_key =  NULL;
-                cc_ofrw_info_t *rw_info = NULL;
-                rw_key = (cc_ofrw_key_t *)rwht_key;
-                rw_info = (cc_ofrw_info_t *)rwht_info;
-                CC_LOG_DEBUG("extended lookup passed");
-                CC_LOG_DEBUG("key: rw_sockfd: %d "
-                            "info: layer4_proto: %s "
-                            "info: poll thread name: %s"
-                            "info: devkey controller ip: 0x%x"
-                            "info: devkey switch ip: 0x%x"
-                            "info: devkey l4port: %d",
-                            rw_key->rw_sockfd,
-                            (rw_info->layer4_proto == TCP)? "TCP":"UDP",
-                            rw_info->thr_mgr_p->tname,
-                            rw_info->dev_key.controller_ip_addr,
-                            rw_info->dev_key.switch_ip_addr,
-                            rw_info->dev_key.controller_L4_port);
-                
-            }
         }
         
         if (g_hash_table_size(cc_htbl) > old_count) {
@@ -570,7 +990,7 @@ update_global_htbl_lockfree(htbl_type_e htbl_type,
         }
 
     }
-    
+
     return CC_OF_OK;
 }
 
@@ -613,38 +1033,34 @@ print_ofdev_htbl(void)
 void
 print_ofrw_htbl(void)
 {
-    GHashTableIter ofrw_iter;
-    cc_ofrw_key_t *rw_key = NULL;
     cc_ofrw_info_t *rw_info = NULL;
-    gpointer rkey = NULL, rinfo = NULL;
-    g_hash_table_iter_init(&ofrw_iter, cc_of_global.ofrw_htbl);
-    int n;
-
-    n = g_hash_table_size(cc_of_global.ofrw_htbl);
-    
-    CC_LOG_DEBUG("Printing ofrw Hash Table with %d entries", n);
-    if (n) {
-        while (g_hash_table_iter_next(&ofrw_iter,
-                                      &rkey, &rinfo)) {
-            rw_info = (cc_ofrw_info_t *)rinfo;
-            rw_key = (cc_ofrw_key_t *)rkey;
-            if (rw_info->thr_mgr_p == NULL) {
-                CC_LOG_ERROR("%s(%d): no polling thread for %d",
-                             __FUNCTION__, __LINE__, rw_key->rw_sockfd);
-            } else {
-                CC_LOG_DEBUG("key: rw_sockfd: %d "
-                            "info: layer4_proto: %s "
-                            "info: poll thread name: %s"
-                            "info: devkey controller ip: 0x%x"
-                            "info: devkey switch ip: 0x%x"
-                            "info: devkey l4port: %d",
-                            rw_key->rw_sockfd,
-                            (rw_info->layer4_proto == TCP)? "TCP":"UDP",
-                            rw_info->thr_mgr_p->tname,
-                            rw_info->dev_key.controller_ip_addr,
-                            rw_info->dev_key.switch_ip_addr,
-                            rw_info->dev_key.controller_L4_port);
-            }
+    int rw_sockfd = -1;
+
+    CC_LOG_DEBUG("Printing ofrw table with %u entries",
+                 cc_of_global.ofrw_tbl.count);
+    while (cc_ofrw_iter_next(&rw_sockfd, &rw_info)) {
+        if ((rw_info->layer4_proto == UDP) &&
+            (rw_info->thr_mgr_p == NULL)) {
+            /* dummy fd of a controller's UDP channel */
+            CC_LOG_DEBUG("key: rw_sockfd: %d "
+                         "info: UDP channel on sockfd %d",
+                         rw_sockfd, rw_info->parent_sockfd);
+        } else if (rw_info->thr_mgr_p == NULL) {
+            CC_LOG_ERROR("%s(%d): no polling thread for %d",
+                         __FUNCTION__, __LINE__, rw_sockfd);
+        } else {
+            CC_LOG_DEBUG("key: rw_sockfd: %d "
+                        "info: layer4_proto: %s "
+                        "info: poll thread name: %s"
+                        "info: devkey controller ip: 0x%x"
+                        "info: devkey switch ip: 0x%x"
+                        "info: devkey l4port: %d",
+                        rw_sockfd,
+                        (rw_info->layer4_proto == TCP)? "TCP":"UDP",
+                        rw_info->thr_mgr_p->tname,
+                        rw_info->dev_key.controller_ip_addr,
+                        rw_info->dev_key.switch_ip_addr,
+                        rw_info->dev_key.controller_L4_port);
         }
     }
 }
@@ -692,29 +1108,28 @@ add_upd_ofrw_rwsocket(int add_fd, adpoll_thread_mgr_t  *thr_mgr_p,
                       L4_type_e layer4_proto,
                       cc_ofdev_key_t key, struct sockaddr_in *client_addr)
 {
-    cc_ofrw_key_t *ofrw_key;
-    cc_ofrw_info_t *ofrw_info;
+    cc_ofrw_key_t ofrw_key;
+    cc_ofrw_info_t ofrw_info;
     gboolean new_entry;
     cc_of_ret rc;
     CC_LOG_DEBUG("%s(%d)", __FUNCTION__, __LINE__);    
-    ofrw_key = (cc_ofrw_key_t *)malloc(sizeof(cc_ofrw_key_t));
-    ofrw_info = (cc_ofrw_info_t *)malloc(sizeof(cc_ofrw_info_t));
 
-    ofrw_key->rw_sockfd = add_fd;
-    ofrw_info->state = CC_OF_RW_DOWN;
-    ofrw_info->thr_mgr_p = thr_mgr_p;
-    memcpy(&(ofrw_info->dev_key), &key, sizeof(cc_ofdev_key_t));
+    /* the rw table keeps a copy */
+    memset(&ofrw_info, 0, sizeof(cc_ofrw_info_t));
+    ofrw_key.rw_sockfd = add_fd;
+    ofrw_info.state = CC_OF_RW_DOWN;
+    ofrw_info.thr_mgr_p = thr_mgr_p;
+    ofrw_info.parent_sockfd = -1;
+    memcpy(&(ofrw_info.dev_key), &key, sizeof(cc_ofdev_key_t));
     if (client_addr)
-        memcpy(&(ofrw_info->client_addr), client_addr, sizeof(struct sockaddr_in));
-    ofrw_info->layer4_proto = layer4_proto;
+        memcpy(&(ofrw_info.client_addr), client_addr, sizeof(struct sockaddr_in));
+    ofrw_info.layer4_proto = layer4_proto;
 
     rc = update_global_htbl_lockfree(OFRW, ADD,
-                                     ofrw_key, ofrw_info,
+                                     &ofrw_key, &ofrw_info,
                                      &new_entry);
     
-    if (!new_entry) {
-        free(ofrw_key);
-    } else {
+    if (new_entry) {
         CC_LOG_DEBUG("%s(%d): new entry %d", __FUNCTION__, __LINE__,
                      add_fd);
         print_ofrw_htbl();
@@ -727,17 +1142,15 @@ cc_of_ret
 find_thrmgr_rwsocket(int sockfd, 
                      adpoll_thread_mgr_t **tmgr) {
     cc_of_ret status = CC_OF_OK;
-    cc_ofrw_key_t rwkey;
     cc_ofrw_info_t *rwinfo = NULL;
     
-    rwkey.rw_sockfd = sockfd;
     g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
     CC_LOG_DEBUG("%s(%d)", __FUNCTION__, __LINE__);
     print_ofrw_htbl();
-    rwinfo = g_hash_table_lookup(cc_of_global.ofrw_htbl, &rwkey);
+    rwinfo = cc_ofrw_lookup(sockfd);
     if (rwinfo == NULL) {
-        CC_LOG_ERROR("%s(%d): could not find rwsock %d in ofrw_htbl",
-                     __FUNCTION__, __LINE__, rwkey.rw_sockfd);
+        CC_LOG_ERROR("%s(%d): could not find rwsock %d in ofrw_tbl",
+                     __FUNCTION__, __LINE__, sockfd);
         g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
         return CC_OF_EHTBL;
     }
@@ -751,14 +1164,12 @@ cc_of_ret
 find_thrmgr_rwsocket_lockfree(int sockfd, 
                               adpoll_thread_mgr_t **tmgr) {
     cc_of_ret status = CC_OF_OK;
-    cc_ofrw_key_t rwkey;
     cc_ofrw_info_t *rwinfo = NULL;
     
-    rwkey.rw_sockfd = sockfd;
-    rwinfo = g_hash_table_lookup(cc_of_global.ofrw_htbl, &rwkey);
+    rwinfo = cc_ofrw_lookup(sockfd);
     if (rwinfo == NULL) {
-        CC_LOG_ERROR("%s(%d): could not find rwsock %d in ofrw_htbl",
-                     __FUNCTION__, __LINE__, rwkey.rw_sockfd);
+        CC_LOG_ERROR("%s(%d): could not find rwsock %d in ofrw_tbl",
+                     __FUNCTION__, __LINE__, sockfd);
         return CC_OF_EHTBL;
     }
     
@@ -796,68 +1207,103 @@ add_upd_ofchann_rwsocket(cc_ofchannel_key_t key,
                                      &new_entry);
     
     if (!new_entry) {
+        /* an existing entry was updated from copies of these */
         g_free(ofchannel_key);
+        g_free(ofchannel_info);
     }
     return rc;
 }
 
-gboolean
-ofchannel_entry_match(cc_ofchannel_key_t *key UNUSED,
-                      cc_ofchannel_info_t *info,
-                      int *rwsock)
+// caller will acquire ofchannel_htbl_lock
+cc_of_ret
+del_ofchann_rwsocket(int rwsock)
 {
-    if (info->rw_sockfd == *rwsock) {
-        return TRUE;
+    cc_ofchannel_key_t *fd_key;
+    cc_ofchannel_key_t chann_key;
+    gboolean new_entry;
+
+    fd_key = g_hash_table_lookup(cc_of_global.ofchann_fd_htbl,
+                                 GINT_TO_POINTER(rwsock));
+    if (fd_key == NULL) {
+        return CC_OF_OK;
     }
-    return FALSE;
+    /* the index entry goes away with the channel entry */
+    memcpy(&chann_key, fd_key, sizeof(cc_ofchannel_key_t));
+    return (update_global_htbl_lockfree(OFCHANN, DEL, (gpointer)&chann_key,
+                                        NULL, &new_entry));
 }
 
+/* move the channel of rw_sockfd to new_key, in one go for the other
+ * holders of ofchannel_htbl_lock. CC_OF_EEXIST if new_key is the
+ * channel of another socket.
+ */
+// caller should acquire ofchannel_htbl_lock
 cc_of_ret
-del_ofchann_rwsocket(int rwsock)
+cc_ofchann_rekey(int rw_sockfd, cc_ofchannel_key_t *new_key)
 {
-    g_hash_table_foreach_remove(cc_of_global.ofchannel_htbl,
-                                (GHRFunc)ofchannel_entry_match,
-                                &rwsock);
-    return CC_OF_OK;
+    cc_ofchannel_key_t *fd_key;
+    cc_ofchannel_info_t *ofchann_info_old, *ofchann_info_new;
+    cc_ofchannel_key_t *ofchann_key_new;
+    cc_of_ret status;
+    gboolean new_entry;
+
+    fd_key = g_hash_table_lookup(cc_of_global.ofchann_fd_htbl,
+                                 GINT_TO_POINTER(rw_sockfd));
+    if (fd_key == NULL) {
+        return CC_OF_EHTBL;
+    }
+    if (cc_ofchannel_htbl_equal_func(fd_key, new_key)) {
+        return CC_OF_OK;
+    }
+    ofchann_info_old = g_hash_table_lookup(cc_of_global.ofchannel_htbl,
+                                           new_key);
+    if ((ofchann_info_old != NULL) &&
+        (ofchann_info_old->rw_sockfd != rw_sockfd)) {
+        return CC_OF_EEXIST;
+    }
+    ofchann_info_old = g_hash_table_lookup(cc_of_global.ofchannel_htbl,
+                                           fd_key);
+    if (ofchann_info_old == NULL) {
+        return CC_OF_EHTBL;
+    }
+
+    /* the htbl keeps the key and info it is given - hand it copies */
+    ofchann_info_new = g_malloc(sizeof(cc_ofchannel_info_t));
+    memcpy(ofchann_info_new, ofchann_info_old, sizeof(cc_ofchannel_info_t));
+    ofchann_key_new = g_malloc(sizeof(cc_ofchannel_key_t));
+    memcpy(ofchann_key_new, new_key, sizeof(cc_ofchannel_key_t));
+
+    /* drops the socket's entry in the fd index as well */
+    status = del_ofchann_rwsocket(rw_sockfd);
+    update_global_htbl_lockfree(OFCHANN, ADD, (gpointer)ofchann_key_new,
+                                ofchann_info_new, &new_entry);
+    if (!new_entry) {
+        g_free(ofchann_key_new);
+        g_free(ofchann_info_new);
+    }
+    return status;
 }
 
 // caller should acquire ofchannel_htbl_lock
 cc_of_ret
 find_ofchann_key_rwsocket(int sockfd, cc_ofchannel_key_t **fd_chann_key) {
 
-    cc_of_ret status = CC_OF_OK;
-    cc_ofchannel_key_t *channel_key_tmp = NULL;
-    GHashTableIter ofchannel_iter;
     cc_ofchannel_key_t *channel_key = NULL;
-    cc_ofchannel_info_t *channel_info = NULL;
 
     /*   
      * Do a reverse lookup to get the channel_key
      * corresponding to this sockfd
      */
-
-    g_hash_table_iter_init(&ofchannel_iter, cc_of_global.ofchannel_htbl);
-    while (g_hash_table_iter_next(&ofchannel_iter,
-                                  (gpointer *)&channel_key,
-                                  (gpointer *)&channel_info)) {
-        CC_LOG_DEBUG("%s(%d): dp/aux %lu/%hu socket %d",
-                     __FUNCTION__, __LINE__, channel_key->dp_id,
-                     channel_key->aux_id, channel_info->rw_sockfd);
-        
-        if (channel_info->rw_sockfd == sockfd) {
-            channel_key_tmp = channel_key;
-            break;
-        }
-    }
-
-    if (channel_key_tmp == NULL) {
+    channel_key = g_hash_table_lookup(cc_of_global.ofchann_fd_htbl,
+                                      GINT_TO_POINTER(sockfd));
+    if (channel_key == NULL) {
         CC_LOG_ERROR("%s(%d): could not find channel_key for rwsock %d"
                      , __FUNCTION__, __LINE__, sockfd);
         return CC_OF_EHTBL;
     }
 
-    *fd_chann_key = channel_key_tmp;
-    return status;
+    *fd_chann_key = channel_key;
+    return CC_OF_OK;
 }
 
 // caller will acquire ofdev_htbl lock 
@@ -947,6 +1393,273 @@ del_ofdev_rwsocket(cc_ofdev_key_t key, int rwsock)
     return CC_OF_OK;
 }
 
+cc_ofrw_ctx_t *
+cc_ofrw_ctx_new(L4_type_e layer4_proto)
+{
+    cc_ofrw_ctx_t *ctx;
+
+    ctx = (cc_ofrw_ctx_t *)g_malloc0(sizeof(cc_ofrw_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    if (layer4_proto == TCP) {
+        ctx->rx = cc_of_msg_rx_new();
+        if (ctx->rx == NULL) {
+            g_free(ctx);
+            return NULL;
+        }
+    }
+    return ctx;
+}
+
+void
+cc_ofrw_ctx_free(cc_ofrw_ctx_t *ctx)
+{
+    GHashTableIter iter;
+    gpointer req = NULL;
+
+    if (ctx) {
+        /* on the poll thread that runs the timer */
+        adp_thr_mgr_timer_cancel(&ctx->echo_timer);
+        /* requests still waiting for a reply lost their channel */
+        while ((ctx->xid_htbl != NULL) &&
+               (g_hash_table_size(ctx->xid_htbl) > 0)) {
+            g_hash_table_iter_init(&iter, ctx->xid_htbl);
+            g_hash_table_iter_next(&iter, NULL, &req);
+            cc_of_xid_req_drop(req);
+        }
+        if (ctx->xid_htbl) {
+            g_hash_table_destroy(ctx->xid_htbl);
+        }
+        cc_of_msg_rx_free(ctx->rx);
+        g_free(ctx);
+    }
+}
+
+void
+cc_ofrw_ctx_update(int sockfd, cc_ofrw_ctx_t *ctx)
+{
+    cc_ofchannel_key_t *fd_chann_key = NULL;
+    cc_ofrw_info_t *rwinfo = NULL;
+    cc_ofdev_info_t *devinfo = NULL;
+
+    if (ctx->cached && (ctx->gen == cc_ofrw_get_ctx_gen(sockfd))) {
+        return;
+    }
+
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+
+    /* every change bumps ctx_gen with one of these locks held */
+    ctx->gen = cc_ofrw_get_ctx_gen(sockfd);
+    ctx->cached = TRUE;
+    ctx->found = FALSE;
+
+    if (find_ofchann_key_rwsocket(sockfd, &fd_chann_key) < 0) {
+        CC_LOG_ERROR("%s(%d): could not find ofchann key for sockfd %d",
+                     __FUNCTION__, __LINE__, sockfd);
+        goto unlock;
+    }
+
+    rwinfo = cc_ofrw_lookup(sockfd);
+    if (rwinfo == NULL) {
+        CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_tbl "
+                     "for sockfd-%d", __FUNCTION__, __LINE__, sockfd);
+        goto unlock;
+    }
+
+    devinfo = g_hash_table_lookup(cc_of_global.ofdev_htbl,
+                                  &(rwinfo->dev_key));
+    if (devinfo == NULL) {
+        CC_LOG_ERROR("%s(%d): could not find devinfo in ofdev_htbl "
+                     "for sockfd-%d", __FUNCTION__, __LINE__, sockfd);
+        goto unlock;
+    }
+
+    ctx->chann_key = *fd_chann_key;
+    ctx->state = rwinfo->state;
+    ctx->recv_func = devinfo->recv_func;
+    ctx->recv_batch_func = devinfo->recv_batch_func;
+    ctx->accept_chann_func = devinfo->accept_chann_func;
+    ctx->chann_up_func = devinfo->chann_up_func;
+    ctx->chann_ready_func = devinfo->chann_ready_func;
+    ctx->of_bitmap = cc_of_msg_version_bitmap(devinfo->of_max_ver);
+    ctx->sockfd = sockfd;
+    ctx->thr_mgr_p = rwinfo->thr_mgr_p;
+    ctx->found = TRUE;
+    /* for cc_of_get_conn_rtt */
+    cc_of_global.ofrw_tbl.slots[sockfd].ctx = ctx;
+    CC_LOG_DEBUG("%s(%d): sockfd %d is dp_id %lu aux_id %u state %d",
+                 __FUNCTION__, __LINE__, sockfd, ctx->chann_key.dp_id,
+                 ctx->chann_key.aux_id, ctx->state);
+
+unlock:
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+}
+
+cc_of_xid_req_t *
+cc_of_xid_req_new(uint64_t dp_id, uint8_t aux_id, uint32_t xid,
+                  uint32_t timeout_ms, cc_of_reply reply_func,
+                  cc_of_multipart_reply mp_func, void *reply_ctx)
+{
+    cc_of_xid_req_t *req;
+
+    req = (cc_of_xid_req_t *)g_malloc0(sizeof(cc_of_xid_req_t));
+    if (req == NULL) {
+        return NULL;
+    }
+    req->xid = xid;
+    req->dp_id = dp_id;
+    req->aux_id = aux_id;
+    req->timeout_ms = timeout_ms;
+    req->reply_func = reply_func;
+    req->mp_func = mp_func;
+    req->reply_ctx = reply_ctx;
+    if (mp_func) {
+        req->mp_data = g_byte_array_new();
+        req->mp_lens = g_array_new(FALSE, FALSE, sizeof(size_t));
+    }
+    return req;
+}
+
+void
+cc_of_xid_req_free(cc_of_xid_req_t *req)
+{
+    if (req) {
+        if (req->mp_func) {
+            g_byte_array_free(req->mp_data, TRUE);
+            g_array_free(req->mp_lens, TRUE);
+        }
+        g_free(req);
+    }
+}
+
+/* copy a part of the reply of a multipart request */
+static void
+cc_of_xid_req_gather(cc_of_xid_req_t *req, char *msg, size_t msg_len)
+{
+    g_byte_array_append(req->mp_data, (guint8 *)msg, msg_len);
+    g_array_append_val(req->mp_lens, msg_len);
+}
+
+/* all parts gathered so far, in one call. The parts point into mp_data,
+ * which no longer moves.
+ */
+static void
+cc_of_xid_req_mp_deliver(cc_of_xid_req_t *req, cc_of_ret status)
+{
+    cc_of_msg_part_t *parts;
+    uint32_t num_parts = req->mp_lens->len;
+    size_t off = 0;
+    uint32_t i;
+
+    parts = g_new(cc_of_msg_part_t, MAX(num_parts, 1));
+    for (i = 0; i < num_parts; i++) {
+        parts[i].of_msg = req->mp_data->data + off;
+        parts[i].of_msg_len = g_array_index(req->mp_lens, size_t, i);
+        off += parts[i].of_msg_len;
+    }
+    req->mp_func(req->dp_id, req->aux_id, req->xid,
+                 num_parts ? parts : NULL, num_parts, status,
+                 req->reply_ctx);
+    g_free(parts);
+}
+
+/* the request's last call of its reply function */
+static void
+cc_of_xid_req_done(cc_of_xid_req_t *req, char *msg, size_t msg_len,
+                   cc_of_ret status)
+{
+    if (req->rw_ctx) {
+        g_hash_table_remove(req->rw_ctx->xid_htbl,
+                            GUINT_TO_POINTER(req->xid));
+        adp_thr_mgr_timer_cancel(&req->timer);
+    }
+    if (req->mp_func) {
+        if (msg) {
+            cc_of_xid_req_gather(req, msg, msg_len);
+        }
+        cc_of_xid_req_mp_deliver(req, status);
+    } else {
+        req->reply_func(req->dp_id, req->aux_id, req->xid, msg, msg_len,
+                        status, req->reply_ctx);
+    }
+    cc_of_xid_req_free(req);
+}
+
+void
+cc_of_xid_req_drop(gpointer req)
+{
+    cc_of_xid_req_done((cc_of_xid_req_t *)req, NULL, 0, CC_OF_ECHANN);
+}
+
+static void
+cc_ofrw_xid_timer_func(char *tname, adpoll_timer_t *timer)
+{
+    cc_of_xid_req_t *req = (cc_of_xid_req_t *)timer->data;
+
+    CC_LOG_DEBUG("%s(%d)[%s]: no reply to xid %u on channel dp_id-%lu "
+                 "aux_id-%u in %u ms", __FUNCTION__, __LINE__, tname,
+                 req->xid, req->dp_id, req->aux_id, req->timeout_ms);
+    cc_of_xid_req_done(req, NULL, 0, CC_OF_ETIMEOUT);
+}
+
+void
+cc_ofrw_xid_req_add(cc_ofrw_ctx_t *ctx, cc_of_xid_req_t *req)
+{
+    if (ctx->xid_htbl == NULL) {
+        ctx->xid_htbl = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    if (g_hash_table_lookup(ctx->xid_htbl, GUINT_TO_POINTER(req->xid))) {
+        /* its reply could not be told apart */
+        cc_of_xid_req_done(req, NULL, 0, CC_OF_EEXIST);
+        return;
+    }
+    g_hash_table_insert(ctx->xid_htbl, GUINT_TO_POINTER(req->xid), req);
+    req->rw_ctx = ctx;
+    adp_thr_mgr_timer_init(&req->timer, cc_ofrw_xid_timer_func, NULL, req);
+    if (req->timeout_ms) {
+        adp_thr_mgr_timer_add(&req->timer, req->timeout_ms);
+    }
+}
+
+cc_of_xid_req_t *
+cc_ofrw_xid_lookup(cc_ofrw_ctx_t *ctx, char *msg)
+{
+    if ((ctx->xid_htbl == NULL) ||
+        (g_hash_table_size(ctx->xid_htbl) == 0) ||
+        cc_of_msg_unsolicited(msg)) {
+        return NULL;
+    }
+    return g_hash_table_lookup(ctx->xid_htbl,
+                               GUINT_TO_POINTER(ntohl(((ofp_header_t *)msg)->xid)));
+}
+
+void
+cc_ofrw_xid_reply(cc_of_xid_req_t *req, char *msg, size_t msg_len)
+{
+    if (!cc_of_msg_reply_more(msg, msg_len)) {
+        cc_of_xid_req_done(req, msg, msg_len, CC_OF_OK);
+        return;
+    }
+
+    /* the timeout starts again with each part */
+    if (req->timeout_ms) {
+        adp_thr_mgr_timer_cancel(&req->timer);
+        adp_thr_mgr_timer_add(&req->timer, req->timeout_ms);
+    }
+    if (req->mp_func) {
+        /* the application hears of it with the last part */
+        cc_of_xid_req_gather(req, msg, msg_len);
+        return;
+    }
+    req->reply_func(req->dp_id, req->aux_id, req->xid, msg, msg_len,
+                    CC_OF_OK, req->reply_ctx);
+}
+
 // Caller will acquire three htbl locks
 cc_of_ret
 atomic_add_upd_htbls_with_rwsocket(int sockfd, struct sockaddr_in *client_addr,
@@ -1014,6 +1727,274 @@ atomic_add_upd_htbls_with_rwsocket(int sockfd, struct sockaddr_in *client_addr,
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Timers of channels: run on the poll thread of the channel's socket    */
+/*-----------------------------------------------------------------------*/
+
+// caller will acquire ofchannel and ofrw locks
+cc_of_ret
+cc_ofchann_timer_arm(cc_ofchannel_key_t chann_key, adpoll_timer_t *timer,
+                     uint32_t delay_ms)
+{
+    cc_ofchannel_info_t *ofchann_info;
+    cc_ofrw_info_t *rwinfo = NULL;
+
+    ofchann_info = g_hash_table_lookup(cc_of_global.ofchannel_htbl,
+                                       &chann_key);
+    if (ofchann_info != NULL) {
+        rwinfo = cc_ofrw_lookup(ofchann_info->rw_sockfd);
+    }
+    /* controller UDP channels are served with their UDP socket */
+    if ((rwinfo != NULL) && (rwinfo->thr_mgr_p == NULL) &&
+        (rwinfo->parent_sockfd >= 0)) {
+        rwinfo = cc_ofrw_lookup(rwinfo->parent_sockfd);
+    }
+    if ((rwinfo == NULL) || (rwinfo->thr_mgr_p == NULL)) {
+        CC_LOG_DEBUG("%s(%d): no poll thread for channel dp_id-%lu "
+                     "aux_id-%u", __FUNCTION__, __LINE__, chann_key.dp_id,
+                     chann_key.aux_id);
+        return CC_OF_EINVAL;
+    }
+
+    if (adp_thr_mgr_timer_arm(rwinfo->thr_mgr_p, timer, delay_ms) < 0) {
+        CC_LOG_ERROR("%s(%d): could not arm timer of channel dp_id-%lu "
+                     "aux_id-%u on %s", __FUNCTION__, __LINE__,
+                     chann_key.dp_id, chann_key.aux_id,
+                     rwinfo->thr_mgr_p->tname);
+        return CC_OF_EMISC;
+    }
+    return CC_OF_OK;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Utilities to reconnect lost switch channels                           */
+/* Reconnects wait on a timer of the rw poll thread that lost them, with */
+/* capped exponential backoff and jitter                                 */
+/*-----------------------------------------------------------------------*/
+static uint32_t ofreconn_gen = 0;
+
+static void cc_ofchann_reconnect_timer_func(char *tname,
+                                            adpoll_timer_t *timer);
+
+/* delay of retry number count_retries (from 1): base * 2^(n-1) capped
+ * at max, less a random part of up to half of it
+ */
+uint32_t
+cc_ofchann_reconnect_delay(uint32_t count_retries)
+{
+    uint32_t base = cc_of_global.ofreconn_base_ms;
+    uint32_t max = cc_of_global.ofreconn_max_ms;
+    uint32_t delay = base;
+    uint32_t i;
+
+    for (i = 1; (i < count_retries) && (delay < max); i++) {
+        delay = (delay > (max / 2)) ? max : (delay * 2);
+    }
+    delay = MIN(delay, max);
+
+    return ((delay / 2) + g_random_int_range(0, (delay / 2) + 1));
+}
+
+// caller will acquire three htbl locks
+gboolean
+cc_ofchann_reconnect(char *tname, cc_ofchannel_key_t chann_key,
+                     cc_ofdev_key_t dev_key, L4_type_e layer4_proto,
+                     uint32_t count_retries)
+{
+    cc_ofchann_reconn_t *reconn;
+    cc_ofchann_reconn_timer_t *reconn_timer;
+    cc_ofchannel_key_t *key;
+    uint32_t delay_ms;
+
+    if ((cc_of_global.ofreconn_htbl == NULL) ||
+        (cc_of_global.ofreconn_base_ms == 0) ||
+        (g_hash_table_lookup(cc_of_global.ofdev_htbl, &dev_key) == NULL) ||
+        ((cc_of_global.ofreconn_max_retries != 0) &&
+         (count_retries > cc_of_global.ofreconn_max_retries))) {
+        cc_ofchann_reconnect_clear(chann_key, NULL);
+        return FALSE;
+    }
+
+    reconn = g_hash_table_lookup(cc_of_global.ofreconn_htbl, &chann_key);
+    if (reconn == NULL) {
+        key = g_malloc0(sizeof(cc_ofchannel_key_t));
+        reconn = g_malloc0(sizeof(cc_ofchann_reconn_t));
+        if ((key == NULL) || (reconn == NULL)) {
+            CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__,
+                         cc_of_strerror(CC_OF_ENOMEM));
+            g_free(key);
+            g_free(reconn);
+            return FALSE;
+        }
+        *key = chann_key;
+        g_hash_table_insert(cc_of_global.ofreconn_htbl, key, reconn);
+    }
+    reconn->dev_key = dev_key;
+    reconn->layer4_proto = layer4_proto;
+    reconn->state = CC_OF_CONN_BACKOFF;
+    reconn->count_retries = count_retries;
+    reconn->gen = ++ofreconn_gen;
+
+    reconn_timer = g_malloc0(sizeof(cc_ofchann_reconn_timer_t));
+    if (reconn_timer == NULL) {
+        CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__,
+                     cc_of_strerror(CC_OF_ENOMEM));
+        cc_ofchann_reconnect_clear(chann_key, NULL);
+        return FALSE;
+    }
+    reconn_timer->chann_key = chann_key;
+    reconn_timer->gen = reconn->gen;
+    adp_thr_mgr_timer_init(&reconn_timer->timer,
+                           cc_ofchann_reconnect_timer_func,
+                           g_free, reconn_timer);
+
+    delay_ms = cc_ofchann_reconnect_delay(count_retries);
+    if (adp_thr_mgr_timer_add(&reconn_timer->timer, delay_ms) < 0) {
+        CC_LOG_ERROR("%s(%d)[%s]: could not arm reconnect timer of channel "
+                     "dp_id-%lu aux_id-%u", __FUNCTION__, __LINE__, tname,
+                     chann_key.dp_id, chann_key.aux_id);
+        g_free(reconn_timer);
+        cc_ofchann_reconnect_clear(chann_key, NULL);
+        return FALSE;
+    }
+
+    CC_LOG_INFO("%s(%d)[%s]: reconnecting channel dp_id-%lu aux_id-%u in "
+                "%u ms, retry %u", __FUNCTION__, __LINE__, tname,
+                chann_key.dp_id, chann_key.aux_id, delay_ms, count_retries);
+    return TRUE;
+}
+
+// caller will acquire ofchannel lock
+gboolean
+cc_ofchann_reconnect_clear(cc_ofchannel_key_t chann_key,
+                           uint32_t *count_retries)
+{
+    cc_ofchann_reconn_t *reconn;
+
+    if (cc_of_global.ofreconn_htbl == NULL) {
+        return FALSE;
+    }
+    reconn = g_hash_table_lookup(cc_of_global.ofreconn_htbl, &chann_key);
+    if (reconn == NULL) {
+        return FALSE;
+    }
+    if (count_retries) {
+        *count_retries = reconn->count_retries;
+    }
+    /* its timer, if still armed, finds it gone */
+    g_hash_table_remove(cc_of_global.ofreconn_htbl, &chann_key);
+    return TRUE;
+}
+
+static gboolean
+cc_ofchann_reconnect_dev_match(gpointer key UNUSED, gpointer value,
+                               gpointer user_data)
+{
+    cc_ofchann_reconn_t *reconn = (cc_ofchann_reconn_t *)value;
+
+    return (cc_ofdev_htbl_equal_func(&reconn->dev_key, user_data));
+}
+
+// caller will acquire ofchannel lock
+void
+cc_ofchann_reconnect_dev_clear(cc_ofdev_key_t dev_key)
+{
+    if (cc_of_global.ofreconn_htbl == NULL) {
+        return;
+    }
+    g_hash_table_foreach_remove(cc_of_global.ofreconn_htbl,
+                                cc_ofchann_reconnect_dev_match, &dev_key);
+}
+
+/* reconnect timer expired, on the poll thread that armed it: connect
+ * the channel again. The connect runs without the htbl locks as it
+ * takes them itself.
+ */
+static void
+cc_ofchann_reconnect_timer_func(char *tname, adpoll_timer_t *timer)
+{
+    cc_ofchann_reconn_timer_t *reconn_timer =
+        (cc_ofchann_reconn_timer_t *)timer->data;
+    cc_ofchann_reconn_t *reconn = NULL;
+    cc_ofchannel_key_t chann_key = reconn_timer->chann_key;
+    uint32_t gen = reconn_timer->gen;
+    cc_ofdev_key_t dev_key;
+    cc_ofdev_info_t *dev_info;
+    L4_type_e layer4_proto;
+    uint32_t count_retries;
+    cc_of_delete_channel del_chann_func = NULL;
+    gboolean retry = TRUE;
+
+    g_free(reconn_timer);
+
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+
+    if (cc_of_global.ofreconn_htbl != NULL) {
+        reconn = g_hash_table_lookup(cc_of_global.ofreconn_htbl,
+                                     &chann_key);
+    }
+    if ((reconn == NULL) || (reconn->gen != gen)) {
+        /* channel deleted, or reconnected another way meanwhile */
+        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+        return;
+    }
+    reconn->state = CC_OF_CONN_CONNECTING;
+    dev_key = reconn->dev_key;
+    layer4_proto = reconn->layer4_proto;
+    count_retries = reconn->count_retries;
+
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+
+    CC_LOG_DEBUG("%s(%d)[%s]: reconnecting channel dp_id-%lu aux_id-%u, "
+                 "retry %u", __FUNCTION__, __LINE__, tname, chann_key.dp_id,
+                 chann_key.aux_id, count_retries);
+
+    if (cc_of_global.NET_SVCS[layer4_proto].open_clientfd(dev_key,
+                                                          chann_key) >= 0) {
+        /* tcp_connect_done takes it from here */
+        return;
+    }
+
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+
+    reconn = NULL;
+    if (cc_of_global.ofreconn_htbl != NULL) {
+        reconn = g_hash_table_lookup(cc_of_global.ofreconn_htbl,
+                                     &chann_key);
+    }
+    if ((reconn != NULL) && (reconn->gen == gen)) {
+        retry = cc_ofchann_reconnect(tname, chann_key, dev_key,
+                                     layer4_proto, count_retries + 1);
+        if (!retry) {
+            dev_info = g_hash_table_lookup(cc_of_global.ofdev_htbl,
+                                           &dev_key);
+            if (dev_info != NULL) {
+                del_chann_func = dev_info->del_chann_func;
+            }
+        }
+    }
+
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+
+    if (!retry) {
+        CC_LOG_ERROR("%s(%d)[%s]: gave up reconnecting channel dp_id-%lu "
+                     "aux_id-%u", __FUNCTION__, __LINE__, tname,
+                     chann_key.dp_id, chann_key.aux_id);
+        if (del_chann_func) {
+            del_chann_func(chann_key.dp_id, chann_key.aux_id);
+        }
+    }
+}
+
+
 /*-----------------------------------------------------------------------*/
 /* Utilities to manage the rw poll thr pool                              */
 /* Sorted list of rw pollthreads                                         */
@@ -1041,7 +2022,8 @@ cc_create_rw_pollthr(adpoll_thread_mgr_t **tmgr)
 
     g_sprintf(tname,"rwthr_%d", cc_get_count_rw_pollthr() + 1);
 
-    tmgr_new = adp_thr_mgr_new(tname, max_sockets, max_pipes);
+    tmgr_new = adp_thr_mgr_new_backend(tname, max_sockets, max_pipes,
+                                       cc_of_global.ofrw_backend);
 
     if (tmgr_new == NULL) {
         CC_LOG_ERROR("%s(%d): failed to create new poll thread for rw",
@@ -1103,6 +2085,61 @@ cc_find_or_create_rw_pollthr(adpoll_thread_mgr_t **tmgr)
     return(CC_OF_OK);
 }
 
+/* like cc_find_or_create_rw_pollthr, but never one of the threads on
+ * excl_list - for sockets that are to be served by different threads
+ */
+cc_of_ret
+cc_find_or_create_rw_pollthr_excl(GList *excl_list,
+                                  adpoll_thread_mgr_t **tmgr)
+{
+    GList *elem;
+    adpoll_thread_mgr_t *tmgr_elem;
+
+    g_mutex_lock(&cc_of_global.ofrw_pollthr_list_lock);
+    for (elem = g_list_first(cc_of_global.ofrw_pollthr_list); elem != NULL;
+         elem = g_list_next(elem)) {
+        tmgr_elem = (adpoll_thread_mgr_t *)(elem->data);
+        if ((adp_thr_mgr_get_num_avail_sockfd(tmgr_elem) != 0) &&
+            (g_list_find(excl_list, tmgr_elem) == NULL)) {
+            *tmgr = tmgr_elem;
+            CC_LOG_DEBUG("%s(%d): Found thr manager %s", __FUNCTION__,
+                         __LINE__, (*tmgr)->tname);
+            g_mutex_unlock(&cc_of_global.ofrw_pollthr_list_lock);
+            return(CC_OF_OK);
+        }
+    }
+    g_mutex_unlock(&cc_of_global.ofrw_pollthr_list_lock);
+
+    CC_LOG_DEBUG("%s(%d): no free poll thr - create new",
+                 __FUNCTION__, __LINE__);
+    return(cc_create_rw_pollthr(tmgr));
+}
+
+/* the rw poll thread of the caller if it has room for a socket, else
+ * NULL
+ */
+static adpoll_thread_mgr_t *
+cc_find_self_rw_pollthr(void)
+{
+    GList *elem;
+    adpoll_thread_mgr_t *tmgr_elem, *tmgr = NULL;
+
+    g_mutex_lock(&cc_of_global.ofrw_pollthr_list_lock);
+    for (elem = g_list_first(cc_of_global.ofrw_pollthr_list); elem != NULL;
+         elem = g_list_next(elem)) {
+        tmgr_elem = (adpoll_thread_mgr_t *)(elem->data);
+        if (tmgr_elem->thread_p == g_thread_self()) {
+            if (adp_thr_mgr_get_num_avail_sockfd(tmgr_elem) != 0) {
+                tmgr = tmgr_elem;
+            }
+            break;
+        }
+    }
+    g_mutex_unlock(&cc_of_global.ofrw_pollthr_list_lock);
+
+    return tmgr;
+}
+
 gint
 cc_pollthr_list_compare_func(adpoll_thread_mgr_t *tmgr1,
                              adpoll_thread_mgr_t *tmgr2)
@@ -1124,16 +2161,9 @@ cc_pollthr_list_compare_func(adpoll_thread_mgr_t *tmgr1,
 cc_of_ret
 cc_del_sockfd_rw_pollthr(adpoll_thread_mgr_t *tmgr, adpoll_thr_msg_t *thr_msg)
 {
-    cc_ofrw_key_t rwkey;
     cc_ofrw_info_t *rwinfo_p = NULL;
     GList *tmp_list = NULL;
-    adpoll_thread_mgr_t  *tmp_tmgr = NULL;
-    gpointer rwht_key, rwht_info;
     
-    CC_LOG_DEBUG("%s(%d) Thread: %s, fd: %d, type: %s", __FUNCTION__,
-                 __LINE__, tmgr->tname, thr_msg->fd,
-                 (thr_msg->fd_type == PIPE)? "pipe":"socket");
-
     if (thr_msg == NULL) {
         CC_LOG_ERROR("%s(%d): invalid parameters",
                      __FUNCTION__, __LINE__);
@@ -1144,6 +2174,9 @@ cc_del_sockfd_rw_pollthr(adpoll_thread_mgr_t *tmgr, adpoll_thr_msg_t *thr_msg)
                      __FUNCTION__, __LINE__);
         return CC_OF_EINVAL;
     }
+    CC_LOG_DEBUG("%s(%d) Thread: %s, fd: %d, type: %s", __FUNCTION__,
+                 __LINE__, tmgr ? tmgr->tname : "none", thr_msg->fd,
+                 (thr_msg->fd_type == PIPE)? "pipe":"socket");
 
     /* Dummy udp sockfds do not belong to any tmgr 
      */
@@ -1166,10 +2199,9 @@ cc_del_sockfd_rw_pollthr(adpoll_thread_mgr_t *tmgr, adpoll_thr_msg_t *thr_msg)
                 return(CC_OF_EMISC);
             }
         
-            tmp_tmgr = (adpoll_thread_mgr_t *)tmp_list->data;
+            /* re-sort: only the list link goes, tmgr is still in use */
             cc_of_global.ofrw_pollthr_list =
                 g_list_delete_link(cc_of_global.ofrw_pollthr_list, tmp_list);
-            free(tmp_tmgr);
         
             cc_of_global.ofrw_pollthr_list = g_list_insert_sorted(
                 cc_of_global.ofrw_pollthr_list,
@@ -1179,25 +2211,18 @@ cc_del_sockfd_rw_pollthr(adpoll_thread_mgr_t *tmgr, adpoll_thr_msg_t *thr_msg)
         }
     }
     
-    rwkey.rw_sockfd = thr_msg->fd;
-    if (g_hash_table_contains(cc_of_global.ofrw_htbl, &rwkey)) {
-        CC_LOG_DEBUG("%s(%d) - ofrw_htbl does contain %d",
-                     __FUNCTION__, __LINE__, rwkey.rw_sockfd);
-    }
-
-    if (g_hash_table_lookup_extended(cc_of_global.ofrw_htbl, &rwkey,
-                                     &rwht_key, &rwht_info) == FALSE) {
-        CC_LOG_DEBUG("%s(%d) ofrw_htbl does not have the entry for fd %d",
-                     __FUNCTION__, __LINE__, rwkey.rw_sockfd);
+    rwinfo_p = cc_ofrw_lookup(thr_msg->fd);
+    if (rwinfo_p == NULL) {
+        CC_LOG_DEBUG("%s(%d) ofrw_tbl does not have the entry for fd %d",
+                     __FUNCTION__, __LINE__, thr_msg->fd);
     }
-    rwinfo_p = (cc_ofrw_info_t *)rwht_info;
 
     if (rwinfo_p) {
         //ofrw_socket_list in device
         del_ofdev_rwsocket(rwinfo_p->dev_key, thr_msg->fd);
 
     }
-    //cc_of_global.ofrw_htbl - cc_ofrw_info_t
+    //cc_of_global.ofrw_tbl - cc_ofrw_info_t
     del_ofrw_rwsocket(thr_msg->fd);
     
     //delete from ofchannel_htbl - cc_ofchannel_info_t
@@ -1215,60 +2240,80 @@ cc_add_sockfd_rw_pollthr(adpoll_thr_msg_t *thr_msg, cc_ofdev_key_t key,
     cc_of_ret status = CC_OF_OK;
     adpoll_thread_mgr_t *tmgr = NULL;
 
+    /* from a rw poll thread, e.g. a reconnect on its timer: the socket
+     * stays with it while it has room, as waiting on another poll
+     * thread that may be doing the same could deadlock
+     */
+    tmgr = cc_find_self_rw_pollthr();
+
     /* find or create a poll thread */
-    status = cc_find_or_create_rw_pollthr(&tmgr);
+    if (tmgr == NULL) {
+        status = cc_find_or_create_rw_pollthr(&tmgr);
+    }
 
     if(status < 0) {
         CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, 
                      cc_of_strerror(status));
         return status;
-    } else {
-        /* add fd to global structures */
+    }
+    return (cc_add_sockfd_rw_pollthr_tmgr(tmgr, thr_msg, key, layer4_proto,
+                                          ofchann_key));
+}
+
+// callee will acquire all three htbl locks
+cc_of_ret
+cc_add_sockfd_rw_pollthr_tmgr(adpoll_thread_mgr_t *tmgr,
+                              adpoll_thr_msg_t *thr_msg, cc_ofdev_key_t key,
+                              L4_type_e layer4_proto,
+                              cc_ofchannel_key_t ofchann_key)
+{
+    cc_of_ret status = CC_OF_OK;
 
+    /* add fd to global structures */
+
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    
+
+    CC_LOG_DEBUG("%s(%d) dev controller ip 0x%x, switch ip 0x%x, "
+                 "layer4 port %d", __FUNCTION__, __LINE__,
+                 key.controller_ip_addr, key.switch_ip_addr,
+                 key.controller_L4_port);
+ 
+    status = atomic_add_upd_htbls_with_rwsocket(thr_msg->fd, NULL,
+                                                tmgr,
+                                                key, 
+                                                layer4_proto,
+                                                ofchann_key);
+
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+    
+    if (status < 0) {
+        CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, 
+                     cc_of_strerror(status));
+        /* Del fd from thr_mgr if update of global structures fails */
         g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
         g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
         g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
         
-
-        CC_LOG_DEBUG("%s(%d) dev controller ip 0x%x, switch ip 0x%x, "
-                     "layer4 port %d", __FUNCTION__, __LINE__,
-                     key.controller_ip_addr, key.switch_ip_addr,
-                     key.controller_L4_port);
- 
-        status = atomic_add_upd_htbls_with_rwsocket(thr_msg->fd, NULL,
-                                                    tmgr,
-                                                    key, 
-                                                    layer4_proto,
-                                                    ofchann_key);
+        cc_del_sockfd_rw_pollthr(tmgr, thr_msg);
 
         g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
         g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
         g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
         
-        if (status < 0) {
-            CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, 
-                         cc_of_strerror(status));
-            /* Del fd from thr_mgr if update of global structures fails */
-            g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
-            g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
-            g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
-            
-            cc_del_sockfd_rw_pollthr(tmgr, thr_msg);
-
-            g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-            g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
-            g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
-            
-            return status;
-        }
-        /* add the fd to the thr */
-        CC_LOG_DEBUG("%s(%d): adding fd %d to thread %s",
-                     __FUNCTION__, __LINE__, thr_msg->fd,
-                     tmgr->tname);
-        CC_LOG_DEBUG("%s(%d): succesfully added fd %d to thread",
-                     __FUNCTION__, __LINE__, thr_msg->fd);
-        adp_thr_mgr_add_del_fd(tmgr, thr_msg);
+        return status;
     }
-    
+    /* add the fd to the thr */
+    CC_LOG_DEBUG("%s(%d): adding fd %d to thread %s",
+                 __FUNCTION__, __LINE__, thr_msg->fd,
+                 tmgr->tname);
+    CC_LOG_DEBUG("%s(%d): succesfully added fd %d to thread",
+                 __FUNCTION__, __LINE__, thr_msg->fd);
+    adp_thr_mgr_add_del_fd(tmgr, thr_msg);
+
     return status;
 }
@@ -0,0 +1,157 @@
+/*
+*****************************************************
+**      CodeChix ONF Driver (LibCCOF)
+**      codechix.org - May the code be with you...
+**              Sept. 15, 2013
+*****************************************************
+**
+** License:        Apache 2.0 (ONF requirement)
+** Version:        0.0
+** LibraryName:    LibCCOF
+** GLIB License:   GNU LGPL
+** Description:    poll() event backend for the poll thread
+** Assumptions:    N/A
+** Testing:        N/A
+** Authors:        Deepa Karnad Dhurka
+**
+*****************************************************
+*/
+
+#include "cc_pollthr_mgr.h"
+#include "cc_log.h"
+
+/* pollfd_arr is kept dense; owner_arr[i] is the fd entry for
+ * pollfd_arr[i] so a delete can move the last slot into the hole
+ */
+typedef struct poll_backend_data_ {
+    int              num_fds;
+    struct pollfd    *pollfd_arr;
+    adpoll_fd_info_t **owner_arr;
+} poll_backend_data_t;
+
+static int
+poll_backend_init(pollthr_private_t *thr_pvt_p)
+{
+    poll_backend_data_t *pdata;
+
+    pdata = (poll_backend_data_t *)malloc(sizeof(poll_backend_data_t));
+    if (pdata == NULL) {
+        return -1;
+    }
+    pdata->num_fds = 0;
+    pdata->pollfd_arr = (struct pollfd *)malloc(sizeof(struct pollfd) *
+                                                thr_pvt_p->max_pollfds);
+    pdata->owner_arr = (adpoll_fd_info_t **)
+        malloc(sizeof(adpoll_fd_info_t *) * thr_pvt_p->max_pollfds);
+
+    if ((pdata->pollfd_arr == NULL) || (pdata->owner_arr == NULL)) {
+        free(pdata->pollfd_arr);
+        free(pdata->owner_arr);
+        free(pdata);
+        return -1;
+    }
+    thr_pvt_p->backend_data = pdata;
+    return 0;
+}
+
+static void
+poll_backend_cleanup(pollthr_private_t *thr_pvt_p)
+{
+    poll_backend_data_t *pdata = thr_pvt_p->backend_data;
+
+    free(pdata->pollfd_arr);
+    free(pdata->owner_arr);
+    free(pdata);
+    thr_pvt_p->backend_data = NULL;
+}
+
+static int
+poll_backend_add_fd(pollthr_private_t *thr_pvt_p,
+                    adpoll_fd_info_t *fd_entry_p,
+                    short poll_events)
+{
+    poll_backend_data_t *pdata = thr_pvt_p->backend_data;
+    int idx = pdata->num_fds;
+
+    if (idx >= thr_pvt_p->max_pollfds) {
+        return -1;
+    }
+    pdata->pollfd_arr[idx].fd = fd_entry_p->fd;
+    pdata->pollfd_arr[idx].events = poll_events;
+    pdata->pollfd_arr[idx].revents = 0;
+    pdata->owner_arr[idx] = fd_entry_p;
+    pdata->num_fds++;
+
+    fd_entry_p->backend_idx = idx;
+    fd_entry_p->pollfd_entry_p = &pdata->pollfd_arr[idx];
+    return 0;
+}
+
+static int
+poll_backend_del_fd(pollthr_private_t *thr_pvt_p,
+                    adpoll_fd_info_t *fd_entry_p)
+{
+    poll_backend_data_t *pdata = thr_pvt_p->backend_data;
+    int idx = fd_entry_p->backend_idx;
+    int last = pdata->num_fds - 1;
+
+    if ((idx < 0) || (idx > last) || (pdata->owner_arr[idx] != fd_entry_p)) {
+        return -1;
+    }
+
+    /* the entry may still be looked at before it is freed */
+    fd_entry_p->pollfd_entry = pdata->pollfd_arr[idx];
+    fd_entry_p->pollfd_entry_p = &fd_entry_p->pollfd_entry;
+    fd_entry_p->backend_idx = -1;
+
+    if (idx != last) {
+        pdata->pollfd_arr[idx] = pdata->pollfd_arr[last];
+        pdata->owner_arr[idx] = pdata->owner_arr[last];
+        pdata->owner_arr[idx]->backend_idx = idx;
+        pdata->owner_arr[idx]->pollfd_entry_p = &pdata->pollfd_arr[idx];
+    }
+    pdata->num_fds--;
+    return 0;
+}
+
+static int
+poll_backend_mod_fd(pollthr_private_t *thr_pvt_p UNUSED,
+                    adpoll_fd_info_t *fd_entry_p UNUSED)
+{
+    /* events are edited in place in pollfd_arr */
+    return 0;
+}
+
+static int
+poll_backend_wait(pollthr_private_t *thr_pvt_p, int timeout)
+{
+    poll_backend_data_t *pdata = thr_pvt_p->backend_data;
+    int rv, i;
+
+    thr_pvt_p->num_ready = 0;
+
+    rv = poll(pdata->pollfd_arr, pdata->num_fds, timeout);
+    if (rv <= 0) {
+        return rv;
+    }
+
+    for (i = 0; (i < pdata->num_fds) && (thr_pvt_p->num_ready < rv); i++) {
+        if (pdata->pollfd_arr[i].revents) {
+            thr_pvt_p->ready_arr[thr_pvt_p->num_ready++] =
+                pdata->owner_arr[i];
+        }
+    }
+    return thr_pvt_p->num_ready;
+}
+
+adpoll_backend_ops_t adpoll_poll_fns = {
+    "poll",
+    poll_backend_init,
+    poll_backend_cleanup,
+    poll_backend_add_fd,
+    poll_backend_del_fd,
+    poll_backend_mod_fd,
+    poll_backend_wait,
+    NULL,
+    NULL,
+};
@@ -20,7 +20,9 @@
 #include "cc_pollthr_mgr.h"
 #include "cc_log.h"
 #include "cc_of_global.h"
+#include "cc_of_util.h"
 #include "errno.h"
+#include <sys/eventfd.h>
 
 #define FD_LIST_COUNT_LOG "%s(%d)[%s]: fd_list has %d entries "
 #define POLLFD_COUNT_LOG "%s(%d)[%s]: num pollfds is %d "
@@ -35,26 +37,207 @@ pollthr_data_pipe_process_func(char *tname,
                                adpoll_fd_info_t *data_p,
                                adpoll_send_msg_htbl_info_t *unused_data UNUSED);                               
 
+static void
+pollthr_send_ring_process_func(char *tname,
+                               adpoll_fd_info_t *data_p,
+                               adpoll_send_msg_htbl_info_t *unused_data UNUSED);
+
+static void
+pollthr_fd_add(pollthr_private_t *thr_pvt_p, char *tname,
+               adpoll_thr_msg_t *msg);
+
+static void
+pollthr_fd_del(pollthr_private_t *thr_pvt_p, char *tname,
+               adpoll_thr_msg_t *msg);
+
+static void
+pollthr_timers_run(pollthr_private_t *thr_pvt_p, char *tname);
+
+static void
+pollthr_timers_free(pollthr_private_t *thr_pvt_p);
+
+static adpoll_timer_wheel_t *
+adpoll_timer_wheel_new(int wake_fd);
+
+static void
+adpoll_timer_wheel_free(adpoll_timer_wheel_t *wheel);
+
 /* Utility functions */
-gint
-fdinfo_compare_fd(gconstpointer list_elem, gconstpointer compare_fd)
+static adpoll_backend_ops_t *
+adp_thr_mgr_backend_fns(adpoll_backend_e backend)
 {
-    adpoll_fd_info_t *list_elem_p = (adpoll_fd_info_t *)list_elem;
-    int fd = *(int *)compare_fd;
-    
-    if (list_elem_p->fd < fd) {
-        return -1;
-    } else if (list_elem_p->fd > fd) {
-        return 1;
-    } else {
-        return 0;
+    switch (backend) {
+      case ADPOLL_POLL:
+        return &adpoll_poll_fns;
+      case ADPOLL_IOURING:
+        return &adpoll_iouring_fns;
+      case ADPOLL_EPOLL:
+      default:
+        return &adpoll_epoll_fns;
     }
-    return 0;
 }
+
+/* backend to try when backend_fns cannot be initialized */
+static adpoll_backend_ops_t *
+adp_thr_mgr_backend_fallback(adpoll_backend_ops_t *backend_fns)
+{
+    if (backend_fns == &adpoll_iouring_fns) {
+        return &adpoll_epoll_fns;
+    } else if (backend_fns == &adpoll_epoll_fns) {
+        return &adpoll_poll_fns;
+    }
+    return NULL;
+}
+
+/* update the poll events of an fd owned by this poll thread */
+static void
+pollthr_fd_set_events(pollthr_private_t *thr_pvt_p,
+                      adpoll_fd_info_t *fd_entry_p,
+                      short poll_events)
+{
+    if (fd_entry_p->pollfd_entry_p->events == poll_events) {
+        return;
+    }
+    fd_entry_p->pollfd_entry_p->events = poll_events;
+    thr_pvt_p->backend->mod_fd(thr_pvt_p, fd_entry_p);
+}
+
+/* Send ring - see adpoll_send_ring_t */
+static adpoll_send_ring_t *
+adpoll_send_ring_new(void)
+{
+    adpoll_send_ring_t *ring = NULL;
+    guint i;
+
+    if (posix_memalign((void **)&ring, ADPOLL_CACHELINE,
+                       sizeof(adpoll_send_ring_t)) != 0) {
+        return NULL;
+    }
+    ring->slots = (adpoll_send_ring_slot_t *)
+        malloc(sizeof(adpoll_send_ring_slot_t) * ADPOLL_SEND_RING_SIZE);
+    ring->doorbell_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((ring->slots == NULL) || (ring->doorbell_fd == -1)) {
+        CC_LOG_ERROR("%s(%d): send ring setup failed: %s",
+                     __FUNCTION__, __LINE__, g_strerror(errno));
+        if (ring->doorbell_fd != -1) {
+            close(ring->doorbell_fd);
+        }
+        free(ring->slots);
+        free(ring);
+        return NULL;
+    }
+    ring->mask = ADPOLL_SEND_RING_SIZE - 1;
+    for (i = 0; i < ADPOLL_SEND_RING_SIZE; i++) {
+        ring->slots[i].seq = i;
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    ring->overflow = 0;
+    return ring;
+}
+
+/* any thread; publishes all num_msgs in consecutive slots or none,
+ * FALSE if there is not enough room
+ */
+static gboolean
+adpoll_send_ring_push_n(adpoll_send_ring_t *ring, adpoll_send_msg_t *msgs,
+                        guint num_msgs)
+{
+    adpoll_send_ring_slot_t *slot;
+    guint pos, i;
+    gint diff;
+
+    if ((num_msgs == 0) || (num_msgs > ring->mask + 1)) {
+        return FALSE;
+    }
+
+    /* slots are freed in order, so if the last one is free for this
+     * lap all of them are
+     */
+    pos = (guint)g_atomic_int_get(&ring->tail);
+    for ( ; ; ) {
+        slot = &ring->slots[(pos + num_msgs - 1) & ring->mask];
+        diff = (gint)((guint)g_atomic_int_get(&slot->seq) -
+                      (pos + num_msgs - 1));
+        if (diff == 0) {
+            if (g_atomic_int_compare_and_exchange(&ring->tail, (gint)pos,
+                                                  (gint)(pos + num_msgs))) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* slot still holds a message from the previous lap */
+            return FALSE;
+        }
+        pos = (guint)g_atomic_int_get(&ring->tail);
+    }
+    for (i = 0; i < num_msgs; i++) {
+        slot = &ring->slots[(pos + i) & ring->mask];
+        slot->msg = msgs[i];
+        g_atomic_int_set(&slot->seq, (gint)(pos + i + 1));
+    }
+
+    /* the consumer stores head before it looks at the next slot, so
+     * either it sees these messages or we see it waiting on one of them
+     */
+    if (((guint)g_atomic_int_get(&ring->head) - pos) < num_msgs) {
+        eventfd_write(ring->doorbell_fd, 1);
+    }
+    return TRUE;
+}
+
+/* any thread; FALSE if the ring is full */
+static gboolean
+adpoll_send_ring_push(adpoll_send_ring_t *ring, adpoll_send_msg_t *msg)
+{
+    return adpoll_send_ring_push_n(ring, msg, 1);
+}
+
+/* poll thread only; FALSE if the ring is empty */
+static gboolean
+adpoll_send_ring_pop(adpoll_send_ring_t *ring, adpoll_send_msg_t *msg)
+{
+    adpoll_send_ring_slot_t *slot;
+    guint pos;
+
+    pos = (guint)ring->head;
+    slot = &ring->slots[pos & ring->mask];
+    if ((gint)((guint)g_atomic_int_get(&slot->seq) - (pos + 1)) < 0) {
+        return FALSE;
+    }
+    *msg = slot->msg;
+    g_atomic_int_set(&slot->seq, (gint)(pos + ring->mask + 1));
+    g_atomic_int_set(&ring->head, (gint)(pos + 1));
+    return TRUE;
+}
+
+/* after the poll thread has exited */
+static void
+adpoll_send_ring_free(adpoll_send_ring_t *ring)
+{
+    adpoll_send_msg_t msg;
+
+    while (adpoll_send_ring_pop(ring, &msg)) {
+        adp_thr_mgr_msg_free(msg.msg_p);
+    }
+    close(ring->doorbell_fd);
+    free(ring->slots);
+    free(ring);
+}
+
 adpoll_thread_mgr_t *
 adp_thr_mgr_new(char *tname,
                 uint32_t max_sockets,
                 uint32_t max_pipes)
+{
+    return adp_thr_mgr_new_backend(tname, max_sockets, max_pipes,
+                                   cc_of_global.ofpoll_backend);
+}
+
+adpoll_thread_mgr_t *
+adp_thr_mgr_new_backend(char *tname,
+                        uint32_t max_sockets,
+                        uint32_t max_pipes,
+                        adpoll_backend_e backend)
 {
     int i = 0;
     adpoll_thread_mgr_t *this = NULL;
@@ -83,6 +266,11 @@ adp_thr_mgr_new(char *tname,
     this->max_pipes = max_pipes*2 + 4; /* 2fds per pipe; 4fds additional for internal use */
     this->num_pipes = 0;
     this->num_sockets = 0;
+    this->tx_drops = g_new0(adpoll_tx_drops_t, 1);
+    this->backend = backend;
+    if (this->backend >= MAX_ADPOLL_BACKEND) {
+        this->backend = ADPOLL_EPOLL;
+    }
 
     this->pipes_arr = (int *)malloc(sizeof(int) * 2 * this->max_pipes);
 
@@ -98,6 +286,14 @@ adp_thr_mgr_new(char *tname,
     }
     this->num_pipes += 2; /* pipe creates 2 fds */
 
+    this->send_ring = adpoll_send_ring_new();
+    if (this->send_ring == NULL) {
+        CC_LOG_FATAL("%s(%d): send ring creation failed",__FUNCTION__,
+                     __LINE__);
+    }
+    /* a timer armed from another thread rings the send ring doorbell */
+    this->timer_wheel = adpoll_timer_wheel_new(this->send_ring->doorbell_fd);
+
     CC_LOG_DEBUG(PIPEFD_CREATE_LOG "PRIMARY",
                  __FUNCTION__, __LINE__, tname,
                  this->pipes_arr[PRI_PIPE_RD_FD],
@@ -106,17 +302,22 @@ adp_thr_mgr_new(char *tname,
     strncpy(thread_user_data->tname, this->tname, tname_len);
     thread_user_data->max_pollfds = max_sockets + this->max_pipes;
     thread_user_data->primary_pipe_rd_fd = this->pipes_arr[PRI_PIPE_RD_FD];
+    thread_user_data->backend = this->backend;
+    thread_user_data->send_ring = this->send_ring;
 
     thread_user_data->mgr = this;
     CC_LOG_DEBUG("%s(%d): tname is %s", __FUNCTION__, __LINE__,
                  thread_user_data->tname);
+    /* hold the init mutex across thread creation so the init signal
+     * from thr_mgr_poll_thread_func cannot be lost
+     */
+    g_mutex_lock(this->adp_thr_init_cv_mutex);
+
     this->thread_p = g_thread_new(this->tname,
                             (GThreadFunc) adp_thr_mgr_poll_thread_func,
                             thread_user_data);
 
     /* synchronize with thr_mgr_poll_thread_func */
-    g_mutex_lock(this->adp_thr_init_cv_mutex);
-    
     g_cond_wait(this->adp_thr_init_cv_cond,
                 this->adp_thr_init_cv_mutex);
     g_mutex_unlock(this->adp_thr_init_cv_mutex);
@@ -130,6 +331,8 @@ adp_thr_mgr_new(char *tname,
     */
     add_datapipe_msg.pollin_func = &pollthr_data_pipe_process_func;
     add_datapipe_msg.pollout_func = NULL;
+    add_datapipe_msg.io_offload = FALSE;
+    add_datapipe_msg.connect_pending = FALSE;
 
     adp_thr_mgr_add_del_fd(this, &add_datapipe_msg);
     CC_LOG_DEBUG("%s(%d): new pipe added for data %d",
@@ -151,6 +354,8 @@ void adp_thr_mgr_free(adpoll_thread_mgr_t *this)
     destruct_msg.poll_events = 0;
     destruct_msg.pollin_func = NULL;
     destruct_msg.pollout_func = NULL;
+    destruct_msg.io_offload = FALSE;
+    destruct_msg.connect_pending = FALSE;
 
     adp_thr_mgr_add_del_fd(this, &destruct_msg);
     
@@ -163,11 +368,67 @@ void adp_thr_mgr_free(adpoll_thread_mgr_t *this)
     
     free(this->pipes_arr);
 
+    /* messages still in the ring are freed with it */
+    adpoll_send_ring_free(this->send_ring);
+    this->send_ring = NULL;
+
+    /* its timers were freed as the thread exited */
+    adpoll_timer_wheel_free(this->timer_wheel);
+    this->timer_wheel = NULL;
+
     g_cond_clear(this->adp_thr_init_cv_cond);
     g_mutex_clear(this->adp_thr_init_cv_mutex);
     
     g_cond_clear(this->add_del_pipe_cv_cond);
     g_mutex_clear(this->add_del_pipe_cv_mutex);    
+
+    g_free(this->tx_drops);
+    this->tx_drops = NULL;
+}
+
+/* take one of this thread's max_sockets, FALSE if all are in use.
+ * num_sockets changes on the poll thread and on app threads alike
+ */
+static gboolean
+adp_thr_mgr_sock_reserve(adpoll_thread_mgr_t *this)
+{
+    gint num;
+
+    do {
+        num = g_atomic_int_get(&this->num_sockets);
+        if ((uint32_t)num >= this->max_sockets) {
+            return FALSE;
+        }
+    } while (!g_atomic_int_compare_and_exchange(&this->num_sockets,
+                                                num, num + 1));
+    return TRUE;
+}
+
+/* adp_thr_mgr_add_del_fd of a socket, on the poll thread itself */
+static int
+adp_thr_mgr_add_del_fd_self(adpoll_thread_mgr_t *this,
+                            adpoll_thr_msg_t    *msg)
+{
+    pollthr_private_t *thr_pvt_p = g_private_get(&tname_key);
+
+    if (msg->fd_action == ADD_FD) {
+        CC_LOG_DEBUG("%s(%d)[%s]: socket %d ADD in thread",
+                     __FUNCTION__, __LINE__, this->tname, msg->fd);
+
+        if (!adp_thr_mgr_sock_reserve(this)) {
+            CC_LOG_ERROR("%s(%d)[%s]: unable to add more sockets - "
+                         "max out", __FUNCTION__, __LINE__, this->tname);
+            return -1;
+        }
+        pollthr_fd_add(thr_pvt_p, this->tname, msg);
+        return msg->fd;
+    }
+
+    CC_LOG_DEBUG("%s(%d)[%s]: socket %d DELETE in thread",
+                 __FUNCTION__, __LINE__, this->tname, msg->fd);
+    pollthr_fd_del(thr_pvt_p, this->tname, msg);
+    g_atomic_int_add(&this->num_sockets, -1);
+    return -1;
 }
 
 /* Function: adp_thr_mgr_add_del_fd
@@ -294,16 +555,22 @@ adp_thr_mgr_add_del_fd(adpoll_thread_mgr_t *this,
             }
         }
     } else if (msg->fd_type == SOCKET) {
+        /* from one of this thread's own callbacks, e.g. a listenfd it
+         * serves accepting a socket onto it: done in place, as waiting
+         * for the primary pipe to be read would never return
+         */
+        if (g_thread_self() == this->thread_p) {
+            return (adp_thr_mgr_add_del_fd_self(this, msg));
+        }
         if (msg->fd_action == ADD_FD) {
             CC_LOG_DEBUG("%s(%d)[%s]: socket %d ADD",
                          __FUNCTION__, __LINE__, this->tname, msg->fd);
 
-            if (this->num_sockets == this->max_sockets) {
+            if (!adp_thr_mgr_sock_reserve(this)) {
                 CC_LOG_ERROR("%s(%d)[%s]: unable to add more sockets - "
                              "max out", __FUNCTION__, __LINE__, this->tname);
                 return retval;
             }
-            this->num_sockets += 1;
             
             g_mutex_lock((this->add_del_pipe_cv_mutex));
             
@@ -344,7 +611,7 @@ adp_thr_mgr_add_del_fd(adpoll_thread_mgr_t *this,
             
             this->num_pipes -= 2;
         } else {
-            (this->num_sockets)--;
+            g_atomic_int_add(&this->num_sockets, -1);
         }
     }
     return retval;
@@ -354,19 +621,61 @@ adp_thr_mgr_add_del_fd(adpoll_thread_mgr_t *this,
 void
 fd_entry_free(adpoll_fd_info_t *data)
 {
+    if (data->user_ctx && data->user_ctx_free) {
+        data->user_ctx_free(data->user_ctx);
+    }
+    g_queue_free_full(data->send_q, (GDestroyNotify)adp_thr_mgr_msg_free);
     free(data);
 }
 
+static void
+fd_entry_htbl_free(gpointer key UNUSED, adpoll_fd_info_t *data,
+                   gpointer user_data UNUSED)
+{
+    fd_entry_free(data);
+}
+
 static void
 poll_fd_process(adpoll_fd_info_t *data_p,
                 char *tname)
 {
     pollthr_private_t *thr_pvt_p = NULL;
-    int send_msg_key_fd;
     adpoll_send_msg_htbl_info_t *send_msg_info;    
+    uint sent_before, popped, event_bytes, max_bytes;
     
     thr_pvt_p = g_private_get(&tname_key);
 
+    /* deleted by an earlier callback in this dispatch */
+    if (data_p->deleted) {
+        return;
+    }
+
+    /* nothing but the connect completion until the socket is connected;
+     * a failed connect is reported as POLLERR/POLLHUP
+     */
+    if (data_p->connect_pending) {
+        if ((data_p->pollfd_entry_p == NULL) ||
+            !(data_p->pollfd_entry_p->revents &
+              (POLLOUT | POLLERR | POLLHUP))) {
+            return;
+        }
+        CC_LOG_DEBUG("%s(%d)[%s]: connect completed on fd %d",
+                     __FUNCTION__, __LINE__, tname, data_p->fd);
+        data_p->connect_pending = FALSE;
+        if (data_p->pollout_func) {
+            data_p->pollout_func(tname, data_p, NULL);
+            thr_pvt_p = g_private_get(&tname_key);
+        }
+        if (data_p->deleted) {
+            return;
+        }
+        /* messages sent while connecting go out below */
+        if (g_queue_is_empty(data_p->send_q)) {
+            pollthr_fd_set_events(thr_pvt_p, data_p,
+                                  data_p->pollfd_entry_p->events & ~POLLOUT);
+        }
+    }
+
     if ((data_p->pollfd_entry_p) &&
         ((data_p->pollfd_entry_p->revents & POLLIN) &
          (data_p->pollfd_entry_p->events & POLLIN)))
@@ -385,57 +694,79 @@ poll_fd_process(adpoll_fd_info_t *data_p,
         CC_LOG_DEBUG("%s(%d)[%s]: POLLOUT on fd %d",
                      __FUNCTION__, __LINE__, tname,
                      data_p->pollfd_entry_p->fd);
-        
-        /* lookup hash table entry for this socket fd*/
-        send_msg_key_fd = data_p->pollfd_entry_p->fd;
 
-        g_mutex_lock(&thr_pvt_p->send_msg_htbl_lock);
-        
-        CC_LOG_DEBUG("%s(%d)[%s]: fd key looked up in hash table: %d",
-                     __FUNCTION__, __LINE__, tname,
-                     send_msg_key_fd);
+        if (data_p->deleted) {
+            return;
+        }
 
-        if(!g_hash_table_contains(thr_pvt_p->send_msg_htbl,
-                                  GINT_TO_POINTER (send_msg_key_fd))) {
-            CC_LOG_ERROR("%s(%d)[%s]: hash table does not have fd %d; "
-                         "hash table size is %d", __FUNCTION__, __LINE__,
-                         tname, send_msg_key_fd,
-                         g_hash_table_size(thr_pvt_p->send_msg_htbl));
+        if (data_p->pollout_func == NULL) {
+            CC_LOG_ERROR("%s(%d)[%s]: No pollout function defined - "
+                         "dropping %u messages", __FUNCTION__, __LINE__,
+                         tname, g_queue_get_length(data_p->send_q));
+            while (!g_queue_is_empty(data_p->send_q)) {
+                adp_thr_mgr_msg_free(g_queue_pop_head(data_p->send_q));
+            }
         }
-        
-        send_msg_info = g_hash_table_lookup(
-            thr_pvt_p->send_msg_htbl,
-            GINT_TO_POINTER (send_msg_key_fd));
 
-        g_assert(send_msg_info != NULL);
-        g_private_replace(&tname_key,
-                          (gpointer)thr_pvt_p);
-        
-        if (data_p->pollout_func) {
+        /* drain the send queue in order until the socket is full or
+         * the byte budget of this POLLOUT is used up
+         */
+        max_bytes = cc_of_global.ofsend_max_bytes ?
+            cc_of_global.ofsend_max_bytes : CC_OF_SEND_MAX_BYTES;
+        event_bytes = 0;
+        while ((send_msg_info = g_queue_peek_head(data_p->send_q)) != NULL) {
+            sent_before = send_msg_info->data_off;
+
+            g_private_replace(&tname_key,
+                              (gpointer)thr_pvt_p);
             data_p->pollout_func(tname, data_p, send_msg_info);
-        } else {
-            CC_LOG_ERROR("%s(%d)[%s]: No pollout function defined",
-                         __FUNCTION__, __LINE__, tname);
-        }
-        
-        thr_pvt_p = g_private_get(&tname_key);        
-        
-        if (!g_hash_table_remove(thr_pvt_p->send_msg_htbl,
-                                 GINT_TO_POINTER (send_msg_key_fd))) {
-            CC_LOG_ERROR("%s(%d)[%s]: htbl delete failed for fd %d",
-                         __FUNCTION__, __LINE__, tname, send_msg_key_fd);
+            thr_pvt_p = g_private_get(&tname_key);
+            data_p->tx_syscalls++;
+
+            /* the callback closed the fd; its queue is freed with it */
+            if (data_p->deleted) {
+                break;
+            }
+
+            /* the callback may have flushed several queued messages */
+            popped = 0;
+            while (((send_msg_info = g_queue_peek_head(data_p->send_q))
+                    != NULL) &&
+                   (send_msg_info->data_off >= send_msg_info->data_size)) {
+                event_bytes += send_msg_info->data_size;
+                adp_thr_mgr_msg_free(g_queue_pop_head(data_p->send_q));
+                popped++;
+            }
+            data_p->tx_msgs += popped;
+
+            if (send_msg_info == NULL) {
+                break;
+            }
+            if ((popped == 0) || (send_msg_info->data_off > 0)) {
+                /* short write or EAGAIN: resume at data_off on the
+                 * next POLLOUT
+                 */
+                CC_LOG_DEBUG("%s(%d)[%s]: fd %d sent %u bytes of the "
+                             "head message, %u messages queued",
+                             __FUNCTION__, __LINE__, tname, data_p->fd,
+                             send_msg_info->data_off -
+                             ((popped == 0) ? sent_before : 0),
+                             g_queue_get_length(data_p->send_q));
+                break;
+            }
+            if (event_bytes >= max_bytes) {
+                break;
+            }
         }
 
         /* if this is the last of the messages for this fd,
          *  reset pollout flag */
-        if(!g_hash_table_contains(thr_pvt_p->send_msg_htbl,
-                                  GINT_TO_POINTER (send_msg_key_fd))) {
-            
+        if (!data_p->deleted && g_queue_is_empty(data_p->send_q)) {
             CC_LOG_DEBUG("%s(%d)[%s]: Resetting POLLOUT flag for fd %d",
-                         __FUNCTION__, __LINE__, tname, send_msg_key_fd);
-            data_p->pollfd_entry_p->events &= ~POLLOUT;
+                         __FUNCTION__, __LINE__, tname, data_p->fd);
+            pollthr_fd_set_events(thr_pvt_p, data_p,
+                                  data_p->pollfd_entry_p->events & ~POLLOUT);
         }
-        g_mutex_unlock(&thr_pvt_p->send_msg_htbl_lock);
     }
     
     g_private_replace(&tname_key,
@@ -443,11 +774,14 @@ poll_fd_process(adpoll_fd_info_t *data_p,
 }
 
 static void
-print_fd_list(adpoll_fd_info_t *data_p)
+print_fd_list(gpointer key UNUSED, adpoll_fd_info_t *data_p,
+              gpointer user_data UNUSED)
 {
-    CC_LOG_DEBUG("fd: %d\tfd_type: %d\tpollin_func: %p\tpollout_func: %p \tevents: %x",
+    CC_LOG_DEBUG("fd: %d\tfd_type: %d\tpollin_func: %p\tpollout_func: %p \tevents: %x\tsend_q: %u\ttx msgs/syscalls: %lu/%lu",
                 data_p->fd, data_p->fd_type, data_p->pollin_func,
-                data_p->pollout_func, data_p->pollfd_entry_p->events);
+                data_p->pollout_func, data_p->pollfd_entry_p->events,
+                g_queue_get_length(data_p->send_q),
+                data_p->tx_msgs, data_p->tx_syscalls);
 }
 
 
@@ -456,17 +790,190 @@ print_fd_list(adpoll_fd_info_t *data_p)
  * Callback function to process a pipe read
  * This function is of type fd_process_func
  */
+/* add the fd of msg to this thread's fd_htbl and backend
+ * called on the poll thread
+ */
+static void
+pollthr_fd_add(pollthr_private_t *thr_pvt_p, char *tname,
+               adpoll_thr_msg_t *msg)
+{
+    adpoll_fd_info_t *fd_entry_p; /* add this entry to fd_htbl */
+
+    CC_LOG_DEBUG("%s(%d)[%s]: fd ADD %d of type %d of action %d",
+                 __FUNCTION__, __LINE__, tname, msg->fd,
+                 msg->fd_type, msg->fd_action);
+
+    /* check for existing entry */
+    g_assert(g_hash_table_lookup(thr_pvt_p->fd_htbl,
+                                 GINT_TO_POINTER(msg->fd)) == NULL);
+          
+    fd_entry_p = (adpoll_fd_info_t *)malloc(sizeof(adpoll_fd_info_t));
+    fd_entry_p->fd = msg->fd;
+    fd_entry_p->fd_type = msg->fd_type;
+            
+    fd_entry_p->pollin_func = msg->pollin_func;
+        
+    fd_entry_p->pollout_func = msg->pollout_func;
+    fd_entry_p->deleted = FALSE;
+    fd_entry_p->connect_pending = (msg->connect_pending == TRUE) &&
+        (msg->fd_type == SOCKET);
+    /* an offloaded fd gets POLLOUT without polling - not usable to wait
+     * for a connect
+     */
+    fd_entry_p->io_offload = (msg->io_offload == TRUE) &&
+        (thr_pvt_p->backend->recv != NULL) && !fd_entry_p->connect_pending;
+    fd_entry_p->backend_priv = NULL;
+    fd_entry_p->send_q = g_queue_new();
+    fd_entry_p->tx_syscalls = 0;
+    fd_entry_p->tx_msgs = 0;
+    fd_entry_p->user_ctx = NULL;
+    fd_entry_p->user_ctx_free = NULL;
+
+    /* remove POLLOUT until message is buffered to send out, or keep it
+     * to learn when the connect completes
+     */
+    if (thr_pvt_p->backend->add_fd(thr_pvt_p, fd_entry_p,
+                                   fd_entry_p->connect_pending ?
+                                   (msg->poll_events | POLLOUT) :
+                                   (msg->poll_events & ~(POLLOUT))) < 0) {
+        CC_LOG_ERROR("%s(%d)[%s]: %s backend could not add fd %d",
+                     __FUNCTION__, __LINE__, tname,
+                     thr_pvt_p->backend->name, msg->fd);
+        g_queue_free(fd_entry_p->send_q);
+        free(fd_entry_p);
+        return;
+    }
+
+    if (msg->pollin_func == &pollthr_data_pipe_process_func) {
+        thr_pvt_p->data_pipe_rd_fd = msg->fd;
+    }
+
+    thr_pvt_p->num_pollfds += 1;
+
+    CC_LOG_DEBUG(POLLFD_COUNT_LOG "after ADD_FD",
+                 __FUNCTION__, __LINE__, tname,
+                 thr_pvt_p->num_pollfds);
+          
+    g_hash_table_insert(thr_pvt_p->fd_htbl,
+                        GINT_TO_POINTER(msg->fd), fd_entry_p);
+
+    if(cc_of_global.ofut_enable) {
+        CC_LOG_DEBUG(FD_LIST_COUNT_LOG "ADD_FD", __FUNCTION__, __LINE__,
+                     tname, g_hash_table_size(thr_pvt_p->fd_htbl));
+    }
+}
+
+/* remove the fd of msg from this thread; the entry is freed after the
+ * current dispatch as it may be in the ready list
+ * called on the poll thread
+ */
+/* a socket is being deleted with messages still queued: what goes
+ * without blocking is sent, the rest dropped and counted. Stream
+ * sockets only - where a datagram goes only its pollout callback
+ * knows. An io_offload socket sends through its backend, behind what
+ * that has buffered.
+ */
+static void
+pollthr_fd_flush(pollthr_private_t *thr_pvt_p, char *tname,
+                 adpoll_fd_info_t *fd_entry_p)
+{
+    adpoll_send_msg_htbl_info_t *msg_p;
+    gboolean stream = FALSE;
+    int so_type;
+    socklen_t so_len = sizeof(so_type);
+    ssize_t sent;
+    uint32_t msgs = 0, bytes = 0;
+
+    if (g_queue_is_empty(fd_entry_p->send_q)) {
+        return;
+    }
+    if ((fd_entry_p->fd_type == SOCKET) && !fd_entry_p->connect_pending &&
+        (getsockopt(fd_entry_p->fd, SOL_SOCKET, SO_TYPE,
+                    &so_type, &so_len) == 0)) {
+        stream = (so_type == SOCK_STREAM);
+    }
+
+    while ((msg_p = g_queue_pop_head(fd_entry_p->send_q)) != NULL) {
+        while (stream && (msg_p->data_off < msg_p->data_size)) {
+            if (fd_entry_p->io_offload && thr_pvt_p->backend->send) {
+                sent = thr_pvt_p->backend->send(
+                    thr_pvt_p, fd_entry_p, msg_p->data + msg_p->data_off,
+                    msg_p->data_size - msg_p->data_off);
+            } else {
+                sent = send(fd_entry_p->fd, msg_p->data + msg_p->data_off,
+                            msg_p->data_size - msg_p->data_off,
+                            MSG_DONTWAIT | MSG_NOSIGNAL);
+            }
+            if ((sent < 0) && (errno == EINTR)) {
+                continue;
+            }
+            if (sent <= 0) {
+                /* nothing goes after a message that did not */
+                stream = FALSE;
+                break;
+            }
+            msg_p->data_off += sent;
+        }
+        if (msg_p->data_off < msg_p->data_size) {
+            msgs++;
+            bytes += msg_p->data_size - msg_p->data_off;
+        } else {
+            fd_entry_p->tx_msgs++;
+        }
+        adp_thr_mgr_msg_free(msg_p);
+    }
+
+    if (msgs) {
+        CC_LOG_DEBUG("%s(%d)[%s]: fd %d deleted - dropping %u messages, "
+                     "%u bytes unsent", __FUNCTION__, __LINE__, tname,
+                     fd_entry_p->fd, msgs, bytes);
+        pollthr_tx_drop(thr_pvt_p, msgs, bytes);
+    }
+}
+
+static void
+pollthr_fd_del(pollthr_private_t *thr_pvt_p, char *tname,
+               adpoll_thr_msg_t *msg)
+{
+    adpoll_fd_info_t *fd_entry_p;
+
+    fd_entry_p = g_hash_table_lookup(thr_pvt_p->fd_htbl,
+                                     GINT_TO_POINTER(msg->fd));
+    if (fd_entry_p == NULL) {
+        CC_LOG_ERROR("%s(%d)[%s]: NOT found fd in fd_htbl",
+                     __FUNCTION__, __LINE__, tname);
+        return;
+    }
+
+    CC_LOG_DEBUG("%s(%d)[%s]: found fd in fd_htbl",
+                 __FUNCTION__, __LINE__, tname);
+
+    pollthr_fd_flush(thr_pvt_p, tname, fd_entry_p);
+    thr_pvt_p->backend->del_fd(thr_pvt_p, fd_entry_p);
+    g_hash_table_remove(thr_pvt_p->fd_htbl, GINT_TO_POINTER(msg->fd));
+    thr_pvt_p->num_pollfds--;
+
+    /* the entry may be in the ready list being dispatched */
+    fd_entry_p->deleted = TRUE;
+    thr_pvt_p->fd_free_list = g_list_prepend(thr_pvt_p->fd_free_list,
+                                             fd_entry_p);
+                  
+    CC_LOG_DEBUG(POLLFD_COUNT_LOG "after DELETE_FD",
+                 __FUNCTION__, __LINE__, tname,
+                 thr_pvt_p->num_pollfds);
+
+    if(cc_of_global.ofut_enable) {
+        CC_LOG_DEBUG(FD_LIST_COUNT_LOG "DELETE_FD", __FUNCTION__, __LINE__,
+                     tname, g_hash_table_size(thr_pvt_p->fd_htbl));
+    }
+}
+
 static void
 pollthr_pri_pipe_process_func(char *tname,
                               adpoll_fd_info_t *data_p,
                               adpoll_send_msg_htbl_info_t *unused_data UNUSED)
 {
     adpoll_thr_msg_t msg;
-    adpoll_fd_info_t *fd_entry_p; /* append this entry to fd_list */
-    int i;
-    struct pollfd *pollfd_entry_p;
-    GList *traverse = NULL;
-    
     pollthr_private_t *thr_pvt_p = NULL;
     
     thr_pvt_p = g_private_get(&tname_key);
@@ -483,62 +990,15 @@ pollthr_pri_pipe_process_func(char *tname,
 
     switch (msg.fd_action) {
       case ADD_FD:
-      {
-
-          CC_LOG_DEBUG("%s(%d)[%s]: fd ADD %d of type %d of action %d",
-                       __FUNCTION__, __LINE__, tname, msg.fd,
-                       msg.fd_type, msg.fd_action);
-
-          /* check for existing entry */
-          g_assert(g_list_find_custom(
-                       thr_pvt_p->fd_list,
-                       &msg.fd,
-                       fdinfo_compare_fd) == NULL);
-          
-          fd_entry_p = (adpoll_fd_info_t *)malloc(sizeof(adpoll_fd_info_t));
-          fd_entry_p->fd = msg.fd;
-          fd_entry_p->fd_type = msg.fd_type;
-            
-          fd_entry_p->pollin_func = msg.pollin_func;
-        
-          fd_entry_p->pollout_func = msg.pollout_func;
-
-          /* access and modify the polling thread's pollfd array */
-          /* add a corresponding pollfd entry */
-          pollfd_entry_p = &(thr_pvt_p->pollfd_arr[thr_pvt_p->num_pollfds]);
-
-          thr_pvt_p->num_pollfds += 1;
-
-          CC_LOG_DEBUG(POLLFD_COUNT_LOG "after ADD_FD",
-                       __FUNCTION__, __LINE__, tname,
-                       thr_pvt_p->num_pollfds);
-          
-          pollfd_entry_p->fd = msg.fd;
-          pollfd_entry_p->events = msg.poll_events;
-
-          /* remove POLLOUT until message is buffered to send out */
-          pollfd_entry_p->events &= ~(POLLOUT);
-
-          fd_entry_p->pollfd_entry_p = pollfd_entry_p;
-          
-          thr_pvt_p->fd_list = g_list_append(thr_pvt_p->fd_list, fd_entry_p);
-
-          if(cc_of_global.ofut_enable) {
-              CC_LOG_DEBUG(FD_LIST_COUNT_LOG "ADD_FD", __FUNCTION__, __LINE__,
-                           tname, g_list_length(thr_pvt_p->fd_list));
-          }
-          
-      }
-      break;      
+          pollthr_fd_add(thr_pvt_p, tname, &msg);
+          break;
       case DELETE_FD:
       {
-          gboolean found = FALSE;
-          int del_index;
           CC_LOG_DEBUG("%s(%d)[%s]: fd DELETE", __FUNCTION__, __LINE__,
                        tname);
           
-          if ((msg.fd == thr_pvt_p->pollfd_arr[0].fd) ||
-              (msg.fd == thr_pvt_p->pollfd_arr[1].fd)) {
+          if ((msg.fd == thr_pvt_p->pri_pipe_rd_fd) ||
+              (msg.fd == thr_pvt_p->data_pipe_rd_fd)) {
               CC_LOG_DEBUG("%s(%d)[%s]: Received DEL on primary pipe FD "
                            "or data pipe FD - SELF DESTRUCT",
                            __FUNCTION__, __LINE__, tname);
@@ -548,66 +1008,8 @@ pollthr_pri_pipe_process_func(char *tname,
               g_private_replace(&tname_key,
                                 (gpointer)thr_pvt_p);
               return;
-          } else {
-              
-              /* find and delete the pollfd entry */              
-              for (i = 1; i < thr_pvt_p->num_pollfds; i++) {
-                  if (msg.fd == thr_pvt_p->pollfd_arr[i].fd) {
-                      del_index = i;
-                      found = TRUE;
-                      break;
-                  }
-              }
-              if (found == TRUE) {
-                  CC_LOG_DEBUG("%s(%d)[%s]: found fd in pollfd_arr",
-                               __FUNCTION__, __LINE__, tname);
-                  
-                  for (i = del_index + 1 ; i< thr_pvt_p->num_pollfds; i++) {
-                      thr_pvt_p->pollfd_arr[i-1].fd =
-                          thr_pvt_p->pollfd_arr[i].fd;
-                      
-                      thr_pvt_p->pollfd_arr[i-1].events =
-                          thr_pvt_p->pollfd_arr[i].events;
-                      
-                      thr_pvt_p->pollfd_arr[i-1].revents =
-                          thr_pvt_p->pollfd_arr[i].revents;
-                  }
-                  thr_pvt_p->num_pollfds--;
-                  
-                  CC_LOG_DEBUG(POLLFD_COUNT_LOG "after DELETE_FD",
-                               __FUNCTION__, __LINE__, tname,
-                               thr_pvt_p->num_pollfds);
-                  
-                  /* find and delete the list entry for this pipe fd */
-                  traverse = g_list_first(thr_pvt_p->fd_list);
-                  fd_entry_p = NULL;
-                  
-                  while (traverse != NULL) {
-                      if (((adpoll_fd_info_t *)(traverse->data))->fd == msg.fd) {
-                          fd_entry_p = (adpoll_fd_info_t *)(traverse->data);
-                          break;
-                      }
-                      traverse = g_list_next(traverse);
-                  }
-                  
-                  if (fd_entry_p) {
-                      thr_pvt_p->fd_list = g_list_remove(thr_pvt_p->fd_list,
-                                                         (gconstpointer) fd_entry_p);
-                  } else {
-                      
-                      CC_LOG_ERROR("%s(%d)[%s]: inconsistent database "
-                                   "- pollfd found but fd entry not in list",
-                                   __FUNCTION__, __LINE__, tname);
-                  }
-                  if(cc_of_global.ofut_enable) {
-                      CC_LOG_DEBUG(FD_LIST_COUNT_LOG "DELETE_FD", __FUNCTION__, __LINE__,
-                                   tname, g_list_length(thr_pvt_p->fd_list));
-                  }
-              } else {
-                  CC_LOG_ERROR("%s(%d)[%s]: NOT found fd in pollfd_arr",
-                               __FUNCTION__, __LINE__, tname);
-              }
           }
+          pollthr_fd_del(thr_pvt_p, tname, &msg);
       }
       break;
       default:
@@ -623,91 +1025,387 @@ pollthr_pri_pipe_process_func(char *tname,
     g_mutex_unlock((thr_pvt_p->add_del_pipe_cv_mutex));
 }
 
+/* queue msg_p on the send queue of fd; called on the poll thread */
 static void
-pollthr_data_pipe_process_func(char *tname,
-                               adpoll_fd_info_t *data_p,
-                               adpoll_send_msg_htbl_info_t *unused_data UNUSED)
+pollthr_queue_send_msg(pollthr_private_t *thr_pvt_p, char *tname,
+                       int fd, adpoll_send_msg_htbl_info_t *msg_p)
 {
-    char msg_buf[SEND_MSG_BUF_SIZE];
-    adpoll_send_msg_t *msg_p;
-    struct pollfd *pollfd_entry_p;
-    int send_msg_key_fd;
-    adpoll_send_msg_htbl_info_t *send_msg_info;
-    GList *rdfd_info_list = NULL;
     adpoll_fd_info_t *rdfd_info;
-    int data_size;
 
-    pollthr_private_t *thr_pvt_p = NULL;    
-    thr_pvt_p = g_private_get(&tname_key);
-    
-    read(data_p->fd, msg_buf, SEND_MSG_BUF_SIZE);
-    msg_p = (adpoll_send_msg_t *)msg_buf;
-    
     CC_LOG_DEBUG("%s(%d)[%s]: message received: size: %u, fd : %d",
-                 __FUNCTION__, __LINE__, tname,
-                 msg_p->hdr.msg_size, msg_p->hdr.fd);
-
-    send_msg_key_fd = msg_p->hdr.fd;
-    data_size = msg_p->hdr.msg_size - sizeof(adpoll_send_msg_hdr_t);
-
-    send_msg_info = malloc(sizeof(adpoll_send_msg_htbl_info_t) + data_size);
-    send_msg_info->data_size = data_size;
-    g_memmove(send_msg_info->data, msg_p->data, data_size);
-
-    /* add message to htbl */
-    g_mutex_lock(&thr_pvt_p->send_msg_htbl_lock);
-
-    g_hash_table_insert(thr_pvt_p->send_msg_htbl,
-                        GINT_TO_POINTER(send_msg_key_fd),
-                        (gpointer)send_msg_info);
-    
-    /* update POLLOUT flag on pollfd entry so it can be sent out */
-    /* find the pollfd_entry_p of the send_msg_key->fd descriptor */
-    /* data_p->pollfd_entry_p is that of the data pipe!! */
-    rdfd_info_list =  g_list_find_custom(
-        thr_pvt_p->fd_list,
-        &send_msg_key_fd,
-        fdinfo_compare_fd);
-
-    g_assert(rdfd_info_list != NULL);
-    
-    rdfd_info = g_list_nth_data (rdfd_info_list, 0);
-
-    g_assert(rdfd_info != NULL);
-    
-    pollfd_entry_p = rdfd_info->pollfd_entry_p;
+                 __FUNCTION__, __LINE__, tname, msg_p->data_size, fd);
+
+    /* find the fd entry of the destination descriptor */
+    rdfd_info = g_hash_table_lookup(thr_pvt_p->fd_htbl,
+                                    GINT_TO_POINTER(fd));
+    if ((rdfd_info == NULL) || (rdfd_info->deleted)) {
+        CC_LOG_ERROR("%s(%d)[%s]: fd %d not polled by this thread - "
+                     "dropping message", __FUNCTION__, __LINE__, tname, fd);
+        pollthr_tx_drop(thr_pvt_p, 1, msg_p->data_size);
+        adp_thr_mgr_msg_free(msg_p);
+        return;
+    }
 
-    g_assert(pollfd_entry_p != NULL);
-    
-    pollfd_entry_p->events |= POLLOUT;
+    /* the socket it was addressed to was closed and the fd reused */
+    if (msg_p->fd_gen && (msg_p->fd_gen != cc_ofrw_get_gen(fd))) {
+        CC_LOG_DEBUG("%s(%d)[%s]: fd %d was replaced - dropping message "
+                     "to %lu/%u", __FUNCTION__, __LINE__, tname, fd,
+                     msg_p->dp_id, msg_p->aux_id);
+        pollthr_tx_drop(thr_pvt_p, 1, msg_p->data_size);
+        adp_thr_mgr_msg_free(msg_p);
+        return;
+    }
 
-    g_mutex_unlock(&thr_pvt_p->send_msg_htbl_lock);
+    /* queue behind any message not yet sent on this fd */
+    g_queue_push_tail(rdfd_info->send_q, msg_p);
     
-    g_private_replace(&tname_key,
-                      (gpointer)thr_pvt_p);
+    /* update POLLOUT flag so it can be sent out */
+    pollthr_fd_set_events(thr_pvt_p, rdfd_info,
+                          rdfd_info->pollfd_entry_p->events | POLLOUT);
 }
 
-void func_destroy_key(gpointer data UNUSED)
+/* move everything published in the send ring to the send queues */
+static void
+pollthr_send_ring_drain(pollthr_private_t *thr_pvt_p, char *tname)
 {
-    /* noop since we are using GINT_TO_POINTER */
-    return;
+    adpoll_send_msg_t msg;
+    int num_msgs = 0;
+
+    while (adpoll_send_ring_pop(thr_pvt_p->send_ring, &msg)) {
+        pollthr_queue_send_msg(thr_pvt_p, tname, msg.fd, msg.msg_p);
+        if (++num_msgs == ADPOLL_SEND_RING_SIZE) {
+            /* producers keep up with us - come back after the sockets */
+            eventfd_write(thr_pvt_p->send_ring->doorbell_fd, 1);
+            break;
+        }
+    }
 }
 
-void func_destroy_val(gpointer data)
+static void
+pollthr_send_ring_process_func(char *tname,
+                               adpoll_fd_info_t *data_p,
+                               adpoll_send_msg_htbl_info_t *unused_data UNUSED)
 {
-    /* freeing of 'data' is sufficient to free the entire node */
-    free(data);
+    eventfd_t count;
+    pollthr_private_t *thr_pvt_p = NULL;    
+    thr_pvt_p = g_private_get(&tname_key);
+
+    /* clear the doorbell before draining, a ring after the last
+     * empty check must wake us up again
+     */
+    eventfd_read(data_p->fd, &count);
+    pollthr_send_ring_drain(thr_pvt_p, tname);
+
+    g_private_replace(&tname_key,
+                      (gpointer)thr_pvt_p);
 }
 
+/* max send message records taken off the data pipe per read */
+#define DATA_PIPE_READ_BATCH 64
 
-/*
- * Function: adp_thr_mgr_poll_thread_func
+static void
+pollthr_data_pipe_process_func(char *tname,
+                               adpoll_fd_info_t *data_p,
+                               adpoll_send_msg_htbl_info_t *unused_data UNUSED)
+{
+    adpoll_send_msg_t pipe_msg_arr[DATA_PIPE_READ_BATCH];
+    ssize_t rv;
+    int num_msgs, i;
+
+    pollthr_private_t *thr_pvt_p = NULL;    
+    thr_pvt_p = g_private_get(&tname_key);
+    
+    /* writers send whole records of less than PIPE_BUF, so a read
+     * only ever returns whole records
+     */
+    rv = read(data_p->fd, pipe_msg_arr, sizeof(pipe_msg_arr));
+    if (rv <= 0) {
+        if ((rv == -1) && (errno != EINTR) && (errno != EAGAIN)) {
+            CC_LOG_ERROR("%s(%d)[%s]: data pipe read failed: %s",
+                         __FUNCTION__, __LINE__, tname, g_strerror(errno));
+        }
+        return;
+    }
+    num_msgs = rv / sizeof(adpoll_send_msg_t);
+
+    /* the pipe only carries ring overflow: whatever made it into the
+     * ring before these messages goes first
+     */
+    pollthr_send_ring_drain(thr_pvt_p, tname);
+
+    for (i = 0; i < num_msgs; i++) {
+        pollthr_queue_send_msg(thr_pvt_p, tname, pipe_msg_arr[i].fd,
+                               pipe_msg_arr[i].msg_p);
+    }
+    g_atomic_int_add(&thr_pvt_p->send_ring->overflow, -num_msgs);
+
+    g_private_replace(&tname_key,
+                      (gpointer)thr_pvt_p);
+}
+
+/* current time in timer wheel ticks */
+static uint64_t
+adpoll_timer_now(void)
+{
+    return ((uint64_t)g_get_monotonic_time() / (1000 * ADPOLL_TIMER_TICK_MS));
+}
+
+static adpoll_timer_wheel_t *
+adpoll_timer_wheel_new(int wake_fd)
+{
+    adpoll_timer_wheel_t *wheel;
+
+    wheel = g_new0(adpoll_timer_wheel_t, 1);
+    g_mutex_init(&wheel->lock);
+    wheel->tick = adpoll_timer_now() + 1;
+    wheel->next_tick = G_MAXUINT64;
+    wheel->wake_fd = wake_fd;
+    return wheel;
+}
+
+static void
+adpoll_timer_wheel_free(adpoll_timer_wheel_t *wheel)
+{
+    g_mutex_clear(&wheel->lock);
+    g_free(wheel);
+}
+
+/* first tick from wheel->tick on at which slot idx of level expires
+ * (level 0) or is cascaded
+ */
+static uint64_t
+adpoll_timer_slot_tick(adpoll_timer_wheel_t *wheel, uint32_t level,
+                       uint32_t idx)
+{
+    uint32_t shift = level * ADPOLL_TIMER_LEVEL_BITS;
+    uint64_t u;
+
+    u = (wheel->tick + (1ULL << shift) - 1) >> shift;
+    return ((u + ((idx - u) & ADPOLL_TIMER_LEVEL_MASK)) << shift);
+}
+
+// caller will acquire wheel lock
+static void
+adpoll_timer_link(adpoll_timer_wheel_t *wheel, adpoll_timer_t *timer)
+{
+    adpoll_timer_t **head;
+    uint64_t delta, slot_tick;
+    uint32_t level, idx;
+
+    /* never in a tick that was already run */
+    if (timer->expiry < wheel->tick) {
+        timer->expiry = wheel->tick;
+    }
+    delta = timer->expiry - wheel->tick;
+    for (level = 0; level < ADPOLL_TIMER_LEVELS - 1; level++) {
+        if (delta < (1ULL << ((level + 1) * ADPOLL_TIMER_LEVEL_BITS))) {
+            break;
+        }
+    }
+    if (delta >= (1ULL << (ADPOLL_TIMER_LEVELS * ADPOLL_TIMER_LEVEL_BITS))) {
+        timer->expiry = wheel->tick +
+            (1ULL << (ADPOLL_TIMER_LEVELS * ADPOLL_TIMER_LEVEL_BITS)) - 1;
+    }
+    idx = (timer->expiry >> (level * ADPOLL_TIMER_LEVEL_BITS)) &
+        ADPOLL_TIMER_LEVEL_MASK;
+
+    head = &wheel->slot[level][idx];
+    timer->next = *head;
+    if (timer->next) {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head = timer;
+    timer->level = level;
+    timer->wheel = wheel;
+    wheel->level_timers[level]++;
+    wheel->num_timers++;
+
+    slot_tick = adpoll_timer_slot_tick(wheel, level, idx);
+    if (slot_tick < wheel->next_tick) {
+        wheel->next_tick = slot_tick;
+    }
+}
+
+// caller will acquire wheel lock
+static void
+adpoll_timer_unlink(adpoll_timer_wheel_t *wheel, adpoll_timer_t *timer)
+{
+    *(timer->pprev) = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+    /* level ADPOLL_TIMER_LEVELS - on the list being run */
+    if (timer->level < ADPOLL_TIMER_LEVELS) {
+        wheel->level_timers[timer->level]--;
+    }
+    wheel->num_timers--;
+}
+
+/* move the timers of a slot down to the levels below */
+static void
+adpoll_timer_cascade(adpoll_timer_wheel_t *wheel, uint32_t level,
+                     uint32_t idx)
+{
+    adpoll_timer_t *timer;
+
+    while ((timer = wheel->slot[level][idx]) != NULL) {
+        adpoll_timer_unlink(wheel, timer);
+        adpoll_timer_link(wheel, timer);
+    }
+}
+
+/* lower bound on the tick of the next expiry: the first non empty slot
+ * of each level. O(slots), only done after timers ran
+ */
+static uint64_t
+adpoll_timer_next_tick(adpoll_timer_wheel_t *wheel)
+{
+    uint64_t next_tick = G_MAXUINT64, slot_tick;
+    uint32_t level, shift, i;
+    uint64_t u;
+
+    for (level = 0; level < ADPOLL_TIMER_LEVELS; level++) {
+        if (wheel->level_timers[level] == 0) {
+            continue;
+        }
+        shift = level * ADPOLL_TIMER_LEVEL_BITS;
+        u = (wheel->tick + (1ULL << shift) - 1) >> shift;
+        for (i = 0; i < ADPOLL_TIMER_LEVEL_SLOTS; i++) {
+            if (wheel->slot[level][(u + i) & ADPOLL_TIMER_LEVEL_MASK]) {
+                slot_tick = (u + i) << shift;
+                next_tick = MIN(next_tick, slot_tick);
+                break;
+            }
+        }
+    }
+    return next_tick;
+}
+
+/* run the timers that are due, once per loop of the poll thread. The
+ * callbacks run without the wheel lock.
+ */
+static void
+pollthr_timers_run(pollthr_private_t *thr_pvt_p, char *tname)
+{
+    adpoll_timer_wheel_t *wheel = thr_pvt_p->timer_wheel;
+    adpoll_timer_t *due, *timer;
+    uint64_t now, tick;
+    uint32_t level;
+
+    now = adpoll_timer_now();
+
+    g_mutex_lock(&wheel->lock);
+    while (wheel->tick <= now) {
+        if (wheel->num_timers == 0) {
+            wheel->tick = now + 1;
+            wheel->next_tick = G_MAXUINT64;
+            break;
+        }
+        /* no slot expires or cascades before next_tick */
+        if (wheel->next_tick > wheel->tick) {
+            wheel->tick = MIN(wheel->next_tick, now + 1);
+            continue;
+        }
+
+        tick = wheel->tick;
+        for (level = 1; (level < ADPOLL_TIMER_LEVELS) &&
+                 (((tick >> ((level - 1) * ADPOLL_TIMER_LEVEL_BITS)) &
+                   ADPOLL_TIMER_LEVEL_MASK) == 0); level++) {
+            adpoll_timer_cascade(wheel, level,
+                                 (tick >> (level * ADPOLL_TIMER_LEVEL_BITS)) &
+                                 ADPOLL_TIMER_LEVEL_MASK);
+        }
+        wheel->tick = tick + 1;
+
+        /* take the slot; timers armed from the callbacks below go
+         * after it
+         */
+        due = wheel->slot[0][tick & ADPOLL_TIMER_LEVEL_MASK];
+        wheel->slot[0][tick & ADPOLL_TIMER_LEVEL_MASK] = NULL;
+        if (due != NULL) {
+            due->pprev = &due;
+        }
+        for (timer = due; timer != NULL; timer = timer->next) {
+            wheel->level_timers[0]--;
+            timer->level = ADPOLL_TIMER_LEVELS;
+        }
+
+        while ((timer = due) != NULL) {
+            adpoll_timer_unlink(wheel, timer);
+            g_mutex_unlock(&wheel->lock);
+
+            CC_LOG_DEBUG("%s(%d)[%s]: timer %p expired",
+                         __FUNCTION__, __LINE__, tname, timer);
+            timer->func(tname, timer);
+            g_private_replace(&tname_key, (gpointer)thr_pvt_p);
+
+            g_mutex_lock(&wheel->lock);
+        }
+        wheel->next_tick = adpoll_timer_next_tick(wheel);
+    }
+    g_mutex_unlock(&wheel->lock);
+}
+
+/* timers still armed when the poll thread exits; none can be armed
+ * after
+ */
+static void
+pollthr_timers_free(pollthr_private_t *thr_pvt_p)
+{
+    adpoll_timer_wheel_t *wheel = thr_pvt_p->timer_wheel;
+    adpoll_timer_t *timer;
+    uint32_t level, idx;
+
+    g_mutex_lock(&wheel->lock);
+    wheel->stopped = TRUE;
+    for (level = 0; level < ADPOLL_TIMER_LEVELS; level++) {
+        for (idx = 0; idx < ADPOLL_TIMER_LEVEL_SLOTS; idx++) {
+            while ((timer = wheel->slot[level][idx]) != NULL) {
+                adpoll_timer_unlink(wheel, timer);
+                if (timer->free_func) {
+                    g_mutex_unlock(&wheel->lock);
+                    timer->free_func(timer);
+                    g_mutex_lock(&wheel->lock);
+                }
+            }
+        }
+    }
+    g_mutex_unlock(&wheel->lock);
+}
+
+/* wait no longer than until the next timer expiry */
+static int
+pollthr_timers_timeout(pollthr_private_t *thr_pvt_p, int timeout)
+{
+    adpoll_timer_wheel_t *wheel = thr_pvt_p->timer_wheel;
+    int64_t wait_us;
+
+    g_mutex_lock(&wheel->lock);
+    if ((wheel->num_timers > 0) && (wheel->next_tick != G_MAXUINT64)) {
+        wait_us = (int64_t)(wheel->next_tick * 1000 * ADPOLL_TIMER_TICK_MS) -
+            g_get_monotonic_time();
+        if (wait_us <= 0) {
+            timeout = 0;
+        } else if (wait_us < (int64_t)timeout * 1000) {
+            timeout = (int)((wait_us + 999) / 1000);
+        }
+    }
+    g_mutex_unlock(&wheel->lock);
+    return timeout;
+}
+
+/*
+ * Function: adp_thr_mgr_poll_thread_func
  * adp_thr_mgr_new() creates a poll thread that runs this function
  * This function polls on pipe and socket fds in a loop
  * The first pipe is setup permanently with the parent thread
  * Parent thread sends new socket and pipe fds to poll on via the
  *   permanent pipe.
  * The permanent pipe is deleted only when the poll thread is torn down
+ * Only the fds reported ready by the event backend are dispatched.
  */
 void
 adp_thr_mgr_poll_thread_func(adpoll_pollthr_data_t *pollthr_data_p)
@@ -716,13 +1414,14 @@ adp_thr_mgr_poll_thread_func(adpoll_pollthr_data_t *pollthr_data_p)
     adpoll_fd_info_t *fd_entry_p;
     pollthr_private_t *thr_pvt_p;
     char pollthr_name[MAX_NAME_LEN];
-    GList *thr_pvt_fd_list = NULL;
+    adpoll_thread_mgr_t *mgr;
 
     if (pollthr_data_p == NULL) {
         CC_LOG_FATAL("%s(%d): received NULL user data", __FUNCTION__, __LINE__);
     }
     
     strncpy(pollthr_name, pollthr_data_p->tname, MAX_NAME_LEN);
+    mgr = pollthr_data_p->mgr;
     
     CC_LOG_DEBUG("%s(%d)[%s]: thread started with max pollfds %d"
                  " and primary pipe rd fd %d", __FUNCTION__,
@@ -732,55 +1431,88 @@ adp_thr_mgr_poll_thread_func(adpoll_pollthr_data_t *pollthr_data_p)
     
     /* Initialize thread private data */
     thr_pvt_p = (pollthr_private_t *)malloc(sizeof(pollthr_private_t));
-    thr_pvt_p->pollfd_arr = (struct pollfd *)malloc(sizeof(struct pollfd) *
-                                                    pollthr_data_p->max_pollfds);
-    thr_pvt_p->fd_list = NULL;
+    thr_pvt_p->num_pollfds = 0;
+    thr_pvt_p->max_pollfds = pollthr_data_p->max_pollfds;
+    thr_pvt_p->pri_pipe_rd_fd = pollthr_data_p->primary_pipe_rd_fd;
+    thr_pvt_p->data_pipe_rd_fd = -1;
+    thr_pvt_p->fd_htbl = g_hash_table_new(g_direct_hash, g_direct_equal);
+    thr_pvt_p->fd_free_list = NULL;
+    thr_pvt_p->ready_arr = (adpoll_fd_info_t **)
+        malloc(sizeof(adpoll_fd_info_t *) * thr_pvt_p->max_pollfds);
+    thr_pvt_p->num_ready = 0;
+    thr_pvt_p->timer_wheel = mgr->timer_wheel;
+
+    thr_pvt_p->backend = adp_thr_mgr_backend_fns(pollthr_data_p->backend);
+    while (thr_pvt_p->backend->init(thr_pvt_p) < 0) {
+        CC_LOG_ERROR("%s(%d)[%s]: %s backend init failed",
+                     __FUNCTION__, __LINE__, pollthr_name,
+                     thr_pvt_p->backend->name);
+        thr_pvt_p->backend = adp_thr_mgr_backend_fallback(thr_pvt_p->backend);
+        if (thr_pvt_p->backend == NULL) {
+            CC_LOG_FATAL("%s(%d)[%s]: no event backend available",
+                         __FUNCTION__, __LINE__, pollthr_name);
+        }
+    }
 
-    thr_pvt_p->add_del_pipe_cv_mutex = pollthr_data_p->mgr->add_del_pipe_cv_mutex;
-    thr_pvt_p->add_del_pipe_cv_cond = pollthr_data_p->mgr->add_del_pipe_cv_cond;
-    thr_pvt_p->adp_thr_init_cv_mutex = pollthr_data_p->mgr->adp_thr_init_cv_mutex;
-    thr_pvt_p->adp_thr_init_cv_cond = pollthr_data_p->mgr->adp_thr_init_cv_cond;
+    thr_pvt_p->add_del_pipe_cv_mutex = mgr->add_del_pipe_cv_mutex;
+    thr_pvt_p->add_del_pipe_cv_cond = mgr->add_del_pipe_cv_cond;
+    thr_pvt_p->adp_thr_init_cv_mutex = mgr->adp_thr_init_cv_mutex;
+    thr_pvt_p->adp_thr_init_cv_cond = mgr->adp_thr_init_cv_cond;
+    thr_pvt_p->tx_drops = mgr->tx_drops;
 
 
-    g_mutex_init(&thr_pvt_p->send_msg_htbl_lock);
-    thr_pvt_p->send_msg_htbl = g_hash_table_new_full(g_direct_hash,
-                                                     g_direct_equal,
-                                                     func_destroy_key,
-                                                     func_destroy_val);
 
-    /* Initialize the first fd entry in fd_list */
+    /* Initialize the first fd entry in fd_htbl */
     fd_entry_p = (adpoll_fd_info_t *)malloc(sizeof(adpoll_fd_info_t));
     fd_entry_p->fd = pollthr_data_p->primary_pipe_rd_fd;
     fd_entry_p->fd_type = PIPE;
     fd_entry_p->pollin_func = &pollthr_pri_pipe_process_func;
     fd_entry_p->pollout_func = NULL;
+    fd_entry_p->deleted = FALSE;
+    fd_entry_p->io_offload = FALSE;
+    fd_entry_p->connect_pending = FALSE;
+    fd_entry_p->backend_priv = NULL;
+    fd_entry_p->send_q = g_queue_new();
+    fd_entry_p->tx_syscalls = 0;
+    fd_entry_p->tx_msgs = 0;
+    fd_entry_p->user_ctx = NULL;
+    fd_entry_p->user_ctx_free = NULL;
 
     /* setup poll fd for primary pipe*/
-    thr_pvt_p->pollfd_arr[0].fd = fd_entry_p->fd;
-    thr_pvt_p->pollfd_arr[0].events = POLLIN;
+    thr_pvt_p->backend->add_fd(thr_pvt_p, fd_entry_p, POLLIN);
     thr_pvt_p->num_pollfds = 1;
 
-    fd_entry_p->pollfd_entry_p = &(thr_pvt_p->pollfd_arr[0]);
-    thr_pvt_p->fd_list = g_list_append(thr_pvt_p->fd_list, fd_entry_p);
+    g_hash_table_insert(thr_pvt_p->fd_htbl,
+                        GINT_TO_POINTER(fd_entry_p->fd), fd_entry_p);
+
+    /* send ring doorbell - internal, not counted in num_pollfds */
+    thr_pvt_p->send_ring = pollthr_data_p->send_ring;
+    thr_pvt_p->doorbell_entry = (adpoll_fd_info_t *)
+        calloc(1, sizeof(adpoll_fd_info_t));
+    thr_pvt_p->doorbell_entry->fd = thr_pvt_p->send_ring->doorbell_fd;
+    thr_pvt_p->doorbell_entry->fd_type = PIPE;
+    thr_pvt_p->doorbell_entry->pollin_func = &pollthr_send_ring_process_func;
+    thr_pvt_p->doorbell_entry->send_q = g_queue_new();
+    thr_pvt_p->backend->add_fd(thr_pvt_p, thr_pvt_p->doorbell_entry, POLLIN);
 
     if(cc_of_global.ofut_enable) {
         CC_LOG_DEBUG(FD_LIST_COUNT_LOG "SETUP PRI PIPE",
                      __FUNCTION__, __LINE__, pollthr_name,
-                     g_list_length(thr_pvt_p->fd_list));
+                     g_hash_table_size(thr_pvt_p->fd_htbl));
     }
     g_private_set(&tname_key,
                   (gpointer)thr_pvt_p);
 
     free(pollthr_data_p);
 
-    CC_LOG_DEBUG("%s(%d)[%s]: reading on fd %d",
+    CC_LOG_DEBUG("%s(%d)[%s]: reading on fd %d using %s",
                  __FUNCTION__, __LINE__, pollthr_name,
-                 thr_pvt_p->pollfd_arr[0].fd);
+                 fd_entry_p->fd, thr_pvt_p->backend->name);
     
     /* synchronize completion of thread initialization */
-    g_mutex_lock(pollthr_data_p->mgr->adp_thr_init_cv_mutex);
-    g_cond_signal(pollthr_data_p->mgr->adp_thr_init_cv_cond);
-    g_mutex_unlock(pollthr_data_p->mgr->adp_thr_init_cv_mutex);
+    g_mutex_lock(mgr->adp_thr_init_cv_mutex);
+    g_cond_signal(mgr->adp_thr_init_cv_cond);
+    g_mutex_unlock(mgr->adp_thr_init_cv_mutex);
 
     for( ; ; ) {
         CC_LOG_DEBUG("%s(%d)[%s] before poll",
@@ -799,11 +1531,14 @@ adp_thr_mgr_poll_thread_func(adpoll_pollthr_data_t *pollthr_data_p)
             break;
         }
         
-        rv = poll(thr_pvt_p->pollfd_arr,
-                  thr_pvt_p->num_pollfds,
-                  10000);
+        rv = thr_pvt_p->backend->wait(thr_pvt_p,
+                                      pollthr_timers_timeout(thr_pvt_p,
+                                                             10000));
         
         if (rv == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
             CC_LOG_ERROR("%s(%d)[%s]: poll error %d",
                          __FUNCTION__, __LINE__,pollthr_name,
                          errno);
@@ -815,46 +1550,49 @@ adp_thr_mgr_poll_thread_func(adpoll_pollthr_data_t *pollthr_data_p)
             CC_LOG_DEBUG("%s(%d)[%s]: thread was polling on %d number of fds",
                          __FUNCTION__, __LINE__, pollthr_name,
                          thr_pvt_p->num_pollfds);
-            for (i = 0; i < thr_pvt_p->num_pollfds; i++) {
-                CC_LOG_DEBUG("%s(%d)[%s]thr_pvt_p->pollfd_arr[%d].fd: %d, "
-                             "thr_pvt_p->pollfd_arr[%d].events: %d",
-                             __FUNCTION__, __LINE__, pollthr_name,
-                             i, thr_pvt_p->pollfd_arr[i].fd,
-                             i, thr_pvt_p->pollfd_arr[i].events);
-            }
         } else {
-            thr_pvt_fd_list = thr_pvt_p->fd_list;
-            
             g_private_replace(&tname_key,
                               (gpointer)thr_pvt_p);
             
-            g_list_foreach(thr_pvt_fd_list, (GFunc)poll_fd_process,
-                           (gpointer)pollthr_name);
-
-            g_assert(pollthr_name != NULL);
-            CC_LOG_DEBUG("%s(%d)[%s]: listing of updated GList",
-                         __FUNCTION__, __LINE__, pollthr_name);
+            /* pipes first: an fd deleted via the primary pipe must
+             * not be dispatched, its owner may hold the global locks
+             */
+            for (i = 0; i < rv; i++) {
+                if (thr_pvt_p->ready_arr[i]->fd_type == PIPE) {
+                    poll_fd_process(thr_pvt_p->ready_arr[i], pollthr_name);
+                }
+            }
+            for (i = 0; i < rv; i++) {
+                if (thr_pvt_p->ready_arr[i]->fd_type != PIPE) {
+                    poll_fd_process(thr_pvt_p->ready_arr[i], pollthr_name);
+                }
+            }
 
-            g_list_foreach(thr_pvt_fd_list, (GFunc)print_fd_list, NULL);
-            CC_LOG_DEBUG("%s(%d)[%s]: listing %d items of updated pollfd_arr",
-                         __FUNCTION__, __LINE__, pollthr_name,
-                         thr_pvt_p->num_pollfds);
-            
             thr_pvt_p = g_private_get(&tname_key);
-            thr_pvt_p->fd_list = thr_pvt_fd_list;
-            for (i = 0; i < thr_pvt_p->num_pollfds; i++) {
-                CC_LOG_DEBUG("%s(%d)[%s]: thr_pvt_p->pollfd_arr[%d].fd: %d, "
-                             "thr_pvt_p->pollfd_arr[%d].events: %d",
+
+            /* entries deleted while dispatching are safe to free now */
+            g_list_free_full(thr_pvt_p->fd_free_list,
+                             (GDestroyNotify)fd_entry_free);
+            thr_pvt_p->fd_free_list = NULL;
+
+            if (cc_of_global.ofdebug_enable) {
+                CC_LOG_DEBUG("%s(%d)[%s]: listing %d items of updated fd_htbl",
                              __FUNCTION__, __LINE__, pollthr_name,
-                             i, thr_pvt_p->pollfd_arr[i].fd,
-                             i, thr_pvt_p->pollfd_arr[i].events);
+                             thr_pvt_p->num_pollfds);
+                g_hash_table_foreach(thr_pvt_p->fd_htbl,
+                                     (GHFunc)print_fd_list, NULL);
             }
         }
+
+        pollthr_timers_run(thr_pvt_p, pollthr_name);
     }
-    free(thr_pvt_p->pollfd_arr);
-    g_list_free_full(thr_pvt_p->fd_list, (GDestroyNotify)fd_entry_free);
-    g_mutex_clear(&thr_pvt_p->send_msg_htbl_lock);
-    g_hash_table_destroy(thr_pvt_p->send_msg_htbl);
+    pollthr_timers_free(thr_pvt_p);
+    g_list_free_full(thr_pvt_p->fd_free_list, (GDestroyNotify)fd_entry_free);
+    g_hash_table_foreach(thr_pvt_p->fd_htbl, (GHFunc)fd_entry_htbl_free, NULL);
+    g_hash_table_destroy(thr_pvt_p->fd_htbl);
+    fd_entry_free(thr_pvt_p->doorbell_entry);
+    thr_pvt_p->backend->cleanup(thr_pvt_p);
+    free(thr_pvt_p->ready_arr);
 
     
     g_mutex_lock((thr_pvt_p->add_del_pipe_cv_mutex));
@@ -867,9 +1605,28 @@ adp_thr_mgr_poll_thread_func(adpoll_pollthr_data_t *pollthr_data_p)
 uint32_t
 adp_thr_mgr_get_num_avail_sockfd(adpoll_thread_mgr_t *this)
 {
+    gint num_sockets;
+
     CC_LOG_DEBUG("max sockets is %d", this->max_sockets);
-    CC_LOG_DEBUG("num sockets is %d", this->num_sockets);
-    return (this->max_sockets - this->num_sockets);
+    num_sockets = g_atomic_int_get(&this->num_sockets);
+    CC_LOG_DEBUG("num sockets is %d", num_sockets);
+    return (this->max_sockets - num_sockets);
+}
+
+uint32_t
+adp_thr_mgr_get_tx_drops(adpoll_thread_mgr_t *this, uint32_t *bytes)
+{
+    if (bytes) {
+        *bytes = (uint32_t)g_atomic_int_get(&this->tx_drops->bytes);
+    }
+    return (uint32_t)g_atomic_int_get(&this->tx_drops->msgs);
+}
+
+void
+pollthr_tx_drop(pollthr_private_t *thr_pvt_p, uint32_t msgs, uint32_t bytes)
+{
+    g_atomic_int_add(&thr_pvt_p->tx_drops->msgs, msgs);
+    g_atomic_int_add(&thr_pvt_p->tx_drops->bytes, bytes);
 }
 
 /* return value: write pipe fd */
@@ -901,3 +1658,382 @@ adp_thr_mgr_get_data_pipe_rd(adpoll_thread_mgr_t *this)
     return(this->pipes_arr[DATA_PIPE_RD_FD]);
 }
 
+/* fd entry of fd if the calling poll thread's backend does its I/O */
+static adpoll_fd_info_t *
+adp_thr_mgr_offload_entry(int fd, pollthr_private_t **thr_pvt_pp)
+{
+    pollthr_private_t *thr_pvt_p;
+    adpoll_fd_info_t *fd_entry_p;
+
+    thr_pvt_p = g_private_get(&tname_key);
+    if ((thr_pvt_p == NULL) || (thr_pvt_p->backend->recv == NULL)) {
+        return NULL;
+    }
+    fd_entry_p = g_hash_table_lookup(thr_pvt_p->fd_htbl,
+                                     GINT_TO_POINTER(fd));
+    if ((fd_entry_p == NULL) || !fd_entry_p->io_offload) {
+        return NULL;
+    }
+    *thr_pvt_pp = thr_pvt_p;
+    return fd_entry_p;
+}
+
+ssize_t
+adp_thr_mgr_recv(int fd, void *buf, size_t len, int flags)
+{
+    pollthr_private_t *thr_pvt_p = NULL;
+    adpoll_fd_info_t *fd_entry_p;
+
+    fd_entry_p = adp_thr_mgr_offload_entry(fd, &thr_pvt_p);
+    if (fd_entry_p == NULL) {
+        return recv(fd, buf, len, flags);
+    }
+    /* data was already received by the backend; flags do not apply */
+    return thr_pvt_p->backend->recv(thr_pvt_p, fd_entry_p, buf, len);
+}
+
+ssize_t
+adp_thr_mgr_send(int fd, const void *buf, size_t len, int flags)
+{
+    pollthr_private_t *thr_pvt_p = NULL;
+    adpoll_fd_info_t *fd_entry_p;
+
+    fd_entry_p = adp_thr_mgr_offload_entry(fd, &thr_pvt_p);
+    if (fd_entry_p == NULL) {
+        return send(fd, buf, len, flags);
+    }
+    return thr_pvt_p->backend->send(thr_pvt_p, fd_entry_p, buf, len);
+}
+
+ssize_t
+adp_thr_mgr_sendv(int fd, const struct iovec *iov, int iovcnt, int flags)
+{
+    pollthr_private_t *thr_pvt_p = NULL;
+    adpoll_fd_info_t *fd_entry_p;
+    struct msghdr msg;
+    ssize_t sent, total = 0;
+    int i;
+
+    fd_entry_p = adp_thr_mgr_offload_entry(fd, &thr_pvt_p);
+    if (fd_entry_p == NULL) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (struct iovec *)iov;
+        msg.msg_iovlen = iovcnt;
+        return sendmsg(fd, &msg, flags);
+    }
+    /* the backend copies into one buffer sent with a single SEND,
+     * up to what it has room for
+     */
+    for (i = 0; i < iovcnt; i++) {
+        sent = thr_pvt_p->backend->send(thr_pvt_p, fd_entry_p,
+                                        iov[i].iov_base, iov[i].iov_len);
+        if (sent < 0) {
+            return total ? total : sent;
+        }
+        total += sent;
+        if ((size_t)sent < iov[i].iov_len) {
+            break;
+        }
+    }
+    return total;
+}
+
+/* Send message pool
+ * Buffers are kept in power of two size classes from
+ * MSG_POOL_MIN_SIZE to MSG_POOL_MAX_SIZE, each with a small stack of
+ * free buffers. Larger messages are malloc'ed and freed directly.
+ */
+#define MSG_POOL_MIN_SHIFT  8   /* 256 bytes */
+#define MSG_POOL_MAX_SHIFT  16  /* 64KB */
+#define MSG_POOL_NUM_CLASS  (MSG_POOL_MAX_SHIFT - MSG_POOL_MIN_SHIFT + 1)
+#define MSG_POOL_MAX_FREE   256 /* free buffers kept per class */
+
+typedef struct adpoll_msg_pool_ {
+    GMutex                      lock;
+    int                         num_free;
+    adpoll_send_msg_htbl_info_t *free_arr[MSG_POOL_MAX_FREE];
+} adpoll_msg_pool_t;
+
+static adpoll_msg_pool_t msg_pool[MSG_POOL_NUM_CLASS];
+
+adpoll_send_msg_htbl_info_t *
+adp_thr_mgr_msg_alloc(uint buf_size)
+{
+    adpoll_send_msg_htbl_info_t *msg_p = NULL;
+    adpoll_msg_pool_t *pool;
+    int idx = 0;
+
+    while ((idx < MSG_POOL_NUM_CLASS) &&
+           (buf_size > (1U << (idx + MSG_POOL_MIN_SHIFT)))) {
+        idx++;
+    }
+
+    if (idx == MSG_POOL_NUM_CLASS) {
+        msg_p = malloc(sizeof(adpoll_send_msg_htbl_info_t) + buf_size);
+        if (msg_p == NULL) {
+            return NULL;
+        }
+        msg_p->buf_size = buf_size;
+        msg_p->pool_idx = -1;
+    } else {
+        pool = &msg_pool[idx];
+        g_mutex_lock(&pool->lock);
+        if (pool->num_free) {
+            msg_p = pool->free_arr[--pool->num_free];
+        }
+        g_mutex_unlock(&pool->lock);
+
+        if (msg_p == NULL) {
+            msg_p = malloc(sizeof(adpoll_send_msg_htbl_info_t) +
+                           (1U << (idx + MSG_POOL_MIN_SHIFT)));
+            if (msg_p == NULL) {
+                return NULL;
+            }
+        }
+        msg_p->buf_size = 1U << (idx + MSG_POOL_MIN_SHIFT);
+        msg_p->pool_idx = idx;
+    }
+    msg_p->data_size = 0;
+    msg_p->data_off = 0;
+    msg_p->dp_id = 0;
+    msg_p->aux_id = 0;
+    msg_p->fd_gen = 0;
+    msg_p->req = NULL;
+    msg_p->req_free = NULL;
+    return msg_p;
+}
+
+void
+adp_thr_mgr_msg_free(adpoll_send_msg_htbl_info_t *msg_p)
+{
+    adpoll_msg_pool_t *pool;
+
+    if (msg_p == NULL) {
+        return;
+    }
+    if ((msg_p->req != NULL) && (msg_p->req_free != NULL)) {
+        msg_p->req_free(msg_p->req);
+    }
+    msg_p->req = NULL;
+    if ((msg_p->pool_idx >= 0) && (msg_p->pool_idx < MSG_POOL_NUM_CLASS)) {
+        pool = &msg_pool[msg_p->pool_idx];
+        g_mutex_lock(&pool->lock);
+        if (pool->num_free < MSG_POOL_MAX_FREE) {
+            pool->free_arr[pool->num_free++] = msg_p;
+            msg_p = NULL;
+        }
+        g_mutex_unlock(&pool->lock);
+    }
+    free(msg_p);
+}
+
+int
+adp_thr_mgr_send_msg(adpoll_thread_mgr_t *this, int fd,
+                     adpoll_send_msg_htbl_info_t *msg_p)
+{
+    adpoll_send_msg_t pipe_msg;
+    adpoll_send_ring_t *ring;
+    pollthr_private_t *thr_pvt_p;
+    ssize_t rv;
+
+    if ((this == NULL) || (msg_p == NULL) ||
+        (msg_p->data_size > msg_p->buf_size)) {
+        return -1;
+    }
+    msg_p->data_off = 0;
+    pipe_msg.fd = fd;
+    pipe_msg.msg_p = msg_p;
+    ring = this->send_ring;
+
+    /* sent from one of this thread's own callbacks */
+    if (g_thread_self() == this->thread_p) {
+        thr_pvt_p = g_private_get(&tname_key);
+        pollthr_queue_send_msg(thr_pvt_p, this->tname, fd, msg_p);
+        return 0;
+    }
+
+    if ((g_atomic_int_get(&ring->overflow) == 0) &&
+        adpoll_send_ring_push(ring, &pipe_msg)) {
+        return 0;
+    }
+
+    /* ring is full or earlier messages are still on the pipe */
+    g_atomic_int_inc(&ring->overflow);
+    do {
+        rv = write(adp_thr_mgr_get_data_pipe_wr(this),
+                   &pipe_msg, sizeof(pipe_msg));
+    } while ((rv == -1) && (errno == EINTR));
+
+    if (rv != sizeof(pipe_msg)) {
+        g_atomic_int_add(&ring->overflow, -1);
+        CC_LOG_ERROR("%s(%d)[%s]: data pipe write failed for fd %d: %s",
+                     __FUNCTION__, __LINE__, this->tname, fd,
+                     g_strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* hand msg_arr[] to the poll thread with at most one wakeup. Returns
+ * the number of messages handed over; the rest, if any, still belong
+ * to the caller.
+ */
+int
+adp_thr_mgr_send_msg_batch(adpoll_thread_mgr_t *this,
+                           adpoll_send_msg_t *msg_arr, int num_msgs)
+{
+    pollthr_private_t *thr_pvt_p;
+    int i, chunk;
+
+    if ((this == NULL) || (msg_arr == NULL) || (num_msgs <= 0)) {
+        return 0;
+    }
+    for (i = 0; i < num_msgs; i++) {
+        if ((msg_arr[i].msg_p == NULL) ||
+            (msg_arr[i].msg_p->data_size > msg_arr[i].msg_p->buf_size)) {
+            num_msgs = i;
+            break;
+        }
+        msg_arr[i].msg_p->data_off = 0;
+    }
+
+    if (g_thread_self() == this->thread_p) {
+        thr_pvt_p = g_private_get(&tname_key);
+        for (i = 0; i < num_msgs; i++) {
+            pollthr_queue_send_msg(thr_pvt_p, this->tname, msg_arr[i].fd,
+                                   msg_arr[i].msg_p);
+        }
+        return num_msgs;
+    }
+
+    for (i = 0; i < num_msgs; i += chunk) {
+        chunk = MIN(num_msgs - i, ADPOLL_SEND_RING_SIZE);
+        if ((g_atomic_int_get(&this->send_ring->overflow) != 0) ||
+            !adpoll_send_ring_push_n(this->send_ring, &msg_arr[i],
+                                     chunk)) {
+            break;
+        }
+    }
+
+    /* no room for a whole chunk - one at a time, spilling to the pipe */
+    for ( ; i < num_msgs; i++) {
+        if (adp_thr_mgr_send_msg(this, msg_arr[i].fd,
+                                 msg_arr[i].msg_p) < 0) {
+            break;
+        }
+    }
+    return i;
+}
+
+
+void
+adp_thr_mgr_timer_init(adpoll_timer_t *timer, adpoll_timer_func func,
+                       GDestroyNotify free_func, gpointer data)
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expiry = 0;
+    timer->level = 0;
+    timer->wheel = NULL;
+    timer->func = func;
+    timer->free_func = free_func;
+    timer->data = data;
+}
+
+/* arm timer on wheel; rearm moves it if it is already armed there.
+ * return value: 0 and whether the poll thread must wake up, or -1
+ */
+static int
+adpoll_timer_wheel_arm(adpoll_timer_wheel_t *wheel, adpoll_timer_t *timer,
+                       uint32_t delay_ms, gboolean rearm, gboolean *wake)
+{
+    uint64_t next_tick;
+
+    g_mutex_lock(&wheel->lock);
+    if (wheel->stopped ||
+        ((timer->pprev != NULL) &&
+         (!rearm || (timer->wheel != wheel)))) {
+        g_mutex_unlock(&wheel->lock);
+        return -1;
+    }
+    if (timer->pprev != NULL) {
+        adpoll_timer_unlink(wheel, timer);
+    }
+
+    next_tick = wheel->next_tick;
+    timer->expiry = adpoll_timer_now() +
+        MAX(1, (delay_ms + ADPOLL_TIMER_TICK_MS - 1) / ADPOLL_TIMER_TICK_MS);
+    adpoll_timer_link(wheel, timer);
+    *wake = (wheel->next_tick < next_tick);
+    g_mutex_unlock(&wheel->lock);
+    return 0;
+}
+
+int
+adp_thr_mgr_timer_arm(adpoll_thread_mgr_t *this, adpoll_timer_t *timer,
+                      uint32_t delay_ms)
+{
+    gboolean wake = FALSE;
+
+    if ((this == NULL) || (this->timer_wheel == NULL)) {
+        return -1;
+    }
+    if (adpoll_timer_wheel_arm(this->timer_wheel, timer, delay_ms, TRUE,
+                               &wake) < 0) {
+        return -1;
+    }
+    /* the poll thread sleeps until the earlier next_tick */
+    if (wake && (g_thread_self() != this->thread_p)) {
+        eventfd_write(this->timer_wheel->wake_fd, 1);
+    }
+    return 0;
+}
+
+int
+adp_thr_mgr_timer_add(adpoll_timer_t *timer, uint32_t delay_ms)
+{
+    pollthr_private_t *thr_pvt_p;
+    gboolean wake = FALSE;
+
+    thr_pvt_p = g_private_get(&tname_key);
+    if (thr_pvt_p == NULL) {
+        return -1;
+    }
+    /* the poll thread works out its timeout after its callbacks */
+    return (adpoll_timer_wheel_arm(thr_pvt_p->timer_wheel, timer, delay_ms,
+                                   FALSE, &wake));
+}
+
+gboolean
+adp_thr_mgr_timer_cancel(adpoll_timer_t *timer)
+{
+    adpoll_timer_wheel_t *wheel = timer->wheel;
+    gboolean armed = FALSE;
+
+    if (wheel == NULL) {
+        return FALSE;
+    }
+    g_mutex_lock(&wheel->lock);
+    if (timer->pprev != NULL) {
+        /* next_tick stays a lower bound */
+        adpoll_timer_unlink(wheel, timer);
+        armed = TRUE;
+    }
+    g_mutex_unlock(&wheel->lock);
+    return armed;
+}
+
+gboolean
+adp_thr_mgr_timer_pending(adpoll_timer_t *timer)
+{
+    adpoll_timer_wheel_t *wheel = timer->wheel;
+    gboolean armed;
+
+    if (wheel == NULL) {
+        return FALSE;
+    }
+    g_mutex_lock(&wheel->lock);
+    armed = (timer->pprev != NULL);
+    g_mutex_unlock(&wheel->lock);
+    return armed;
+}
@@ -17,6 +17,11 @@
 *****************************************************
 */
 
+/* accept4 */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "cc_of_global.h"
 #include "cc_of_priv.h"
 #include <unistd.h>
@@ -36,6 +41,8 @@ ssize_t tcp_read(int sockfd, void *buf, size_t len, int flags,
 ssize_t tcp_write(int sockfd, const void *buf, size_t len, int flags,
                   const struct sockaddr *dest_addr UNUSED,
                   socklen_t addrlen UNUSED);
+static ssize_t tcp_writev(int sockfd, const struct iovec *iov, int iovcnt);
+static void tcp_chann_down(char *tname, int tcp_sockfd, gboolean connected);
     
 
 /* Callback Registration for TCP */
@@ -104,35 +111,497 @@ void process_listenfd_pollin_func(char *tname UNUSED,
 }
 
 
+/* pollin of a listenfd served by a rw poll thread, see
+ * cc_of_set_tcp_listeners. The device is found by fd in the ofrw_tbl.
+ */
+void process_listenfd_rw_pollin_func(char *tname,
+                                     adpoll_fd_info_t *data_p,
+                                     adpoll_send_msg_htbl_info_t *unused_data UNUSED)
+{
+    cc_ofrw_info_t *rw_info;
+    cc_ofdev_key_t dkey;
+    int listenfd;
+
+    if (data_p == NULL) {
+        CC_LOG_ERROR("%s(%d): received NULL data",
+                     __FUNCTION__, __LINE__);
+        return;
+    }
+    listenfd = data_p->fd;
+
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    rw_info = cc_ofrw_lookup(listenfd);
+    if (rw_info == NULL) {
+        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+        CC_LOG_ERROR("%s(%d)[%s]: could not find listenfd %d in ofrw_tbl",
+                     __FUNCTION__, __LINE__, tname, listenfd);
+        return;
+    }
+    memcpy(&dkey, &rw_info->dev_key, sizeof(cc_ofdev_key_t));
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+
+    cc_of_global.NET_SVCS[TCP].accept_conn(listenfd, dkey);
+}
+
+
+/* where tcp_deliver_msg sends the messages of one read */
+typedef struct tcp_deliver_ctx_ {
+    cc_ofrw_ctx_t        *rw_ctx;
+    char                 *tname;
+    uint32_t             num_batch;
+    cc_of_recv_msg_t     batch[CC_OF_RECV_BATCH_MAX];
+} tcp_deliver_ctx_t;
+
+static void
+tcp_deliver_flush(tcp_deliver_ctx_t *ctx)
+{
+    if (ctx->num_batch) {
+        ctx->rw_ctx->recv_batch_func(ctx->batch, ctx->num_batch);
+        ctx->num_batch = 0;
+    }
+}
+
+/* queue a message of the library (echo, features request) on the
+ * socket of rw_ctx: a copy of msg with type, or a bare header. On its
+ * poll thread, so it goes out with the next POLLOUT without locks or a
+ * wakeup.
+ */
+static gboolean
+tcp_ctl_send(char *tname, cc_ofrw_ctx_t *rw_ctx, const char *msg,
+             size_t msg_len, uint8_t type, uint32_t xid)
+{
+    adpoll_send_msg_htbl_info_t *msg_p;
+    ofp_header_t *hdr;
+
+    msg_p = adp_thr_mgr_msg_alloc((uint)msg_len);
+    if (msg_p == NULL) {
+        CC_LOG_ERROR("%s(%d)[%s]: no memory for echo on tcp sockfd %d",
+                     __FUNCTION__, __LINE__, tname, rw_ctx->sockfd);
+        return FALSE;
+    }
+    hdr = (ofp_header_t *)msg_p->data;
+    if (msg) {
+        memcpy(msg_p->data, msg, msg_len);
+    } else {
+        hdr->version = (uint8_t)rw_ctx->of_version;
+        hdr->length = htons((uint16_t)msg_len);
+        hdr->xid = htonl(xid);
+    }
+    hdr->type = type;
+    msg_p->data_size = msg_len;
+    msg_p->dp_id = rw_ctx->chann_key.dp_id;
+    msg_p->aux_id = rw_ctx->chann_key.aux_id;
+
+    if (adp_thr_mgr_send_msg(rw_ctx->thr_mgr_p, rw_ctx->sockfd,
+                             msg_p) < 0) {
+        adp_thr_mgr_msg_free(msg_p);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* echo reply to our last echo request: update the RTT estimates,
+ * smoothed like TCP's (RFC 6298 alpha 1/8).
+ * return value: FALSE if the reply is not to our echo request
+ */
+static gboolean
+tcp_echo_reply(cc_ofrw_ctx_t *rw_ctx, uint32_t xid)
+{
+    gint64 rtt;
+    gint srtt, min_rtt;
+
+    if ((rw_ctx->echo_sent_at == 0) || (xid != rw_ctx->echo_xid)) {
+        return FALSE;
+    }
+    rtt = g_get_monotonic_time() - rw_ctx->echo_sent_at;
+    rtt = CLAMP(rtt, 1, G_MAXINT);
+    rw_ctx->echo_sent_at = 0;
+    rw_ctx->echo_missed = 0;
+
+    srtt = g_atomic_int_get(&rw_ctx->srtt_us);
+    srtt = (srtt == 0) ? (gint)rtt :
+        (gint)(((gint64)srtt * 7 + rtt) / 8);
+    min_rtt = g_atomic_int_get(&rw_ctx->min_rtt_us);
+    if ((min_rtt == 0) || (rtt < min_rtt)) {
+        g_atomic_int_set(&rw_ctx->min_rtt_us, (gint)rtt);
+    }
+    g_atomic_int_set(&rw_ctx->rtt_us, (gint)rtt);
+    g_atomic_int_set(&rw_ctx->srtt_us, MAX(srtt, 1));
+    return TRUE;
+}
+
+static void tcp_chann_announce(char *tname, cc_ofrw_ctx_t *rw_ctx);
+
+/* channel past the hello exchange, on its poll thread. A switch
+ * channel is up; a controller's is only now up and made known to the
+ * application, after the features exchange if it wants real ids.
+ */
+static void
+tcp_chann_ready(char *tname, cc_ofrw_ctx_t *rw_ctx)
+{
+    cc_ofchannel_info_t *chann_info = NULL;
+    uint32_t count_retries = 0;
+
+    CC_LOG_INFO("%s(%d)[%s]: channel dp_id-%lu aux_id-%u on tcp sockfd %d "
+                "negotiated OF version 0x%x", __FUNCTION__, __LINE__, tname,
+                rw_ctx->chann_key.dp_id, rw_ctx->chann_key.aux_id,
+                rw_ctx->sockfd, rw_ctx->of_version);
+
+    if (cc_of_global.ofdev_type == SWITCH) {
+        g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+        /* retries it took stay visible until the channel goes down */
+        cc_ofchann_reconnect_clear(rw_ctx->chann_key, &count_retries);
+        chann_info = g_hash_table_lookup(cc_of_global.ofchannel_htbl,
+                                         &rw_ctx->chann_key);
+        if (chann_info != NULL) {
+            chann_info->count_retries = count_retries;
+        }
+        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+
+        if (rw_ctx->chann_up_func) {
+            rw_ctx->chann_up_func(rw_ctx->chann_key.dp_id,
+                                  rw_ctx->chann_key.aux_id);
+        }
+        return;
+    }
+
+    /* the real dp_id/aux_id first, see tcp_features_recv */
+    if (rw_ctx->chann_ready_func) {
+        if (tcp_ctl_send(tname, rw_ctx, NULL, OFP_HEADER_LEN,
+                         OFPT_FEATURES_REQUEST, 0)) {
+            rw_ctx->features_pending = TRUE;
+        } else {
+            rw_ctx->setup_failed = TRUE;
+        }
+        return;
+    }
+    tcp_chann_announce(tname, rw_ctx);
+}
+
+/* controller channel up: the application is told of it, by its real
+ * ids if features_pending was set
+ */
+static void
+tcp_chann_announce(char *tname, cc_ofrw_ctx_t *rw_ctx)
+{
+    cc_ofrw_key_t rw_key;
+    cc_ofrw_info_t *rw_info = NULL;
+    cc_ofrw_info_t rw_info_new;
+    struct sockaddr_in peeraddr;
+    socklen_t addrlen = sizeof(peeraddr);
+    gboolean new_entry;
+    gboolean ready = rw_ctx->features_pending;
+
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    rw_info = cc_ofrw_lookup(rw_ctx->sockfd);
+    if (rw_info != NULL) {
+        rw_key.rw_sockfd = rw_ctx->sockfd;
+        memcpy(&rw_info_new, rw_info, sizeof(cc_ofrw_info_t));
+        rw_info_new.state = CC_OF_RW_UP;
+        update_global_htbl_lockfree(OFRW, ADD, (gpointer)&rw_key,
+                                    (gpointer)&rw_info_new, &new_entry);
+    }
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+
+    if (rw_info == NULL) {
+        CC_LOG_ERROR("%s(%d)[%s]: could not find rwinfo in ofrw_tbl for "
+                     "tcp sockfd %d", __FUNCTION__, __LINE__, tname,
+                     rw_ctx->sockfd);
+        return;
+    }
+    rw_ctx->state = CC_OF_RW_UP;
+    rw_ctx->features_pending = FALSE;
+
+    /* Notify the controller about the new TCP channel */
+    memset(&peeraddr, 0, sizeof(peeraddr));
+    getpeername(rw_ctx->sockfd, (struct sockaddr *)&peeraddr, &addrlen);
+    if (ready) {
+        if (rw_ctx->chann_ready_func) {
+            rw_ctx->chann_ready_func(rw_ctx->chann_key.dp_id,
+                                     rw_ctx->chann_key.aux_id,
+                                     (uint32_t)(peeraddr.sin_addr.s_addr),
+                                     (uint16_t)(ntohs(peeraddr.sin_port)));
+        }
+    } else if (rw_ctx->accept_chann_func) {
+        rw_ctx->accept_chann_func(rw_ctx->chann_key.dp_id,
+                                  rw_ctx->chann_key.aux_id,
+                                  (uint32_t)(peeraddr.sin_addr.s_addr),
+                                  (uint16_t)(ntohs(peeraddr.sin_port)));
+    }
+}
+
+/* the peer's hello: agree on a version or fail the channel, telling the
+ * peer why. The error is queued behind anything already on the socket
+ * and the channel is closed once it is out, see
+ * process_tcpfd_pollout_func.
+ */
+static void
+tcp_hello_recv(char *tname, cc_ofrw_ctx_t *rw_ctx, char *msg, size_t msg_len)
+{
+    ofp_header_t *hdr = (ofp_header_t *)msg;
+    char err_msg[OFP_HEADER_LEN + 4];
+    ofp_header_t *err_hdr = (ofp_header_t *)err_msg;
+    int version;
+
+    version = cc_of_msg_hello_negotiate(msg, msg_len, rw_ctx->of_bitmap);
+    if (version < 0) {
+        CC_LOG_ERROR("%s(%d)[%s]: no OF version in common with the peer "
+                     "(hello version 0x%x) on tcp sockfd %d", __FUNCTION__,
+                     __LINE__, tname, hdr->version, rw_ctx->sockfd);
+        err_hdr->version = hdr->version;
+        err_hdr->type = OFPT_ERROR;
+        err_hdr->length = htons(sizeof(err_msg));
+        err_hdr->xid = hdr->xid;
+        *(uint16_t *)(err_msg + OFP_HEADER_LEN) = htons(OFPET_HELLO_FAILED);
+        *(uint16_t *)(err_msg + OFP_HEADER_LEN + 2) =
+            htons(OFPHFC_INCOMPATIBLE);
+        rw_ctx->close_pending = tcp_ctl_send(tname, rw_ctx, err_msg,
+                                             sizeof(err_msg), OFPT_ERROR, 0);
+        rw_ctx->setup_failed = TRUE;
+        return;
+    }
+    g_atomic_int_set(&rw_ctx->of_version, version);
+    rw_ctx->hello_done = TRUE;
+    tcp_chann_ready(tname, rw_ctx);
+}
+
+/* FEATURES_REPLY to our request: move the channel from its dummy ids
+ * to the switch's dp_id/aux_id, then announce it.
+ * return value: FALSE if the channel failed
+ */
+static gboolean
+tcp_features_recv(char *tname, cc_ofrw_ctx_t *rw_ctx, char *msg,
+                  size_t msg_len)
+{
+    cc_ofchannel_key_t chann_key;
+    cc_of_ret status;
+
+    status = cc_of_msg_features_parse(msg, msg_len, &chann_key.dp_id,
+                                      &chann_key.aux_id);
+    if (status == CC_OF_OK) {
+        g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+        status = cc_ofchann_rekey(rw_ctx->sockfd, &chann_key);
+        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    }
+    if (status != CC_OF_OK) {
+        CC_LOG_ERROR("%s(%d)[%s]: features reply on tcp sockfd %d for "
+                     "dp_id-%lu aux_id-%u: %s", __FUNCTION__, __LINE__,
+                     tname, rw_ctx->sockfd, chann_key.dp_id,
+                     chann_key.aux_id, cc_of_strerror(status));
+        rw_ctx->features_pending = FALSE;
+        rw_ctx->setup_failed = TRUE;
+        return FALSE;
+    }
+    rw_ctx->chann_key = chann_key;
+    tcp_chann_announce(tname, rw_ctx);
+    return TRUE;
+}
+
+static void
+tcp_deliver_msg(char *msg, size_t msg_len, void *user_data)
+{
+    tcp_deliver_ctx_t *ctx = (tcp_deliver_ctx_t *)user_data;
+    cc_ofrw_ctx_t *rw_ctx = ctx->rw_ctx;
+    cc_of_recv_msg_t *rmsg;
+    cc_of_xid_req_t *req;
+    ofp_header_t *hdr = (ofp_header_t *)msg;
+
+    /* a hello must come first; the application sees nothing before
+     * it, or once the channel failed
+     */
+    if (rw_ctx->setup_failed) {
+        return;
+    }
+    if (!rw_ctx->hello_done) {
+        if (hdr->type == OFPT_HELLO) {
+            tcp_hello_recv(ctx->tname, rw_ctx, msg, msg_len);
+        } else {
+            CC_LOG_DEBUG("%s(%d)[%s]: dropping OF msg type %u before the "
+                         "hello on tcp sockfd %d", __FUNCTION__, __LINE__,
+                         ctx->tname, hdr->type, rw_ctx->sockfd);
+        }
+        return;
+    }
+
+    /* echo requests are answered and consumed here, as are the
+     * replies to our own; replies to the application's go on to it
+     */
+    if (cc_of_global.ofecho_offload) {
+        if (hdr->type == OFPT_ECHO_REQUEST) {
+            tcp_ctl_send(ctx->tname, rw_ctx, msg, msg_len,
+                         OFPT_ECHO_REPLY, 0);
+            return;
+        }
+        if ((hdr->type == OFPT_ECHO_REPLY) &&
+            tcp_echo_reply(rw_ctx, ntohl(hdr->xid))) {
+            return;
+        }
+    }
+
+    /* the reply is delivered as well, by the real ids */
+    if (rw_ctx->features_pending) {
+        if ((hdr->type != OFPT_FEATURES_REPLY) ||
+            !tcp_features_recv(ctx->tname, rw_ctx, msg, msg_len)) {
+            CC_LOG_DEBUG("%s(%d)[%s]: dropping OF msg type %u before the "
+                         "features reply on tcp sockfd %d", __FUNCTION__,
+                         __LINE__, ctx->tname, hdr->type, rw_ctx->sockfd);
+            return;
+        }
+    }
+
+    /* replies to cc_of_send_request, after what was received before */
+    if ((req = cc_ofrw_xid_lookup(rw_ctx, msg)) != NULL) {
+        if (rw_ctx->recv_batch_func) {
+            tcp_deliver_flush(ctx);
+        }
+        cc_ofrw_xid_reply(req, msg, msg_len);
+        return;
+    }
+
+    if (rw_ctx->recv_batch_func == NULL) {
+        rw_ctx->recv_func(rw_ctx->chann_key.dp_id, rw_ctx->chann_key.aux_id,
+                          msg, msg_len);
+        return;
+    }
+
+    /* messages stay in place in the receive buffer until the next read,
+     * so the batch only holds views into it
+     */
+    rmsg = &ctx->batch[ctx->num_batch++];
+    rmsg->dp_id = rw_ctx->chann_key.dp_id;
+    rmsg->aux_id = rw_ctx->chann_key.aux_id;
+    rmsg->of_msg = msg;
+    rmsg->of_msg_len = msg_len;
+    if (ctx->num_batch == CC_OF_RECV_BATCH_MAX) {
+        tcp_deliver_flush(ctx);
+    }
+}
+
+/* echo keepalive of a channel, on its poll thread: a channel that
+ * missed ofecho_max_missed replies in a row goes down
+ */
+static void
+tcp_echo_timer_func(char *tname, adpoll_timer_t *timer)
+{
+    cc_ofrw_ctx_t *rw_ctx = (cc_ofrw_ctx_t *)timer->data;
+
+    if (!cc_of_global.ofecho_offload ||
+        (cc_of_global.ofecho_interval_ms == 0)) {
+        /* turned off - started again by the next read if turned on */
+        rw_ctx->echo_sent_at = 0;
+        rw_ctx->echo_missed = 0;
+        rw_ctx->echo_started = FALSE;
+        return;
+    }
+
+    if (rw_ctx->echo_sent_at != 0) {
+        rw_ctx->echo_missed++;
+        if ((cc_of_global.ofecho_max_missed > 0) &&
+            (rw_ctx->echo_missed >= cc_of_global.ofecho_max_missed)) {
+            CC_LOG_INFO("%s(%d)[%s]: %u echo replies missed on channel "
+                        "dp_id-%lu aux_id-%u, tcp sockfd %d", __FUNCTION__,
+                        __LINE__, tname, rw_ctx->echo_missed,
+                        rw_ctx->chann_key.dp_id, rw_ctx->chann_key.aux_id,
+                        rw_ctx->sockfd);
+            /* frees rw_ctx with the fd entry */
+            tcp_chann_down(tname, rw_ctx->sockfd, TRUE);
+            return;
+        }
+    }
+
+    if (tcp_ctl_send(tname, rw_ctx, NULL, OFP_HEADER_LEN,
+                     OFPT_ECHO_REQUEST, rw_ctx->echo_xid + 1)) {
+        rw_ctx->echo_xid++;
+        rw_ctx->echo_sent_at = g_get_monotonic_time();
+    }
+    adp_thr_mgr_timer_add(timer, cc_of_global.ofecho_interval_ms);
+}
+
+/* first echo of a channel once it is up, at a random point of the
+ * first interval so the channels of a poll thread do not echo together
+ */
+static void
+tcp_echo_start(cc_ofrw_ctx_t *rw_ctx)
+{
+    uint32_t interval = cc_of_global.ofecho_interval_ms;
+
+    rw_ctx->echo_started = TRUE;
+    if (!cc_of_global.ofecho_offload || (interval == 0)) {
+        return;
+    }
+    /* from a random start, so they are unlikely to be among the xids
+     * the application is waiting on
+     */
+    rw_ctx->echo_xid = g_random_int();
+    adp_thr_mgr_timer_init(&rw_ctx->echo_timer, tcp_echo_timer_func,
+                           NULL, rw_ctx);
+    adp_thr_mgr_timer_add(&rw_ctx->echo_timer,
+                          (interval / 2) +
+                          g_random_int_range(0, (interval / 2) + 1));
+}
+
+/* channel, device callbacks, the OF message reassembly buffer and the
+ * requests waiting for a reply are kept with the socket's fd entry
+ */
+static cc_ofrw_ctx_t *
+tcp_rw_ctx_get(char *tname, adpoll_fd_info_t *data_p)
+{
+    cc_ofrw_ctx_t *rw_ctx = (cc_ofrw_ctx_t *)data_p->user_ctx;
+
+    if (rw_ctx == NULL) {
+        rw_ctx = cc_ofrw_ctx_new(TCP);
+        if (rw_ctx == NULL) {
+            CC_LOG_ERROR("%s(%d)[%s]: no memory for receive context of "
+                         "tcp sockfd %d", __FUNCTION__, __LINE__, tname,
+                         data_p->fd);
+            return NULL;
+        }
+        data_p->user_ctx = rw_ctx;
+        data_p->user_ctx_free = (GDestroyNotify)cc_ofrw_ctx_free;
+    }
+    return rw_ctx;
+}
+
 void process_tcpfd_pollin_func(char *tname,
                                adpoll_fd_info_t *data_p,
                                adpoll_send_msg_htbl_info_t *unused_data UNUSED)
 {
-    char buf[MAXBUF]; /* Allocate buf to read data */
+    cc_ofrw_ctx_t *rw_ctx;
+    cc_of_msg_rx_t *rx;
+    char *rx_space;
+    size_t rx_space_len;
     ssize_t read_len = 0;
-    cc_ofchannel_key_t *fd_chann_key;
-    int tcp_sockfd = data_p->fd;
-    cc_of_ret status = CC_OF_OK;
-    cc_ofrw_key_t rwkey;
-    cc_ofrw_info_t *rwinfo = NULL;
-    cc_ofdev_info_t *devinfo = NULL;
+    int tcp_sockfd;
+    tcp_deliver_ctx_t deliver_ctx;
+    int num_msgs;
     
     if (data_p == NULL) {
         CC_LOG_ERROR("%s(%d): received NULL data",
                      __FUNCTION__, __LINE__);
         return;
     }
+    tcp_sockfd = data_p->fd;
 
     CC_LOG_DEBUG("%s(%d)[%s]: Someone wants to talk TCP to me at %d!",
                  __FUNCTION__, __LINE__, tname, tcp_sockfd);
 
+    rw_ctx = tcp_rw_ctx_get(tname, data_p);
+    if (rw_ctx == NULL) {
+        return;
+    }
+    rx = rw_ctx->rx;
+    rx_space = cc_of_msg_rx_space(rx, &rx_space_len);
+
     /* Read data from socket */
-    if ((read_len = tcp_read(tcp_sockfd, buf, MAXBUF, 0, NULL, NULL)) < 0) {
+    if ((read_len = tcp_read(tcp_sockfd, rx_space, rx_space_len, 0,
+                             NULL, NULL)) < 0) {
 
         if (errno != EAGAIN) {
             CC_LOG_ERROR("%s(%d)[%s]: %s, Error while reading pkt on tcp sockfd: %d",
                          __FUNCTION__, __LINE__, tname,
                          strerror(errno), tcp_sockfd);
+            /* lost before the hello is a failed attempt to a switch */
+            tcp_chann_down(tname, tcp_sockfd, rw_ctx->hello_done);
         } else {
             CC_LOG_DEBUG("%s(%d)[%s]: EWOULDBLOCK..!", __FUNCTION__,
                          __LINE__, tname);
@@ -142,91 +611,193 @@ void process_tcpfd_pollin_func(char *tname,
     CC_LOG_DEBUG("%s(%d): RECEIVED PKT LENGTH IS %zd on channel dp_id-%d aux_id-%d",
                   __FUNCTION__, __LINE__, read_len, tcp_sockfd, tcp_sockfd);
  
-    /* Dropping all TCP control pkts */
-#if 0
+    /* nothing to deliver on a TCP control pkt (peer closed) */
     if (read_len == 0) {
-        CC_LOG_DEBUG("%s(%d): Drop this pkt as this is a TCP controll" 
-                     "pkt and not an OFP packet on channel dp_id-%d aux_id-%d",
-                     __FUNCTION__, __LINE__, tcp_sockfd, tcp_sockfd);
+        CC_LOG_DEBUG("%s(%d)[%s]: no data on tcp sockfd %d, %u bytes of a "
+                     "partial message buffered", __FUNCTION__, __LINE__,
+                     tname, tcp_sockfd, rx->len);
+        /* the peer went away - also the only way a controller hears of
+         * a switch closing, through its del_chann_func
+         */
+        tcp_chann_down(tname, tcp_sockfd, rw_ctx->hello_done);
+        return;
+    }
+
+    /* takes the htbl locks only if the htbls changed since last time */
+    cc_ofrw_ctx_update(tcp_sockfd, rw_ctx);
+
+    if (!rw_ctx->found) {
+        CC_LOG_ERROR("%s(%d)[%s]: no channel for tcp sockfd %d, dropping "
+                     "pkt", __FUNCTION__, __LINE__, tname, tcp_sockfd);
+        /* keep the stream in sync: consume the messages, drop them */
+        cc_of_msg_rx_commit(rx, read_len, NULL, NULL);
         return;
     }
-#endif
 
-    CC_LOG_DEBUG("%s(%d)[%s]: Received a message %s",
-                 __FUNCTION__, __LINE__, tname, buf);
+    /* Send each complete OF message to controller/switch via their
+     * callback; a partial one stays buffered for the next read
+     */
+    deliver_ctx.rw_ctx = rw_ctx;
+    deliver_ctx.tname = tname;
+    deliver_ctx.num_batch = 0;
+    num_msgs = cc_of_msg_rx_commit(rx, read_len, tcp_deliver_msg,
+                                   &deliver_ctx);
+    if (rw_ctx->recv_batch_func) {
+        tcp_deliver_flush(&deliver_ctx);
+    }
+
+    if (rw_ctx->setup_failed) {
+        /* counted as a failed connect - a switch gives up in the end.
+         * With an error to the peer still queued it goes once that is
+         * sent
+         */
+        if (!rw_ctx->close_pending) {
+            tcp_chann_down(tname, tcp_sockfd, FALSE);
+        }
+        return;
+    }
+    if (num_msgs < 0) {
+        /* bad header length: there is no finding the next message in
+         * the stream, the channel is unusable
+         */
+        tcp_chann_down(tname, tcp_sockfd, rw_ctx->hello_done);
+        return;
+    }
+    if (rw_ctx->hello_done && !rw_ctx->echo_started) {
+        tcp_echo_start(rw_ctx);
+    }
+    
+    CC_LOG_DEBUG("%s(%d)[%s]: Read %d msgs on tcp sockfd: %d, dp_id: %lu, aux_id: %u"
+                "and sent them to controller/switch", __FUNCTION__, __LINE__,
+                tname, num_msgs, tcp_sockfd, rw_ctx->chann_key.dp_id,
+                rw_ctx->chann_key.aux_id);
+}
+
+
+/* channel lost on its poll thread - connected, or the connect or
+ * hello failed: close it. A switch reconnects with backoff, or deletes
+ * it if that is disabled or out of retries; a controller deletes it.
+ */
+static void
+tcp_chann_down(char *tname, int tcp_sockfd, gboolean connected)
+{
+    cc_ofchannel_key_t *fd_chann_key = NULL;
+    cc_ofchannel_key_t chann_key;
+    cc_ofrw_info_t *rw_info = NULL;
+    cc_ofdev_key_t dev_key;
+    cc_ofdev_info_t *dev_info = NULL;
+    cc_of_delete_channel del_chann_func = NULL;
+    uint32_t count_retries = 0;
+    gboolean reconn;
+    gboolean notify;
+
     g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
     g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
     g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
 
-    print_ofchann_htbl();
-    status = find_ofchann_key_rwsocket(tcp_sockfd, &fd_chann_key);
-    if (status < 0) {
-        CC_LOG_ERROR("%s(%d)[%s]: could not find ofchann key for sockfd %d",
-
+    rw_info = cc_ofrw_lookup(tcp_sockfd);
+    if ((rw_info == NULL) ||
+        (find_ofchann_key_rwsocket(tcp_sockfd, &fd_chann_key) < 0)) {
+        CC_LOG_ERROR("%s(%d)[%s]: no channel for tcp sockfd %d",
                      __FUNCTION__, __LINE__, tname, tcp_sockfd);
         g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
         g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
         g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
         return;
     }
+    chann_key = *fd_chann_key;
+    dev_key = rw_info->dev_key;
+    /* a controller's application knows of the channel once it is up */
+    notify = (cc_of_global.ofdev_type == SWITCH) ||
+        (rw_info->state == CC_OF_RW_UP);
+
+    dev_info = g_hash_table_lookup(cc_of_global.ofdev_htbl, &dev_key);
+    if (dev_info != NULL) {
+        del_chann_func = dev_info->del_chann_func;
+    }
 
-    /* 
-     * Do a reverse lookup to get the dev_key 
-     * corresponding to this tcp sockfd
-     */
-    rwkey.rw_sockfd = tcp_sockfd;
-    rwinfo = g_hash_table_lookup(cc_of_global.ofrw_htbl, &rwkey);
-    if (rwinfo == NULL) {
-        CC_LOG_ERROR("%s(%d)[%s]: could not find rwsockinfo in ofrw_htbl"
-                     "for sockfd-%d", __FUNCTION__, __LINE__, tname,
-                     rwkey.rw_sockfd);
-        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
-        
-        return;
+    /* retries count from the last time the channel was up */
+    cc_ofchann_reconnect_clear(chann_key, &count_retries);
+    if (connected) {
+        count_retries = 0;
     }
+    tcp_close(tcp_sockfd);
+    reconn = (cc_of_global.ofdev_type == SWITCH) &&
+        cc_ofchann_reconnect(tname, chann_key, dev_key, TCP,
+                             count_retries + 1);
 
-    if ((cc_of_global.ofdev_type == CONTROLLER) && 
-        (rwinfo->state != CC_OF_RW_UP)){
-        /* Drop this pkt as the controller is not ready to recv mesgs on this
-         * channel yet. Let it finish initilaizing this channel info and 
-         * then send pkts. 
-         */
-        CC_LOG_DEBUG("%s(%d): Drop this pkt as the controller is not"
-                     "ready to rev mesgs on TCP channel dp_id-%lu aux_id-%u",
-                     __FUNCTION__, __LINE__, tcp_sockfd, tcp_sockfd);
-        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
-        
-		return;
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+
+    if (!reconn && notify && del_chann_func) {
+        del_chann_func(chann_key.dp_id, chann_key.aux_id);
     }
+}
+
 
-    devinfo = g_hash_table_lookup(cc_of_global.ofdev_htbl, &(rwinfo->dev_key));
-    if (devinfo == NULL) {
-        CC_LOG_ERROR("%s(%d)[%s]: could not find devinfo in ofdev_htbl"
-                     "for device", __FUNCTION__, __LINE__,tname);
+/* completion of the connect of a switch channel, on its poll thread:
+ * the socket goes up and sends what was queued on it, starting with our
+ * hello, or is reconnected later if the connect failed. The channel is
+ * up for the application after the hello exchange, see tcp_chann_ready.
+ */
+static void
+tcp_connect_done(char *tname, int tcp_sockfd)
+{
+    int sock_err = 0;
+    socklen_t optlen = sizeof(sock_err);
+    cc_ofchannel_key_t *fd_chann_key = NULL;
+    cc_ofchannel_key_t chann_key;
+    cc_ofrw_key_t rw_key;
+    cc_ofrw_info_t *rw_info = NULL;
+    cc_ofrw_info_t rw_info_new;
+    gboolean new_entry;
+
+    if (getsockopt(tcp_sockfd, SOL_SOCKET, SO_ERROR, &sock_err,
+                   &optlen) < 0) {
+        sock_err = errno;
+    }
+
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+
+    rw_info = cc_ofrw_lookup(tcp_sockfd);
+    if ((rw_info == NULL) ||
+        (find_ofchann_key_rwsocket(tcp_sockfd, &fd_chann_key) < 0)) {
+        CC_LOG_ERROR("%s(%d)[%s]: no channel for connected tcp sockfd %d",
+                     __FUNCTION__, __LINE__, tname, tcp_sockfd);
         g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
         g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
         g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
         return;
     }
-
-
-    /* Send data to controller/switch via their callback */
-    devinfo->recv_func(fd_chann_key->dp_id, fd_chann_key->aux_id, 
-                        buf, read_len);
-    
-    CC_LOG_DEBUG("%s(%d)[%s]: Read a pkt on tcp sockfd: %d, dp_id: %lu, aux_id: %u"
-                "and sent it to controller/switch", __FUNCTION__, __LINE__,
-                tname, tcp_sockfd, fd_chann_key->dp_id,
-                fd_chann_key->aux_id);
+    chann_key = *fd_chann_key;
+
+    if (sock_err == 0) {
+        /* still reconnecting until the hello exchange is done */
+        rw_key.rw_sockfd = tcp_sockfd;
+        memcpy(&rw_info_new, rw_info, sizeof(cc_ofrw_info_t));
+        rw_info_new.state = CC_OF_RW_UP;
+        update_global_htbl_lockfree(OFRW, ADD, (gpointer)&rw_key,
+                                    (gpointer)&rw_info_new, &new_entry);
+        CC_LOG_INFO("%s(%d)[%s]: channel dp_id-%lu aux_id-%u is connected "
+                    "on tcp sockfd %d", __FUNCTION__, __LINE__, tname,
+                    chann_key.dp_id, chann_key.aux_id, tcp_sockfd);
+    } else {
+        CC_LOG_ERROR("%s(%d)[%s]: %s, could not connect channel dp_id-%lu "
+                     "aux_id-%u", __FUNCTION__, __LINE__, tname,
+                     strerror(sock_err), chann_key.dp_id, chann_key.aux_id);
+    }
 
     g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
     g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
     g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
-    
+
+    /* up, and chann_up_func called, after the hello exchange */
+    if (sock_err != 0) {
+        tcp_chann_down(tname, tcp_sockfd, FALSE);
+    }
 }
 
 
@@ -235,32 +806,142 @@ void process_tcpfd_pollout_func(char *tname,
                                 adpoll_send_msg_htbl_info_t *send_msg_p)
 {
     int tcp_sockfd = 0;
+    ssize_t sent_len;
+    struct iovec iov[CC_OF_SEND_IOV_LIMIT];
+    int iovcnt = 0;
+    uint32_t max_iov, max_bytes, num_bytes = 0;
+    adpoll_send_msg_htbl_info_t *msg_p;
+    cc_ofrw_ctx_t *rw_ctx;
+    GList *elem;
+    size_t len;
 
     if (data_p == NULL) {
         CC_LOG_ERROR("%s(%d)[%s]: received NULL data",
                      __FUNCTION__, __LINE__, tname);
+        return;
     }
 
+    /* called without a message once the connect of a switch channel
+     * completes
+     */
     if (send_msg_p == NULL) {
-        CC_LOG_ERROR("%s(%d)[%s]: send message invalid",
-                     __FUNCTION__, __LINE__, tname);
+        tcp_connect_done(tname, data_p->fd);
+        return;
     }
 
     tcp_sockfd = data_p->fd;
 
-    /* Call tcpsocket send fn */
-    if (tcp_write(tcp_sockfd, send_msg_p->data, send_msg_p->data_size, 0, NULL, 0) < 0) {
-        CC_LOG_ERROR("%s(%d)[%s]: %s, error while sending pkt on tcp sockfd: %d", 
-                     __FUNCTION__, __LINE__, tname, strerror(errno), tcp_sockfd);
-        return;
+    max_iov = cc_of_global.ofsend_max_iov ?
+        cc_of_global.ofsend_max_iov : CC_OF_SEND_MAX_IOV;
+    max_bytes = cc_of_global.ofsend_max_bytes ?
+        cc_of_global.ofsend_max_bytes : CC_OF_SEND_MAX_BYTES;
+
+    /* gather send_msg_p and the messages queued behind it; the head
+     * always goes even if it alone is over max_bytes
+     */
+    g_assert(g_queue_peek_head(data_p->send_q) == send_msg_p);
+    for (elem = g_queue_peek_head_link(data_p->send_q);
+         (elem != NULL) && (iovcnt < (int)max_iov) &&
+             ((iovcnt == 0) || (num_bytes < max_bytes));
+         elem = elem->next) {
+        msg_p = (adpoll_send_msg_htbl_info_t *)elem->data;
+        /* a request waits for its reply from before it goes out */
+        if ((msg_p->req != NULL) &&
+            ((rw_ctx = tcp_rw_ctx_get(tname, data_p)) != NULL)) {
+            cc_ofrw_xid_req_add(rw_ctx, (cc_of_xid_req_t *)msg_p->req);
+            msg_p->req = NULL;
+        }
+        iov[iovcnt].iov_base = msg_p->data + msg_p->data_off;
+        iov[iovcnt].iov_len = msg_p->data_size - msg_p->data_off;
+        num_bytes += iov[iovcnt].iov_len;
+        iovcnt++;
+    }
+
+    /* Call tcpsocket send fn - resume after what was already sent */
+    sent_len = tcp_writev(tcp_sockfd, iov, iovcnt);
+    if (sent_len < 0) {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+            /* retried on the next POLLOUT */
+            return;
+        }
+        CC_LOG_ERROR("%s(%d)[%s]: %s, error while sending %d pkts on tcp sockfd: %d", 
+                     __FUNCTION__, __LINE__, tname, strerror(errno), iovcnt,
+                     tcp_sockfd);
+        /* drop them */
+        sent_len = num_bytes;
     } 
 
-    CC_LOG_DEBUG("%s(%d)[%s]: Sent a pkt out on tcp sockfd: %d", __FUNCTION__, 
-                __LINE__, tname, tcp_sockfd);
+    CC_LOG_DEBUG("%s(%d)[%s]: Sent %zd of %u bytes from %d pkts out on "
+                 "tcp sockfd: %d", __FUNCTION__, __LINE__, tname, sent_len,
+                 num_bytes, iovcnt, tcp_sockfd);
+
+    /* advance data_off of each message covered by the write */
+    for (elem = g_queue_peek_head_link(data_p->send_q);
+         (elem != NULL) && (sent_len > 0);
+         elem = elem->next) {
+        msg_p = (adpoll_send_msg_htbl_info_t *)elem->data;
+        len = MIN((size_t)sent_len, msg_p->data_size - msg_p->data_off);
+        msg_p->data_off += len;
+        sent_len -= len;
+    }
 
+    /* a failed hello: close once the error to the peer, and whatever
+     * was queued before it, is out
+     */
+    rw_ctx = (cc_ofrw_ctx_t *)data_p->user_ctx;
+    if ((rw_ctx != NULL) && rw_ctx->close_pending) {
+        msg_p = g_queue_peek_tail(data_p->send_q);
+        if (msg_p->data_off >= msg_p->data_size) {
+            tcp_chann_down(tname, tcp_sockfd, FALSE);
+        }
+    }
 }
 
 
+/* queue our hello on a new channel socket, ahead of anything the
+ * application sends on it
+ */
+static void
+tcp_hello_send(int sockfd, cc_ofdev_key_t key)
+{
+    cc_ofdev_info_t *dev_info = NULL;
+    cc_ofrw_info_t *rw_info = NULL;
+    cc_ofver_e max_ofver = CC_OFVER_1_0;
+    adpoll_thread_mgr_t *tmgr = NULL;
+    adpoll_send_msg_htbl_info_t *msg_p;
+
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    dev_info = g_hash_table_lookup(cc_of_global.ofdev_htbl, &key);
+    if (dev_info != NULL) {
+        max_ofver = dev_info->of_max_ver;
+    }
+    rw_info = cc_ofrw_lookup(sockfd);
+    if (rw_info != NULL) {
+        tmgr = rw_info->thr_mgr_p;
+    }
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+
+    if ((dev_info == NULL) || (tmgr == NULL)) {
+        CC_LOG_ERROR("%s(%d): no device or poll thread for tcp sockfd %d",
+                     __FUNCTION__, __LINE__, sockfd);
+        return;
+    }
+
+    msg_p = adp_thr_mgr_msg_alloc(CC_OF_MSG_HELLO_MAX_LEN);
+    if (msg_p == NULL) {
+        CC_LOG_ERROR("%s(%d): no memory for hello on tcp sockfd %d",
+                     __FUNCTION__, __LINE__, sockfd);
+        return;
+    }
+    msg_p->data_size = cc_of_msg_hello_build(msg_p->data,
+                           cc_of_msg_version_bitmap(max_ofver), 0);
+    if (adp_thr_mgr_send_msg(tmgr, sockfd, msg_p) < 0) {
+        adp_thr_mgr_msg_free(msg_p);
+    }
+}
+
 cc_of_ret tcp_open_clientfd(cc_ofdev_key_t key, cc_ofchannel_key_t ofchann_key)
 {
     int clientfd;
@@ -283,6 +964,7 @@ cc_of_ret tcp_open_clientfd(cc_ofdev_key_t key, cc_ofchannel_key_t ofchann_key)
                              (const void *)&optval, sizeof(int))) < 0) {
         CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, 
                      strerror(errno));
+        close(clientfd);
         return status;
     }
 
@@ -299,6 +981,7 @@ cc_of_ret tcp_open_clientfd(cc_ofdev_key_t key, cc_ofchannel_key_t ofchann_key)
     if ((status = bind(clientfd, (struct sockaddr *) &localaddr, 
                        sizeof(localaddr))) < 0) {
 	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, strerror(errno));
+	    close(clientfd);
 	    return status;
     }
  
@@ -307,11 +990,19 @@ cc_of_ret tcp_open_clientfd(cc_ofdev_key_t key, cc_ofchannel_key_t ofchann_key)
     serveraddr.sin_addr.s_addr = htonl(key.controller_ip_addr);
     serveraddr.sin_port = htons(key.controller_L4_port);
 
-    // Establish connection with server
+    /* Establish connection with server - completed on the poll thread,
+     * see tcp_connect_done
+     */
     if ((status = connect(clientfd, (struct sockaddr *) &serveraddr, 
                           sizeof(serveraddr))) < 0) {
-	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, strerror(errno));
-	    return status;
+        if (errno != EINPROGRESS) {
+	        CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__,
+                         strerror(errno));
+	        close(clientfd);
+	        return status;
+        }
+        CC_LOG_DEBUG("%s(%d): connect in progress on tcp sockfd %d",
+                     __FUNCTION__, __LINE__, clientfd);
     }
     
     // Add clientfd to a thr_mgr and update it in ofrw, ofdev htbls
@@ -323,6 +1014,8 @@ cc_of_ret tcp_open_clientfd(cc_ofdev_key_t key, cc_ofchannel_key_t ofchann_key)
     thr_msg.poll_events = POLLIN | POLLOUT;
     thr_msg.pollin_func = &process_tcpfd_pollin_func;
     thr_msg.pollout_func = &process_tcpfd_pollout_func;
+    thr_msg.io_offload = TRUE;
+    thr_msg.connect_pending = TRUE;
         
     status = cc_add_sockfd_rw_pollthr(&thr_msg, key, TCP, ofchann_key);
     if (status < 0) {
@@ -331,19 +1024,22 @@ cc_of_ret tcp_open_clientfd(cc_ofdev_key_t key, cc_ofchannel_key_t ofchann_key)
 	    close(clientfd);
 	    return status;
     }
+    tcp_hello_send(clientfd, key);
     return clientfd;
 }
 
 
-cc_of_ret tcp_open_listenfd(cc_ofdev_key_t key)
+/* open a non-blocking TCP listen socket on the device's address and
+ * port. reuseport lets the other listeners of the device share it.
+ */
+static int
+tcp_open_listenfd_one(cc_ofdev_key_t key, gboolean reuseport)
 {
     int listenfd;
-    cc_of_ret status = CC_OF_OK;
     int optval = 1;
+    int sockflags;
     struct sockaddr_in serveraddr;
-    adpoll_thr_msg_t thr_msg;
 
-    
     CC_LOG_DEBUG("%s(%d): Starting to open listen fd 0x%x:%d",
                  __FUNCTION__, __LINE__, key.controller_ip_addr,
                  key.controller_L4_port);
@@ -354,28 +1050,139 @@ cc_of_ret tcp_open_listenfd(cc_ofdev_key_t key)
     }
 
     // To prevent "Address already in use" error from bind
-    if ((status = setsockopt(listenfd, SOL_SOCKET,SO_REUSEADDR, 
-                             (const void *)&optval, sizeof(int))) < 0) {
+    if (setsockopt(listenfd, SOL_SOCKET,SO_REUSEADDR, 
+                   (const void *)&optval, sizeof(int)) < 0) {
 	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, strerror(errno));
-	    return status;
+	    close(listenfd);
+	    return -1;
     }
 
+    // The listeners of a device share its port
+    if (reuseport &&
+        (setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT,
+                    (const void *)&optval, sizeof(int)) < 0)) {
+	    CC_LOG_ERROR("%s(%d): SO_REUSEPORT: %s", __FUNCTION__, __LINE__,
+                     strerror(errno));
+	    close(listenfd);
+	    return -1;
+    }
+
+    // tcp_accept takes connections until EAGAIN
+    sockflags = fcntl(listenfd, F_GETFL, 0);
+    g_assert(sockflags != -1);
+    fcntl(listenfd, F_SETFL, sockflags | O_NONBLOCK);
+
     memset(&serveraddr, 0, sizeof(serveraddr));
     serveraddr.sin_family = AF_INET;
     serveraddr.sin_addr.s_addr = htonl(key.controller_ip_addr);
     serveraddr.sin_port = htons(key.controller_L4_port);
     
-    if ((status = bind(listenfd, (struct sockaddr *)&serveraddr, 
-                                  sizeof(serveraddr))) < 0) {
+    if (bind(listenfd, (struct sockaddr *)&serveraddr, 
+             sizeof(serveraddr)) < 0) {
 	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, strerror(errno));
-	    return status;
+	    close(listenfd);
+	    return -1;
     }
     CC_LOG_DEBUG("%s(%d): listen fd established: %d",
                  __FUNCTION__, __LINE__, listenfd);
 
-    if ((status = listen(listenfd, LISTENQ)) < 0) {
+    if (listen(listenfd, LISTENQ) < 0) {
 	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, strerror(errno));
-	    return status;
+	    close(listenfd);
+	    return -1;
+    }
+    return listenfd;
+}
+
+
+/* cc_of_global.oftcp_num_listeners listeners sharing the port with
+ * SO_REUSEPORT, each on its own rw poll thread. They are rw sockets of
+ * the device like the UDP serverfds, so they are found by fd in the
+ * ofrw_tbl and closed with the device's ofrw_socket_list. The first one
+ * is returned as the device's main_sockfd_tcp.
+ */
+static int
+tcp_open_listenfd_rw(cc_ofdev_key_t key)
+{
+    int listenfd[CC_OF_TCP_MAX_LISTENERS];
+    uint32_t num_listeners = MIN(cc_of_global.oftcp_num_listeners,
+                                 CC_OF_TCP_MAX_LISTENERS);
+    adpoll_thread_mgr_t *tmgr = NULL;
+    GList *thr_list = NULL;
+    adpoll_thr_msg_t thr_msg;
+    cc_ofchannel_key_t ckey;
+    cc_of_ret status = CC_OF_OK;
+    uint32_t i, j;
+
+    for (i = 0; i < num_listeners; i++) {
+        listenfd[i] = tcp_open_listenfd_one(key, TRUE);
+        if (listenfd[i] < 0) {
+            break;
+        }
+        status = cc_find_or_create_rw_pollthr_excl(thr_list, &tmgr);
+        if (status < 0) {
+            CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__,
+                         cc_of_strerror(status));
+            close(listenfd[i]);
+            break;
+        }
+
+        thr_msg.fd = listenfd[i];
+        thr_msg.fd_type = SOCKET;
+        thr_msg.fd_action = ADD;
+        thr_msg.poll_events = POLLIN;
+        thr_msg.pollin_func = &process_listenfd_rw_pollin_func;
+        thr_msg.pollout_func = NULL;
+        thr_msg.io_offload = FALSE;
+        thr_msg.connect_pending = FALSE;
+
+        ckey.dp_id = listenfd[i];
+        ckey.aux_id = listenfd[i];
+
+        status = cc_add_sockfd_rw_pollthr_tmgr(tmgr, &thr_msg, key, TCP,
+                                               ckey);
+        if (status < 0) {
+            CC_LOG_ERROR("%s(%d):Error adding listenfd to rw poll thread: %s",
+                         __FUNCTION__, __LINE__, cc_of_strerror(status));
+            close(listenfd[i]);
+            break;
+        }
+        thr_list = g_list_prepend(thr_list, tmgr);
+    }
+    g_list_free(thr_list);
+
+    if (i < num_listeners) {
+        /* all or none */
+        g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+        g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+        g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+        for (j = 0; j < i; j++) {
+            tcp_close(listenfd[j]);
+        }
+        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+        return -1;
+    }
+
+    CC_LOG_DEBUG("%s(%d): %u listeners on port %d", __FUNCTION__, __LINE__,
+                 num_listeners, key.controller_L4_port);
+    return listenfd[0];
+}
+
+
+cc_of_ret tcp_open_listenfd(cc_ofdev_key_t key)
+{
+    int listenfd;
+    cc_of_ret status = CC_OF_OK;
+    adpoll_thr_msg_t thr_msg;
+
+    if (cc_of_global.oftcp_num_listeners > 1) {
+        return tcp_open_listenfd_rw(key);
+    }
+
+    if ((listenfd = tcp_open_listenfd_one(key, FALSE)) < 0) {
+        return listenfd;
     }
 
     // Add tcp_listenfd to the global oflisten_pollthr
@@ -385,6 +1192,8 @@ cc_of_ret tcp_open_listenfd(cc_ofdev_key_t key)
     thr_msg.poll_events = POLLIN;
     thr_msg.pollin_func = &process_listenfd_pollin_func;
     thr_msg.pollout_func = NULL;
+    thr_msg.io_offload = FALSE;
+    thr_msg.connect_pending = FALSE;
 
     status = adp_thr_mgr_add_del_fd(cc_of_global.oflisten_pollthr_p, &thr_msg);
     if (status < 0) {
@@ -398,48 +1207,17 @@ cc_of_ret tcp_open_listenfd(cc_ofdev_key_t key)
 }
 
 
-cc_of_ret tcp_accept(int listenfd, cc_ofdev_key_t key)
+/* add one accepted connection to the htbls and a poll thread - tmgr,
+ * the listener's own thread, if it has room - and tell the controller
+ */
+static cc_of_ret
+tcp_accept_conn(int connfd, struct sockaddr_in *clientaddr,
+                cc_ofdev_key_t key, adpoll_thread_mgr_t *tmgr)
 {
-    int connfd;
     cc_of_ret status = CC_OF_OK;
-    struct sockaddr_in clientaddr;
-    socklen_t addrlen = sizeof(struct sockaddr_in);
     adpoll_thr_msg_t thr_msg;
-    cc_ofdev_info_t *dev_info = NULL;
     cc_ofchannel_key_t chann_key;
-    cc_ofrw_key_t rw_key;
-    cc_ofrw_info_t *rw_info = NULL;
-    cc_ofrw_info_t rw_info_new;
-    struct timeval timeout;
-    int sockflags;
-    timeout.tv_sec = 10;
-    timeout.tv_usec = 0;
-    gboolean new_entry;
 
-    if ((connfd = accept(listenfd, (struct sockaddr *) &clientaddr, 
-                         &addrlen)) < 0 ) {
-	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, strerror(errno));
-	    return connfd;
-    }
-
-    sockflags = fcntl(connfd,F_GETFL,0);
-    g_assert(sockflags != -1);
-    fcntl(connfd, F_SETFL, sockflags | O_NONBLOCK);
-
-    #if 0
-    if ((status = setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO,
-                              (char *)&timeout, sizeof(timeout))) < 0) {
-        CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, 
-                     strerror(errno));
-    }
-    
-    if ((status = setsockopt(connfd, SOL_SOCKET, SO_SNDTIMEO,
-                             (char *)&timeout, sizeof(timeout))) < 0) {
-        CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, 
-                     strerror(errno));
-    }
-    #endif
-    
     // Add connfd to a thr_mgr and update it in ofrw, ofdev htbls
     thr_msg.fd = connfd;
     thr_msg.fd_type = SOCKET;
@@ -447,62 +1225,87 @@ cc_of_ret tcp_accept(int listenfd, cc_ofdev_key_t key)
     thr_msg.poll_events = POLLIN | POLLOUT;
     thr_msg.pollin_func = &process_tcpfd_pollin_func;
     thr_msg.pollout_func = &process_tcpfd_pollout_func;
-    
-    status = cc_add_sockfd_rw_pollthr(&thr_msg, key, TCP, chann_key);
+    thr_msg.io_offload = TRUE;
+    thr_msg.connect_pending = FALSE;
+
+    /* the controller keys the channel by connfd, see
+     * atomic_add_upd_htbls_with_rwsocket
+     */
+    chann_key.dp_id = connfd;
+    chann_key.aux_id = connfd;
+
+    if ((tmgr != NULL) && (adp_thr_mgr_get_num_avail_sockfd(tmgr) > 0)) {
+        status = cc_add_sockfd_rw_pollthr_tmgr(tmgr, &thr_msg, key, TCP,
+                                               chann_key);
+    } else {
+        status = cc_add_sockfd_rw_pollthr(&thr_msg, key, TCP, chann_key);
+    }
     if (status < 0) {
 	    CC_LOG_ERROR("%s(%d):Error updating sockfd in global structures: %s",
-                     __FUNCTION__, __LINE__, cc_of_strerror(errno));
+                     __FUNCTION__, __LINE__, cc_of_strerror(status));
 	    close(connfd);
 	    return status;
     }
 
-    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);    
-    dev_info = g_hash_table_lookup(cc_of_global.ofdev_htbl, &key);
-
-    if (dev_info == NULL) {
-        CC_LOG_ERROR("%s(%d): could not find devinfo in ofdev_htbl"
-                     "for device", __FUNCTION__, __LINE__);
-        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
-        close(connfd);
-        return CC_OF_EHTBL;
-    }
- 
     CC_LOG_DEBUG("%s(%d): client_ip:%d port:%d\n" , 
 	    		 __FUNCTION__, __LINE__, 
-				(uint32_t)clientaddr.sin_addr.s_addr,
-				(uint16_t)(ntohs(clientaddr.sin_port)));
-    /* Notify the controller about the new TCP channel */
-    dev_info->accept_chann_func((uint64_t)connfd, (uint8_t)connfd, 
-                                (uint32_t)(clientaddr.sin_addr.s_addr),
-                                (uint16_t)(ntohs(clientaddr.sin_port)));
+				(uint32_t)clientaddr->sin_addr.s_addr,
+				(uint16_t)(ntohs(clientaddr->sin_port)));
 
-    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
-    
-
-    /* Update the ofrw_state to CC_OF_RW_UP after controller is 
-     * notified of this new channel 
+    /* the channel goes up, and the controller is told of it, once the
+     * switch's hello agrees on a version - see tcp_chann_ready
      */
+    tcp_hello_send(connfd, key);
+
+    return CC_OF_OK;
+}
+
+
+/* accepts every pending connection on listenfd - after a controller
+ * restart the switches reconnect in bursts. Returns the number of
+ * connections accepted, or -1 if accept failed before any was.
+ */
+cc_of_ret tcp_accept(int listenfd, cc_ofdev_key_t key)
+{
+    int connfd;
+    int num_conns = 0;
+    struct sockaddr_in clientaddr;
+    socklen_t addrlen;
+    adpoll_thread_mgr_t *tmgr = NULL;
+    cc_ofrw_info_t *rw_info = NULL;
+
+    /* a listener on a rw poll thread keeps its connections there */
     g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
-    
-    rw_key.rw_sockfd = connfd;
-    rw_info = g_hash_table_lookup(cc_of_global.ofrw_htbl, &rw_key);
-    if (rw_info == NULL) {
-        CC_LOG_ERROR("%s(%d): could not find rwinfo in ofrw_htbl"
-                     "for the newly connected socket %d", 
-                     __FUNCTION__, __LINE__, connfd);
-        return CC_OF_EHTBL;
-    }
-    memcpy(&rw_info_new, rw_info, sizeof(cc_ofrw_info_t));
-    rw_info_new.state = CC_OF_RW_UP;
-    update_global_htbl_lockfree(OFRW, ADD, (gpointer)&rw_key, (gpointer)&rw_info_new, 
-                       &new_entry);
-    CC_LOG_DEBUG("%s(%d): Updated TCP channel State to CC_OF_RW_UP",
-                __FUNCTION__, __LINE__);
-    print_ofrw_htbl();
-    
-    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);        
+    rw_info = cc_ofrw_lookup(listenfd);
+    if (rw_info != NULL) {
+        tmgr = rw_info->thr_mgr_p;
+    }
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+
+    for ( ; ; ) {
+        addrlen = sizeof(struct sockaddr_in);
+        connfd = accept4(listenfd, (struct sockaddr *) &clientaddr,
+                         &addrlen, SOCK_NONBLOCK);
+        if (connfd < 0) {
+            if ((errno == EINTR) || (errno == ECONNABORTED)) {
+                continue;
+            }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                break;
+            }
+            CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__,
+                         strerror(errno));
+            return ((num_conns > 0) ? num_conns : -1);
+        }
 
-    return connfd;
+        if (tcp_accept_conn(connfd, &clientaddr, key, tmgr) == CC_OF_OK) {
+            num_conns++;
+        }
+    }
+
+    CC_LOG_DEBUG("%s(%d): accepted %d connections on listenfd %d",
+                 __FUNCTION__, __LINE__, num_conns, listenfd);
+    return num_conns;
 }
 
 
@@ -512,7 +1315,7 @@ ssize_t tcp_read(int sockfd, void *buf, size_t len, int flags,
 {
     ssize_t ret_len;
     CC_LOG_DEBUG("%s(%d): Receiving from socket %d", __FUNCTION__, __LINE__, sockfd);
-    ret_len = recv(sockfd, buf, len, flags);
+    ret_len = adp_thr_mgr_recv(sockfd, buf, len, flags);
     CC_LOG_DEBUG("%s(%d): Received %zd bytes from socket %d", __FUNCTION__, __LINE__, ret_len, sockfd);
     
     return ret_len;
@@ -523,7 +1326,13 @@ ssize_t tcp_write(int sockfd, const void *buf, size_t len, int flags,
                   const struct sockaddr *dest_addr UNUSED,
                   socklen_t addrlen UNUSED)
 {
-    return send(sockfd, buf, len, flags);
+    return adp_thr_mgr_send(sockfd, buf, len, flags);
+}
+
+
+static ssize_t tcp_writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+    return adp_thr_mgr_sendv(sockfd, iov, iovcnt, MSG_NOSIGNAL);
 }
 
 
@@ -17,9 +17,18 @@
 *****************************************************
 */
 
+/* recvmmsg/sendmmsg */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "cc_of_global.h"
 #include "cc_of_priv.h"
 
+/* datagrams read by one recvmmsg / sent by one sendmmsg */
+#define CC_UDP_RECV_BATCH 32
+#define CC_UDP_SEND_BATCH 64
+
 /* Forward Declarations */
 int udp_open_clientfd(cc_ofdev_key_t key, cc_ofchannel_key_t ofchann_key);
 int udp_open_serverfd(cc_ofdev_key_t key);
@@ -28,6 +37,10 @@ ssize_t udp_read(int sockfd, void *buf, size_t len, int flags,
 	             struct sockaddr *src_addr, socklen_t *addrlen);
 ssize_t udp_write(int sockfd, const void *buf, size_t len, int flags,
 	              const struct sockaddr *dest_addr, socklen_t addrlen);
+int udp_readmm(int sockfd, struct mmsghdr *msgs, unsigned int vlen,
+               int flags);
+int udp_writemm(int sockfd, struct mmsghdr *msgs, unsigned int vlen,
+                int flags);
 
 net_svcs_t udp_sockfns = {
     udp_open_clientfd,
@@ -39,73 +52,69 @@ net_svcs_t udp_sockfns = {
 };
 
 
-static void process_udpfd_pollin_func(char *tname UNUSED,
-                                      adpoll_fd_info_t *data_p,
-                                      adpoll_send_msg_htbl_info_t *unused_data UNUSED)
+/* receive vector of a UDP socket, kept in its poll thread fd entry
+ * (adpoll_fd_info_t user_ctx) so one recvmmsg can drain the socket
+ */
+typedef struct cc_udp_rx_ {
+    struct mmsghdr       msgs[CC_UDP_RECV_BATCH];
+    struct iovec         iov[CC_UDP_RECV_BATCH];
+    struct sockaddr_in   addrs[CC_UDP_RECV_BATCH];
+    cc_of_recv_msg_t     rmsgs[CC_UDP_RECV_BATCH];
+    char                 bufs[CC_UDP_RECV_BATCH][MAXBUF];
+} cc_udp_rx_t;
+
+static cc_udp_rx_t *
+udp_rx_get(adpoll_fd_info_t *data_p)
 {
-    char buf[MAXBUF]; /* Allocate buf to read data */
-    ssize_t read_len = 0;
-    cc_ofchannel_key_t *fd_chann_key;
-    int udp_sockfd = 0, dummy_udp_sockfd = 0;
-    cc_of_ret status = CC_OF_OK;
-    cc_ofrw_key_t rwkey;
-    cc_ofrw_info_t *rwinfo = NULL;
-    cc_ofdev_info_t *devinfo = NULL;
-    struct sockaddr_in src_addr;
-    socklen_t addrlen;
-    static uint32_t random = MAX_OPEN_FILES;
-    gboolean new_conn = TRUE;
-    
-    if (data_p == NULL) {
-        CC_LOG_ERROR("%s(%d): received NULL data",
-                     __FUNCTION__, __LINE__);
-        return;
-    }
+    cc_udp_rx_t *rx;
+    int i;
 
-    /* Read data from socket */
-    udp_sockfd = data_p->fd;
-    if ((read_len = udp_read(udp_sockfd, buf, MAXBUF, 0, 
-                             (struct sockaddr *)&src_addr, &addrlen)) < 0) {
-        CC_LOG_ERROR("%s(%d): %s, Error while reading pkt on udp sockfd: %d",
-                     __FUNCTION__, __LINE__, strerror(errno), udp_sockfd);
-        return;
+    if (data_p->user_ctx) {
+        return (cc_udp_rx_t *)data_p->user_ctx;
     }
-
-    /* Dropping all UDP control pkts */
-    if (read_len == 0) {
-        CC_LOG_DEBUG("%s(%d): Drop this pkt as this is a UDP controll" 
-                     "pkt and not an OFP packet.",
-                     __FUNCTION__, __LINE__);
-        return;
+    rx = g_malloc(sizeof(cc_udp_rx_t));
+    for (i = 0; i < CC_UDP_RECV_BATCH; i++) {
+        rx->iov[i].iov_base = rx->bufs[i];
+        rx->iov[i].iov_len = MAXBUF;
     }
+    data_p->user_ctx = rx;
+    data_p->user_ctx_free = g_free;
+    return rx;
+}
+
+/* channel, device and state checks of one datagram
+ * caller holds the three htbl locks
+ * CC_OF_OK if the datagram is to be delivered on fd_chann_key
+ */
+static cc_of_ret
+udp_process_dgram(int udp_sockfd, struct sockaddr_in *src_addr,
+                  cc_ofchannel_key_t **fd_chann_key,
+                  cc_ofdev_info_t **devinfo_p)
+{
+    int dummy_udp_sockfd = 0;
+    gboolean new_conn = TRUE;
+    cc_of_ret status = CC_OF_OK;
+    cc_ofrw_info_t *rwinfo = NULL;
+    cc_ofdev_info_t *devinfo = NULL;
 
     CC_LOG_DEBUG("%s(%d):, Read pkt on udp sockfd: %d"
                  "from srcIP-%s,srcPort-%u", __FUNCTION__, __LINE__, 
-                 udp_sockfd, inet_ntoa(src_addr.sin_addr), 
-                 ntohs(src_addr.sin_port));
+                 udp_sockfd, inet_ntoa(src_addr->sin_addr), 
+                 ntohs(src_addr->sin_port));
 
-    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
-    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
-    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
- 
     if (cc_of_global.ofdev_type == CONTROLLER) {
-        GHashTableIter ofrw_iter;
-        cc_ofrw_key_t *rw_key;
-        cc_ofrw_info_t *rw_info;
-
-        /* Look up ofrw_htbl to see if this src_addr is an old/new connection */
-        g_hash_table_iter_init(&ofrw_iter, cc_of_global.ofrw_htbl);
-        while (g_hash_table_iter_next(&ofrw_iter, (gpointer *)&rw_key, 
-                                   (gpointer *)&rw_info)) {
-
-            if ((rw_info->client_addr.sin_addr.s_addr == 
-                 ntohl(src_addr.sin_addr.s_addr)) && (rw_info->client_addr.sin_port
-                 == ntohs(src_addr.sin_port))) {
-                new_conn = FALSE;
-                dummy_udp_sockfd = rw_key->rw_sockfd;
-                CC_LOG_ERROR("%s(%d):, Not a new connection",
-                             __FUNCTION__, __LINE__);
-            }
+        int rw_sockfd;
+
+        /* Look up the peer index to see if this src_addr is an old/new
+         * connection. client_addr is kept in network byte order, as
+         * recvmmsg returned it.
+         */
+        rw_sockfd = cc_ofrw_lookup_peer(src_addr);
+        if (rw_sockfd >= 0) {
+            new_conn = FALSE;
+            dummy_udp_sockfd = rw_sockfd;
+            CC_LOG_DEBUG("%s(%d):, Not a new connection",
+                         __FUNCTION__, __LINE__);
         }
 
         /* If this is a new one add an entry into the global htbls 
@@ -116,35 +125,42 @@ static void process_udpfd_pollin_func(char *tname UNUSED,
          * dp_id/aux_id for this channel willbe determined and updated.
          */
         if (new_conn) {
-            random++;
-            dummy_udp_sockfd = random;
-            cc_ofrw_key_t tmp_rwkey;
             cc_ofrw_info_t *tmp_rwinfo = NULL;
             cc_ofchannel_key_t ofchann_key;
 
+            dummy_udp_sockfd = cc_ofrw_dummy_fd_alloc();
+            if (dummy_udp_sockfd < 0) {
+                CC_LOG_ERROR("%s(%d): no dummy sockfd left for a new UDP "
+                             "channel from %s:%u, %d peers", __FUNCTION__,
+                             __LINE__, inet_ntoa(src_addr->sin_addr),
+                             ntohs(src_addr->sin_port),
+                             CC_OFRW_UDP_PEERS_MAX);
+                return CC_OF_ENOMEM;
+            }
+
             /* 
              * Do a reverse lookup to get the dev_key 
              * corresponding to this udp sockfd
              */
-            tmp_rwkey.rw_sockfd = udp_sockfd;
-            tmp_rwinfo = g_hash_table_lookup(cc_of_global.ofrw_htbl, &tmp_rwkey);
+            tmp_rwinfo = cc_ofrw_lookup(udp_sockfd);
             if (tmp_rwinfo == NULL) {
-                CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_htbl"
+                CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_tbl"
                              "for sockfd-%d", __FUNCTION__, __LINE__, 
-                             tmp_rwkey.rw_sockfd);
-
-                g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-                g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
-                g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
- 
-                return;
+                             udp_sockfd);
+                return CC_OF_EHTBL;
             }
             ofchann_key.dp_id = dummy_udp_sockfd;
             ofchann_key.aux_id = dummy_udp_sockfd;
-            atomic_add_upd_htbls_with_rwsocket(dummy_udp_sockfd, &src_addr, 
+            atomic_add_upd_htbls_with_rwsocket(dummy_udp_sockfd, src_addr, 
                                                NULL, tmp_rwinfo->dev_key, 
                                                UDP, ofchann_key);
 
+            /* the channel is sent to on the socket the switch hashed to */
+            tmp_rwinfo = cc_ofrw_lookup(dummy_udp_sockfd);
+            if (tmp_rwinfo != NULL) {
+                tmp_rwinfo->parent_sockfd = udp_sockfd;
+            }
+
         }
         /* If CONTROLLER, use dummysockfd for htbl lookups instead of the
          * main_sockfd_udp of the device. If SWITCH, each connection will
@@ -153,108 +169,162 @@ static void process_udpfd_pollin_func(char *tname UNUSED,
         udp_sockfd = dummy_udp_sockfd;
     }
 
-    status = find_ofchann_key_rwsocket(udp_sockfd, &fd_chann_key);
+    status = find_ofchann_key_rwsocket(udp_sockfd, fd_chann_key);
     if (status < 0) {
         CC_LOG_ERROR("%s(%d): could not find ofchann key for sockfd %d",
                      __FUNCTION__, __LINE__, udp_sockfd);
-
-        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
- 
-        return;
+        return status;
     }
 
     /* 
      * Do a reverse lookup to get the dev_key 
      * corresponding to this udp sockfd
      */
-    rwkey.rw_sockfd = udp_sockfd;
-    rwinfo = g_hash_table_lookup(cc_of_global.ofrw_htbl, &rwkey);
+    rwinfo = cc_ofrw_lookup(udp_sockfd);
     if (rwinfo == NULL) {
-        CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_htbl"
-                     "for sockfd-%d", __FUNCTION__, __LINE__, rwkey.rw_sockfd);
-
-        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
- 
-        return;
+        CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_tbl"
+                     "for sockfd-%d", __FUNCTION__, __LINE__, udp_sockfd);
+        return CC_OF_EHTBL;
     }
 
     devinfo = g_hash_table_lookup(cc_of_global.ofdev_htbl, &(rwinfo->dev_key));
     if (devinfo == NULL) {
         CC_LOG_ERROR("%s(%d): could not find devinfo in ofdev_htbl"
                      "for device", __FUNCTION__, __LINE__);
-
-        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
- 
-        return;
+        return CC_OF_EHTBL;
     }
+    *devinfo_p = devinfo;
 
     if (new_conn) {
         /* Notify the controller about the new UDP channel */
-        devinfo->accept_chann_func(fd_chann_key->dp_id, fd_chann_key->aux_id,
-                                   ntohl(src_addr.sin_addr.s_addr), 
-								   ntohs(src_addr.sin_port));
+        devinfo->accept_chann_func((*fd_chann_key)->dp_id,
+                                   (*fd_chann_key)->aux_id,
+                                   ntohl(src_addr->sin_addr.s_addr), 
+                                   ntohs(src_addr->sin_port));
 
         if (cc_of_global.ofdev_type == CONTROLLER) {
             /* Update the ofrw_state to CC_OF_RW_UP after controller is 
              * notified of this new channel 
              */ 
             cc_ofrw_key_t rkey;
-            cc_ofrw_info_t *rinfo = NULL;
             cc_ofrw_info_t rinfo_new;
-            rkey.rw_sockfd = udp_sockfd;
             gboolean new_entry;
 
-            rinfo = g_hash_table_lookup(cc_of_global.ofrw_htbl, &rkey);
-            if (rinfo == NULL) {
-                CC_LOG_ERROR("%s(%d): could not find rwinfo in ofrw_htbl"
-                             "for the newly connected socket %d", 
-                            __FUNCTION__, __LINE__, udp_sockfd);
-                return;
-            }
-            memcpy(&rinfo_new, rinfo, sizeof(cc_ofrw_info_t));
+            memcpy(&rinfo_new, rwinfo, sizeof(cc_ofrw_info_t));
             rinfo_new.state = CC_OF_RW_UP;
-            update_global_htbl(OFRW, ADD, (gpointer)&rkey, (gpointer)&rinfo_new, 
-                               &new_entry);
+            rkey.rw_sockfd = udp_sockfd;
+            /* ofrw_htbl_lock is already held */
+            update_global_htbl_lockfree(OFRW, ADD, (gpointer)&rkey,
+                                        (gpointer)&rinfo_new, &new_entry);
             CC_LOG_DEBUG("%s(%d): Updated UDP channel State to CC_OF_RW_UP",
                         __FUNCTION__, __LINE__);
         }
     }
 
-    if (cc_of_global.ofdev_type == CONTROLLER) {
-        /* Get the current state of channel and send the pkt to controller
-         * only if CC_OF_RW_UP is the state 
-         */
-        cc_ofrw_key_t rkey;
-        cc_ofrw_info_t *rinfo = NULL;
-        rkey.rw_sockfd = udp_sockfd;
-        rinfo = g_hash_table_lookup(cc_of_global.ofrw_htbl, &rkey);
-        if (rinfo == NULL) {
-            CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_htbl"
-                     "for sockfd-%d", __FUNCTION__, __LINE__, rkey.rw_sockfd);
-            return;
-        }
-        if (rinfo->state != CC_OF_RW_UP) {
+    /* Get the current state of channel and send the pkt to controller
+     * only if CC_OF_RW_UP is the state 
+     */
+    if ((cc_of_global.ofdev_type == CONTROLLER) &&
+        (rwinfo->state != CC_OF_RW_UP)) {
+        CC_LOG_DEBUG("%s(%d): Drop this pkt as the controller is not"
+                     "ready to rev mesgs on UDP channel dp_id-%lu aux_id-%u",
+                     __FUNCTION__, __LINE__, (*fd_chann_key)->dp_id, 
+                     (*fd_chann_key)->aux_id);
+        return CC_OF_EAGAIN;
+    }
+    return CC_OF_OK;
+}
 
-            CC_LOG_DEBUG("%s(%d): Drop this pkt as the controller is not"
-                         "ready to rev mesgs on UDP channel dp_id-%lu aux_id-%u",
-                         __FUNCTION__, __LINE__, fd_chann_key->dp_id, 
-                         fd_chann_key->aux_id);
-            return;
+/* deliver the datagrams gathered for a batch callback */
+static void
+udp_deliver_flush(cc_ofdev_info_t *devinfo, cc_of_recv_msg_t *rmsgs,
+                  int *num_rmsgs)
+{
+    if (*num_rmsgs) {
+        devinfo->recv_batch_func(rmsgs, *num_rmsgs);
+        *num_rmsgs = 0;
+    }
+}
+
+static void process_udpfd_pollin_func(char *tname UNUSED,
+                                      adpoll_fd_info_t *data_p,
+                                      adpoll_send_msg_htbl_info_t *unused_data UNUSED)
+{
+    cc_udp_rx_t *rx;
+    cc_ofchannel_key_t *fd_chann_key;
+    cc_ofdev_info_t *devinfo = NULL, *batch_devinfo = NULL;
+    cc_of_recv_msg_t *rmsg;
+    int udp_sockfd = 0, num_dgrams, num_rmsgs = 0, i;
+    
+    if (data_p == NULL) {
+        CC_LOG_ERROR("%s(%d): received NULL data",
+                     __FUNCTION__, __LINE__);
+        return;
+    }
+
+    /* Read as many datagrams as are queued, up to the vector size */
+    udp_sockfd = data_p->fd;
+    rx = udp_rx_get(data_p);
+    for (i = 0; i < CC_UDP_RECV_BATCH; i++) {
+        memset(&rx->msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+        rx->msgs[i].msg_hdr.msg_iov = &rx->iov[i];
+        rx->msgs[i].msg_hdr.msg_iovlen = 1;
+        rx->msgs[i].msg_hdr.msg_name = &rx->addrs[i];
+        rx->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+    num_dgrams = udp_readmm(udp_sockfd, rx->msgs, CC_UDP_RECV_BATCH,
+                            MSG_DONTWAIT);
+    if (num_dgrams < 0) {
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+            CC_LOG_ERROR("%s(%d): %s, Error while reading pkt on udp sockfd: %d",
+                         __FUNCTION__, __LINE__, strerror(errno), udp_sockfd);
         }
+        return;
     }
+    CC_LOG_DEBUG("%s(%d): read %d pkts on udp sockfd: %d",
+                 __FUNCTION__, __LINE__, num_dgrams, udp_sockfd);
+
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+
+    for (i = 0; i < num_dgrams; i++) {
+        /* Dropping all UDP control pkts */
+        if (rx->msgs[i].msg_len == 0) {
+            CC_LOG_DEBUG("%s(%d): Drop this pkt as this is a UDP controll" 
+                         "pkt and not an OFP packet.",
+                         __FUNCTION__, __LINE__);
+            continue;
+        }
+        if (udp_process_dgram(udp_sockfd, &rx->addrs[i], &fd_chann_key,
+                              &devinfo) != CC_OF_OK) {
+            continue;
+        }
 
-    /* Send data to controller/switch via their callback */
-    devinfo->recv_func(fd_chann_key->dp_id, fd_chann_key->aux_id, 
-                        buf, read_len);
-    CC_LOG_DEBUG("%s(%d): read a pkt on udp sockfd: %d, dp_id: %lu, aux_id: %u"
-                 "and sent it to controller/switch", __FUNCTION__, __LINE__, 
-                 udp_sockfd, fd_chann_key->dp_id, fd_chann_key->aux_id);
+        /* Send data to controller/switch via their callback */
+        if (devinfo->recv_batch_func == NULL) {
+            devinfo->recv_func(fd_chann_key->dp_id, fd_chann_key->aux_id,
+                               rx->bufs[i], rx->msgs[i].msg_len);
+        } else {
+            if (devinfo != batch_devinfo) {
+                if (batch_devinfo) {
+                    udp_deliver_flush(batch_devinfo, rx->rmsgs, &num_rmsgs);
+                }
+                batch_devinfo = devinfo;
+            }
+            rmsg = &rx->rmsgs[num_rmsgs++];
+            rmsg->dp_id = fd_chann_key->dp_id;
+            rmsg->aux_id = fd_chann_key->aux_id;
+            rmsg->of_msg = rx->bufs[i];
+            rmsg->of_msg_len = rx->msgs[i].msg_len;
+        }
+        CC_LOG_DEBUG("%s(%d): read a pkt on udp sockfd: %d, dp_id: %lu, aux_id: %u"
+                     "and sent it to controller/switch", __FUNCTION__, __LINE__, 
+                     udp_sockfd, fd_chann_key->dp_id, fd_chann_key->aux_id);
+    }
+    if (batch_devinfo) {
+        udp_deliver_flush(batch_devinfo, rx->rmsgs, &num_rmsgs);
+    }
     
     g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
     g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
@@ -263,93 +333,130 @@ static void process_udpfd_pollin_func(char *tname UNUSED,
 }
 
 
+/* destination of a queued datagram on a controller's UDP socket
+ * caller holds ofchannel and ofrw htbl locks
+ */
+static cc_of_ret
+udp_find_dest(adpoll_send_msg_htbl_info_t *msg_p,
+              struct sockaddr_in *dest_addr)
+{
+    cc_ofchannel_key_t ckey;
+    cc_ofchannel_info_t *cinfo;
+    cc_ofrw_info_t *rwinfo;
+
+    ckey.dp_id = msg_p->dp_id;
+    ckey.aux_id = msg_p->aux_id;
+
+    cinfo = g_hash_table_lookup(cc_of_global.ofchannel_htbl, &ckey);
+    if (cinfo == NULL) {
+        CC_LOG_ERROR("%s(%d): could not find channelinfo in ofchannel_htbl"
+                     "for dpID-%lu, auxID-%hu", __FUNCTION__, __LINE__, 
+                     ckey.dp_id, ckey.aux_id);
+        return CC_OF_EHTBL;
+    }
+
+    rwinfo = cc_ofrw_lookup(cinfo->rw_sockfd);
+    if (rwinfo == NULL) {
+        CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_tbl"
+                     "for sockfd-%d", __FUNCTION__, __LINE__, cinfo->rw_sockfd);
+        return CC_OF_EHTBL;
+    }
+    memcpy(dest_addr, &rwinfo->client_addr, sizeof(struct sockaddr_in));
+    return CC_OF_OK;
+}
+
 static void process_udpfd_pollout_func(char *tname UNUSED,
                                        adpoll_fd_info_t *data_p,
                                        adpoll_send_msg_htbl_info_t *send_msg_p)
 {
     int udp_sockfd = 0;
-    struct sockaddr_in dest_addr;
-    socklen_t addrlen = sizeof(dest_addr);
+    struct mmsghdr msgs[CC_UDP_SEND_BATCH];
+    struct iovec iov[CC_UDP_SEND_BATCH];
+    struct sockaddr_in dest_addrs[CC_UDP_SEND_BATCH];
+    adpoll_send_msg_htbl_info_t *msg_p, *batch_msgs[CC_UDP_SEND_BATCH];
+    uint32_t max_dgrams, max_bytes, num_bytes = 0;
+    int num_msgs = 0, num_sent, i;
+    GList *elem;
 
     if (data_p == NULL) {
         CC_LOG_ERROR("%s(%d): received NULL data",
                      __FUNCTION__, __LINE__);
+        return;
     }
 
     if (send_msg_p == NULL) {
         CC_LOG_ERROR("%s(%d): send message invalid",
                      __FUNCTION__, __LINE__);
+        return;
     }
    
     udp_sockfd = data_p->fd;
 
+    /* same coalescing limits as the TCP writev */
+    max_dgrams = cc_of_global.ofsend_max_iov ?
+        cc_of_global.ofsend_max_iov : CC_OF_SEND_MAX_IOV;
+    max_dgrams = MIN(max_dgrams, CC_UDP_SEND_BATCH);
+    max_bytes = cc_of_global.ofsend_max_bytes ?
+        cc_of_global.ofsend_max_bytes : CC_OF_SEND_MAX_BYTES;
+
     g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
     g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
- 
-    if (cc_of_global.ofdev_type == CONTROLLER) {
-        cc_ofchannel_key_t ckey;
-        cc_ofchannel_info_t *cinfo;
-        cc_ofrw_key_t rwkey;
-        cc_ofrw_info_t *rwinfo;
-        ckey.dp_id = send_msg_p->dp_id;
-        ckey.aux_id = send_msg_p->aux_id;
-
-        cinfo = g_hash_table_lookup(cc_of_global.ofchannel_htbl, &ckey);
-        if (cinfo == NULL) {
-            CC_LOG_ERROR("%s(%d): could not find channelinfo in ofchannel_htbl"
-                     "for dpID-%lu, auxID-%hu", __FUNCTION__, __LINE__, 
-                      ckey.dp_id, ckey.aux_id);
-            
-            g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-            g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
- 
-            return;
-        }
-
-        rwkey.rw_sockfd = cinfo->rw_sockfd;
-        rwinfo = g_hash_table_lookup(cc_of_global.ofrw_htbl, &rwkey);
-        if (rwinfo == NULL) {
-            CC_LOG_ERROR("%s(%d): could not find rwsockinfo in ofrw_htbl"
-                         "for sockfd-%d", __FUNCTION__, __LINE__, rwkey.rw_sockfd);
 
-            g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-            g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
- 
-            return;
+    /* one datagram per queued message, starting with send_msg_p.
+     * A SWITCH socket is connected and needs no destination.
+     */
+    g_assert(g_queue_peek_head(data_p->send_q) == send_msg_p);
+    for (elem = g_queue_peek_head_link(data_p->send_q);
+         (elem != NULL) && (num_msgs < (int)max_dgrams) &&
+             ((num_msgs == 0) || (num_bytes < max_bytes));
+         elem = elem->next) {
+        msg_p = (adpoll_send_msg_htbl_info_t *)elem->data;
+        memset(&msgs[num_msgs].msg_hdr, 0, sizeof(struct msghdr));
+        if (cc_of_global.ofdev_type == CONTROLLER) {
+            if (udp_find_dest(msg_p, &dest_addrs[num_msgs]) < 0) {
+                /* no destination - drop it */
+                msg_p->data_off = msg_p->data_size;
+                continue;
+            }
+            msgs[num_msgs].msg_hdr.msg_name = &dest_addrs[num_msgs];
+            msgs[num_msgs].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
         }
-        
-        memcpy(&dest_addr, &rwinfo->client_addr, addrlen);
-
-    } else {
+        iov[num_msgs].iov_base = msg_p->data;
+        iov[num_msgs].iov_len = msg_p->data_size;
+        msgs[num_msgs].msg_hdr.msg_iov = &iov[num_msgs];
+        msgs[num_msgs].msg_hdr.msg_iovlen = 1;
+        batch_msgs[num_msgs] = msg_p;
+        num_bytes += msg_p->data_size;
+        num_msgs++;
+    }
 
-        if (getpeername(udp_sockfd,(struct sockaddr *)&dest_addr, &addrlen) < 0) {
-            CC_LOG_ERROR("%s(%d): %s, error while getting peername for udp sockfd: %d",
-                          __FUNCTION__, __LINE__, strerror(errno), udp_sockfd);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
 
-            g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-            g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
- 
-            return;
-        }
+    if (num_msgs == 0) {
+        return;
     }
 
     /* Call udpsocket send fn */
-    if (udp_write(udp_sockfd, send_msg_p->data, send_msg_p->data_size, 
-                  0, (struct sockaddr *)&dest_addr, addrlen) < 0) {
+    num_sent = udp_writemm(udp_sockfd, msgs, num_msgs, 0);
+    if (num_sent < 0) {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+            /* retried on the next POLLOUT */
+            return;
+        }
         CC_LOG_ERROR("%s(%d): %s, error while sending pkt on udp sockfd: %d", 
                      __FUNCTION__, __LINE__, strerror(errno), udp_sockfd);
-
-        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
- 
-        return;
+        /* drop the datagram that failed, the rest go on the next call */
+        num_sent = 1;
     }
 
-    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
-    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    /* a datagram goes out whole */
+    for (i = 0; i < num_sent; i++) {
+        batch_msgs[i]->data_off = batch_msgs[i]->data_size;
+    }
 
-    CC_LOG_DEBUG("%s(%d): sent a pkt out on udp sockfd: %d", __FUNCTION__, 
-                __LINE__, udp_sockfd);
+    CC_LOG_DEBUG("%s(%d): sent %d of %d pkts out on udp sockfd: %d",
+                 __FUNCTION__, __LINE__, num_sent, num_msgs, udp_sockfd);
 }
 
 
@@ -408,6 +515,8 @@ int udp_open_clientfd(cc_ofdev_key_t key, cc_ofchannel_key_t ofchann_key)
     thr_msg.poll_events = POLLIN | POLLOUT;
     thr_msg.pollin_func = &process_udpfd_pollin_func;
     thr_msg.pollout_func = &process_udpfd_pollout_func;
+    thr_msg.io_offload = FALSE;
+    thr_msg.connect_pending = FALSE;
         
     status = cc_add_sockfd_rw_pollthr(&thr_msg, key, UDP, ofchann_key);
     if (status < 0) {
@@ -422,7 +531,12 @@ int udp_open_clientfd(cc_ofdev_key_t key, cc_ofchannel_key_t ofchann_key)
 }
 
 
-int udp_open_serverfd(cc_ofdev_key_t key)
+/* open one UDP server socket and add it to a poll thread that is not
+ * on excl_list
+ */
+static int
+udp_open_serverfd_thr(cc_ofdev_key_t key, gboolean reuseport,
+                      GList *excl_list, adpoll_thread_mgr_t **tmgr)
 {
     int serverfd;
     int optval = 1;
@@ -432,13 +546,24 @@ int udp_open_serverfd(cc_ofdev_key_t key)
     cc_ofchannel_key_t ckey;
  
     if ((serverfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, cc_of_strerror(errno));
+	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, strerror(errno));
 	    return -1;
     }
 
     // To prevent "Address already in use" error from bind
     if (setsockopt(serverfd, SOL_SOCKET,SO_REUSEADDR, (const void *)&optval, sizeof(int)) < 0) {
-	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, cc_of_strerror(errno));
+	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, strerror(errno));
+	    close(serverfd);
+	    return -1;
+    }
+
+    // The sockets of a device share its port
+    if (reuseport &&
+        (setsockopt(serverfd, SOL_SOCKET, SO_REUSEPORT,
+                    (const void *)&optval, sizeof(int)) < 0)) {
+	    CC_LOG_ERROR("%s(%d): SO_REUSEPORT: %s", __FUNCTION__, __LINE__,
+                     strerror(errno));
+	    close(serverfd);
 	    return -1;
     }
 
@@ -449,40 +574,92 @@ int udp_open_serverfd(cc_ofdev_key_t key)
     
 
     if (bind(serverfd, (struct sockaddr *)&serveraddr, sizeof(serveraddr)) < 0) {
-	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, cc_of_strerror(errno));
+	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__, strerror(errno));
+	    close(serverfd);
 	    return -1;
     }
     
     CC_LOG_DEBUG("%s(%d): UDP SERVER SOCKET %d", __FUNCTION__,
                  __LINE__, serverfd);
 
+    status = cc_find_or_create_rw_pollthr_excl(excl_list, tmgr);
+    if (status < 0) {
+	    CC_LOG_ERROR("%s(%d): %s", __FUNCTION__, __LINE__,
+                     cc_of_strerror(status));
+	    close(serverfd);
+	    return -1;
+    }
 
-    // Add udpfd to a pollthrmgr
+    // Add udpfd to the pollthrmgr
     thr_msg.fd = serverfd;
     thr_msg.fd_type = SOCKET;
     thr_msg.fd_action = ADD;
     thr_msg.poll_events = POLLIN|POLLOUT;
     thr_msg.pollin_func = &process_udpfd_pollin_func;
     thr_msg.pollout_func = &process_udpfd_pollout_func;
+    thr_msg.io_offload = FALSE;
+    thr_msg.connect_pending = FALSE;
 
     ckey.dp_id = serverfd;
     ckey.aux_id = serverfd;
 
-    /* A single udp serverfd will serve multiple channnels/clients from
-     * switches. This will be stored as dev_info->main_sockfd_udp. 
-     */
-    status = cc_add_sockfd_rw_pollthr(&thr_msg, key, UDP, ckey);
+    status = cc_add_sockfd_rw_pollthr_tmgr(*tmgr, &thr_msg, key, UDP, ckey);
     if (status < 0) {
 	    CC_LOG_ERROR("%s(%d):Error updating udp sockfd in global structures: %s",
-                     __FUNCTION__, __LINE__, cc_of_strerror(errno));
+                     __FUNCTION__, __LINE__, cc_of_strerror(status));
 	    close(serverfd);
-	    return status;
+	    return -1;
     }
 
     return serverfd;
 }
 
 
+/* A udp serverfd serves multiple channels/clients from switches. With
+ * cc_of_global.ofudp_num_sockets above 1 the device gets that many, bound
+ * to the same port with SO_REUSEPORT and each on its own poll thread, so
+ * the kernel spreads the switches over the threads by their address. A
+ * switch keeps hashing to the same socket, which its dummy channel is
+ * tied to. The first one is stored as dev_info->main_sockfd_udp, all of
+ * them are on the device's ofrw_socket_list.
+ */
+int udp_open_serverfd(cc_ofdev_key_t key)
+{
+    int serverfd[CC_OF_UDP_MAX_SOCKETS];
+    uint32_t num_sockets = cc_of_global.ofudp_num_sockets;
+    adpoll_thread_mgr_t *tmgr = NULL;
+    GList *thr_list = NULL;
+    uint32_t i, j;
+
+    num_sockets = CLAMP(num_sockets, 1, CC_OF_UDP_MAX_SOCKETS);
+    for (i = 0; i < num_sockets; i++) {
+        serverfd[i] = udp_open_serverfd_thr(key, (num_sockets > 1),
+                                            thr_list, &tmgr);
+        if (serverfd[i] < 0) {
+            break;
+        }
+        thr_list = g_list_prepend(thr_list, tmgr);
+    }
+    g_list_free(thr_list);
+
+    if (i < num_sockets) {
+        /* all or none */
+        g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+        g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+        g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+        for (j = 0; j < i; j++) {
+            udp_close(serverfd[j]);
+        }
+        g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+        g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+        g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+        return -1;
+    }
+
+    return serverfd[0];
+}
+
+
 ssize_t udp_read(int sockfd, void *buf, size_t len, int flags,
 	         struct sockaddr *src_addr, socklen_t *addrlen)
 {
@@ -496,6 +673,20 @@ ssize_t udp_write(int sockfd, const void *buf, size_t len, int flags,
     return sendto(sockfd, buf, len, flags, dest_addr, addrlen);
 }
 
+
+int udp_readmm(int sockfd, struct mmsghdr *msgs, unsigned int vlen,
+               int flags)
+{
+    return recvmmsg(sockfd, msgs, vlen, flags, NULL);
+}
+
+
+int udp_writemm(int sockfd, struct mmsghdr *msgs, unsigned int vlen,
+                int flags)
+{
+    return sendmmsg(sockfd, msgs, vlen, flags);
+}
+
 //caller should acqure three htbl locks
 int udp_close(int sockfd)
 {
@@ -0,0 +1,689 @@
+/*
+*****************************************************
+**      CodeChix ONF Driver (LibCCOF)
+**      codechix.org - May the code be with you...
+**              Sept. 15, 2013
+*****************************************************
+**
+** License:        Apache 2.0 (ONF requirement)
+** Version:        0.0
+** LibraryName:    LibCCOF
+** GLIB License:   GNU LGPL
+** Description:    Test harness for OF channels over TCP for LibCCOF:
+**                 the library on one end, a plain socket on the other
+** Assumptions:    N/A
+** Testing:        N/A
+** Authors:        Deepa Karnad Dhurka
+**
+*****************************************************
+*/
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "cc_of_lib.h"
+#include "cc_of_global.h"
+#include "cc_of_msg.h"
+#include "cc_log.h"
+
+#ifndef UNUSED
+#define UNUSED __attribute__ ((__unused__))
+#endif
+
+extern cc_of_global_t cc_of_global;
+
+/* 127.0.0.1 on both ends */
+#define TEST_IP 0x7F000001
+
+/* Fixture data: what the library told the application */
+typedef struct test_data_ {
+    of_dev_type_e dev_type;
+    uint16_t      port;         /* of the device */
+    gint          num_accept;
+    gint          num_del;
+    gint          num_up;
+    gint          num_recv;
+    uint64_t      dp_id;        /* of the last accept */
+    uint8_t       aux_id;
+    uint8_t       recv_type;    /* of the last message received */
+    uint32_t      recv_xid;
+} test_data_t;
+
+/* the callbacks have no user data */
+static test_data_t *test_cur;
+
+static int
+test_recv_func(uint64_t dp_id UNUSED, uint8_t aux_id UNUSED,
+               void *of_msg, size_t of_msg_len UNUSED)
+{
+    ofp_header_t *hdr = (ofp_header_t *)of_msg;
+
+    test_cur->recv_type = hdr->type;
+    test_cur->recv_xid = ntohl(hdr->xid);
+    g_atomic_int_inc(&test_cur->num_recv);
+    return 0;
+}
+
+static int
+test_accept_func(uint64_t dp_id, uint8_t aux_id,
+                 uint32_t client_ip UNUSED, uint16_t client_port UNUSED)
+{
+    test_cur->dp_id = dp_id;
+    test_cur->aux_id = aux_id;
+    g_atomic_int_inc(&test_cur->num_accept);
+    return 0;
+}
+
+static int
+test_del_func(uint64_t dp_id UNUSED, uint8_t aux_id UNUSED)
+{
+    g_atomic_int_inc(&test_cur->num_del);
+    return 0;
+}
+
+static int
+test_up_func(uint64_t dp_id UNUSED, uint8_t aux_id UNUSED)
+{
+    g_atomic_int_inc(&test_cur->num_up);
+    return 0;
+}
+
+/* wait up to ms for cond, checked every ms */
+#define TEST_WAIT_FOR(cond, ms)                                         \
+    do {                                                                \
+        int wait_ms_ = (ms);                                            \
+        while (!(cond) && (wait_ms_-- > 0)) {                           \
+            g_usleep(1000);                                             \
+        }                                                               \
+    } while (0)
+
+/*  Function: chann_start
+ *  This is a fixture function.
+ *  Initialize the library as the device type of the test and register
+ *  a device on the test's port
+ */
+static void
+chann_start(test_data_t *tdata,
+            gconstpointer tudata)
+{
+    memset(tdata, 0, sizeof(test_data_t));
+    tdata->dev_type = (strstr((char *)tudata, "switch") != NULL) ?
+        SWITCH : CONTROLLER;
+    tdata->port = (uint16_t)atoi(strrchr((char *)tudata, ':') + 1);
+    test_cur = tdata;
+
+    g_assert(cc_of_lib_init(tdata->dev_type) == CC_OF_OK);
+//    cc_of_debug_toggle(TRUE);    //enable if debugging test code
+    g_assert(cc_of_dev_register(TEST_IP, TEST_IP, tdata->port,
+                                CC_OFVER_1_3_1, test_recv_func,
+                                test_accept_func,
+                                test_del_func) == CC_OF_OK);
+    if (tdata->dev_type == SWITCH) {
+        g_assert(cc_of_dev_register_chann_up(TEST_IP, TEST_IP, tdata->port,
+                                             test_up_func) == CC_OF_OK);
+    }
+}
+
+/* Function that tears down the test and cleans up */
+static void
+chann_end(test_data_t *tdata UNUSED,
+          gconstpointer tudata UNUSED)
+{
+    g_test_message("In CHANN_END");
+    cc_of_lib_free();
+    test_cur = NULL;
+}
+
+/* plain socket end of a channel */
+static int
+test_connect(uint16_t port)
+{
+    struct sockaddr_in addr;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    g_assert(fd >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(TEST_IP);
+    addr.sin_port = htons(port);
+    g_assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    return fd;
+}
+
+static int
+test_listen(uint16_t port)
+{
+    struct sockaddr_in addr;
+    int fd, optval = 1;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    g_assert(fd >= 0);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(TEST_IP);
+    addr.sin_port = htons(port);
+    g_assert(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    g_assert(listen(fd, 16) == 0);
+    return fd;
+}
+
+/* accept within timeout_ms, -1 if none */
+static int
+test_accept(int listen_fd, int timeout_ms)
+{
+    struct pollfd pfd;
+
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+        return -1;
+    }
+    return accept(listen_fd, NULL, NULL);
+}
+
+/* read one OF message into buf within timeout_ms.
+ * return value: its length, 0 on EOF, -1 on timeout
+ */
+static int
+test_read_msg(int fd, char *buf, size_t buf_len, int timeout_ms)
+{
+    struct pollfd pfd;
+    size_t len = 0, msg_len = OFP_HEADER_LEN;
+    ssize_t rv;
+
+    while (len < msg_len) {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, timeout_ms) <= 0) {
+            return -1;
+        }
+        rv = read(fd, buf + len, msg_len - len);
+        if (rv <= 0) {
+            return 0;
+        }
+        len += rv;
+        if (len == OFP_HEADER_LEN) {
+            msg_len = ntohs(((ofp_header_t *)buf)->length);
+            g_assert_cmpuint(msg_len, >=, OFP_HEADER_LEN);
+            g_assert_cmpuint(msg_len, <=, buf_len);
+        }
+    }
+    return (int)len;
+}
+
+/* header only message */
+static void
+test_write_msg(int fd, uint8_t type, uint32_t xid)
+{
+    ofp_header_t hdr;
+
+    hdr.version = OFP_VERSION_1_3;
+    hdr.type = type;
+    hdr.length = htons(OFP_HEADER_LEN);
+    hdr.xid = htonl(xid);
+    g_assert(write(fd, &hdr, sizeof(hdr)) == sizeof(hdr));
+}
+
+/* read messages until one of type, within timeout_ms */
+static int
+test_read_type(int fd, char *buf, size_t buf_len, uint8_t type,
+               int timeout_ms)
+{
+    gint64 end = g_get_monotonic_time() + (gint64)timeout_ms * 1000;
+    int len, left;
+
+    while ((left = (int)((end - g_get_monotonic_time()) / 1000)) > 0) {
+        len = test_read_msg(fd, buf, buf_len, left);
+        if (len <= 0) {
+            return len;
+        }
+        if (((ofp_header_t *)buf)->type == type) {
+            return len;
+        }
+    }
+    return -1;
+}
+
+/* hello exchange from the plain socket end */
+static void
+test_hello(int fd)
+{
+    char buf[256];
+
+    g_assert_cmpint(test_read_msg(fd, buf, sizeof(buf), 1000), >, 0);
+    g_assert_cmpuint(((ofp_header_t *)buf)->type, ==, OFPT_HELLO);
+    test_write_msg(fd, OFPT_HELLO, 1);
+}
+
+/* connect and wait for the controller to accept */
+static int
+test_connect_up(test_data_t *tdata)
+{
+    int fd;
+
+    g_usleep(100000);    /* listen is up */
+    fd = test_connect(tdata->port);
+    test_hello(fd);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_accept) == 1, 2000);
+    g_assert_cmpint(tdata->num_accept, ==, 1);
+    return fd;
+}
+
+//tc_1 - controller: a switch that closes its channel is deleted and the
+//       application is told through its del_chann_func
+static void
+chann_tc_1(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    int fd;
+
+    fd = test_connect_up(tdata);
+
+    test_write_msg(fd, OFPT_PACKET_IN, 5);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_recv) == 1, 2000);
+    g_assert_cmpuint(tdata->recv_xid, ==, 5);
+
+    close(fd);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_del) == 1, 2000);
+    g_assert_cmpint(tdata->num_del, ==, 1);
+
+    g_assert_cmpint(cc_of_get_conn_state(tdata->dp_id, tdata->aux_id,
+                                         NULL, NULL), ==, CC_OF_EINVAL);
+}
+
+//tc_2 - controller: replies to the library's echoes are consumed and
+//       update the RTT, other echo replies go to the application
+static void
+chann_tc_2(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    char buf[256];
+    uint32_t xid, rtt_us, srtt_us, min_rtt_us;
+    int fd;
+
+    g_assert(cc_of_set_echo(TRUE, 50, 0) == CC_OF_OK);
+    fd = test_connect_up(tdata);
+    g_assert_cmpint(cc_of_get_conn_rtt(tdata->dp_id, tdata->aux_id,
+                                       &rtt_us, &srtt_us, &min_rtt_us),
+                    ==, CC_OF_EAGAIN);
+
+    /* not a reply to the library's echo request */
+    g_assert_cmpint(test_read_type(fd, buf, sizeof(buf), OFPT_ECHO_REQUEST,
+                                   1000), >, 0);
+    xid = ntohl(((ofp_header_t *)buf)->xid);
+    test_write_msg(fd, OFPT_ECHO_REPLY, xid + 7);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_recv) == 1, 2000);
+    g_assert_cmpuint(tdata->recv_type, ==, OFPT_ECHO_REPLY);
+    g_assert_cmpuint(tdata->recv_xid, ==, xid + 7);
+
+    /* the reply to it */
+    g_usleep(20000);
+    test_write_msg(fd, OFPT_ECHO_REPLY, xid);
+    TEST_WAIT_FOR(cc_of_get_conn_rtt(tdata->dp_id, tdata->aux_id,
+                                     &rtt_us, &srtt_us,
+                                     &min_rtt_us) == CC_OF_OK, 2000);
+    g_assert_cmpuint(rtt_us, >=, 20000);
+    g_assert_cmpuint(srtt_us, ==, rtt_us);
+    g_assert_cmpuint(min_rtt_us, ==, rtt_us);
+
+    /* a quicker one */
+    g_assert_cmpint(test_read_type(fd, buf, sizeof(buf), OFPT_ECHO_REQUEST,
+                                   1000), >, 0);
+    xid = ntohl(((ofp_header_t *)buf)->xid);
+    test_write_msg(fd, OFPT_ECHO_REPLY, xid);
+    TEST_WAIT_FOR((cc_of_get_conn_rtt(tdata->dp_id, tdata->aux_id,
+                                      &rtt_us, &srtt_us,
+                                      &min_rtt_us) == CC_OF_OK) &&
+                  (min_rtt_us < 20000), 2000);
+    g_assert_cmpuint(min_rtt_us, ==, rtt_us);
+    g_assert_cmpuint(srtt_us, >, rtt_us);
+
+    g_assert_cmpint(g_atomic_int_get(&tdata->num_recv), ==, 1);
+    close(fd);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_del) == 1, 2000);
+}
+
+//tc_3 - controller: a message with a bad header length takes the
+//       channel down
+static void
+chann_tc_3(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    ofp_header_t hdr;
+    char buf[256];
+    int fd;
+
+    fd = test_connect_up(tdata);
+
+    g_test_expect_message(CC_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                          "*bad OF message length*");
+    hdr.version = OFP_VERSION_1_3;
+    hdr.type = OFPT_PACKET_IN;
+    hdr.length = htons(OFP_HEADER_LEN / 2);
+    hdr.xid = htonl(5);
+    g_assert(write(fd, &hdr, sizeof(hdr)) == sizeof(hdr));
+    test_write_msg(fd, OFPT_PACKET_IN, 6);
+
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_del) == 1, 2000);
+    g_assert_cmpint(tdata->num_del, ==, 1);
+    g_test_assert_expected_messages();
+    g_assert_cmpint(g_atomic_int_get(&tdata->num_recv), ==, 0);
+    g_assert_cmpint(cc_of_get_conn_state(tdata->dp_id, tdata->aux_id,
+                                         NULL, NULL), ==, CC_OF_EINVAL);
+
+    /* and the socket is closed */
+    g_assert_cmpint(test_read_type(fd, buf, sizeof(buf), OFPT_HELLO,
+                                   1000), ==, 0);
+    close(fd);
+}
+
+//tc_4 - controller: echo requests are answered by the library, with
+//       interval 0 it sends none
+static void
+chann_tc_4(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    char buf[256];
+    int fd;
+
+    g_assert(cc_of_set_echo(TRUE, 0, 3) == CC_OF_OK);
+    fd = test_connect_up(tdata);
+
+    test_write_msg(fd, OFPT_ECHO_REQUEST, 7);
+    g_assert_cmpint(test_read_msg(fd, buf, sizeof(buf), 1000), ==,
+                    OFP_HEADER_LEN);
+    g_assert_cmpuint(((ofp_header_t *)buf)->type, ==, OFPT_ECHO_REPLY);
+    g_assert_cmpuint(ntohl(((ofp_header_t *)buf)->xid), ==, 7);
+
+    g_assert_cmpint(test_read_msg(fd, buf, sizeof(buf), 300), ==, -1);
+    g_assert_cmpint(g_atomic_int_get(&tdata->num_recv), ==, 0);
+    close(fd);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_del) == 1, 2000);
+}
+
+//tc_5 - controller: a channel missing max_missed echo replies in a row
+//       is taken down
+static void
+chann_tc_5(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    char buf[256];
+    int fd, num_echo = 0;
+
+    g_assert(cc_of_set_echo(TRUE, 50, 2) == CC_OF_OK);
+    fd = test_connect_up(tdata);
+
+    /* echo requests until the channel is closed */
+    while (test_read_type(fd, buf, sizeof(buf), OFPT_ECHO_REQUEST,
+                          1000) > 0) {
+        num_echo++;
+    }
+    g_assert_cmpint(num_echo, ==, 2);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_del) == 1, 2000);
+    g_assert_cmpint(tdata->num_del, ==, 1);
+    g_assert_cmpint(cc_of_get_conn_state(tdata->dp_id, tdata->aux_id,
+                                         NULL, NULL), ==, CC_OF_EINVAL);
+    close(fd);
+}
+
+//tc_6 - controller: with offload turned off the library stops its echoes
+//       and echo requests go to the application
+static void
+chann_tc_6(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    char buf[256];
+    int fd;
+
+    g_assert(cc_of_set_echo(TRUE, 50, 0) == CC_OF_OK);
+    fd = test_connect_up(tdata);
+    g_assert_cmpint(test_read_type(fd, buf, sizeof(buf), OFPT_ECHO_REQUEST,
+                                   1000), >, 0);
+
+    g_assert(cc_of_set_echo(FALSE, 50, 0) == CC_OF_OK);
+    /* at most the one already queued */
+    while (test_read_msg(fd, buf, sizeof(buf), 150) > 0);
+    g_assert_cmpint(test_read_msg(fd, buf, sizeof(buf), 300), ==, -1);
+
+    test_write_msg(fd, OFPT_ECHO_REQUEST, 9);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_recv) == 1, 2000);
+    g_assert_cmpuint(tdata->recv_type, ==, OFPT_ECHO_REQUEST);
+    g_assert_cmpuint(tdata->recv_xid, ==, 9);
+    g_assert_cmpint(test_read_msg(fd, buf, sizeof(buf), 200), ==, -1);
+    close(fd);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_del) == 1, 2000);
+}
+
+#define TEST_DPID 0x77
+
+static cc_of_conn_state_e
+test_conn_state(uint32_t *count_retries)
+{
+    cc_of_conn_state_e state = MAX_CONN_STATE;
+
+    g_assert_cmpint(cc_of_get_conn_state(TEST_DPID, 0, &state,
+                                         count_retries), ==, CC_OF_OK);
+    return state;
+}
+
+/* switch: accept its channel and do the hello */
+static int
+test_accept_up(test_data_t *tdata, int listen_fd, gint num_up)
+{
+    int fd;
+
+    fd = test_accept(listen_fd, 2000);
+    g_assert_cmpint(fd, >=, 0);
+    test_hello(fd);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_up) == num_up, 2000);
+    g_assert_cmpint(tdata->num_up, ==, num_up);
+    return fd;
+}
+
+//tc_7 - switch: a channel the controller closes is reconnected after a
+//       backoff, and cc_of_get_conn_state shows the retry
+static void
+chann_tc_7(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    uint32_t count_retries = UINT32_MAX;
+    cc_of_conn_state_e state;
+    int listen_fd, fd;
+
+    g_assert(cc_of_set_reconnect(200, 1000, 0) == CC_OF_OK);
+    listen_fd = test_listen(tdata->port);
+    g_assert(cc_of_create_channel(TEST_IP, TEST_IP, tdata->port, TEST_DPID,
+                                  0, TCP) == CC_OF_OK);
+    fd = test_accept_up(tdata, listen_fd, 1);
+    g_assert_cmpint(test_conn_state(&count_retries), ==, CC_OF_CONN_UP);
+    g_assert_cmpuint(count_retries, ==, 0);
+
+    /* waits 100 to 200ms before the first retry */
+    close(fd);
+    TEST_WAIT_FOR(test_conn_state(NULL) != CC_OF_CONN_UP, 2000);
+    g_assert_cmpint(test_conn_state(&count_retries), ==, CC_OF_CONN_BACKOFF);
+    g_assert_cmpuint(count_retries, ==, 1);
+    g_assert_cmpint(test_accept(listen_fd, 50), ==, -1);
+
+    fd = test_accept_up(tdata, listen_fd, 2);
+    TEST_WAIT_FOR(test_conn_state(NULL) == CC_OF_CONN_UP, 2000);
+    state = test_conn_state(&count_retries);
+    g_assert_cmpint(state, ==, CC_OF_CONN_UP);
+    g_assert_cmpuint(count_retries, ==, 1);
+    g_assert_cmpint(g_atomic_int_get(&tdata->num_del), ==, 0);
+
+    close(fd);
+    close(listen_fd);
+}
+
+//tc_8 - switch: a channel that never gets through the hello is deleted
+//       after max_retries attempts
+static void
+chann_tc_8(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    uint32_t count_retries = 0, max_seen = 0;
+    char buf[256];
+    int listen_fd, fd, num_accept = 0;
+
+    g_assert(cc_of_set_reconnect(20, 80, 3) == CC_OF_OK);
+    listen_fd = test_listen(tdata->port);
+    g_assert(cc_of_create_channel(TEST_IP, TEST_IP, tdata->port, TEST_DPID,
+                                  0, TCP) == CC_OF_OK);
+
+    /* closed after its hello, before ours */
+    while ((fd = test_accept(listen_fd, 500)) >= 0) {
+        num_accept++;
+        g_assert_cmpint(test_read_msg(fd, buf, sizeof(buf), 1000), >, 0);
+        close(fd);
+        if (cc_of_get_conn_state(TEST_DPID, 0, NULL,
+                                 &count_retries) == CC_OF_OK) {
+            max_seen = MAX(max_seen, count_retries);
+        }
+    }
+    g_assert_cmpint(num_accept, ==, 1 + 3);
+    g_assert_cmpuint(max_seen, <=, 3);
+    TEST_WAIT_FOR(g_atomic_int_get(&tdata->num_del) == 1, 2000);
+    g_assert_cmpint(tdata->num_del, ==, 1);
+    g_assert_cmpint(g_atomic_int_get(&tdata->num_up), ==, 0);
+    g_assert_cmpint(cc_of_get_conn_state(TEST_DPID, 0, NULL, NULL), ==,
+                    CC_OF_EINVAL);
+    close(listen_fd);
+}
+
+//tc_9 - switch: a reconnect timer that fires after the channel was
+//       destroyed does nothing
+static void
+chann_tc_9(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    uint32_t count_retries;
+    int listen_fd, fd;
+
+    g_assert(cc_of_set_reconnect(400, 400, 0) == CC_OF_OK);
+    listen_fd = test_listen(tdata->port);
+    g_assert(cc_of_create_channel(TEST_IP, TEST_IP, tdata->port, TEST_DPID,
+                                  0, TCP) == CC_OF_OK);
+    fd = test_accept_up(tdata, listen_fd, 1);
+
+    close(fd);
+    TEST_WAIT_FOR(test_conn_state(NULL) != CC_OF_CONN_UP, 2000);
+    g_assert_cmpint(test_conn_state(&count_retries), ==, CC_OF_CONN_BACKOFF);
+    g_assert(cc_of_destroy_channel(TEST_DPID, 0) == CC_OF_OK);
+    g_assert_cmpint(cc_of_get_conn_state(TEST_DPID, 0, NULL, NULL), ==,
+                    CC_OF_EINVAL);
+
+    /* its timer expires within 400ms and finds it gone */
+    g_assert_cmpint(test_accept(listen_fd, 800), ==, -1);
+    g_assert_cmpint(cc_of_get_conn_state(TEST_DPID, 0, NULL, NULL), ==,
+                    CC_OF_EINVAL);
+    close(listen_fd);
+}
+
+//tc_10 - controller: a hello with no version in common gets a
+//        HELLO_FAILED error, then the channel is closed
+static void
+chann_tc_10(test_data_t *tdata,
+            gconstpointer tudata UNUSED)
+{
+    ofp_header_t hdr;
+    char buf[256];
+    int fd, len;
+
+    g_usleep(100000);    /* listen is up */
+    fd = test_connect(tdata->port);
+    g_assert_cmpint(test_read_msg(fd, buf, sizeof(buf), 1000), >, 0);
+    g_assert_cmpuint(((ofp_header_t *)buf)->type, ==, OFPT_HELLO);
+
+    g_test_expect_message(CC_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                          "*no OF version in common*");
+    hdr.version = 0;
+    hdr.type = OFPT_HELLO;
+    hdr.length = htons(OFP_HEADER_LEN);
+    hdr.xid = htonl(9);
+    g_assert(write(fd, &hdr, sizeof(hdr)) == sizeof(hdr));
+
+    len = test_read_msg(fd, buf, sizeof(buf), 2000);
+    g_assert_cmpint(len, ==, OFP_HEADER_LEN + 4);
+    g_assert_cmpuint(((ofp_header_t *)buf)->type, ==, OFPT_ERROR);
+    g_assert_cmpuint(ntohl(((ofp_header_t *)buf)->xid), ==, 9);
+    g_assert_cmpuint(ntohs(*(uint16_t *)(buf + OFP_HEADER_LEN)), ==,
+                     OFPET_HELLO_FAILED);
+    g_assert_cmpuint(ntohs(*(uint16_t *)(buf + OFP_HEADER_LEN + 2)), ==,
+                     OFPHFC_INCOMPATIBLE);
+
+    /* closed after it, and never handed to the application */
+    g_assert_cmpint(test_read_msg(fd, buf, sizeof(buf), 2000), ==, 0);
+    g_test_assert_expected_messages();
+    g_assert_cmpint(g_atomic_int_get(&tdata->num_accept), ==, 0);
+    g_assert_cmpint(g_atomic_int_get(&tdata->num_del), ==, 0);
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/chann/tc_1",
+               test_data_t,
+               "controller:6680",
+               chann_start, chann_tc_1, chann_end);
+
+    g_test_add("/chann/tc_2",
+               test_data_t,
+               "controller:6681",
+               chann_start, chann_tc_2, chann_end);
+
+    g_test_add("/chann/tc_3",
+               test_data_t,
+               "controller:6682",
+               chann_start, chann_tc_3, chann_end);
+
+    g_test_add("/chann/tc_4",
+               test_data_t,
+               "controller:6683",
+               chann_start, chann_tc_4, chann_end);
+
+    g_test_add("/chann/tc_5",
+               test_data_t,
+               "controller:6684",
+               chann_start, chann_tc_5, chann_end);
+
+    g_test_add("/chann/tc_6",
+               test_data_t,
+               "controller:6685",
+               chann_start, chann_tc_6, chann_end);
+
+    g_test_add("/chann/tc_7",
+               test_data_t,
+               "switch:6686",
+               chann_start, chann_tc_7, chann_end);
+
+    g_test_add("/chann/tc_8",
+               test_data_t,
+               "switch:6687",
+               chann_start, chann_tc_8, chann_end);
+
+    g_test_add("/chann/tc_9",
+               test_data_t,
+               "switch:6688",
+               chann_start, chann_tc_9, chann_end);
+
+    g_test_add("/chann/tc_10",
+               test_data_t,
+               "controller:6689",
+               chann_start, chann_tc_10, chann_end);
+
+    return g_test_run();
+}
@@ -0,0 +1,383 @@
+/*
+*****************************************************
+**      CodeChix ONF Driver (LibCCOF)
+**      codechix.org - May the code be with you...
+**              Sept. 15, 2013
+*****************************************************
+**
+** License:        Apache 2.0 (ONF requirement)
+** Version:        0.0
+** LibraryName:    LibCCOF
+** GLIB License:   GNU LGPL
+** Description:    Test harness for OF message framing for LibCCOF
+** Assumptions:    N/A
+** Testing:        N/A
+** Authors:        Deepa Karnad Dhurka
+**
+*****************************************************
+*/
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
+
+#include "cc_of_msg.h"
+#include "cc_of_global.h"
+#include "cc_log.h"
+
+#ifndef UNUSED
+#define UNUSED __attribute__ ((__unused__))
+#endif
+
+#define MAX_TEST_MSGS 16
+
+extern cc_of_global_t cc_of_global;
+
+/* Fixture data */
+typedef struct test_data_ {
+    cc_of_msg_rx_t *rx;
+    int            num_msgs;
+    size_t         msg_len[MAX_TEST_MSGS];
+    uint32_t       msg_xid[MAX_TEST_MSGS];
+    char           *msg[MAX_TEST_MSGS];
+} test_data_t;
+
+static void
+ofmsg_start(test_data_t *tdata,
+            gconstpointer tudata UNUSED)
+{
+    tdata->rx = cc_of_msg_rx_new();
+    g_assert(tdata->rx != NULL);
+    tdata->num_msgs = 0;
+}
+
+static void
+ofmsg_end(test_data_t *tdata,
+          gconstpointer tudata UNUSED)
+{
+    cc_of_msg_rx_free(tdata->rx);
+}
+
+/* records every message handed out */
+static void
+test_msg_func(char *msg, size_t msg_len, void *user_data)
+{
+    test_data_t *tdata = (test_data_t *)user_data;
+    ofp_header_t *hdr = (ofp_header_t *)msg;
+
+    g_assert_cmpint(tdata->num_msgs, <, MAX_TEST_MSGS);
+    g_assert_cmpuint(ntohs(hdr->length), ==, msg_len);
+
+    tdata->msg_len[tdata->num_msgs] = msg_len;
+    tdata->msg_xid[tdata->num_msgs] = ntohl(hdr->xid);
+    tdata->msg[tdata->num_msgs] = msg;
+    tdata->num_msgs++;
+}
+
+/* build an OF message of msg_len bytes at buf */
+static void
+test_build_msg(char *buf, size_t msg_len, uint32_t xid)
+{
+    ofp_header_t *hdr = (ofp_header_t *)buf;
+
+    memset(buf, 0xab, msg_len);
+    hdr->version = 4;
+    hdr->type = 10; /* PACKET_IN */
+    hdr->length = htons(msg_len);
+    hdr->xid = htonl(xid);
+}
+
+/* copy len bytes of data into the receive space and commit them */
+static int
+test_feed(test_data_t *tdata, char *data, size_t len)
+{
+    char *space;
+    size_t space_len;
+
+    space = cc_of_msg_rx_space(tdata->rx, &space_len);
+    g_assert_cmpuint(space_len, >=, len);
+    memcpy(space, data, len);
+    return cc_of_msg_rx_commit(tdata->rx, len, test_msg_func, tdata);
+}
+
+//tc_1 - one message split over three reads, the split inside the header
+//     - delivered once, when the last byte arrives
+static void
+ofmsg_tc_1(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    char msg[100];
+
+    test_build_msg(msg, sizeof(msg), 1);
+
+    g_assert_cmpint(test_feed(tdata, msg, 3), ==, 0);
+    g_assert_cmpint(test_feed(tdata, msg + 3, 50), ==, 0);
+    g_assert_cmpint(tdata->num_msgs, ==, 0);
+    g_assert_cmpint(test_feed(tdata, msg + 53, sizeof(msg) - 53), ==, 1);
+
+    g_assert_cmpint(tdata->num_msgs, ==, 1);
+    g_assert_cmpuint(tdata->msg_len[0], ==, sizeof(msg));
+    g_assert_cmpuint(tdata->msg_xid[0], ==, 1);
+    g_assert_cmpuint(tdata->rx->len, ==, 0);
+}
+
+//tc_2 - three messages and the start of a fourth in one read
+//     - three delivered in order, the fourth after the next read
+static void
+ofmsg_tc_2(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    char buf[8 + 64 + 200 + 30];
+    size_t off = 0;
+
+    test_build_msg(buf + off, 8, 1);    /* header only, e.g. HELLO */
+    off += 8;
+    test_build_msg(buf + off, 64, 2);
+    off += 64;
+    test_build_msg(buf + off, 200, 3);
+    off += 200;
+    test_build_msg(buf + off, 30, 4);
+
+    g_assert_cmpint(test_feed(tdata, buf, off + 10), ==, 3);
+    g_assert_cmpint(tdata->num_msgs, ==, 3);
+    g_assert_cmpuint(tdata->msg_len[0], ==, 8);
+    g_assert_cmpuint(tdata->msg_len[1], ==, 64);
+    g_assert_cmpuint(tdata->msg_len[2], ==, 200);
+    g_assert_cmpuint(tdata->msg_xid[2], ==, 3);
+    g_assert_cmpuint(tdata->rx->len, ==, 10);
+
+    g_assert_cmpint(test_feed(tdata, buf + off + 10, 20), ==, 1);
+    g_assert_cmpuint(tdata->msg_xid[3], ==, 4);
+    g_assert_cmpuint(tdata->rx->rx_msgs, ==, 4);
+}
+
+//tc_3 - a message larger than the initial buffer
+//     - the buffer grows to hold it
+static void
+ofmsg_tc_3(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    size_t msg_len = OFP_MAX_MSG_LEN;
+    char *msg = malloc(msg_len);
+    size_t off = 0, len;
+
+    test_build_msg(msg, msg_len, 7);
+    while (off < msg_len) {
+        len = MIN(msg_len - off, 1000);
+        test_feed(tdata, msg + off, len);
+        off += len;
+    }
+    g_assert_cmpint(tdata->num_msgs, ==, 1);
+    g_assert_cmpuint(tdata->msg_len[0], ==, msg_len);
+    g_assert_cmpuint(tdata->rx->size, >=, msg_len);
+    free(msg);
+}
+
+//tc_4 - a header with a length below the header size
+//     - rejected and the buffered data dropped
+static void
+ofmsg_tc_4(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    char buf[16];
+
+    test_build_msg(buf, sizeof(buf), 1);
+    ((ofp_header_t *)buf)->length = htons(4);
+
+    g_test_expect_message(CC_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                          "*bad OF message length*");
+    g_assert_cmpint(test_feed(tdata, buf, sizeof(buf)), ==, CC_OF_EINVAL);
+    g_test_assert_expected_messages();
+    g_assert_cmpint(tdata->num_msgs, ==, 0);
+    g_assert_cmpuint(tdata->rx->len, ==, 0);
+    g_assert_cmpuint(tdata->rx->rx_errs, ==, 1);
+}
+
+//tc_5 - two messages and the start of a third in one read
+//     - the two handed out stay intact after the commit returns, until
+//       the space for the next read is asked for
+static void
+ofmsg_tc_5(test_data_t *tdata,
+           gconstpointer tudata UNUSED)
+{
+    char buf[40 + 40 + 40];
+    char *space;
+    size_t space_len;
+
+    test_build_msg(buf, 40, 1);
+    test_build_msg(buf + 40, 40, 2);
+    test_build_msg(buf + 80, 40, 3);
+
+    g_assert_cmpint(test_feed(tdata, buf, 100), ==, 2);
+    g_assert(memcmp(tdata->msg[0], buf, 40) == 0);
+    g_assert(memcmp(tdata->msg[1], buf + 40, 40) == 0);
+
+    /* the partial message moves to the front */
+    space = cc_of_msg_rx_space(tdata->rx, &space_len);
+    g_assert(space == tdata->rx->buf + 20);
+    memcpy(space, buf + 100, 20);
+    g_assert_cmpint(cc_of_msg_rx_commit(tdata->rx, 20, test_msg_func,
+                                        tdata), ==, 1);
+    g_assert(tdata->msg[2] == tdata->rx->buf);
+    g_assert_cmpuint(tdata->msg_xid[2], ==, 3);
+}
+
+//tc_6 - hello version negotiation with and without version bitmaps
+static void
+ofmsg_tc_6(test_data_t *tdata UNUSED,
+           gconstpointer tudata UNUSED)
+{
+    char buf[CC_OF_MSG_HELLO_MAX_LEN + 8];
+    uint32_t bitmap_13, bitmap_10;
+    size_t msg_len;
+
+    bitmap_13 = cc_of_msg_version_bitmap(CC_OFVER_1_3_1);
+    bitmap_10 = cc_of_msg_version_bitmap(CC_OFVER_1_0);
+
+    /* 1.3 hello carries the bitmap, 1.0 hello is a bare header */
+    msg_len = cc_of_msg_hello_build(buf, bitmap_13, 7);
+    g_assert_cmpuint(msg_len, ==, OFP_HEADER_LEN + 8);
+    g_assert_cmpuint(((ofp_header_t *)buf)->version, ==, OFP_VERSION_1_3);
+    g_assert_cmpint(cc_of_msg_hello_negotiate(buf, msg_len, bitmap_13),
+                    ==, OFP_VERSION_1_3);
+    g_assert_cmpint(cc_of_msg_hello_negotiate(buf, msg_len, bitmap_10),
+                    ==, OFP_VERSION_1_0);
+
+    msg_len = cc_of_msg_hello_build(buf, bitmap_10, 8);
+    g_assert_cmpuint(msg_len, ==, OFP_HEADER_LEN);
+    g_assert_cmpint(cc_of_msg_hello_negotiate(buf, msg_len, bitmap_13),
+                    ==, OFP_VERSION_1_0);
+
+    /* a 1.5 peer without a bitmap falls back to our highest */
+    ((ofp_header_t *)buf)->version = 6;
+    g_assert_cmpint(cc_of_msg_hello_negotiate(buf, msg_len, bitmap_13),
+                    ==, OFP_VERSION_1_3);
+
+    /* a peer supporting only 1.4 and 1.5 has nothing in common */
+    msg_len = cc_of_msg_hello_build(buf, (1 << 5) | (1 << 6), 9);
+    g_assert_cmpint(cc_of_msg_hello_negotiate(buf, msg_len, bitmap_13),
+                    ==, CC_OF_EINVAL);
+
+    /* a 1.2 peer without a bitmap - 1.2 is not ours */
+    ((ofp_header_t *)buf)->version = 3;
+    ((ofp_header_t *)buf)->length = htons(OFP_HEADER_LEN);
+    g_assert_cmpint(cc_of_msg_hello_negotiate(buf, OFP_HEADER_LEN,
+                                              bitmap_13),
+                    ==, CC_OF_EINVAL);
+}
+
+//tc_7 - dp_id and aux_id of 1.3 and 1.0 FEATURES_REPLY messages
+static void
+ofmsg_tc_7(test_data_t *tdata UNUSED,
+           gconstpointer tudata UNUSED)
+{
+    char buf[OFP_SWITCH_FEATURES_LEN];
+    ofp_header_t *hdr = (ofp_header_t *)buf;
+    uint32_t dp_id_hi = htonl(0x00000a0b), dp_id_lo = htonl(0x0c0d0e0f);
+    uint64_t dp_id = 0;
+    uint8_t aux_id = 0;
+
+    test_build_msg(buf, sizeof(buf), 3);
+    hdr->type = OFPT_FEATURES_REPLY;
+    memcpy(buf + OFP_HEADER_LEN, &dp_id_hi, sizeof(dp_id_hi));
+    memcpy(buf + OFP_HEADER_LEN + 4, &dp_id_lo, sizeof(dp_id_lo));
+    buf[OFP_SWITCH_FEATURES_AUX_OFF] = 2;
+
+    g_assert_cmpint(cc_of_msg_features_parse(buf, sizeof(buf), &dp_id,
+                                             &aux_id), ==, CC_OF_OK);
+    g_assert_cmpuint(dp_id, ==, 0x00000a0b0c0d0e0fULL);
+    g_assert_cmpuint(aux_id, ==, 2);
+
+    /* 1.0 has no aux_id, the byte is padding */
+    hdr->version = OFP_VERSION_1_0;
+    g_assert_cmpint(cc_of_msg_features_parse(buf, sizeof(buf), &dp_id,
+                                             &aux_id), ==, CC_OF_OK);
+    g_assert_cmpuint(aux_id, ==, 0);
+
+    g_assert_cmpint(cc_of_msg_features_parse(buf, sizeof(buf) - 1, &dp_id,
+                                             &aux_id), ==, CC_OF_EINVAL);
+}
+
+//tc_8 - replies to requests and the REPLY_MORE flag of multipart replies
+static void
+ofmsg_tc_8(test_data_t *tdata UNUSED,
+           gconstpointer tudata UNUSED)
+{
+    char buf[OFP_HEADER_LEN + 8];
+    ofp_header_t *hdr = (ofp_header_t *)buf;
+    uint16_t flags = htons(OFPMPF_REPLY_MORE);
+
+    test_build_msg(buf, sizeof(buf), 4);
+    memcpy(buf + OFP_MULTIPART_FLAGS_OFF, &flags, sizeof(flags));
+
+    hdr->type = OFPT_PACKET_IN;
+    g_assert(cc_of_msg_unsolicited(buf));
+    g_assert(!cc_of_msg_reply_more(buf, sizeof(buf)));
+    hdr->type = OFPT_ERROR;
+    g_assert(!cc_of_msg_unsolicited(buf));
+
+    hdr->type = OFPT13_MULTIPART_REPLY;
+    g_assert(!cc_of_msg_unsolicited(buf));
+    g_assert(cc_of_msg_reply_more(buf, sizeof(buf)));
+    g_assert(!cc_of_msg_reply_more(buf, OFP_HEADER_LEN));
+
+    /* stats reply of 1.0, 19 is its barrier reply there */
+    hdr->version = OFP_VERSION_1_0;
+    g_assert(!cc_of_msg_reply_more(buf, sizeof(buf)));
+    hdr->type = OFPT10_STATS_REPLY;
+    g_assert(cc_of_msg_reply_more(buf, sizeof(buf)));
+
+    /* last part */
+    flags = 0;
+    memcpy(buf + OFP_MULTIPART_FLAGS_OFF, &flags, sizeof(flags));
+    g_assert(!cc_of_msg_reply_more(buf, sizeof(buf)));
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/ofmsg/tc_1",
+               test_data_t,
+               NULL,
+               ofmsg_start, ofmsg_tc_1, ofmsg_end);
+
+    g_test_add("/ofmsg/tc_2",
+               test_data_t,
+               NULL,
+               ofmsg_start, ofmsg_tc_2, ofmsg_end);
+
+    g_test_add("/ofmsg/tc_3",
+               test_data_t,
+               NULL,
+               ofmsg_start, ofmsg_tc_3, ofmsg_end);
+
+    g_test_add("/ofmsg/tc_4",
+               test_data_t,
+               NULL,
+               ofmsg_start, ofmsg_tc_4, ofmsg_end);
+
+    g_test_add("/ofmsg/tc_5",
+               test_data_t,
+               NULL,
+               ofmsg_start, ofmsg_tc_5, ofmsg_end);
+
+    g_test_add("/ofmsg/tc_6",
+               test_data_t,
+               NULL,
+               ofmsg_start, ofmsg_tc_6, ofmsg_end);
+
+    g_test_add("/ofmsg/tc_7",
+               test_data_t,
+               NULL,
+               ofmsg_start, ofmsg_tc_7, ofmsg_end);
+
+    g_test_add("/ofmsg/tc_8",
+               test_data_t,
+               NULL,
+               ofmsg_start, ofmsg_tc_8, ofmsg_end);
+
+    return g_test_run();
+}
@@ -28,9 +28,18 @@
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
 
 #include "cc_pollthr_mgr.h"
 #include "cc_of_global.h"
+#include "cc_of_util.h"
 #include "cc_log.h"
 
 #ifndef UNUSED
@@ -47,10 +56,40 @@ typedef struct test_data_ {
     char                liblog[LIBLOG_SIZE];
 } test_data_t;
     
+/* a kernel without io_uring for the calling thread and the threads it
+ * creates: io_uring_setup fails with ENOSYS
+ */
+static gpointer
+test_nouring_mgr_thread_func(gpointer data)
+{
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                 offsetof(struct seccomp_data, nr)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_io_uring_setup, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+    struct sock_fprog prog;
+
+    prog.len = sizeof(filter) / sizeof(filter[0]);
+    prog.filter = filter;
+    g_assert_cmpint(prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0), ==, 0);
+    g_assert_cmpint(prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog),
+                    ==, 0);
+    g_assert(!adpoll_iouring_supported());
+
+    /* its poll thread fails to set up io_uring and falls back */
+    g_test_expect_message(CC_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                          "*io_uring_setup failed*");
+    g_test_expect_message(CC_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                          "*io_uring backend init failed*");
+    return adp_thr_mgr_new_backend((char *)data, 10, 1, ADPOLL_IOURING);
+}
+
 /*  Function: pollthread_start
  *  This is a fixture funxtion.
  *  Initialize a poll thread with 10 max sockets
- *  and 1 max pipes
+ *  and 1 max pipes, on io_uring for the iouring tests
  */
 static void
 pollthread_start(test_data_t *tdata,
@@ -69,7 +108,20 @@ pollthread_start(test_data_t *tdata,
     cc_of_global.ofut_enable = TRUE;
     
     /* create new thread manager */
-    temp_mgr_p = adp_thr_mgr_new((char *)tudata, 10, 1);
+    if (strstr((char *)tudata, "nouring") != NULL) {
+        temp_mgr_p = g_thread_join(g_thread_new("nouring",
+                                                test_nouring_mgr_thread_func,
+                                                (gpointer)tudata));
+        g_test_assert_expected_messages();
+    } else if (strstr((char *)tudata, "iouring") != NULL) {
+        if (!adpoll_iouring_supported()) {
+            g_test_message("no io_uring in this kernel - on epoll instead");
+        }
+        temp_mgr_p = adp_thr_mgr_new_backend((char *)tudata, 10, 1,
+                                             ADPOLL_IOURING);
+    } else {
+        temp_mgr_p = adp_thr_mgr_new((char *)tudata, 10, 1);
+    }
     
     /* need to copy the contents to tp because tp is
        allocated by test framework - the location needs
@@ -416,6 +468,7 @@ pollthread_tc_3(test_data_t *tdata,
         add_sock_msg.fd = sv[0];
         add_sock_msg.fd_type = SOCKET;
         add_sock_msg.fd_action = ADD_FD;
+        add_sock_msg.connect_pending = FALSE;
         add_sock_msg.poll_events = POLLIN;
         add_sock_msg.pollin_func = &test_socket_in_process_func;
         add_sock_msg.pollout_func = NULL;
@@ -537,6 +590,7 @@ test_socket_out_process_func(char *tname,
                    __FUNCTION__, out_data.msg);
     
     write(data_p->fd, &out_data, sizeof(out_data));
+    htbl_out_data->data_off = htbl_out_data->data_size;
 
     return;
 }
@@ -553,9 +607,9 @@ pollthread_tc_4(test_data_t *tdata,
     adpoll_thr_msg_t del_sock_msg;
     test_fd_rd_wr_data_t test_msg;
     char *temp_liblog = NULL;
-    int rd_fd, wr_fd;
+    int rd_fd;
     int sv[2]; /* the pair of socket descriptors */
-    char send_buf[100];
+    adpoll_send_msg_htbl_info_t *send_msg_p;
     char test_str[] = "hello 1..2..3..10..20";
     int status, childpid;
 
@@ -584,6 +638,7 @@ pollthread_tc_4(test_data_t *tdata,
         add_sock_msg.fd = sv[0];
         add_sock_msg.fd_type = SOCKET;
         add_sock_msg.fd_action = ADD_FD;
+        add_sock_msg.connect_pending = FALSE;
         add_sock_msg.poll_events = POLLOUT;
         add_sock_msg.pollin_func = NULL;
         add_sock_msg.pollout_func = &test_socket_out_process_func;
@@ -630,18 +685,15 @@ pollthread_tc_4(test_data_t *tdata,
         
         /* clear the log */
         cc_of_log_clear();
-        ((adpoll_send_msg_t *)send_buf)->hdr.msg_size =
-            sizeof(adpoll_send_msg_t) + strlen(test_str) + 1;
-        
-        ((adpoll_send_msg_t *)send_buf)->hdr.fd = rd_fd;
+        send_msg_p = adp_thr_mgr_msg_alloc(strlen(test_str) + 1);
+        g_assert(send_msg_p != NULL);
+        send_msg_p->data_size = strlen(test_str) + 1;
             
-        g_memmove(((adpoll_send_msg_t *)send_buf)->data,
-                  test_str, strlen(test_str) + 1);
+        g_memmove(send_msg_p->data, test_str, strlen(test_str) + 1);
         
-        wr_fd = adp_thr_mgr_get_data_pipe_wr(&tdata->tp_data);
-
-        write(wr_fd, send_buf,
-              ((adpoll_send_msg_t *)send_buf)->hdr.msg_size);
+        /* the poll thread owns and frees send_msg_p from here */
+        g_assert_cmpint(adp_thr_mgr_send_msg(&tdata->tp_data, rd_fd,
+                                             send_msg_p), ==, 0);
         g_test_message("waiting on wait %d ", childpid);
         waitpid(childpid,&status,0); /* wait for child to finish up */
         
@@ -816,6 +868,7 @@ pollthread_tc_5(test_data_t *tdata,
     add_sock_msg.fd = server_fd;
     add_sock_msg.fd_type = SOCKET;
     add_sock_msg.fd_action = ADD_FD;
+    add_sock_msg.connect_pending = FALSE;
     add_sock_msg.poll_events = POLLIN;
     add_sock_msg.pollin_func = &test_socket_listen_process_func;
     add_sock_msg.pollout_func = NULL;
@@ -847,6 +900,792 @@ pollthread_tc_5(test_data_t *tdata,
     close(connect_fd);
 }
 
+/* more messages than the send ring holds, so some overflow to the
+ * data pipe
+ */
+#define TC6_NUM_MSGS (ADPOLL_SEND_RING_SIZE * 2 + 100)
+#define TC6_BATCH    50
+
+void
+test_socket_seq_out_process_func(char *tname UNUSED,
+                                 adpoll_fd_info_t *data_p,
+                                 adpoll_send_msg_htbl_info_t *htbl_out_data)
+{
+    ssize_t rv;
+
+    rv = write(data_p->fd, htbl_out_data->data + htbl_out_data->data_off,
+               htbl_out_data->data_size - htbl_out_data->data_off);
+    if (rv > 0) {
+        htbl_out_data->data_off += rv;
+    }
+}
+
+//tc_6 - messages queued faster than the poll thread sends them
+//     - send TC6_NUM_MSGS sequence numbers without waiting, singly
+//       and in batches
+//     - all of them arrive on the peer in order
+static void
+pollthread_tc_6(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    adpoll_thr_msg_t add_sock_msg;
+    adpoll_thr_msg_t del_sock_msg;
+    adpoll_send_msg_htbl_info_t *send_msg_p;
+    adpoll_send_msg_t batch[TC6_BATCH];
+    int sv[2];
+    uint32_t seq, rcv_seq[64];
+    uint32_t expect_seq = 0;
+    struct pollfd pfd;
+    ssize_t rv;
+    int i, rcv_len = 0;
+
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+
+    add_sock_msg.fd = sv[0];
+    add_sock_msg.fd_type = SOCKET;
+    add_sock_msg.fd_action = ADD_FD;
+    add_sock_msg.connect_pending = FALSE;
+    add_sock_msg.poll_events = POLLOUT;
+    add_sock_msg.pollin_func = NULL;
+    add_sock_msg.pollout_func = &test_socket_seq_out_process_func;
+    add_sock_msg.io_offload = FALSE;
+
+    g_assert_cmpint(adp_thr_mgr_add_del_fd(&tdata->tp_data, &add_sock_msg),
+                    ==, sv[0]);
+
+    /* first half one at a time, the rest in batches */
+    for (seq = 0; seq < TC6_NUM_MSGS / 2; seq++) {
+        send_msg_p = adp_thr_mgr_msg_alloc(sizeof(seq));
+        g_assert(send_msg_p != NULL);
+        send_msg_p->data_size = sizeof(seq);
+        g_memmove(send_msg_p->data, &seq, sizeof(seq));
+        g_assert_cmpint(adp_thr_mgr_send_msg(&tdata->tp_data, sv[0],
+                                             send_msg_p), ==, 0);
+    }
+    while (seq < TC6_NUM_MSGS) {
+        for (i = 0; (i < TC6_BATCH) && (seq < TC6_NUM_MSGS); i++, seq++) {
+            batch[i].fd = sv[0];
+            batch[i].msg_p = adp_thr_mgr_msg_alloc(sizeof(seq));
+            g_assert(batch[i].msg_p != NULL);
+            batch[i].msg_p->data_size = sizeof(seq);
+            g_memmove(batch[i].msg_p->data, &seq, sizeof(seq));
+        }
+        g_assert_cmpint(adp_thr_mgr_send_msg_batch(&tdata->tp_data,
+                                                   batch, i), ==, i);
+    }
+
+    g_test_message("test - %d messages arrive in order", TC6_NUM_MSGS);
+    pfd.fd = sv[1];
+    pfd.events = POLLIN;
+    while (expect_seq < TC6_NUM_MSGS) {
+        if (poll(&pfd, 1, 5000) <= 0) {
+            break;
+        }
+        /* a read may end in the middle of a sequence number */
+        rv = read(sv[1], (char *)rcv_seq + rcv_len,
+                  sizeof(rcv_seq) - rcv_len);
+        g_assert_cmpint(rv, >, 0);
+        rcv_len += rv;
+        for (i = 0; i < rcv_len / (int)sizeof(seq); i++) {
+            g_assert_cmpuint(rcv_seq[i], ==, expect_seq);
+            expect_seq++;
+        }
+        g_memmove(rcv_seq, &rcv_seq[i], rcv_len % sizeof(seq));
+        rcv_len %= sizeof(seq);
+    }
+    g_assert_cmpuint(expect_seq, ==, TC6_NUM_MSGS);
+
+    del_sock_msg.fd = sv[0];
+    del_sock_msg.fd_type = SOCKET;
+    del_sock_msg.fd_action = DELETE_FD;
+    del_sock_msg.poll_events = 0;
+    del_sock_msg.pollin_func = NULL;
+    del_sock_msg.pollout_func = NULL;
+    del_sock_msg.io_offload = FALSE;
+
+    adp_thr_mgr_add_del_fd(&tdata->tp_data, &del_sock_msg);
+
+    close(sv[0]);
+    close(sv[1]);
+}
+
+adpoll_thread_mgr_t *tc7_mgr_p;
+int tc7_sv[2];
+gint tc7_added, tc7_read;
+
+/* reads the data on the socket added from the other callback and
+ * deletes the socket from its own thread
+ */
+void
+test_socket_self_del_process_func(char *tname UNUSED,
+                                  adpoll_fd_info_t *data_p,
+                                  adpoll_send_msg_htbl_info_t
+                                  *unused_data UNUSED)
+{
+    adpoll_thr_msg_t del_sock_msg;
+    char c;
+
+    g_assert_cmpint(read(data_p->fd, &c, 1), ==, 1);
+
+    del_sock_msg.fd = data_p->fd;
+    del_sock_msg.fd_type = SOCKET;
+    del_sock_msg.fd_action = DELETE_FD;
+    del_sock_msg.poll_events = 0;
+    del_sock_msg.pollin_func = NULL;
+    del_sock_msg.pollout_func = NULL;
+    del_sock_msg.io_offload = FALSE;
+    adp_thr_mgr_add_del_fd(tc7_mgr_p, &del_sock_msg);
+
+    g_atomic_int_set(&tc7_read, 1);
+}
+
+/* adds tc7_sv[0] to its own thread, as an accepting listenfd does */
+void
+test_socket_self_add_process_func(char *tname UNUSED,
+                                  adpoll_fd_info_t *data_p,
+                                  adpoll_send_msg_htbl_info_t
+                                  *unused_data UNUSED)
+{
+    adpoll_thr_msg_t add_sock_msg;
+    char c;
+
+    g_assert_cmpint(read(data_p->fd, &c, 1), ==, 1);
+
+    add_sock_msg.fd = tc7_sv[0];
+    add_sock_msg.fd_type = SOCKET;
+    add_sock_msg.fd_action = ADD_FD;
+    add_sock_msg.connect_pending = FALSE;
+    add_sock_msg.poll_events = POLLIN;
+    add_sock_msg.pollin_func = &test_socket_self_del_process_func;
+    add_sock_msg.pollout_func = NULL;
+    add_sock_msg.io_offload = FALSE;
+    g_assert_cmpint(adp_thr_mgr_add_del_fd(tc7_mgr_p, &add_sock_msg),
+                    ==, tc7_sv[0]);
+
+    g_atomic_int_set(&tc7_added, 1);
+}
+
+/* wait up to 5s for flag to be set by the poll thread */
+static gboolean
+test_wait_flag(gint *flag)
+{
+    int i;
+
+    for (i = 0; i < 500; i++) {
+        if (g_atomic_int_get(flag)) {
+            return TRUE;
+        }
+        g_usleep(10000);
+    }
+    return FALSE;
+}
+
+//tc_7 - sockets added and deleted from the poll thread's own callbacks
+//     - a callback adds a socket to its own thread; that socket's
+//       callback deletes it again. Neither waits on the primary pipe
+static void
+pollthread_tc_7(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    adpoll_thr_msg_t add_sock_msg;
+    adpoll_thr_msg_t del_sock_msg;
+    int sv[2];
+
+    tc7_mgr_p = &tdata->tp_data;
+    g_atomic_int_set(&tc7_added, 0);
+    g_atomic_int_set(&tc7_read, 0);
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, tc7_sv), ==, 0);
+
+    add_sock_msg.fd = sv[0];
+    add_sock_msg.fd_type = SOCKET;
+    add_sock_msg.fd_action = ADD_FD;
+    add_sock_msg.connect_pending = FALSE;
+    add_sock_msg.poll_events = POLLIN;
+    add_sock_msg.pollin_func = &test_socket_self_add_process_func;
+    add_sock_msg.pollout_func = NULL;
+    add_sock_msg.io_offload = FALSE;
+    g_assert_cmpint(adp_thr_mgr_add_del_fd(&tdata->tp_data, &add_sock_msg),
+                    ==, sv[0]);
+    g_assert_cmpint(g_atomic_int_get(&tdata->tp_data.num_sockets), ==, 1);
+
+    g_assert_cmpint(write(sv[1], "a", 1), ==, 1);
+    g_assert(test_wait_flag(&tc7_added));
+    g_assert_cmpint(g_atomic_int_get(&tdata->tp_data.num_sockets), ==, 2);
+
+    g_assert_cmpint(write(tc7_sv[1], "b", 1), ==, 1);
+    g_assert(test_wait_flag(&tc7_read));
+    g_assert_cmpint(g_atomic_int_get(&tdata->tp_data.num_sockets), ==, 1);
+
+    del_sock_msg.fd = sv[0];
+    del_sock_msg.fd_type = SOCKET;
+    del_sock_msg.fd_action = DELETE_FD;
+    del_sock_msg.poll_events = 0;
+    del_sock_msg.pollin_func = NULL;
+    del_sock_msg.pollout_func = NULL;
+    del_sock_msg.io_offload = FALSE;
+    adp_thr_mgr_add_del_fd(&tdata->tp_data, &del_sock_msg);
+    g_assert_cmpint(g_atomic_int_get(&tdata->tp_data.num_sockets), ==, 0);
+
+    close(sv[0]);
+    close(sv[1]);
+    close(tc7_sv[0]);
+    close(tc7_sv[1]);
+}
+
+gint tc8_connected, tc8_calls;
+
+/* called without a message when the connect completes */
+void
+test_socket_connect_process_func(char *tname UNUSED,
+                                 adpoll_fd_info_t *data_p,
+                                 adpoll_send_msg_htbl_info_t *send_msg_p)
+{
+    int sock_err = -1;
+    socklen_t optlen = sizeof(sock_err);
+
+    g_assert(send_msg_p == NULL);
+    g_assert(data_p->connect_pending == FALSE);
+    g_assert_cmpint(getsockopt(data_p->fd, SOL_SOCKET, SO_ERROR,
+                               &sock_err, &optlen), ==, 0);
+    g_atomic_int_inc(&tc8_calls);
+    g_atomic_int_set(&tc8_connected, (sock_err == 0) ? 1 : -1);
+}
+
+//tc_8 - non-blocking connect completion
+//     - a connecting socket is polled for POLLOUT without any queued
+//       message; pollout_func is called once, without a message, when
+//       the connect completes
+static void
+pollthread_tc_8(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    adpoll_thr_msg_t add_sock_msg;
+    adpoll_thr_msg_t del_sock_msg;
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    int listenfd, clientfd, connfd;
+
+    g_atomic_int_set(&tc8_connected, 0);
+    g_atomic_int_set(&tc8_calls, 0);
+
+    listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    g_assert_cmpint(listenfd, >=, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    g_assert_cmpint(bind(listenfd, (struct sockaddr *)&addr,
+                         sizeof(addr)), ==, 0);
+    g_assert_cmpint(listen(listenfd, 1), ==, 0);
+    g_assert_cmpint(getsockname(listenfd, (struct sockaddr *)&addr,
+                                &addrlen), ==, 0);
+
+    clientfd = socket(AF_INET, SOCK_STREAM, 0);
+    g_assert_cmpint(clientfd, >=, 0);
+    fcntl(clientfd, F_SETFL, fcntl(clientfd, F_GETFL, 0) | O_NONBLOCK);
+    if (connect(clientfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        g_assert_cmpint(errno, ==, EINPROGRESS);
+    }
+
+    add_sock_msg.fd = clientfd;
+    add_sock_msg.fd_type = SOCKET;
+    add_sock_msg.fd_action = ADD_FD;
+    add_sock_msg.connect_pending = TRUE;
+    add_sock_msg.poll_events = POLLIN | POLLOUT;
+    add_sock_msg.pollin_func = NULL;
+    add_sock_msg.pollout_func = &test_socket_connect_process_func;
+    add_sock_msg.io_offload = FALSE;
+    g_assert_cmpint(adp_thr_mgr_add_del_fd(&tdata->tp_data, &add_sock_msg),
+                    ==, clientfd);
+
+    g_assert(test_wait_flag(&tc8_connected));
+    g_assert_cmpint(g_atomic_int_get(&tc8_connected), ==, 1);
+
+    /* POLLOUT is dropped once the connect is done */
+    g_usleep(100000);
+    g_assert_cmpint(g_atomic_int_get(&tc8_calls), ==, 1);
+
+    connfd = accept(listenfd, NULL, NULL);
+    g_assert_cmpint(connfd, >=, 0);
+
+    del_sock_msg.fd = clientfd;
+    del_sock_msg.fd_type = SOCKET;
+    del_sock_msg.fd_action = DELETE_FD;
+    del_sock_msg.poll_events = 0;
+    del_sock_msg.pollin_func = NULL;
+    del_sock_msg.pollout_func = NULL;
+    del_sock_msg.io_offload = FALSE;
+    adp_thr_mgr_add_del_fd(&tdata->tp_data, &del_sock_msg);
+    g_assert_cmpint(g_atomic_int_get(&tdata->tp_data.num_sockets), ==, 0);
+
+    close(connfd);
+    close(clientfd);
+    close(listenfd);
+}
+
+gint tc9_calls, tc9_err, tc9_read;
+
+/* sends through the backend of an io_offload socket */
+void
+test_socket_offload_out_process_func(char *tname UNUSED,
+                                     adpoll_fd_info_t *data_p,
+                                     adpoll_send_msg_htbl_info_t
+                                     *htbl_out_data)
+{
+    ssize_t rv;
+
+    g_atomic_int_inc(&tc9_calls);
+    rv = adp_thr_mgr_send(data_p->fd,
+                          htbl_out_data->data + htbl_out_data->data_off,
+                          htbl_out_data->data_size - htbl_out_data->data_off,
+                          MSG_NOSIGNAL);
+    if (rv >= 0) {
+        htbl_out_data->data_off += rv;
+    } else if (errno != EAGAIN) {
+        /* drop it */
+        g_atomic_int_set(&tc9_err, errno);
+        htbl_out_data->data_off = htbl_out_data->data_size;
+    }
+}
+
+/* receives through the backend of an io_offload socket */
+void
+test_socket_offload_in_process_func(char *tname UNUSED,
+                                    adpoll_fd_info_t *data_p,
+                                    adpoll_send_msg_htbl_info_t
+                                    *unused_data UNUSED)
+{
+    char buf[64];
+    ssize_t rv;
+
+    while ((rv = adp_thr_mgr_recv(data_p->fd, buf, sizeof(buf), 0)) > 0) {
+        g_atomic_int_add(&tc9_read, (gint)rv);
+    }
+}
+
+/* add fd with io_offload and the offload callbacks; non-blocking like
+ * the library's sockets, for when the I/O is not offloaded after all
+ */
+static void
+test_offload_add(test_data_t *tdata, int fd)
+{
+    adpoll_thr_msg_t add_sock_msg;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    g_atomic_int_set(&tc9_calls, 0);
+    g_atomic_int_set(&tc9_err, 0);
+    g_atomic_int_set(&tc9_read, 0);
+
+    add_sock_msg.fd = fd;
+    add_sock_msg.fd_type = SOCKET;
+    add_sock_msg.fd_action = ADD_FD;
+    add_sock_msg.connect_pending = FALSE;
+    add_sock_msg.poll_events = POLLIN | POLLOUT;
+    add_sock_msg.pollin_func = &test_socket_offload_in_process_func;
+    add_sock_msg.pollout_func = &test_socket_offload_out_process_func;
+    add_sock_msg.io_offload = TRUE;
+    g_assert_cmpint(adp_thr_mgr_add_del_fd(&tdata->tp_data, &add_sock_msg),
+                    ==, fd);
+}
+
+static void
+test_offload_del(test_data_t *tdata, int fd)
+{
+    adpoll_thr_msg_t del_sock_msg;
+
+    del_sock_msg.fd = fd;
+    del_sock_msg.fd_type = SOCKET;
+    del_sock_msg.fd_action = DELETE_FD;
+    del_sock_msg.poll_events = 0;
+    del_sock_msg.pollin_func = NULL;
+    del_sock_msg.pollout_func = NULL;
+    del_sock_msg.io_offload = FALSE;
+    adp_thr_mgr_add_del_fd(&tdata->tp_data, &del_sock_msg);
+}
+
+static void
+test_offload_queue(test_data_t *tdata, int fd, uint32_t *seq_arr,
+                   uint32_t num_seq)
+{
+    adpoll_send_msg_htbl_info_t *send_msg_p;
+
+    send_msg_p = adp_thr_mgr_msg_alloc(num_seq * sizeof(uint32_t));
+    g_assert(send_msg_p != NULL);
+    send_msg_p->data_size = num_seq * sizeof(uint32_t);
+    g_memmove(send_msg_p->data, seq_arr, send_msg_p->data_size);
+    g_assert_cmpint(adp_thr_mgr_send_msg(&tdata->tp_data, fd,
+                                         send_msg_p), ==, 0);
+}
+
+#define TC9_NUM_MSGS 512
+#define TC9_MSG_SEQS 1000   /* 4000 bytes, so some only partly fit */
+
+//tc_9 - io_uring sends to a peer that does not read
+//     - the backend buffers a bounded amount, taking part of a message
+//       when that is all that fits, and does not report POLLOUT again
+//       until it has room
+//     - once the peer reads, everything arrives in order
+static void
+pollthread_tc_9(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    uint32_t seq_arr[TC9_MSG_SEQS], rcv_seq[TC9_MSG_SEQS];
+    uint32_t seq = 0, expect_seq = 0;
+    struct pollfd pfd;
+    gint calls;
+    ssize_t rv;
+    int sv[2], i, j, rcv_len = 0;
+
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+    test_offload_add(tdata, sv[0]);
+
+    for (i = 0; i < TC9_NUM_MSGS; i++) {
+        for (j = 0; j < TC9_MSG_SEQS; j++) {
+            seq_arr[j] = seq++;
+        }
+        test_offload_queue(tdata, sv[0], seq_arr, TC9_MSG_SEQS);
+    }
+
+    g_usleep(300000);
+    if (adpoll_iouring_supported()) {
+        g_test_message("test - sends are held back by the peer, no spin");
+        calls = g_atomic_int_get(&tc9_calls);
+        g_assert_cmpint(calls, <, TC9_NUM_MSGS);
+        g_usleep(200000);
+        g_assert_cmpint(g_atomic_int_get(&tc9_calls) - calls, <=, 2);
+    }
+
+    g_test_message("test - %u sequence numbers arrive in order", seq);
+    pfd.fd = sv[1];
+    pfd.events = POLLIN;
+    while (expect_seq < seq) {
+        if (poll(&pfd, 1, 5000) <= 0) {
+            break;
+        }
+        rv = read(sv[1], (char *)rcv_seq + rcv_len,
+                  sizeof(rcv_seq) - rcv_len);
+        g_assert_cmpint(rv, >, 0);
+        rcv_len += rv;
+        for (i = 0; i < rcv_len / (int)sizeof(seq); i++) {
+            g_assert_cmpuint(rcv_seq[i], ==, expect_seq);
+            expect_seq++;
+        }
+        g_memmove(rcv_seq, &rcv_seq[i], rcv_len % sizeof(seq));
+        rcv_len %= sizeof(seq);
+    }
+    g_assert_cmpuint(expect_seq, ==, seq);
+    g_assert_cmpint(g_atomic_int_get(&tc9_err), ==, 0);
+
+    test_offload_del(tdata, sv[0]);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+//tc_10 - io_uring send errors reach the sender
+//      - once the peer is gone the backend fails sends with the error
+//        of the SEND that failed, with POLLOUT reported for it
+static void
+pollthread_tc_10(test_data_t *tdata,
+                 gconstpointer tudata UNUSED)
+{
+    uint32_t seq = 0;
+    int sv[2], i;
+
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+    test_offload_add(tdata, sv[0]);
+    close(sv[1]);
+
+    for (i = 0; (i < 50) && !g_atomic_int_get(&tc9_err); i++) {
+        test_offload_queue(tdata, sv[0], &seq, 1);
+        g_usleep(20000);
+    }
+    g_assert_cmpint(g_atomic_int_get(&tc9_err), ==, EPIPE);
+
+    test_offload_del(tdata, sv[0]);
+    close(sv[0]);
+}
+
+//tc_11 - io_uring asked for on a kernel without it
+//      - the poll thread falls back to epoll and io_offload sockets
+//        send and receive through the plain syscalls
+static void
+pollthread_tc_11(test_data_t *tdata,
+                 gconstpointer tudata UNUSED)
+{
+    uint32_t seq_arr[4] = {0, 1, 2, 3}, rcv_seq[4];
+    struct pollfd pfd;
+    int sv[2];
+
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+    test_offload_add(tdata, sv[0]);
+
+    test_offload_queue(tdata, sv[0], seq_arr, 4);
+    pfd.fd = sv[1];
+    pfd.events = POLLIN;
+    g_assert_cmpint(poll(&pfd, 1, 5000), ==, 1);
+    g_assert_cmpint(read(sv[1], rcv_seq, sizeof(rcv_seq)), ==,
+                    sizeof(rcv_seq));
+    g_assert(memcmp(seq_arr, rcv_seq, sizeof(rcv_seq)) == 0);
+
+    g_assert_cmpint(write(sv[1], seq_arr, sizeof(seq_arr)), ==,
+                    sizeof(seq_arr));
+    g_assert(test_wait_flag(&tc9_read));
+    g_usleep(50000);
+    g_assert_cmpint(g_atomic_int_get(&tc9_read), ==, sizeof(seq_arr));
+    g_assert_cmpint(g_atomic_int_get(&tc9_err), ==, 0);
+
+    test_offload_del(tdata, sv[0]);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+//tc_12 - a message addressed to an fd that was closed and reused
+//      - the poll thread sends it while the fd keeps its generation
+//      - after the rw slot is deleted and added again it drops the
+//        message and counts it in the thread's tx_drops
+static void
+pollthread_tc_12(test_data_t *tdata,
+                 gconstpointer tudata UNUSED)
+{
+    adpoll_thr_msg_t add_sock_msg;
+    adpoll_thr_msg_t del_sock_msg;
+    adpoll_send_msg_htbl_info_t *send_msg_p;
+    cc_ofrw_key_t rw_key;
+    cc_ofrw_info_t rw_info;
+    gboolean new_entry;
+    uint32_t seq = 12, rcv_seq, gen, drops;
+    struct pollfd pfd;
+    int sv[2];
+
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+
+    memset(&rw_info, 0, sizeof(rw_info));
+    rw_info.layer4_proto = TCP;
+    rw_key.rw_sockfd = sv[0];
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    g_assert(cc_ofrw_tbl_init(&cc_of_global.ofrw_tbl) == CC_OF_OK);
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    gen = cc_ofrw_get_gen(sv[0]);
+    g_assert_cmpuint(gen, !=, 0);
+
+    add_sock_msg.fd = sv[0];
+    add_sock_msg.fd_type = SOCKET;
+    add_sock_msg.fd_action = ADD_FD;
+    add_sock_msg.connect_pending = FALSE;
+    add_sock_msg.poll_events = POLLOUT;
+    add_sock_msg.pollin_func = NULL;
+    add_sock_msg.pollout_func = &test_socket_seq_out_process_func;
+    add_sock_msg.io_offload = FALSE;
+
+    g_assert_cmpint(adp_thr_mgr_add_del_fd(&tdata->tp_data, &add_sock_msg),
+                    ==, sv[0]);
+
+    g_test_message("test - message to the same socket is sent");
+    send_msg_p = adp_thr_mgr_msg_alloc(sizeof(seq));
+    g_assert(send_msg_p != NULL);
+    send_msg_p->data_size = sizeof(seq);
+    send_msg_p->fd_gen = gen;
+    g_memmove(send_msg_p->data, &seq, sizeof(seq));
+    g_assert_cmpint(adp_thr_mgr_send_msg(&tdata->tp_data, sv[0],
+                                         send_msg_p), ==, 0);
+
+    pfd.fd = sv[1];
+    pfd.events = POLLIN;
+    g_assert_cmpint(poll(&pfd, 1, 5000), ==, 1);
+    g_assert_cmpint(read(sv[1], &rcv_seq, sizeof(rcv_seq)), ==,
+                    sizeof(rcv_seq));
+    g_assert_cmpuint(rcv_seq, ==, seq);
+
+    g_test_message("test - message to the replaced socket is dropped");
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    g_assert(cc_ofrw_tbl_update(DEL, &rw_key, NULL,
+                                &new_entry) == CC_OF_OK);
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_assert_cmpuint(cc_ofrw_get_gen(sv[0]), !=, gen);
+
+    drops = adp_thr_mgr_get_tx_drops(&tdata->tp_data, NULL);
+    send_msg_p = adp_thr_mgr_msg_alloc(sizeof(seq));
+    g_assert(send_msg_p != NULL);
+    send_msg_p->data_size = sizeof(seq);
+    send_msg_p->fd_gen = gen;
+    g_memmove(send_msg_p->data, &seq, sizeof(seq));
+    g_assert_cmpint(adp_thr_mgr_send_msg(&tdata->tp_data, sv[0],
+                                         send_msg_p), ==, 0);
+
+    g_assert_cmpint(poll(&pfd, 1, 500), ==, 0);
+    g_assert_cmpuint(adp_thr_mgr_get_tx_drops(&tdata->tp_data, NULL), ==,
+                     drops + 1);
+
+    del_sock_msg.fd = sv[0];
+    del_sock_msg.fd_type = SOCKET;
+    del_sock_msg.fd_action = DELETE_FD;
+    del_sock_msg.poll_events = 0;
+    del_sock_msg.pollin_func = NULL;
+    del_sock_msg.pollout_func = NULL;
+    del_sock_msg.io_offload = FALSE;
+
+    adp_thr_mgr_add_del_fd(&tdata->tp_data, &del_sock_msg);
+
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    cc_ofrw_tbl_free(&cc_of_global.ofrw_tbl);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+/* never sends, so messages stay queued until the fd is deleted */
+void
+test_socket_stall_out_process_func(char *tname UNUSED,
+                                   adpoll_fd_info_t *data_p UNUSED,
+                                   adpoll_send_msg_htbl_info_t
+                                   *htbl_out_data UNUSED)
+{
+}
+
+#define TC13_NUM_MSGS 8
+
+/* add fd with the stalling pollout, queue TC13_NUM_MSGS sequence
+ * numbers for it and delete it once they are queued
+ */
+static void
+test_stall_queue_del(test_data_t *tdata, int fd)
+{
+    adpoll_thr_msg_t sock_msg;
+    adpoll_send_msg_htbl_info_t *send_msg_p;
+    uint32_t seq;
+
+    sock_msg.fd = fd;
+    sock_msg.fd_type = SOCKET;
+    sock_msg.fd_action = ADD_FD;
+    sock_msg.connect_pending = FALSE;
+    sock_msg.poll_events = POLLOUT;
+    sock_msg.pollin_func = NULL;
+    sock_msg.pollout_func = &test_socket_stall_out_process_func;
+    sock_msg.io_offload = FALSE;
+    g_assert_cmpint(adp_thr_mgr_add_del_fd(&tdata->tp_data, &sock_msg),
+                    ==, fd);
+
+    for (seq = 0; seq < TC13_NUM_MSGS; seq++) {
+        send_msg_p = adp_thr_mgr_msg_alloc(sizeof(seq));
+        g_assert(send_msg_p != NULL);
+        send_msg_p->data_size = sizeof(seq);
+        g_memmove(send_msg_p->data, &seq, sizeof(seq));
+        g_assert_cmpint(adp_thr_mgr_send_msg(&tdata->tp_data, fd,
+                                             send_msg_p), ==, 0);
+    }
+    /* the delete comes on another pipe, let the messages be queued */
+    g_usleep(20000);
+
+    sock_msg.fd_action = DELETE_FD;
+    sock_msg.poll_events = 0;
+    sock_msg.pollout_func = NULL;
+    adp_thr_mgr_add_del_fd(&tdata->tp_data, &sock_msg);
+}
+
+//tc_13 - messages still queued for a socket that is deleted
+//      - they are sent then, in order, if the socket takes them
+//      - if it does not they are dropped and counted, messages and
+//        bytes
+static void
+pollthread_tc_13(test_data_t *tdata,
+                 gconstpointer tudata UNUSED)
+{
+    uint32_t rcv_seq[TC13_NUM_MSGS], drops, drop_bytes, seq;
+    char fill[4096];
+    int sv[2], size = 4096;
+
+    g_test_message("test - queued messages go out on delete");
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL, 0) | O_NONBLOCK);
+    drops = adp_thr_mgr_get_tx_drops(&tdata->tp_data, &drop_bytes);
+
+    test_stall_queue_del(tdata, sv[0]);
+    close(sv[0]);
+    g_assert_cmpint(read(sv[1], rcv_seq, sizeof(rcv_seq)), ==,
+                    sizeof(rcv_seq));
+    for (seq = 0; seq < TC13_NUM_MSGS; seq++) {
+        g_assert_cmpuint(rcv_seq[seq], ==, seq);
+    }
+    g_assert_cmpuint(adp_thr_mgr_get_tx_drops(&tdata->tp_data, NULL), ==,
+                     drops);
+    close(sv[1]);
+
+    g_test_message("test - a full socket drops them");
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL, 0) | O_NONBLOCK);
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    while (write(sv[0], fill, sizeof(fill)) > 0) {
+    }
+    g_assert_cmpint(errno, ==, EAGAIN);
+
+    test_stall_queue_del(tdata, sv[0]);
+    g_assert_cmpuint(adp_thr_mgr_get_tx_drops(&tdata->tp_data, &seq), ==,
+                     drops + TC13_NUM_MSGS);
+    g_assert_cmpuint(seq, ==, drop_bytes + TC13_NUM_MSGS * sizeof(seq));
+    close(sv[0]);
+    close(sv[1]);
+}
+
+//tc_14 - io_uring socket deleted with sends buffered behind a SEND in
+//        flight to a peer that does not read
+//      - they follow it once the peer reads, and then the socket is
+//        closed
+//      - every byte queued either arrives, in order, or is counted
+//        as dropped
+static void
+pollthread_tc_14(test_data_t *tdata,
+                 gconstpointer tudata UNUSED)
+{
+    uint32_t seq_arr[TC9_MSG_SEQS], rcv_seq[TC9_MSG_SEQS];
+    uint32_t seq = 0, expect_seq = 0, drops, drop_bytes, bytes;
+    struct pollfd pfd;
+    ssize_t rv;
+    int sv[2], i, j, rcv_len = 0;
+
+    g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+    drops = adp_thr_mgr_get_tx_drops(&tdata->tp_data, &drop_bytes);
+    test_offload_add(tdata, sv[0]);
+
+    for (i = 0; i < TC9_NUM_MSGS; i++) {
+        for (j = 0; j < TC9_MSG_SEQS; j++) {
+            seq_arr[j] = seq++;
+        }
+        test_offload_queue(tdata, sv[0], seq_arr, TC9_MSG_SEQS);
+    }
+    g_usleep(300000);
+    test_offload_del(tdata, sv[0]);
+    close(sv[0]);
+
+    pfd.fd = sv[1];
+    pfd.events = POLLIN;
+    while (poll(&pfd, 1, 5000) > 0) {
+        rv = read(sv[1], (char *)rcv_seq + rcv_len,
+                  sizeof(rcv_seq) - rcv_len);
+        if (rv <= 0) {
+            break;
+        }
+        rcv_len += rv;
+        for (i = 0; i < rcv_len / (int)sizeof(seq); i++) {
+            g_assert_cmpuint(rcv_seq[i], ==, expect_seq);
+            expect_seq++;
+        }
+        g_memmove(rcv_seq, &rcv_seq[i], rcv_len % sizeof(seq));
+        rcv_len %= sizeof(seq);
+    }
+    g_assert_cmpint(rv, ==, 0);
+
+    g_assert_cmpuint(adp_thr_mgr_get_tx_drops(&tdata->tp_data, &bytes), >,
+                     drops);
+    g_assert_cmpuint(expect_seq * sizeof(seq) + rcv_len + bytes - drop_bytes,
+                     ==, seq * sizeof(seq));
+    close(sv[1]);
+}
+
 int main(int argc, char **argv)
 {
     g_test_init(&argc, &argv, NULL);
@@ -872,10 +1711,57 @@ int main(int argc, char **argv)
                "thread_tc_4",
                pollthread_start, pollthread_tc_4, pollthread_end);
     
+    /* tc_5 has no teardown, keep it last */
+    g_test_add("/pollthread/tc_6",
+               test_data_t,
+               "thread_tc_6",
+               pollthread_start, pollthread_tc_6, pollthread_end);
+
+    g_test_add("/pollthread/tc_7",
+               test_data_t,
+               "thread_tc_7",
+               pollthread_start, pollthread_tc_7, pollthread_end);
+
+    g_test_add("/pollthread/tc_8",
+               test_data_t,
+               "thread_tc_8",
+               pollthread_start, pollthread_tc_8, pollthread_end);
+
+    g_test_add("/pollthread/tc_9",
+               test_data_t,
+               "thread_iouring_tc_9",
+               pollthread_start, pollthread_tc_9, pollthread_end);
+
+    g_test_add("/pollthread/tc_10",
+               test_data_t,
+               "thread_iouring_tc_10",
+               pollthread_start, pollthread_tc_10, pollthread_end);
+
+    g_test_add("/pollthread/tc_11",
+               test_data_t,
+               "thread_nouring_tc_11",
+               pollthread_start, pollthread_tc_11, pollthread_end);
+
+    g_test_add("/pollthread/tc_12",
+               test_data_t,
+               "thread_tc_12",
+               pollthread_start, pollthread_tc_12, pollthread_end);
+
+    g_test_add("/pollthread/tc_13",
+               test_data_t,
+               "thread_tc_13",
+               pollthread_start, pollthread_tc_13, pollthread_end);
+
+    g_test_add("/pollthread/tc_14",
+               test_data_t,
+               "thread_iouring_tc_14",
+               pollthread_start, pollthread_tc_14, pollthread_end);
+
     g_test_add("/pollthread/tc_5",
                test_data_t,
                "thread_tc_5",
                pollthread_start, pollthread_tc_5, NULL);
 
+
     return g_test_run();
 }
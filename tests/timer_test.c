@@ -0,0 +1,408 @@
+/*
+*****************************************************
+**      CodeChix ONF Driver (LibCCOF)
+**      codechix.org - May the code be with you...
+**              Sept. 15, 2013
+*****************************************************
+**
+** License:        Apache 2.0 (ONF requirement)
+** Version:        0.0
+** LibraryName:    LibCCOF
+** GLIB License:   GNU LGPL
+** Description:    Test harness for pollthread timers for LibCCOF
+** Assumptions:    N/A
+** Testing:        N/A
+** Authors:        Deepa Karnad Dhurka
+**
+*****************************************************
+*/
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "cc_pollthr_mgr.h"
+#include "cc_of_global.h"
+#include "cc_log.h"
+
+#ifndef UNUSED
+#define UNUSED __attribute__ ((__unused__))
+#endif
+
+extern cc_of_global_t cc_of_global;
+
+/* timers of tc_5 */
+#define NUM_SCALE_TIMERS 100000
+
+/* Fixture data */
+typedef struct test_data_ {
+    adpoll_thread_mgr_t *tmgr;
+} test_data_t;
+
+/* a test timer and what happened to it */
+typedef struct test_timer_ {
+    adpoll_timer_t timer;
+    gint64         armed_at;
+    gint64         fired_at;
+    gint           num_fired;
+    gint           num_rearm;    /* tc_6: times to arm again */
+    gboolean       freed;
+} test_timer_t;
+
+/*  Function: timerthread_start
+ *  This is a fixture funxtion.
+ *  Initialize a poll thread with 10 max sockets
+ *  and 1 max pipes, on io_uring for the iouring tests
+ */
+static void
+timerthread_start(test_data_t *tdata,
+                  gconstpointer tudata)
+{
+    /* initialize and setup debug and logfile */
+    cc_of_global.oflog_fd = NULL;
+    cc_of_global.oflog_file = malloc(sizeof(char) *
+                                     LOG_FILE_NAME_SIZE);
+    g_mutex_init(&cc_of_global.oflog_lock);
+//    cc_of_debug_toggle(TRUE);    //enable if debugging test code
+    cc_of_log_toggle(TRUE);
+    cc_of_global.ofut_enable = TRUE;
+
+    if (strstr((char *)tudata, "iouring") != NULL) {
+        if (!adpoll_iouring_supported()) {
+            g_test_message("no io_uring in this kernel - on epoll instead");
+        }
+        tdata->tmgr = adp_thr_mgr_new_backend((char *)tudata, 10, 1,
+                                              ADPOLL_IOURING);
+    } else {
+        tdata->tmgr = adp_thr_mgr_new((char *)tudata, 10, 1);
+    }
+    g_assert(tdata->tmgr != NULL);
+}
+
+/* Function that tears down the test and cleans up */
+static void
+timerthread_end(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    g_test_message("In TIMERTHREAD_END");
+
+    if (tdata->tmgr) {
+        adp_thr_mgr_free(tdata->tmgr);
+        g_free(tdata->tmgr);
+        tdata->tmgr = NULL;
+    }
+    cc_of_log_toggle(FALSE);
+    cc_of_global.ofut_enable = FALSE;
+    g_mutex_clear(&cc_of_global.oflog_lock);
+    g_free(cc_of_global.oflog_file);
+}
+
+static void
+test_timer_func(char *tname UNUSED, adpoll_timer_t *timer)
+{
+    test_timer_t *ttimer = (test_timer_t *)timer->data;
+
+    ttimer->fired_at = g_get_monotonic_time();
+    g_atomic_int_inc(&ttimer->num_fired);
+
+    if (ttimer->num_rearm > 0) {
+        ttimer->num_rearm--;
+        ttimer->armed_at = g_get_monotonic_time();
+        g_assert_cmpint(adp_thr_mgr_timer_add(timer, 20), ==, 0);
+    }
+}
+
+static void
+test_timer_free_func(gpointer data)
+{
+    adpoll_timer_t *timer = (adpoll_timer_t *)data;
+    test_timer_t *ttimer = (test_timer_t *)timer->data;
+
+    ttimer->freed = TRUE;
+}
+
+static void
+test_timer_arm(test_data_t *tdata, test_timer_t *ttimer, uint32_t delay_ms)
+{
+    ttimer->armed_at = g_get_monotonic_time();
+    g_assert_cmpint(adp_thr_mgr_timer_arm(tdata->tmgr, &ttimer->timer,
+                                          delay_ms), ==, 0);
+}
+
+/* fired once, not before its delay and not much after */
+static void
+test_timer_check(test_timer_t *ttimer, uint32_t delay_ms)
+{
+    gint64 elapsed_ms;
+
+    g_assert_cmpint(g_atomic_int_get(&ttimer->num_fired), ==, 1);
+    elapsed_ms = (ttimer->fired_at - ttimer->armed_at) / 1000;
+    g_assert_cmpint(elapsed_ms, >=, (gint64)delay_ms - ADPOLL_TIMER_TICK_MS);
+    g_assert_cmpint(elapsed_ms, <=, (gint64)delay_ms + 200);
+}
+
+//tc_1 - timers armed from another thread expire in order
+static void
+test_timer_tc_1(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    uint32_t delay_arr[] = {300, 10, 100, 50, 0};
+    test_timer_t ttimer[sizeof(delay_arr) / sizeof(delay_arr[0])];
+    guint i, num = sizeof(delay_arr) / sizeof(delay_arr[0]);
+
+    memset(ttimer, 0, sizeof(ttimer));
+    for (i = 0; i < num; i++) {
+        adp_thr_mgr_timer_init(&ttimer[i].timer, test_timer_func, NULL,
+                               &ttimer[i]);
+        test_timer_arm(tdata, &ttimer[i], delay_arr[i]);
+        g_assert(adp_thr_mgr_timer_pending(&ttimer[i].timer));
+    }
+
+    /* the poll thread is woken for the earlier ones */
+    g_usleep(150 * 1000);
+    g_assert_cmpint(g_atomic_int_get(&ttimer[0].num_fired), ==, 0);
+    g_assert(adp_thr_mgr_timer_pending(&ttimer[0].timer));
+
+    g_usleep(400 * 1000);
+    for (i = 0; i < num; i++) {
+        test_timer_check(&ttimer[i], delay_arr[i]);
+        g_assert(!adp_thr_mgr_timer_pending(&ttimer[i].timer));
+    }
+    g_assert(ttimer[4].fired_at <= ttimer[1].fired_at);
+    g_assert(ttimer[1].fired_at <= ttimer[3].fired_at);
+    g_assert(ttimer[3].fired_at <= ttimer[2].fired_at);
+    g_assert(ttimer[2].fired_at <= ttimer[0].fired_at);
+}
+
+//tc_2 - cancelled timers do not run
+static void
+test_timer_tc_2(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    test_timer_t ttimer[100];
+    guint i;
+
+    memset(ttimer, 0, sizeof(ttimer));
+    for (i = 0; i < 100; i++) {
+        adp_thr_mgr_timer_init(&ttimer[i].timer, test_timer_func, NULL,
+                               &ttimer[i]);
+        test_timer_arm(tdata, &ttimer[i], 50 + i);
+    }
+    for (i = 0; i < 100; i += 2) {
+        g_assert(adp_thr_mgr_timer_cancel(&ttimer[i].timer));
+        g_assert(!adp_thr_mgr_timer_cancel(&ttimer[i].timer));
+    }
+
+    g_usleep(400 * 1000);
+    for (i = 0; i < 100; i++) {
+        g_assert_cmpint(g_atomic_int_get(&ttimer[i].num_fired), ==, i % 2);
+    }
+    /* too late once it ran */
+    g_assert(!adp_thr_mgr_timer_cancel(&ttimer[1].timer));
+}
+
+//tc_3 - arming an armed timer moves it
+static void
+test_timer_tc_3(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    test_timer_t ttimer;
+
+    memset(&ttimer, 0, sizeof(ttimer));
+    adp_thr_mgr_timer_init(&ttimer.timer, test_timer_func, NULL, &ttimer);
+    test_timer_arm(tdata, &ttimer, 50);
+    test_timer_arm(tdata, &ttimer, 300);
+
+    g_usleep(150 * 1000);
+    g_assert_cmpint(g_atomic_int_get(&ttimer.num_fired), ==, 0);
+
+    g_usleep(400 * 1000);
+    test_timer_check(&ttimer, 300);
+
+    /* and earlier */
+    ttimer.num_fired = 0;
+    test_timer_arm(tdata, &ttimer, 2000);
+    test_timer_arm(tdata, &ttimer, 20);
+    g_usleep(250 * 1000);
+    test_timer_check(&ttimer, 20);
+}
+
+//tc_4 - timers beyond level 0 of the wheel are cascaded down in time
+static void
+test_timer_tc_4(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    uint32_t delay_arr[] = {2550, 2600, 3000};
+    test_timer_t ttimer[3];
+    guint i;
+
+    memset(ttimer, 0, sizeof(ttimer));
+    for (i = 0; i < 3; i++) {
+        adp_thr_mgr_timer_init(&ttimer[i].timer, test_timer_func, NULL,
+                               &ttimer[i]);
+        test_timer_arm(tdata, &ttimer[i], delay_arr[i]);
+    }
+
+    g_usleep(2400 * 1000);
+    for (i = 0; i < 3; i++) {
+        g_assert_cmpint(g_atomic_int_get(&ttimer[i].num_fired), ==, 0);
+    }
+    g_usleep(900 * 1000);
+    for (i = 0; i < 3; i++) {
+        test_timer_check(&ttimer[i], delay_arr[i]);
+    }
+}
+
+//tc_5 - 100k timers each expire once
+static void
+test_timer_tc_5(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    test_timer_t *ttimer;
+    guint i, num_fired = 0, num_late = 0;
+    uint32_t delay_ms;
+    gint64 start;
+
+    ttimer = g_new0(test_timer_t, NUM_SCALE_TIMERS);
+    start = g_get_monotonic_time();
+    for (i = 0; i < NUM_SCALE_TIMERS; i++) {
+        delay_ms = g_random_int_range(0, 1000);
+        adp_thr_mgr_timer_init(&ttimer[i].timer, test_timer_func, NULL,
+                               &ttimer[i]);
+        test_timer_arm(tdata, &ttimer[i], delay_ms);
+        /* expiry as armed, to check against */
+        ttimer[i].num_rearm = 0;
+        ttimer[i].armed_at += delay_ms * 1000;
+    }
+    g_test_message("armed %d timers in %ld us", NUM_SCALE_TIMERS,
+                   (long)(g_get_monotonic_time() - start));
+
+    g_usleep(1500 * 1000);
+    for (i = 0; i < NUM_SCALE_TIMERS; i++) {
+        g_assert_cmpint(g_atomic_int_get(&ttimer[i].num_fired), ==, 1);
+        num_fired++;
+        g_assert_cmpint(ttimer[i].fired_at, >=,
+                        ttimer[i].armed_at - ADPOLL_TIMER_TICK_MS * 1000);
+        if (ttimer[i].fired_at > ttimer[i].armed_at + 100 * 1000) {
+            num_late++;
+        }
+    }
+    g_test_message("%u fired, %u more than 100ms late", num_fired, num_late);
+    g_assert_cmpuint(num_late, <, NUM_SCALE_TIMERS / 100);
+    g_free(ttimer);
+}
+
+//tc_6 - a timer armed again from its callback, on the poll thread
+static void
+test_timer_tc_6(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    test_timer_t ttimer;
+
+    memset(&ttimer, 0, sizeof(ttimer));
+    /* not on a poll thread */
+    adp_thr_mgr_timer_init(&ttimer.timer, test_timer_func, NULL, &ttimer);
+    g_assert_cmpint(adp_thr_mgr_timer_add(&ttimer.timer, 20), ==, -1);
+
+    ttimer.num_rearm = 4;
+    test_timer_arm(tdata, &ttimer, 20);
+    g_usleep(500 * 1000);
+    g_assert_cmpint(g_atomic_int_get(&ttimer.num_fired), ==, 5);
+    g_assert(!adp_thr_mgr_timer_pending(&ttimer.timer));
+}
+
+//tc_7 - timers armed when the poll thread exits are freed
+static void
+test_timer_tc_7(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    test_timer_t ttimer;
+    adpoll_thread_mgr_t *tmgr = tdata->tmgr;
+
+    memset(&ttimer, 0, sizeof(ttimer));
+    adp_thr_mgr_timer_init(&ttimer.timer, test_timer_func,
+                           test_timer_free_func, &ttimer);
+    test_timer_arm(tdata, &ttimer, 60 * 1000);
+
+    adp_thr_mgr_free(tmgr);
+    g_free(tmgr);
+    tdata->tmgr = NULL;
+
+    g_assert(ttimer.freed);
+    g_assert_cmpint(ttimer.num_fired, ==, 0);
+}
+
+//tc_8 - io_uring: a short timer armed while the poll thread waits out
+//       its idle timeout fires on time, as do its re-arms
+static void
+test_timer_tc_8(test_data_t *tdata,
+                gconstpointer tudata UNUSED)
+{
+    test_timer_t ttimer;
+
+    /* the poll thread is in its 10s idle wait */
+    g_usleep(100 * 1000);
+
+    memset(&ttimer, 0, sizeof(ttimer));
+    adp_thr_mgr_timer_init(&ttimer.timer, test_timer_func, NULL, &ttimer);
+    test_timer_arm(tdata, &ttimer, 20);
+    g_usleep(150 * 1000);
+    test_timer_check(&ttimer, 20);
+
+    /* armed again on the poll thread, without a wake up */
+    ttimer.num_fired = 0;
+    ttimer.num_rearm = 4;
+    test_timer_arm(tdata, &ttimer, 20);
+    g_usleep(400 * 1000);
+    g_assert_cmpint(g_atomic_int_get(&ttimer.num_fired), ==, 5);
+    g_assert_cmpint((ttimer.fired_at - ttimer.armed_at) / 1000, <=, 100);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/timer/tc_1",
+               test_data_t,
+               "timer_tc_1",
+               timerthread_start, test_timer_tc_1, timerthread_end);
+
+    g_test_add("/timer/tc_2",
+               test_data_t,
+               "timer_tc_2",
+               timerthread_start, test_timer_tc_2, timerthread_end);
+
+    g_test_add("/timer/tc_3",
+               test_data_t,
+               "timer_tc_3",
+               timerthread_start, test_timer_tc_3, timerthread_end);
+
+    g_test_add("/timer/tc_4",
+               test_data_t,
+               "timer_tc_4",
+               timerthread_start, test_timer_tc_4, timerthread_end);
+
+    g_test_add("/timer/tc_5",
+               test_data_t,
+               "timer_tc_5",
+               timerthread_start, test_timer_tc_5, timerthread_end);
+
+    g_test_add("/timer/tc_6",
+               test_data_t,
+               "timer_tc_6",
+               timerthread_start, test_timer_tc_6, timerthread_end);
+
+    g_test_add("/timer/tc_7",
+               test_data_t,
+               "timer_tc_7",
+               timerthread_start, test_timer_tc_7, timerthread_end);
+
+    g_test_add("/timer/tc_8",
+               test_data_t,
+               "timer_iouring_tc_8",
+               timerthread_start, test_timer_tc_8, timerthread_end);
+
+    return g_test_run();
+}
@@ -39,6 +39,7 @@
 #include "cc_of_lib.h"
 #include "cc_tcp_conn.h"
 #include "cc_udp_conn.h"
+#include "cc_of_msg.h"
 
 
 #ifndef UNUSED
@@ -51,8 +52,6 @@
 
 //extern cc_of_global_t cc_of_global;
 extern
-gboolean cc_ofrw_htbl_equal_func(gconstpointer a, gconstpointer b);
-extern
 gboolean cc_ofchannel_htbl_equal_func(gconstpointer a, gconstpointer b);
 extern
 gboolean cc_ofdev_htbl_equal_func(gconstpointer a, gconstpointer b);
@@ -125,13 +124,15 @@ util_start(test_data_t *tdata,
                                                         cc_of_destroy_generic);
     g_assert(cc_of_global.ofchannel_htbl != NULL);
 
+    cc_of_global.ofchann_fd_htbl = g_hash_table_new_full(g_direct_hash,
+                                                         g_direct_equal,
+                                                         NULL,
+                                                         cc_of_destroy_generic);
+    g_assert(cc_of_global.ofchann_fd_htbl != NULL);
+    cc_ofchann_rtbl_init(&cc_of_global.ofchann_rtbl);
 
-    cc_of_global.ofrw_htbl = g_hash_table_new_full(cc_ofrw_hash_func,
-                                                   cc_ofrw_htbl_equal_func,
-                                                   cc_of_destroy_generic,
-                                                   cc_of_destroy_generic);
 
-    g_assert (cc_of_global.ofrw_htbl != NULL);
+    g_assert(cc_ofrw_tbl_init(&cc_of_global.ofrw_tbl) == CC_OF_OK);
 
    
     cc_of_log_clear();
@@ -288,7 +289,7 @@ util_tc_1(test_data_t *tdata, gconstpointer tudata)
     list_elem = (adpoll_thread_mgr_t *)first_elem_list->data;
     
     g_assert_cmpstr(list_elem->tname, ==, tdata->tp_data[0].tname);
-    g_assert_cmpuint(list_elem->num_sockets, ==, tdata->tp_data[0].num_sockets);
+    g_assert_cmpint(list_elem->num_sockets, ==, tdata->tp_data[0].num_sockets);
     g_assert_cmpuint(list_elem->num_pipes, ==, tdata->tp_data[0].num_pipes);
     g_assert_cmpuint(list_elem->max_sockets, ==, tdata->tp_data[0].max_sockets);
     g_assert_cmpuint(list_elem->max_pipes, ==, tdata->tp_data[0].max_pipes);
@@ -378,9 +379,15 @@ receive_packet_process_func(uint64_t dp_id, uint8_t aux_id,
                     __FUNCTION__, __LINE__, dp_id, aux_id);
         return 0;
     } else {
-        g_memmove(in_str,of_msg,of_msg_len);
+        /* one whole OF message: header + payload_str */
+        g_assert_cmpuint(of_msg_len, ==,
+                         OFP_HEADER_LEN + strlen(payload_str) + 1);
+        g_assert_cmpuint(ntohs(((ofp_header_t *)of_msg)->length), ==,
+                         of_msg_len);
+        g_memmove(in_str, (char *)of_msg + OFP_HEADER_LEN,
+                  of_msg_len - OFP_HEADER_LEN);
         CC_LOG_DEBUG("size of message is %d", of_msg_len);
-        in_str[of_msg_len] = 0;
+        in_str[of_msg_len - OFP_HEADER_LEN] = 0;
         CC_LOG_DEBUG("%s: WOOOHOOOO message received %s", __FUNCTION__,
                      in_str);
     }
@@ -397,7 +404,8 @@ util_tc_2(test_data_t *tdata UNUSED, gconstpointer tudata)
     gint32 num_fds = 0;
     cc_ofdev_key_t devkey;
     cc_of_ret retval;
-    char send_buf[1024];
+    adpoll_send_msg_htbl_info_t *send_msg_p;
+    ofp_header_t *of_hdr;
     int clientfd;
     cc_of_ret client_status = CC_OF_OK;
     int optval = 1;
@@ -485,6 +493,7 @@ util_tc_2(test_data_t *tdata UNUSED, gconstpointer tudata)
     thr_msg.poll_events = POLLIN | POLLOUT;
     thr_msg.pollin_func = &process_tcpfd_pollin_func;
     thr_msg.pollout_func = &process_tcpfd_pollout_func;
+    thr_msg.connect_pending = FALSE;
     
     client_status = cc_add_sockfd_rw_pollthr(&thr_msg, devkey, TCP, ofchann_key);
     if (client_status < 0) {
@@ -504,18 +513,32 @@ util_tc_2(test_data_t *tdata UNUSED, gconstpointer tudata)
 
 
     /* now write to the client FD and test on pollin for RW FD */
-    ((adpoll_send_msg_t *)send_buf)->hdr.msg_size =
-        sizeof(adpoll_send_msg_t) + strlen(payload_str) + 1;
-    
-    ((adpoll_send_msg_t *)send_buf)->hdr.fd = clientfd;
-    
-    g_memmove(((adpoll_send_msg_t *)send_buf)->data,
-              payload_str, strlen(payload_str) + 1);
-
     find_thrmgr_rwsocket_lockfree(clientfd, &tmgr);
 
     g_assert_cmpstr(tmgr->tname, ==, "rwthr_1");
 
+    /* the accepted channel delivers nothing before the hello exchange */
+    send_msg_p = adp_thr_mgr_msg_alloc(CC_OF_MSG_HELLO_MAX_LEN);
+    g_assert(send_msg_p != NULL);
+    send_msg_p->data_size =
+        cc_of_msg_hello_build(send_msg_p->data,
+                              cc_of_msg_version_bitmap(CC_OFVER_1_3_1), 1);
+    g_assert_cmpint(adp_thr_mgr_send_msg(tmgr, clientfd, send_msg_p), ==, 0);
+
+    /* the library delivers whole OF messages - frame the payload */
+    send_msg_p = adp_thr_mgr_msg_alloc(OFP_HEADER_LEN +
+                                       strlen(payload_str) + 1);
+    g_assert(send_msg_p != NULL);
+    send_msg_p->data_size = OFP_HEADER_LEN + strlen(payload_str) + 1;
+    
+    of_hdr = (ofp_header_t *)send_msg_p->data;
+    of_hdr->version = 4;
+    of_hdr->type = 10; /* PACKET_IN */
+    of_hdr->length = htons(send_msg_p->data_size);
+    of_hdr->xid = htonl(2);
+    g_memmove(send_msg_p->data + OFP_HEADER_LEN, payload_str,
+              strlen(payload_str) + 1);
+
     CC_LOG_DEBUG("%s(%d) found the rw thread for client sockfd %d",
                  __FUNCTION__, __LINE__, clientfd);
 
@@ -525,8 +548,7 @@ util_tc_2(test_data_t *tdata UNUSED, gconstpointer tudata)
     }
     datapipe_fd = adp_thr_mgr_get_data_pipe_wr(tmgr);
     
-    write(datapipe_fd, send_buf,
-          ((adpoll_send_msg_t *)send_buf)->hdr.msg_size);
+    g_assert_cmpint(adp_thr_mgr_send_msg(tmgr, clientfd, send_msg_p), ==, 0);
 
     CC_LOG_DEBUG("%s(%d): wrote to data pipe %d", __FUNCTION__, __LINE__, datapipe_fd);
 
@@ -538,6 +560,514 @@ util_tc_2(test_data_t *tdata UNUSED, gconstpointer tudata)
 }
 
 
+//tc_3 - socket to channel key index follows the channel through
+//       add, re-key with the real dp_id/aux_id and delete
+// do not use fixture data
+static void
+util_tc_3(test_data_t *tdata UNUSED, gconstpointer tudata UNUSED)
+{
+    cc_ofchannel_key_t chann_key, *fd_chann_key = NULL;
+    int sockfd = 55;
+
+    /* controller: dummy dp_id/aux_id from the socket until FEATURES */
+    chann_key.dp_id = (uint64_t)sockfd;
+    chann_key.aux_id = (uint8_t)sockfd;
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_assert(add_upd_ofchann_rwsocket(chann_key, sockfd) == CC_OF_OK);
+    g_assert(find_ofchann_key_rwsocket(sockfd, &fd_chann_key) == CC_OF_OK);
+    g_assert_cmpuint(fd_chann_key->dp_id, ==, sockfd);
+    g_assert_cmpuint(fd_chann_key->aux_id, ==, sockfd);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+
+    g_assert(cc_of_set_real_dpid_auxid(sockfd, sockfd,
+                                       0x1234, 2) == CC_OF_OK);
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_assert(find_ofchann_key_rwsocket(sockfd, &fd_chann_key) == CC_OF_OK);
+    g_assert_cmpuint(fd_chann_key->dp_id, ==, 0x1234);
+    g_assert_cmpuint(fd_chann_key->aux_id, ==, 2);
+    g_assert_cmpuint(g_hash_table_size(cc_of_global.ofchannel_htbl), ==, 1);
+
+    g_assert(del_ofchann_rwsocket(sockfd) == CC_OF_OK);
+    g_test_expect_message(CC_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                          "*could not find channel_key*");
+    g_assert(find_ofchann_key_rwsocket(sockfd,
+                                       &fd_chann_key) == CC_OF_EHTBL);
+    g_test_assert_expected_messages();
+    g_assert_cmpuint(g_hash_table_size(cc_of_global.ofchannel_htbl), ==, 0);
+    g_assert_cmpuint(g_hash_table_size(cc_of_global.ofchann_fd_htbl), ==, 0);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+}
+
+//tc_4 - rw socket table: a reused fd gets a new generation, walks see
+//       only the sockets in use, a dummy UDP fd above MAX_OPEN_FILES
+//       has a slot, an fd beyond the reserved slots is refused
+// do not use fixture data
+static void
+util_tc_4(test_data_t *tdata UNUSED, gconstpointer tudata UNUSED)
+{
+    cc_ofrw_key_t rw_key;
+    cc_ofrw_info_t rw_info, *found = NULL;
+    gboolean new_entry;
+    uint32_t gen;
+    int fd, num_fds = 0;
+
+    memset(&rw_info, 0, sizeof(rw_info));
+    rw_info.layer4_proto = TCP;
+
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    rw_key.rw_sockfd = 40;
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    g_assert(new_entry == TRUE);
+    gen = cc_ofrw_get_gen(40);
+
+    rw_info.state = CC_OF_RW_UP;
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    g_assert(new_entry == FALSE);
+    g_assert_cmpuint(cc_ofrw_get_gen(40), ==, gen);
+    g_assert(cc_ofrw_lookup(40)->state == CC_OF_RW_UP);
+
+    /* fd closed and handed out again */
+    g_assert(cc_ofrw_tbl_update(DEL, &rw_key, NULL,
+                                &new_entry) == CC_OF_OK);
+    g_assert(cc_ofrw_lookup(40) == NULL);
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    g_assert(new_entry == TRUE);
+    g_assert_cmpuint(cc_ofrw_get_gen(40), !=, gen);
+
+    rw_key.rw_sockfd = MAX_OPEN_FILES + 1;
+    rw_info.layer4_proto = UDP;
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    g_assert(cc_ofrw_lookup(40)->layer4_proto == TCP);
+    g_assert(cc_ofrw_lookup(MAX_OPEN_FILES + 1)->layer4_proto == UDP);
+
+    fd = -1;
+    while (cc_ofrw_iter_next(&fd, &found)) {
+        g_assert(fd == 40 || fd == MAX_OPEN_FILES + 1);
+        num_fds++;
+    }
+    g_assert_cmpint(num_fds, ==, 2);
+    g_assert_cmpuint(cc_of_global.ofrw_tbl.count, ==, 2);
+
+    rw_key.rw_sockfd = CC_OFRW_TBL_SLOTS;
+    g_test_expect_message(CC_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                          "*beyond the*");
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_EINVAL);
+    g_test_assert_expected_messages();
+    rw_key.rw_sockfd = MAX_OPEN_FILES + 1;
+
+    g_assert(cc_ofrw_tbl_update(DEL, &rw_key, NULL,
+                                &new_entry) == CC_OF_OK);
+    rw_key.rw_sockfd = 40;
+    g_assert(cc_ofrw_tbl_update(DEL, &rw_key, NULL,
+                                &new_entry) == CC_OF_OK);
+    fd = -1;
+    g_assert(cc_ofrw_iter_next(&fd, &found) == FALSE);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+}
+
+//tc_5 - channel send routes follow the channel htbl: a route has no
+//       poll thread until one is recorded with the socket to send on
+//       and its generation, is found past a busy writer, survives shard
+//       growth and backward shifts on delete, and goes with the channel
+// do not use fixture data
+static void
+util_tc_5(test_data_t *tdata UNUSED, gconstpointer tudata UNUSED)
+{
+    cc_ofchannel_key_t chann_key;
+    adpoll_thread_mgr_t *tmgr = NULL;
+    adpoll_thread_mgr_t *dummy_tmgr = (adpoll_thread_mgr_t *)&chann_key;
+    uint32_t fd_gen;
+    int sockfd = 0, i;
+
+    chann_key.dp_id = 0x1234;
+    chann_key.aux_id = 1;
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_assert(add_upd_ofchann_rwsocket(chann_key, 60) == CC_OF_OK);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+
+    g_assert(cc_ofchann_route_lookup(0x1234, 1, &sockfd, &fd_gen,
+                                     &tmgr) == CC_OF_EAGAIN);
+    g_assert_cmpint(sockfd, ==, 60);
+    /* sent on another socket, as a controller's UDP channels are */
+    cc_ofchann_route_set_thr(&chann_key, 61, 7, dummy_tmgr);
+    g_assert(cc_ofchann_route_lookup(0x1234, 1, &sockfd, &fd_gen,
+                                     &tmgr) == CC_OF_OK);
+    g_assert(tmgr == dummy_tmgr);
+    g_assert_cmpint(sockfd, ==, 61);
+    g_assert_cmpuint(fd_gen, ==, 7);
+
+    /* a writer that never leaves the shard: found under the lock */
+    for (i = 0; i < CC_OFCHANN_SHARDS; i++) {
+        g_atomic_int_inc(&cc_of_global.ofchann_rtbl.shard[i].seq);
+    }
+    sockfd = 0;
+    g_assert(cc_ofchann_route_lookup(0x1234, 1, &sockfd, &fd_gen,
+                                     &tmgr) == CC_OF_OK);
+    g_assert_cmpint(sockfd, ==, 61);
+    for (i = 0; i < CC_OFCHANN_SHARDS; i++) {
+        g_atomic_int_inc(&cc_of_global.ofchann_rtbl.shard[i].seq);
+    }
+
+    /* 256 channels of one switch share a shard */
+    for (i = 0; i < 256; i++) {
+        chann_key.dp_id = 0x5678;
+        chann_key.aux_id = i;
+        cc_ofchann_route_add(&chann_key, 1000 + i);
+    }
+    for (i = 0; i < 256; i += 2) {
+        chann_key.aux_id = i;
+        cc_ofchann_route_del(&chann_key);
+    }
+    for (i = 0; i < 256; i++) {
+        if (i % 2) {
+            g_assert(cc_ofchann_route_lookup(0x5678, i, &sockfd, &fd_gen,
+                                             &tmgr) == CC_OF_EAGAIN);
+            g_assert_cmpint(sockfd, ==, 1000 + i);
+        } else {
+            g_assert(cc_ofchann_route_lookup(0x5678, i, &sockfd, &fd_gen,
+                                             &tmgr) == CC_OF_EHTBL);
+        }
+    }
+    for (i = 1; i < 256; i += 2) {
+        chann_key.aux_id = i;
+        cc_ofchann_route_del(&chann_key);
+    }
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_assert(del_ofchann_rwsocket(60) == CC_OF_OK);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    g_assert(cc_ofchann_route_lookup(0x1234, 1, &sockfd, &fd_gen,
+                                     &tmgr) == CC_OF_EHTBL);
+}
+
+//tc_6 - UDP peers are found by address, as recvfrom returns it, and
+//       leave the index with their dummy fd
+// do not use fixture data
+static void
+util_tc_6(test_data_t *tdata UNUSED, gconstpointer tudata UNUSED)
+{
+    cc_ofrw_key_t rw_key;
+    cc_ofrw_info_t rw_info;
+    struct sockaddr_in peer_addr;
+    gboolean new_entry;
+
+    memset(&peer_addr, 0, sizeof(peer_addr));
+    peer_addr.sin_family = AF_INET;
+    peer_addr.sin_addr.s_addr = inet_addr("10.1.2.3");
+    peer_addr.sin_port = htons(6633);
+
+    memset(&rw_info, 0, sizeof(rw_info));
+    rw_info.layer4_proto = UDP;
+    memcpy(&rw_info.client_addr, &peer_addr, sizeof(peer_addr));
+    rw_key.rw_sockfd = MAX_OPEN_FILES + 7;
+
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    g_assert_cmpint(cc_ofrw_lookup_peer(&peer_addr), ==, -1);
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    g_assert_cmpint(cc_ofrw_lookup_peer(&peer_addr), ==, MAX_OPEN_FILES + 7);
+
+    /* same address, another port */
+    peer_addr.sin_port = htons(6634);
+    g_assert_cmpint(cc_ofrw_lookup_peer(&peer_addr), ==, -1);
+    peer_addr.sin_port = htons(6633);
+
+    g_assert(cc_ofrw_tbl_update(DEL, &rw_key, NULL,
+                                &new_entry) == CC_OF_OK);
+    g_assert_cmpint(cc_ofrw_lookup_peer(&peer_addr), ==, -1);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+}
+
+//tc_7 - sockets that are to be served by different poll threads (the
+//       SO_REUSEPORT UDP sockets of a device) get a new thread once the
+//       existing ones are excluded
+static void
+util_tc_7(test_data_t *tdata UNUSED, gconstpointer tudata UNUSED)
+{
+    adpoll_thread_mgr_t *tmgr1 = NULL, *tmgr2 = NULL, *tmgr = NULL;
+    GList *excl_list = NULL;
+
+    g_assert_cmpuint(cc_get_count_rw_pollthr(), ==, 1);
+    g_assert(cc_find_or_create_rw_pollthr_excl(NULL,
+                                               &tmgr1) == CC_OF_OK);
+    g_assert_cmpuint(cc_get_count_rw_pollthr(), ==, 1);
+
+    excl_list = g_list_prepend(excl_list, tmgr1);
+    g_assert(cc_find_or_create_rw_pollthr_excl(excl_list,
+                                               &tmgr2) == CC_OF_OK);
+    g_assert(tmgr2 != tmgr1);
+    g_assert_cmpuint(cc_get_count_rw_pollthr(), ==, 2);
+
+    /* without exclusions an existing thread is used */
+    g_assert(cc_find_or_create_rw_pollthr_excl(NULL,
+                                               &tmgr) == CC_OF_OK);
+    g_assert((tmgr == tmgr1) || (tmgr == tmgr2));
+    g_assert_cmpuint(cc_get_count_rw_pollthr(), ==, 2);
+    g_list_free(excl_list);
+}
+
+/* what test_mp_reply was last called with */
+static uint32_t test_mp_calls, test_mp_parts;
+static cc_of_ret test_mp_status;
+static size_t test_mp_len;
+
+static void
+test_mp_reply(uint64_t dp_id UNUSED, uint8_t aux_id UNUSED,
+              uint32_t xid UNUSED, cc_of_msg_part_t *parts,
+              uint32_t num_parts, cc_of_ret status, void *reply_ctx UNUSED)
+{
+    uint32_t i;
+
+    test_mp_calls++;
+    test_mp_parts = num_parts;
+    test_mp_status = status;
+    test_mp_len = 0;
+    for (i = 0; i < num_parts; i++) {
+        test_mp_len += parts[i].of_msg_len;
+    }
+}
+
+//tc_8 - parts of a multipart reply are gathered by the request waiting
+//       for it and passed on together with the last one; messages with
+//       other xids are not replies to it
+static void
+util_tc_8(test_data_t *tdata UNUSED, gconstpointer tudata UNUSED)
+{
+    cc_ofrw_ctx_t *ctx;
+    cc_of_xid_req_t *req;
+    char msg[OFP_HEADER_LEN + 8];
+    ofp_header_t *hdr = (ofp_header_t *)msg;
+    uint16_t flags = htons(OFPMPF_REPLY_MORE);
+    int i;
+
+    memset(msg, 0, sizeof(msg));
+    hdr->version = OFP_VERSION_1_3;
+    hdr->type = OFPT13_MULTIPART_REPLY;
+    hdr->length = htons(sizeof(msg));
+    hdr->xid = htonl(7);
+    memcpy(msg + OFP_MULTIPART_FLAGS_OFF, &flags, sizeof(flags));
+
+    ctx = cc_ofrw_ctx_new(TCP);
+    req = cc_of_xid_req_new(1, 0, 7, 0, NULL, test_mp_reply, NULL);
+    cc_ofrw_xid_req_add(ctx, req);
+
+    test_mp_calls = 0;
+    for (i = 0; i < 3; i++) {
+        g_assert(cc_ofrw_xid_lookup(ctx, msg) == req);
+        cc_ofrw_xid_reply(req, msg, sizeof(msg));
+    }
+    g_assert_cmpuint(test_mp_calls, ==, 0);
+
+    hdr->xid = htonl(8);
+    g_assert(cc_ofrw_xid_lookup(ctx, msg) == NULL);
+    hdr->xid = htonl(7);
+    hdr->type = OFPT_PACKET_IN;
+    g_assert(cc_ofrw_xid_lookup(ctx, msg) == NULL);
+
+    /* last part */
+    hdr->type = OFPT13_MULTIPART_REPLY;
+    flags = 0;
+    memcpy(msg + OFP_MULTIPART_FLAGS_OFF, &flags, sizeof(flags));
+    cc_ofrw_xid_reply(cc_ofrw_xid_lookup(ctx, msg), msg, sizeof(msg));
+    g_assert_cmpuint(test_mp_calls, ==, 1);
+    g_assert_cmpuint(test_mp_parts, ==, 4);
+    g_assert_cmpuint(test_mp_len, ==, 4 * sizeof(msg));
+    g_assert_cmpint(test_mp_status, ==, CC_OF_OK);
+    g_assert(cc_ofrw_xid_lookup(ctx, msg) == NULL);
+
+    /* a request still waiting gets its parts when the channel goes */
+    req = cc_of_xid_req_new(1, 0, 9, 0, NULL, test_mp_reply, NULL);
+    cc_ofrw_xid_req_add(ctx, req);
+    hdr->xid = htonl(9);
+    flags = htons(OFPMPF_REPLY_MORE);
+    memcpy(msg + OFP_MULTIPART_FLAGS_OFF, &flags, sizeof(flags));
+    cc_ofrw_xid_reply(cc_ofrw_xid_lookup(ctx, msg), msg, sizeof(msg));
+    cc_ofrw_ctx_free(ctx);
+    g_assert_cmpuint(test_mp_calls, ==, 2);
+    g_assert_cmpuint(test_mp_parts, ==, 1);
+    g_assert_cmpint(test_mp_status, ==, CC_OF_ECHANN);
+}
+
+//tc_9 - reconnect backoff: each retry doubles the delay up to the cap,
+//       less up to half of it as jitter
+static void
+util_tc_9(test_data_t *tdata UNUSED, gconstpointer tudata UNUSED)
+{
+    uint32_t retry, delay, max_delay, i;
+
+    cc_of_global.ofreconn_base_ms = 100;
+    cc_of_global.ofreconn_max_ms = 1000;
+    for (retry = 1; retry <= 8; retry++) {
+        max_delay = MIN(100 << (retry - 1), 1000);
+        for (i = 0; i < 100; i++) {
+            delay = cc_ofchann_reconnect_delay(retry);
+            g_assert_cmpuint(delay, >=, max_delay / 2);
+            g_assert_cmpuint(delay, <=, max_delay);
+        }
+    }
+    /* no overflow however many retries */
+    g_assert_cmpuint(cc_ofchann_reconnect_delay(UINT32_MAX), <=, 1000);
+    g_assert_cmpuint(cc_ofchann_reconnect_delay(UINT32_MAX), >=, 500);
+
+    cc_of_global.ofreconn_max_ms = 100;
+    g_assert_cmpuint(cc_ofchann_reconnect_delay(5), <=, 100);
+}
+
+//tc_10 - dummy fds of UDP peers: one that is freed is handed out again,
+//        and there are no more than CC_OFRW_UDP_PEERS_MAX
+// do not use fixture data
+static void
+util_tc_10(test_data_t *tdata UNUSED, gconstpointer tudata UNUSED)
+{
+    cc_ofrw_key_t rw_key;
+    cc_ofrw_info_t rw_info;
+    gboolean new_entry;
+    uint32_t gen;
+    int fd, i;
+
+    memset(&rw_info, 0, sizeof(rw_info));
+    rw_info.layer4_proto = UDP;
+
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    fd = cc_ofrw_dummy_fd_alloc();
+    g_assert_cmpint(fd, ==, MAX_OPEN_FILES);
+    rw_key.rw_sockfd = fd;
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    gen = cc_ofrw_get_gen(fd);
+    g_assert_cmpint(cc_ofrw_dummy_fd_alloc(), ==, MAX_OPEN_FILES + 1);
+
+    /* the peer goes away, the next one gets its fd */
+    g_assert(cc_ofrw_tbl_update(DEL, &rw_key, NULL,
+                                &new_entry) == CC_OF_OK);
+    g_assert_cmpint(cc_ofrw_dummy_fd_alloc(), ==, fd);
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    g_assert_cmpuint(cc_ofrw_get_gen(fd), !=, gen);
+
+    for (i = 2; i < CC_OFRW_UDP_PEERS_MAX; i++) {
+        g_assert_cmpint(cc_ofrw_dummy_fd_alloc(), ==, MAX_OPEN_FILES + i);
+    }
+    g_assert_cmpint(cc_ofrw_dummy_fd_alloc(), ==, -1);
+
+    g_assert(cc_ofrw_tbl_update(DEL, &rw_key, NULL,
+                                &new_entry) == CC_OF_OK);
+    g_assert_cmpint(cc_ofrw_dummy_fd_alloc(), ==, fd);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+}
+
+
+static int
+test_chann_ready(uint64_t dp_id UNUSED, uint8_t aux_id UNUSED,
+                 uint32_t client_ip UNUSED, uint16_t client_port UNUSED)
+{
+    return 0;
+}
+
+//tc_11 - cached rw socket contexts: a change to one socket's rw entry
+//        refreshes only that socket's context, a device callback
+//        registered refreshes all the sockets of the device
+// do not use fixture data
+static void
+util_tc_11(test_data_t *tdata UNUSED, gconstpointer tudata UNUSED)
+{
+    cc_ofdev_key_t dkey, *dkey_p;
+    cc_ofdev_info_t *dinfo_p;
+    cc_ofchannel_key_t chann_key;
+    cc_ofrw_key_t rw_key;
+    cc_ofrw_info_t rw_info;
+    cc_ofrw_ctx_t *ctx_a, *ctx_b;
+    gboolean new_entry;
+
+    memset(&dkey, 0, sizeof(dkey));
+    dkey.controller_ip_addr = 0x0a000001;
+    dkey.controller_L4_port = 6653;
+    dkey_p = (cc_ofdev_key_t *)g_malloc(sizeof(cc_ofdev_key_t));
+    *dkey_p = dkey;
+    dinfo_p = (cc_ofdev_info_t *)g_malloc0(sizeof(cc_ofdev_info_t));
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    g_hash_table_insert(cc_of_global.ofdev_htbl, dkey_p, dinfo_p);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+
+    memset(&rw_info, 0, sizeof(rw_info));
+    rw_info.layer4_proto = TCP;
+    rw_info.state = CC_OF_RW_DOWN;
+    rw_info.parent_sockfd = -1;
+    rw_info.dev_key = dkey;
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    rw_key.rw_sockfd = 50;
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    rw_key.rw_sockfd = 51;
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    chann_key.aux_id = 0;
+    chann_key.dp_id = 1;
+    g_assert(add_upd_ofchann_rwsocket(chann_key, 50) == CC_OF_OK);
+    chann_key.dp_id = 2;
+    g_assert(add_upd_ofchann_rwsocket(chann_key, 51) == CC_OF_OK);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+
+    ctx_a = cc_ofrw_ctx_new(TCP);
+    ctx_b = cc_ofrw_ctx_new(TCP);
+    cc_ofrw_ctx_update(50, ctx_a);
+    cc_ofrw_ctx_update(51, ctx_b);
+    g_assert(ctx_a->found && ctx_b->found);
+    g_assert_cmpuint(ctx_a->chann_key.dp_id, ==, 1);
+    g_assert_cmpuint(ctx_b->chann_key.dp_id, ==, 2);
+    g_assert(ctx_a->state == CC_OF_RW_DOWN);
+
+    g_test_message("test - only the socket that changed refreshes");
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    /* behind the table's back, so only a refresh would see it */
+    cc_ofrw_lookup(50)->state = CC_OF_RW_UP;
+    rw_info.state = CC_OF_RW_UP;
+    g_assert(cc_ofrw_tbl_update(ADD, &rw_key, &rw_info,
+                                &new_entry) == CC_OF_OK);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+
+    cc_ofrw_ctx_update(50, ctx_a);
+    cc_ofrw_ctx_update(51, ctx_b);
+    g_assert(ctx_a->state == CC_OF_RW_DOWN);
+    g_assert(ctx_b->state == CC_OF_RW_UP);
+
+    g_test_message("test - a device callback refreshes its sockets");
+    g_assert(cc_of_dev_register_chann_ready(dkey.controller_ip_addr,
+                                            dkey.switch_ip_addr,
+                                            dkey.controller_L4_port,
+                                            test_chann_ready) == CC_OF_OK);
+    cc_ofrw_ctx_update(50, ctx_a);
+    cc_ofrw_ctx_update(51, ctx_b);
+    g_assert(ctx_a->state == CC_OF_RW_UP);
+    g_assert(ctx_a->chann_ready_func == test_chann_ready);
+    g_assert(ctx_b->chann_ready_func == test_chann_ready);
+
+    g_mutex_lock(&cc_of_global.ofchannel_htbl_lock);
+    g_assert(del_ofchann_rwsocket(50) == CC_OF_OK);
+    g_assert(del_ofchann_rwsocket(51) == CC_OF_OK);
+    g_mutex_unlock(&cc_of_global.ofchannel_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofrw_htbl_lock);
+    g_assert(del_ofrw_rwsocket(50) == CC_OF_OK);
+    g_assert(del_ofrw_rwsocket(51) == CC_OF_OK);
+    g_mutex_unlock(&cc_of_global.ofrw_htbl_lock);
+    g_mutex_lock(&cc_of_global.ofdev_htbl_lock);
+    g_hash_table_remove(cc_of_global.ofdev_htbl, &dkey);
+    g_mutex_unlock(&cc_of_global.ofdev_htbl_lock);
+    cc_ofrw_ctx_free(ctx_a);
+    cc_ofrw_ctx_free(ctx_b);
+}
+
 int main(int argc, char **argv)
 {
     g_test_init(&argc, &argv, NULL);
@@ -551,6 +1081,51 @@ int main(int argc, char **argv)
                test_data_t,
               "rwthr_1",
                util_start, util_tc_2, util_end);
+
+    g_test_add("/util/tc_3",
+               test_data_t,
+               "rwthr_1",
+               util_start, util_tc_3, util_end);
+
+    g_test_add("/util/tc_4",
+               test_data_t,
+               "rwthr_1",
+               util_start, util_tc_4, util_end);
+
+    g_test_add("/util/tc_5",
+               test_data_t,
+               "rwthr_1",
+               util_start, util_tc_5, util_end);
+
+    g_test_add("/util/tc_6",
+               test_data_t,
+               "rwthr_1",
+               util_start, util_tc_6, util_end);
+
+    g_test_add("/util/tc_7",
+               test_data_t,
+               "rwthr_1",
+               util_start, util_tc_7, util_end);
+
+    g_test_add("/util/tc_8",
+               test_data_t,
+               "rwthr_1",
+               util_start, util_tc_8, util_end);
+
+    g_test_add("/util/tc_9",
+               test_data_t,
+               "rwthr_1",
+               util_start, util_tc_9, util_end);
+
+    g_test_add("/util/tc_10",
+               test_data_t,
+               "rwthr_1",
+               util_start, util_tc_10, util_end);
+
+    g_test_add("/util/tc_11",
+               test_data_t,
+               "rwthr_1",
+               util_start, util_tc_11, util_end);
     
     return g_test_run();
 }